@@ -0,0 +1,287 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+}
+#include "./AccessLog.h"
+#include "./JsonWriter.h"
+#include "./Metrics.h"
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// static
+const uint64_t AccessLog::kDefaultMaxBytes = 64 << 20;
+
+// static
+const int AccessLog::kDefaultMaxAgeSeconds = 24 * 60 * 60;
+
+// static
+const int AccessLog::kKeepFiles = 5;
+
+// static
+const int AccessLog::kFlushMs = 100;
+
+// static
+const size_t AccessLog::kRingSize = 1024;
+
+// Hands out the logs' ids.
+static std::atomic<uint64_t> next_log_id(1);
+
+// Returns the time since the epoch in nanoseconds.
+static uint64_t RealtimeNs() {
+  struct timespec now;
+  Verify333(clock_gettime(CLOCK_REALTIME, &now) == 0);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Writes all "len" bytes of "data" to "fd", giving up on an error.
+static void WriteAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t res = write(fd, data, len);
+    if (res == -1 && errno == EINTR) {
+      continue;
+    }
+    if (res <= 0) {
+      return;
+    }
+    data += res;
+    len -= res;
+  }
+}
+
+AccessLog::AccessLog(const string& path, uint64_t max_bytes, int max_age_s)
+  : id_(next_log_id++), path_(path), max_bytes_(max_bytes),
+    max_age_s_(max_age_s), fd_(-1), file_bytes_(0), opened_ns_(0),
+    written_(0), dropped_reported_(0), stopping_(false) {
+  Open();
+  Start();
+}
+
+AccessLog::AccessLog()
+  : id_(next_log_id++), max_bytes_(0), max_age_s_(0), fd_(STDOUT_FILENO),
+    file_bytes_(0), opened_ns_(0), written_(0), dropped_reported_(0),
+    stopping_(false) {
+  Start();
+}
+
+void AccessLog::Start() {
+  Verify333(pthread_mutex_init(&rings_lock_, nullptr) == 0);
+  Verify333(pthread_mutex_init(&stop_lock_, nullptr) == 0);
+  pthread_condattr_t attr;
+  Verify333(pthread_condattr_init(&attr) == 0);
+  Verify333(pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0);
+  Verify333(pthread_cond_init(&stop_cond_, &attr) == 0);
+  Verify333(pthread_condattr_destroy(&attr) == 0);
+  Verify333(pthread_create(&thread_, nullptr, &ThreadMain, this) == 0);
+}
+
+AccessLog::~AccessLog() {
+  Verify333(pthread_mutex_lock(&stop_lock_) == 0);
+  stopping_ = true;
+  Verify333(pthread_cond_signal(&stop_cond_) == 0);
+  Verify333(pthread_mutex_unlock(&stop_lock_) == 0);
+  Verify333(pthread_join(thread_, nullptr) == 0);
+
+  if (!path_.empty() && fd_ != -1) {
+    close(fd_);
+  }
+  Verify333(pthread_cond_destroy(&stop_cond_) == 0);
+  Verify333(pthread_mutex_destroy(&stop_lock_) == 0);
+  Verify333(pthread_mutex_destroy(&rings_lock_) == 0);
+}
+
+void AccessLog::Log(AccessLogRecord&& record) {
+  if (record.time_ns == 0) {
+    record.time_ns = RealtimeNs();
+  }
+  Ring* ring = ThreadRing();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= kRingSize) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  ring->slots[head % kRingSize] = std::move(record);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t AccessLog::dropped() const {
+  uint64_t total = 0;
+  Verify333(pthread_mutex_lock(&rings_lock_) == 0);
+  for (const std::unique_ptr<Ring>& ring : rings_) {
+    total += ring->dropped.load(std::memory_order_relaxed);
+  }
+  Verify333(pthread_mutex_unlock(&rings_lock_) == 0);
+  return total;
+}
+
+AccessLog::Ring* AccessLog::ThreadRing() {
+  // Each thread remembers its ring in each log it has written to.
+  static thread_local vector<std::pair<uint64_t, Ring*>> rings;
+  for (const auto& entry : rings) {
+    if (entry.first == id_) {
+      return entry.second;
+    }
+  }
+  Ring* ring = new Ring(kRingSize);
+  Verify333(pthread_mutex_lock(&rings_lock_) == 0);
+  rings_.emplace_back(ring);
+  Verify333(pthread_mutex_unlock(&rings_lock_) == 0);
+  rings.emplace_back(id_, ring);
+  return ring;
+}
+
+// static
+void* AccessLog::ThreadMain(void* log) {
+  static_cast<AccessLog*>(log)->Run();
+  return nullptr;
+}
+
+void AccessLog::Run() {
+  Verify333(pthread_mutex_lock(&stop_lock_) == 0);
+  while (!stopping_) {
+    uint64_t wake_ns = MonotonicNs() + kFlushMs * uint64_t(1000000);
+    struct timespec wake;
+    wake.tv_sec = wake_ns / 1000000000;
+    wake.tv_nsec = wake_ns % 1000000000;
+    int res = pthread_cond_timedwait(&stop_cond_, &stop_lock_, &wake);
+    Verify333(res == 0 || res == ETIMEDOUT);
+    Verify333(pthread_mutex_unlock(&stop_lock_) == 0);
+    Flush();
+    Verify333(pthread_mutex_lock(&stop_lock_) == 0);
+  }
+  Verify333(pthread_mutex_unlock(&stop_lock_) == 0);
+
+  // Get out whatever was logged while we were stopping.
+  Flush();
+}
+
+void AccessLog::Flush() {
+  Verify333(pthread_mutex_lock(&rings_lock_) == 0);
+  vector<Ring*> rings;
+  for (const std::unique_ptr<Ring>& ring : rings_) {
+    rings.push_back(ring.get());
+  }
+  Verify333(pthread_mutex_unlock(&rings_lock_) == 0);
+
+  string batch;
+  uint64_t num_written = 0, dropped = 0;
+  for (Ring* ring : rings) {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail < head; tail++) {
+      AccessLogRecord record = std::move(ring->slots[tail % kRingSize]);
+      Format(record, &batch);
+      num_written++;
+    }
+    ring->tail.store(tail, std::memory_order_release);
+    dropped += ring->dropped.load(std::memory_order_relaxed);
+  }
+  if (dropped > dropped_reported_) {
+    AccessLogRecord record;
+    record.event = "dropped";
+    record.detail = std::to_string(dropped - dropped_reported_)
+      + " records dropped";
+    record.time_ns = RealtimeNs();
+    Format(record, &batch);
+    dropped_reported_ = dropped;
+  }
+
+  // Start a new file first if this one is full or old, but only for
+  // something to write, so as not to leave empty files behind.
+  if (!batch.empty() && !path_.empty() && file_bytes_ > 0
+      && ((max_bytes_ != 0 && file_bytes_ + batch.size() > max_bytes_)
+          || (max_age_s_ != 0 && MonotonicNs() - opened_ns_
+              >= static_cast<uint64_t>(max_age_s_) * 1000000000))) {
+    Rotate();
+  }
+  if (!batch.empty() && fd_ != -1) {
+    WriteAll(fd_, batch.data(), batch.size());
+    file_bytes_ += batch.size();
+  }
+  written_ += num_written;
+}
+
+// static
+void AccessLog::Format(const AccessLogRecord& record, string* out) {
+  time_t seconds = record.time_ns / 1000000000;
+  struct tm tm;
+  gmtime_r(&seconds, &tm);
+  char time_str[40];
+  size_t len = strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S",
+                        &tm);
+  snprintf(time_str + len, sizeof(time_str) - len, ".%03dZ",
+           static_cast<int>(record.time_ns / 1000000 % 1000));
+
+  JsonWriter json(out);
+  json.BeginObject().Key("time").String(time_str)
+      .Key("event").String(record.event);
+  if (!record.client.empty()) {
+    json.Key("client").String(record.client);
+  }
+  if (record.port >= 0) {
+    json.Key("port").Int(record.port);
+  }
+  if (!record.method.empty()) {
+    json.Key("method").String(record.method);
+  }
+  if (!record.uri.empty()) {
+    json.Key("uri").String(record.uri);
+  }
+  if (record.status >= 0) {
+    json.Key("status").Int(record.status);
+  }
+  if (record.bytes >= 0) {
+    json.Key("bytes").Int(record.bytes);
+  }
+  if (record.duration_us >= 0) {
+    json.Key("us").Int(record.duration_us);
+  }
+  if (!record.detail.empty()) {
+    json.Key("detail").String(record.detail);
+  }
+  if (!record.trace.empty()) {
+    json.Key("trace").Raw(record.trace);
+  }
+  json.EndObject();
+  out->push_back('\n');
+}
+
+void AccessLog::Rotate() {
+  close(fd_);
+  fd_ = -1;
+  for (int i = kKeepFiles - 1; i >= 1; i--) {
+    rename((path_ + "." + std::to_string(i)).c_str(),
+           (path_ + "." + std::to_string(i + 1)).c_str());
+  }
+  rename(path_.c_str(), (path_ + ".1").c_str());
+  Open();
+}
+
+bool AccessLog::Open() {
+  fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ == -1) {
+    return false;
+  }
+  struct stat info;
+  file_bytes_ = fstat(fd_, &info) == 0 ? info.st_size : 0;
+  opened_ns_ = MonotonicNs();
+  return true;
+}
+
+}  // namespace hw4
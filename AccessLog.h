@@ -0,0 +1,149 @@
+#ifndef HW4_ACCESSLOG_H_
+#define HW4_ACCESSLOG_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// One event in the access log: a connection opening or failing, or a
+// request being answered.  Fields that don't apply are left empty (or
+// negative) and are left out of the log line.
+struct AccessLogRecord {
+  // What happened, such as "connect", "request" or "error".  Must be a
+  // string constant, since it outlives the call to AccessLog::Log().
+  const char* event = "";
+
+  std::string client;
+  int port = -1;
+  std::string method;
+  std::string uri;
+  int status = -1;
+  int64_t bytes = -1;
+  int64_t duration_us = -1;
+  std::string detail;
+
+  // More about the event, as a JSON object already serialized (such as a
+  // RequestTrace), or empty.
+  std::string trace;
+
+  // When it happened, in nanoseconds since the epoch; Log() fills it in.
+  uint64_t time_ns = 0;
+};
+
+// An AccessLog writes a JSON object per line for each event logged to
+// it, without making the threads that log wait on each other or on the
+// disk: each thread appends to a ring buffer of its own, without locking,
+// and a background thread drains all the buffers every kFlushMs and
+// writes what it finds in one go.
+//
+// If a thread logs faster than the writer drains, records that don't fit
+// in its buffer are dropped rather than blocking it; the writer logs a
+// "dropped" event with the count, and dropped() reports the total.
+//
+// A log written to a file is rotated once it reaches its size limit or
+// age limit: the file is renamed to "<path>.1" (shifting older ones to
+// "<path>.2" and so on, up to kKeepFiles) and a new one started.
+//
+// It's safe to use from many threads at once.
+class AccessLog {
+ public:
+  // Logs to the file "path", appending to it if it exists, and rotating
+  // it after "max_bytes" bytes or "max_age_s" seconds (0 for no limit).
+  // Returns false from ok() if the file can't be opened.
+  AccessLog(const std::string& path, uint64_t max_bytes, int max_age_s);
+
+  // Logs to standard output, which is never rotated.
+  AccessLog();
+
+  // Writes out everything logged so far and stops the writer thread.
+  virtual ~AccessLog();
+
+  // Returns true if the log has somewhere to write.
+  bool ok() const { return fd_ != -1; }
+
+  // Queues "record" to be written; never blocks.
+  void Log(AccessLogRecord&& record);
+
+  // Returns the number of records written, and dropped.
+  uint64_t written() const { return written_; }
+  uint64_t dropped() const;
+
+  static const uint64_t kDefaultMaxBytes;
+  static const int kDefaultMaxAgeSeconds;
+  static const int kKeepFiles;
+  static const int kFlushMs;
+  static const size_t kRingSize;
+
+ private:
+  // A single-producer, single-consumer queue of records: the thread that
+  // owns it fills slots at head, and the writer empties them at tail.
+  struct Ring {
+    explicit Ring(size_t size) : slots(size), head(0), tail(0), dropped(0) { }
+    std::vector<AccessLogRecord> slots;
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> dropped;
+  };
+
+  // Initializes the locks and starts the writer thread.
+  void Start();
+
+  // Returns the calling thread's ring, creating it on first use.
+  Ring* ThreadRing();
+
+  // The writer thread, which runs Run().
+  static void* ThreadMain(void* log);
+  void Run();
+
+  // Drains every ring, writing out their records, and rotates the file
+  // if it's due.  Called by the writer thread only.
+  void Flush();
+
+  // Appends "record" as a line of JSON to "out".
+  static void Format(const AccessLogRecord& record, std::string* out);
+
+  // Renames the file aside and opens a new one.
+  void Rotate();
+
+  // Opens path_ for appending, returning false on failure.
+  bool Open();
+
+  // Identifies this log to the threads' ring caches, since a new log may
+  // be allocated where an old one was.
+  uint64_t id_;
+
+  std::string path_;
+  uint64_t max_bytes_;
+  int max_age_s_;
+  int fd_;
+  uint64_t file_bytes_;
+  uint64_t opened_ns_;
+
+  // Every thread's ring.  Rings are only added (under rings_lock_), and
+  // live as long as the log.
+  std::vector<std::unique_ptr<Ring>> rings_;
+  mutable pthread_mutex_t rings_lock_;
+
+  std::atomic<uint64_t> written_;
+  uint64_t dropped_reported_;
+
+  bool stopping_;
+  pthread_mutex_t stop_lock_;
+  pthread_cond_t stop_cond_;
+  pthread_t thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(AccessLog);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_ACCESSLOG_H_
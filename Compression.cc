@@ -0,0 +1,217 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <boost/algorithm/string.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+}
+#include "./Compression.h"
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+const char* kGzipEncoding = "gzip";
+const char* kDeflateEncoding = "deflate";
+
+// zlib's windowBits for the largest window, plus 16 to ask for the gzip
+// wrapper rather than the zlib one.
+static const int kWindowBits = 15;
+static const int kGzipWindowBits = kWindowBits + 16;
+
+// The memLevel zlib uses by default.
+static const int kMemLevel = 8;
+
+// Initializes "stream" to compress with "encoding" at "level".
+static bool InitDeflate(z_stream* stream, const string& encoding, int level) {
+  memset(stream, 0, sizeof(*stream));
+  int window_bits = encoding == kGzipEncoding ? kGzipWindowBits : kWindowBits;
+  return deflateInit2(stream, level, Z_DEFLATED, window_bits, kMemLevel,
+                      Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+// Runs deflate(stream, flush) over "len" bytes of "in" until it has
+// consumed them and produced all it can, appending the output to "out".
+static bool RunDeflate(z_stream* stream, const char* in, size_t len,
+                       int flush, string* out) {
+  stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+  stream->avail_in = len;
+  do {
+    size_t start = out->size();
+    size_t room = deflateBound(stream, stream->avail_in) + 64;
+    out->resize(start + room);
+    stream->next_out = reinterpret_cast<Bytef*>(&(*out)[start]);
+    stream->avail_out = room;
+    int res = deflate(stream, flush);
+    out->resize(start + room - stream->avail_out);
+    if (res == Z_STREAM_END) {
+      return true;
+    }
+    if (res != Z_OK && res != Z_BUF_ERROR) {
+      return false;
+    }
+  } while (stream->avail_in > 0 || stream->avail_out == 0);
+  return flush != Z_FINISH;
+}
+
+string NegotiateEncoding(const string& accept_encoding) {
+  // The q-value of each coding the client named; -1 if it didn't.
+  double gzip = -1, deflate = -1, star = -1;
+  vector<string> codings;
+  boost::split(codings, accept_encoding, boost::is_any_of(","));
+  for (string& coding : codings) {
+    double q = 1;
+    size_t semi = coding.find(';');
+    if (semi != string::npos) {
+      string param = coding.substr(semi + 1);
+      boost::algorithm::trim(param);
+      if (boost::algorithm::istarts_with(param, "q=")) {
+        q = atof(param.c_str() + 2);
+      }
+      coding.resize(semi);
+    }
+    boost::algorithm::trim(coding);
+    boost::algorithm::to_lower(coding);
+    if (coding == "gzip" || coding == "x-gzip") {
+      gzip = q;
+    } else if (coding == "deflate") {
+      deflate = q;
+    } else if (coding == "*") {
+      star = q;
+    }
+  }
+  if (gzip < 0) {
+    gzip = star;
+  }
+  if (deflate < 0) {
+    deflate = star;
+  }
+  if (gzip > 0 && gzip >= deflate) {
+    return kGzipEncoding;
+  }
+  if (deflate > 0) {
+    return kDeflateEncoding;
+  }
+  return "";
+}
+
+bool IsCompressibleType(const string& content_type) {
+  return content_type.compare(0, 5, "text/") == 0
+    || content_type.compare(0, 16, "application/json") == 0
+    || content_type.compare(0, 22, "application/javascript") == 0
+    || content_type.compare(0, 15, "application/xml") == 0
+    || content_type.compare(0, 13, "image/svg+xml") == 0;
+}
+
+bool Compress(const char* in, size_t len, const string& encoding, int level,
+              string* out) {
+  z_stream stream;
+  if (!InitDeflate(&stream, encoding, level)) {
+    return false;
+  }
+  out->clear();
+  bool ok = RunDeflate(&stream, in, len, Z_FINISH, out);
+  deflateEnd(&stream);
+  return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StreamCompressor
+///////////////////////////////////////////////////////////////////////////////
+StreamCompressor::StreamCompressor(const string& encoding, int level) {
+  ok_ = InitDeflate(&stream_, encoding, level);
+}
+
+StreamCompressor::~StreamCompressor() {
+  if (ok_) {
+    deflateEnd(&stream_);
+  }
+}
+
+bool StreamCompressor::Compress(const string& in, bool finish, string* out) {
+  if (!ok_) {
+    return false;
+  }
+  ok_ = RunDeflate(&stream_, in.data(), in.size(),
+                   finish ? Z_FINISH : Z_SYNC_FLUSH, out);
+  return ok_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CompressedFileCache
+///////////////////////////////////////////////////////////////////////////////
+CompressedFileCache::CompressedFileCache(size_t max_bytes)
+  : max_bytes_(max_bytes), size_bytes_(0) {
+  Verify333(pthread_mutex_init(&lock_, nullptr) == 0);
+}
+
+CompressedFileCache::~CompressedFileCache() {
+  Verify333(pthread_mutex_destroy(&lock_) == 0);
+}
+
+shared_ptr<const string> CompressedFileCache::Get(const string& key, int fd,
+                                                  uint64_t size, int level) {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    lru_.splice(lru_.begin(), lru_, it->second);
+    shared_ptr<const string> hit = it->second->second;
+    Verify333(pthread_mutex_unlock(&lock_) == 0);
+    return hit;
+  }
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+
+  // Compress without holding the lock.  Two threads that miss on the
+  // same file at once both compress it, and the second one's copy wins.
+  string contents(size, '\0');
+  size_t done = 0;
+  while (done < size) {
+    ssize_t res = pread(fd, &contents[done], size - done, done);
+    if (res <= 0) {
+      return nullptr;
+    }
+    done += res;
+  }
+  shared_ptr<string> compressed(new string);
+  if (!hw4::Compress(contents.data(), size, kGzipEncoding, level,
+                     compressed.get())) {
+    return nullptr;
+  }
+
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  it = entries_.find(key);
+  if (it != entries_.end()) {
+    size_bytes_ -= it->second->second->size();
+    lru_.erase(it->second);
+    entries_.erase(it);
+  }
+  lru_.emplace_front(key, compressed);
+  entries_[key] = lru_.begin();
+  size_bytes_ += compressed->size();
+  while (size_bytes_ > max_bytes_ && !lru_.empty()) {
+    size_bytes_ -= lru_.back().second->size();
+    entries_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return compressed;
+}
+
+size_t CompressedFileCache::size_bytes() {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  size_t size = size_bytes_;
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return size;
+}
+
+}  // namespace hw4
@@ -0,0 +1,105 @@
+#ifndef HW4_COMPRESSION_H_
+#define HW4_COMPRESSION_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <zlib.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// The content codings we can produce.  "deflate" is, as HTTP defines it,
+// the zlib format, not a raw deflate stream.
+extern const char* kGzipEncoding;
+extern const char* kDeflateEncoding;
+
+// Chooses the content coding for a response from the value of the
+// request's Accept-Encoding header, honoring q-values (including q=0 and
+// "*") and preferring gzip when both are equally welcome.
+//
+// Returns kGzipEncoding, kDeflateEncoding, or "" if the body should be
+// sent as is.
+std::string NegotiateEncoding(const std::string& accept_encoding);
+
+// Returns true if bodies of "content_type" are worth compressing: text,
+// JSON, JavaScript and XML, but not images or archives.
+bool IsCompressibleType(const std::string& content_type);
+
+// Compresses "len" bytes of "in" with "encoding" (see NegotiateEncoding())
+// at zlib "level" (1 to 9), replacing the contents of "out".
+//
+// Returns false on error.
+bool Compress(const char* in, size_t len, const std::string& encoding,
+              int level, std::string* out);
+
+// A StreamCompressor compresses a body that's produced, and must be sent,
+// a piece at a time: each piece's output can be decompressed as soon as
+// it arrives.
+class StreamCompressor {
+ public:
+  StreamCompressor(const std::string& encoding, int level);
+  virtual ~StreamCompressor();
+
+  // Compresses "in" onto the end of "out", flushing so that the client
+  // can decompress everything given so far.  The last piece should be
+  // passed with "finish" set, which ends the stream.
+  //
+  // Returns false on error.
+  bool Compress(const std::string& in, bool finish, std::string* out);
+
+ private:
+  z_stream stream_;
+  bool ok_;
+
+  DISALLOW_COPY_AND_ASSIGN(StreamCompressor);
+};
+
+// A CompressedFileCache keeps the gzipped versions of recently served
+// static files in memory, so a popular file is compressed once instead of
+// on every request.  Entries are keyed by the file's path and entity tag,
+// so a changed file is never served stale, and the least recently used
+// entries are dropped once the cache grows past its size limit.
+//
+// It's safe to use from many threads at once.
+class CompressedFileCache {
+ public:
+  // Arguments:
+  // - max_bytes: the most compressed bytes to keep.
+  explicit CompressedFileCache(size_t max_bytes);
+  virtual ~CompressedFileCache();
+
+  // Returns the gzipped contents of the "size"-byte file open as "fd",
+  // compressing it at "level" unless "key" is already cached.
+  //
+  // Returns nullptr if the file couldn't be read.
+  std::shared_ptr<const std::string> Get(const std::string& key, int fd,
+                                         uint64_t size, int level);
+
+  // Returns the number of compressed bytes being kept.
+  size_t size_bytes();
+
+ private:
+  typedef std::pair<std::string, std::shared_ptr<const std::string>> Entry;
+
+  size_t max_bytes_;
+  size_t size_bytes_;
+
+  // Most recently used first, with an index into it by key.
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+  pthread_mutex_t lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompressedFileCache);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_COMPRESSION_H_
@@ -0,0 +1,201 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+}
+#include "./ConnectionReaper.h"
+#include "./Metrics.h"
+
+namespace hw4 {
+
+// static
+const int ConnectionReaper::kDefaultTickMs = 100;
+
+// static
+const int ConnectionReaper::kLingerMs = 2000;
+
+// static
+const size_t ConnectionReaper::kLingerBytes = 64 << 10;
+
+// static
+const size_t ConnectionReaper::kMaxLingering = 256;
+
+// Returns the time on the monotonic clock in milliseconds.
+static uint64_t NowMs() {
+  return MonotonicNs() / 1000000;
+}
+
+// Reads and discards what the client has sent on "fd", up to "*budget"
+// bytes, without blocking.  Returns true once the client has closed its
+// end, the connection has failed, or the budget has run out, and false if
+// the client may yet send more.
+static bool Discard(int fd, size_t* budget) {
+  char buf[4096];
+  while (*budget > 0) {
+    ssize_t res = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (res == -1 && errno == EINTR) {
+      continue;
+    }
+    if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return false;
+    }
+    if (res <= 0) {
+      return true;
+    }
+    *budget -= std::min(*budget, static_cast<size_t>(res));
+  }
+  return true;
+}
+
+ConnectionReaper::ConnectionReaper(int tick_ms)
+  : tick_ms_(tick_ms), wheel_(NowMs() / tick_ms), expired_(),
+    stopping_(false), num_lingering_(0) {
+  Verify333(pthread_mutex_init(&lock_, nullptr) == 0);
+  pthread_condattr_t attr;
+  Verify333(pthread_condattr_init(&attr) == 0);
+  Verify333(pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0);
+  Verify333(pthread_cond_init(&stop_cond_, &attr) == 0);
+  Verify333(pthread_condattr_destroy(&attr) == 0);
+  Verify333(pthread_create(&thread_, nullptr, &ThreadMain, this) == 0);
+}
+
+ConnectionReaper::~ConnectionReaper() {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  stopping_ = true;
+  Verify333(pthread_cond_signal(&stop_cond_) == 0);
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  Verify333(pthread_join(thread_, nullptr) == 0);
+  Verify333(pthread_cond_destroy(&stop_cond_) == 0);
+  Verify333(pthread_mutex_destroy(&lock_) == 0);
+}
+
+ConnectionReaper::DeadlineId ConnectionReaper::Arm(int fd, Phase phase,
+                                                   int timeout_ms) {
+  if (timeout_ms <= 0) {
+    return 0;
+  }
+  // Round up, so a deadline never fires early.
+  uint64_t expiry = NowTicks() + (timeout_ms + tick_ms_ - 1) / tick_ms_;
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  DeadlineId id = wheel_.Schedule(expiry, [this, fd, phase]() {
+      // Leave the descriptor open, since its thread still owns it.
+      shutdown(fd, SHUT_RDWR);
+      expired_[phase]++;
+    });
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return id;
+}
+
+bool ConnectionReaper::Disarm(DeadlineId id) {
+  if (id == 0) {
+    return false;
+  }
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  bool fired = !wheel_.Cancel(id);
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return fired;
+}
+
+uint64_t ConnectionReaper::expired(Phase phase) {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  uint64_t count = expired_[phase];
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return count;
+}
+
+uint64_t ConnectionReaper::armed() {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  uint64_t count = wheel_.size();
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return count;
+}
+
+void ConnectionReaper::Linger(int fd) {
+  Lingerer lingerer = {fd, NowTicks() + (kLingerMs + tick_ms_ - 1) / tick_ms_,
+                       kLingerBytes};
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  bool full = handed_off_.size() + num_lingering_ >= kMaxLingering;
+  if (!full) {
+    handed_off_.push_back(lingerer);
+  }
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  if (full) {
+    close(fd);
+  }
+}
+
+uint64_t ConnectionReaper::lingering() {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  uint64_t count = handed_off_.size() + num_lingering_;
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return count;
+}
+
+// static
+void* ConnectionReaper::ThreadMain(void* reaper) {
+  static_cast<ConnectionReaper*>(reaper)->Run();
+  return nullptr;
+}
+
+void ConnectionReaper::Run() {
+  // The lingering sockets the thread has taken on, which only it touches.
+  std::vector<Lingerer> lingering;
+
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  while (!stopping_) {
+    // Sleep until the next tick begins.
+    uint64_t wake_ms = (NowTicks() + 1) * tick_ms_;
+    struct timespec wake;
+    wake.tv_sec = wake_ms / 1000;
+    wake.tv_nsec = (wake_ms % 1000) * 1000000;
+    int res = pthread_cond_timedwait(&stop_cond_, &lock_, &wake);
+    Verify333(res == 0 || res == ETIMEDOUT);
+
+    // Shutting sockets down under the lock means that once Disarm()
+    // returns, its socket can be closed without racing the reaper.
+    uint64_t now = NowTicks();
+    wheel_.Advance(now);
+
+    // Take on the sockets handed off since the last tick, and drain them
+    // all without the lock, so that Linger() never waits on the drain.
+    lingering.insert(lingering.end(), handed_off_.begin(), handed_off_.end());
+    handed_off_.clear();
+    num_lingering_ = lingering.size();
+    Verify333(pthread_mutex_unlock(&lock_) == 0);
+    size_t kept = 0;
+    for (Lingerer& lingerer : lingering) {
+      if (Discard(lingerer.fd, &lingerer.budget) || now >= lingerer.expiry) {
+        close(lingerer.fd);
+      } else {
+        lingering[kept++] = lingerer;
+      }
+    }
+    lingering.resize(kept);
+    Verify333(pthread_mutex_lock(&lock_) == 0);
+    num_lingering_ = kept;
+  }
+
+  // Stop lingering.
+  lingering.insert(lingering.end(), handed_off_.begin(), handed_off_.end());
+  handed_off_.clear();
+  num_lingering_ = 0;
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  for (const Lingerer& lingerer : lingering) {
+    close(lingerer.fd);
+  }
+}
+
+uint64_t ConnectionReaper::NowTicks() const {
+  return NowMs() / tick_ms_;
+}
+
+}  // namespace hw4
@@ -0,0 +1,137 @@
+#ifndef HW4_CONNECTIONREAPER_H_
+#define HW4_CONNECTIONREAPER_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "./TimerWheel.h"
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// How long a connection may take over each part of its life, in
+// milliseconds; 0 means forever.
+struct ConnectionTimeouts {
+  // Waiting for the first byte of a request, between keep-alive requests
+  // as well as right after connecting.
+  int idle_ms;
+
+  // Reading the rest of a request, header and body, once it has begun.
+  // This bounds the whole request, so a client can't hold a thread by
+  // trickling the header in a byte at a time.
+  int read_ms;
+
+  // Each write of a response, which bounds how long a client that stops
+  // reading can keep us waiting rather than the time to send a response.
+  int write_ms;
+};
+
+// A ConnectionReaper enforces the deadlines of the connections the server
+// is handling.  A connection arms a deadline before each part of its life
+// that waits on the client (see ConnectionTimeouts), and disarms it when
+// that part is over; if the deadline passes first, the reaper shuts the
+// socket down, which fails whatever read or write the connection's thread
+// is blocked in so the thread gives up on the client.
+//
+// The deadlines are kept in a TimerWheel that a thread of the reaper's
+// own advances every tick, so arming and disarming cost the same however
+// many connections are open.  A deadline fires up to a tick late.
+//
+// The reaper also closes the connections the server turns away, once
+// their clients have had the chance to read why (see Linger()), so that
+// the thread turning them away needn't wait on them.
+//
+// It's safe to use from many threads at once.
+class ConnectionReaper {
+ public:
+  // The parts of a connection's life, for accounting.
+  enum Phase { kIdle = 0, kRead, kWrite, kNumPhases };
+
+  typedef TimerWheel::TimerId DeadlineId;
+
+  // Starts the reaper's thread, which checks deadlines every "tick_ms"
+  // milliseconds.
+  explicit ConnectionReaper(int tick_ms = kDefaultTickMs);
+
+  // Stops the thread.  Connections still armed are left alone, and those
+  // lingering are closed.
+  virtual ~ConnectionReaper();
+
+  // Arms a deadline "timeout_ms" from now for the connection on socket
+  // "fd", which is in "phase".  Returns the id to pass to Disarm(), or 0
+  // if "timeout_ms" is 0 and so there's nothing to disarm.
+  DeadlineId Arm(int fd, Phase phase, int timeout_ms);
+
+  // Disarms deadline "id" (which may be 0).  Once this returns, the
+  // socket won't be shut down on that deadline's account, so it's safe
+  // to close.
+  //
+  // Returns true if the deadline had already passed, so the socket was
+  // shut down.
+  bool Disarm(DeadlineId id);
+
+  // Returns the number of connections shut down for overrunning a
+  // deadline in "phase".
+  uint64_t expired(Phase phase);
+
+  // Returns the number of armed deadlines.
+  uint64_t armed();
+
+  // Takes over the connection on socket "fd", whose sending side has
+  // been shut down after a last response, and closes it once the client
+  // closes its end.  Until then the reaper's thread reads and discards
+  // whatever the client sends, since closing a socket with unread bytes
+  // resets the connection, and the reset can overtake the response.  It
+  // gives up and closes the socket anyway after kLingerMs, or once
+  // kLingerBytes have been discarded, and closes it right away if
+  // kMaxLingering sockets are lingering already.
+  //
+  // Never blocks, so it's safe to call from the accept thread.
+  void Linger(int fd);
+
+  // Returns the number of sockets lingering.
+  uint64_t lingering();
+
+  static const int kDefaultTickMs;
+  static const int kLingerMs;
+  static const size_t kLingerBytes;
+  static const size_t kMaxLingering;
+
+ private:
+  // The reaper's thread, which runs Run().
+  static void* ThreadMain(void* reaper);
+  void Run();
+
+  // Returns the current time in ticks.
+  uint64_t NowTicks() const;
+
+  // A socket handed to Linger(), which is closed at tick "expiry" or
+  // once "budget" more bytes have been discarded, if not before.
+  struct Lingerer {
+    int fd;
+    uint64_t expiry;
+    size_t budget;
+  };
+
+  int tick_ms_;
+  TimerWheel wheel_;
+  uint64_t expired_[kNumPhases];
+  bool stopping_;
+
+  // The sockets handed to Linger() since the thread last took them on,
+  // and how many the thread holds itself.
+  std::vector<Lingerer> handed_off_;
+  size_t num_lingering_;
+
+  pthread_mutex_t lock_;
+  pthread_cond_t stop_cond_;
+  pthread_t thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConnectionReaper);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_CONNECTIONREAPER_H_
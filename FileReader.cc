@@ -1,6 +1,9 @@
 // Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <string>
 #include <cstdlib>
 #include <iostream>
@@ -55,4 +58,28 @@ bool FileReader::ReadFile(string* const contents) {
   return true;
 }
 
+bool FileReader::Stat(struct stat* const info) {
+  string full_file = basedir_ + "/" + fname_;
+  if (!IsPathSafe(basedir_, full_file)) {
+    return false;
+  }
+  return stat(full_file.c_str(), info) == 0 && S_ISREG(info->st_mode);
+}
+
+bool FileReader::Open(int* const fd, struct stat* const info) {
+  string full_file = basedir_ + "/" + fname_;
+  if (!IsPathSafe(basedir_, full_file)) {
+    return false;
+  }
+  *fd = open(full_file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (*fd == -1) {
+    return false;
+  }
+  if (fstat(*fd, info) != 0 || !S_ISREG(info->st_mode)) {
+    close(*fd);
+    return false;
+  }
+  return true;
+}
+
 }  // namespace hw4
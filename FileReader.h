@@ -1,6 +1,8 @@
 #ifndef HW4_FILEREADER_H_
 #define HW4_FILEREADER_H_
 
+#include <sys/stat.h>
+
 #include <string>
 
 namespace hw4 {
@@ -31,6 +33,21 @@ class FileReader {
   // contents of the file.
   bool ReadFile(std::string* const contents);
 
+  // Looks up the file specified by the constructor arguments without
+  // reading it, returning its metadata through the output parameter
+  // "info".
+  //
+  // Return false in the same cases as ReadFile(), or if the file isn't a
+  // regular file.
+  bool Stat(struct stat* const info);
+
+  // Opens the file specified by the constructor arguments for reading,
+  // without reading any of it, returning the file descriptor through
+  // "fd" and its metadata through "info".  The caller must close() "fd".
+  //
+  // Return false in the same cases as Stat().
+  bool Open(int* const fd, struct stat* const info);
+
  private:
   std::string basedir_;
   std::string fname_;
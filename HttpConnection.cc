@@ -1,8 +1,12 @@
 // Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
 
+#include <errno.h>
 #include <stdint.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -10,6 +14,7 @@
 #include "./HttpRequest.h"
 #include "./HttpUtils.h"
 #include "./HttpConnection.h"
+#include "./Metrics.h"
 
 using std::map;
 using std::string;
@@ -20,7 +25,23 @@ namespace hw4 {
 static const char* kHeaderEnd = "\r\n\r\n";
 static const int kHeaderEndLen = 4;
 
+// The largest request body we accept.
+static const size_t kMaxBodyBytes = 1 << 20;
+
+// The most we hand to one write, so that the write timeout measures the
+// client's progress rather than the size of the response.
+static const size_t kWriteSliceBytes = 1 << 16;
+
 bool HttpConnection::GetNextRequest(HttpRequest* const request) {
+  bool ok = ReadRequest(request);
+  ClearDeadline();
+  if (ok) {
+    read_ns_ = MonotonicNs() - request_start_ns_;
+  }
+  return ok;
+}
+
+bool HttpConnection::ReadRequest(HttpRequest* const request) {
   // Use WrappedRead from HttpUtils.cc to read bytes from the files into
   // private buffer_ variable. Keep reading until:
   // 1. The connection drops
@@ -38,14 +59,28 @@ bool HttpConnection::GetNextRequest(HttpRequest* const request) {
   // next time the caller invokes GetNextRequest()!
 
   // STEP 1:
+  // The client is idle until the request begins, and then must finish it
+  // within the read timeout.
+  bool idle = buffer_.empty();
+  if (idle) {
+    SetDeadline(ConnectionReaper::kIdle, timeouts_.idle_ms);
+  } else {
+    SetDeadline(ConnectionReaper::kRead, timeouts_.read_ms);
+    request_start_ns_ = MonotonicNs();
+  }
   unsigned char buf[2048];
   size_t request_bytes = 0;
   while ((request_bytes = buffer_.find(kHeaderEnd)) == string::npos) {
     int bytes_read = WrappedRead(fd_, buf, sizeof(buf));
-    // Returns false if fatal error
-    if (bytes_read == -1) {
+    // Returns false if fatal error or the connection dropped
+    if (bytes_read <= 0) {
       return false;
     }
+    if (idle) {
+      SetDeadline(ConnectionReaper::kRead, timeouts_.read_ms);
+      request_start_ns_ = MonotonicNs();
+      idle = false;
+    }
     buffer_.append(reinterpret_cast<char*>(buf), bytes_read);
   }
   string request_str = buffer_.substr(0, request_bytes + kHeaderEndLen);
@@ -53,20 +88,168 @@ bool HttpConnection::GetNextRequest(HttpRequest* const request) {
   // Save the remaining data for next request
   buffer_ = buffer_.substr(request_bytes + strlen(kHeaderEnd));
 
-  return true;  // you may need to change this return value
+  // If the request has a body, it comes next.
+  string length_str = request->GetHeaderValue("content-length");
+  if (length_str.empty()) {
+    return true;
+  }
+  if (length_str.size() > 9
+      || length_str.find_first_not_of("0123456789") != string::npos) {
+    return false;
+  }
+  size_t body_bytes = std::stoul(length_str);
+  if (body_bytes > kMaxBodyBytes) {
+    return false;
+  }
+  while (buffer_.size() < body_bytes) {
+    int bytes_read = WrappedRead(fd_, buf, sizeof(buf));
+    if (bytes_read <= 0) {
+      return false;
+    }
+    buffer_.append(reinterpret_cast<char*>(buf), bytes_read);
+  }
+  request->set_body(buffer_.substr(0, body_bytes));
+  buffer_.erase(0, body_bytes);
+
+  return true;
 }
 
 bool HttpConnection::WriteResponse(const HttpResponse& response) const {
-  string str = response.GenerateResponseString();
-  int res = WrappedWrite(fd_,
-                         reinterpret_cast<const unsigned char*>(str.c_str()),
-                         str.length());
-  if (res != static_cast<int>(str.length()))
+  write_ns_ = 0;
+  bytes_written_ = 0;
+  if (response.is_streamed()) {
+    return WriteStreamedResponse(response);
+  }
+  if (response.file_ranges().empty()) {
+    return WriteString(response.GenerateResponseString());
+  }
+
+  // Send the body's stretches of file straight from the file.
+  if (!WriteString(response.GenerateHeaderString())) {
+    return false;
+  }
+  const string& body = response.body();
+  size_t pos = 0;
+  for (const HttpResponse::FileRange& range : response.file_ranges()) {
+    if (!WriteBytes(body.data() + pos, range.body_pos - pos)
+        || !SendFile(response.body_file(), range.offset, range.length)) {
+      return false;
+    }
+    pos = range.body_pos;
+  }
+  return WriteBytes(body.data() + pos, body.size() - pos);
+}
+
+bool HttpConnection::WriteStreamedResponse(const HttpResponse& response)
+  const {
+  if (!WriteString(response.GenerateHeaderString())) {
+    return false;
+  }
+
+  // Send each piece of the body as a chunk as soon as it's flushed.
+  bool ok = true;
+  string body, chunk;
+  response.body_stream()(&body, [this, &ok, &body, &chunk]() {
+      if (ok && !body.empty()) {
+        chunk.clear();
+        HttpResponse::AppendChunk(body, &chunk);
+        body.clear();
+        ok = WriteString(chunk);
+      }
+      return ok;
+    });
+  if (!ok) {
     return false;
+  }
+  chunk.clear();
+  HttpResponse::AppendChunk(body, &chunk);
+  HttpResponse::AppendLastChunk(response.GenerateTrailerString(), &chunk);
+  return WriteString(chunk);
+}
+
+bool HttpConnection::WriteString(const string& str) const {
+  return WriteBytes(str.data(), str.size());
+}
+
+bool HttpConnection::WriteBytes(const char* data, size_t len) const {
+  while (len > 0) {
+    size_t slice = std::min(len, kWriteSliceBytes);
+    SetDeadline(ConnectionReaper::kWrite, timeouts_.write_ms);
+    uint64_t start_ns = MonotonicNs();
+    int res = WrappedWrite(fd_, reinterpret_cast<const unsigned char*>(data),
+                           slice);
+    write_ns_ += MonotonicNs() - start_ns;
+    ClearDeadline();
+    if (res > 0) {
+      bytes_written_ += res;
+    }
+    if (res != static_cast<int>(slice))
+      return false;
+    data += slice;
+    len -= slice;
+  }
   return true;
 }
 
-HttpRequest HttpConnection::ParseRequest(const string& request) const {
+bool HttpConnection::SendFile(int file_fd, off_t offset, uint64_t len) const {
+  while (len > 0) {
+    SetDeadline(ConnectionReaper::kWrite, timeouts_.write_ms);
+    uint64_t start_ns = MonotonicNs();
+    ssize_t sent = sendfile(fd_, file_fd, &offset,
+                            std::min(len, uint64_t(kWriteSliceBytes)));
+    write_ns_ += MonotonicNs() - start_ns;
+    ClearDeadline();
+    if (sent == -1 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    // A file that shrank underneath us can't fill the promised length.
+    if (sent <= 0) {
+      return false;
+    }
+    bytes_written_ += sent;
+    len -= sent;
+  }
+  return true;
+}
+
+void HttpConnection::SetDeadline(ConnectionReaper::Phase phase,
+                                 int timeout_ms) const {
+  ClearDeadline();
+  if (reaper_ != nullptr) {
+    deadline_ = reaper_->Arm(fd_, phase, timeout_ms);
+    deadline_phase_ = phase;
+  }
+}
+
+void HttpConnection::ClearDeadline() const {
+  if (reaper_ != nullptr) {
+    if (reaper_->Disarm(deadline_)) {
+      timed_out_ = deadline_phase_;
+    }
+    deadline_ = 0;
+  }
+}
+
+// static
+void HttpConnection::Reject(int fd, const HttpResponse& response,
+                            ConnectionReaper* reaper) {
+  string str = response.GenerateResponseString();
+  ssize_t res;
+  do {
+    res = send(fd, str.data(), str.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+  } while (res == -1 && errno == EINTR);
+  if (res != static_cast<ssize_t>(str.size())) {
+    close(fd);
+    return;
+  }
+
+  // Say we're done, and leave the client to close its end.
+  shutdown(fd, SHUT_WR);
+  reaper->Linger(fd);
+}
+
+// static
+HttpRequest HttpConnection::ParseRequest(const string& request) {
   HttpRequest req("/");  // by default, get "/".
 
   // Plan for STEP 2:
@@ -100,8 +283,12 @@ HttpRequest HttpConnection::ParseRequest(const string& request) const {
                             boost::is_any_of(" "),
                             boost::token_compress_on);
 
-    // Extract URI
+    // Extract method, URI and protocol
+    req.set_method(first_line_vec[0]);
     req.set_uri(first_line_vec[1]);
+    if (first_line_vec.size() > 2) {
+      req.set_protocol(first_line_vec[2]);
+    }
 
     for (size_t i = 1; i < lines.size(); i++) {
       string line = lines[i];
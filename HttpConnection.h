@@ -2,10 +2,12 @@
 #define HW4_HTTPCONNECTION_H_
 
 #include <stdint.h>
+#include <sys/types.h>
 #include <unistd.h>
 #include <map>
 #include <string>
 
+#include "./ConnectionReaper.h"
 #include "./HttpRequest.h"
 #include "./HttpResponse.h"
 
@@ -14,22 +16,43 @@ namespace hw4 {
 // The HttpConnection class represents a connection to a single client
 class HttpConnection {
  public:
-  explicit HttpConnection(int fd) : fd_(fd) { }
+  explicit HttpConnection(int fd)
+    : fd_(fd), reaper_(nullptr), timeouts_(), deadline_(0),
+      deadline_phase_(ConnectionReaper::kIdle),
+      timed_out_(ConnectionReaper::kNumPhases),
+      request_start_ns_(0), read_ns_(0), write_ns_(0), bytes_written_(0) { }
+
+  // Like the above, but "reaper" shuts the connection down if the client
+  // overruns any of "timeouts"; reads and writes then fail.
+  HttpConnection(int fd, ConnectionReaper* reaper,
+                 const ConnectionTimeouts& timeouts)
+    : fd_(fd), reaper_(reaper), timeouts_(timeouts), deadline_(0),
+      deadline_phase_(ConnectionReaper::kIdle),
+      timed_out_(ConnectionReaper::kNumPhases),
+      request_start_ns_(0), read_ns_(0), write_ns_(0), bytes_written_(0) { }
+
   virtual ~HttpConnection() {
+    ClearDeadline();
     close(fd_);
     fd_ = -1;
   }
 
   // Read and parse the next request from the file descriptor fd_,
-  // storing the state in the output parameter "request".
+  // storing the state in the output parameter "request".  If the request
+  // has a Content-Length header, its body is read too.
   //
   // Returns true if a request could be parsed and read, and false otherwise
+  // (including when the connection drops, or the Content-Length is
+  // malformed or larger than we accept)
   //
   // The caller is responsible to close the connection if the function
-  // returns false
+  // returns false (and the client may simply have idled past its
+  // keep-alive timeout; see timed_out())
   bool GetNextRequest(HttpRequest* const request);
 
-  // Write the response to the file descriptor fd_.
+  // Write the response to the file descriptor fd_.  A streamed response
+  // is written chunk by chunk as its body is produced, and stretches of a
+  // body file are sent straight from the file.
   //
   // Returns true if the response was successfully written, false if the
   // connection experiences an error and should be closed.
@@ -38,16 +61,76 @@ class HttpConnection {
   // returns false
   bool WriteResponse(const HttpResponse& response) const;
 
+  // Returns how long the last request read took to arrive and be parsed,
+  // from its first byte (so not counting the wait for it), and how long
+  // the last response spent being written, not counting the time its
+  // body took to produce; both in nanoseconds.
+  uint64_t read_ns() const { return read_ns_; }
+  uint64_t write_ns() const { return write_ns_; }
+
+  // Returns how many bytes of the last response, headers and all, made
+  // it to the client.
+  uint64_t bytes_written() const { return bytes_written_; }
+
+  // Returns the phase whose timeout the client overran, so that the
+  // reaper shut the connection down, or kNumPhases if it hasn't.
+  ConnectionReaper::Phase timed_out() const { return timed_out_; }
+
+  // Turns away the client on socket "fd", which isn't wrapped in an
+  // HttpConnection, with "response": writes it without blocking and hands
+  // the socket to "reaper" to close once the client has read it (see
+  // ConnectionReaper::Linger()), so a client can't hold up the caller.
+  // "response" must be small, so that it fits in the socket's empty send
+  // buffer, and neither streamed nor sent from a file; if it doesn't fit
+  // the socket is simply closed.
+  static void Reject(int fd, const HttpResponse& response,
+                     ConnectionReaper* reaper);
+
+  // Parses "request", the request line and headers of a request read from
+  // a connection (without the blank line that ends them).
+  static HttpRequest ParseRequest(const std::string& request);
+
  private:
-  // A helper function to parse the contents of data read from
-  // the HTTP connection.
-  HttpRequest ParseRequest(const std::string& request) const;
+  // Does the work of GetNextRequest(), leaving a deadline armed.
+  bool ReadRequest(HttpRequest* const request);
+
+  // Replaces the connection's deadline with one "timeout_ms" from now for
+  // "phase", or just clears it.  No-ops without a reaper.
+  void SetDeadline(ConnectionReaper::Phase phase, int timeout_ms) const;
+  void ClearDeadline() const;
+
+  // Writes a streamed response with chunked transfer encoding.
+  bool WriteStreamedResponse(const HttpResponse& response) const;
+
+  // Writes all of "str" (or "len" bytes of "data") to fd_, returning false
+  // if the connection failed.
+  bool WriteString(const std::string& str) const;
+  bool WriteBytes(const char* data, size_t len) const;
+
+  // Sends "len" bytes of the file "file_fd", starting at "offset", to fd_
+  // without copying them through user space.
+  bool SendFile(int file_fd, off_t offset, uint64_t len) const;
 
   // The file descriptor associated with the client.
   int fd_;
 
   // A buffer storing data read from the client.
   std::string buffer_;
+
+  // What enforces our timeouts, if anything, the deadline armed with it
+  // (0 if none) and that deadline's phase, and the phase that timed out.
+  ConnectionReaper* reaper_;
+  ConnectionTimeouts timeouts_;
+  mutable ConnectionReaper::DeadlineId deadline_;
+  mutable ConnectionReaper::Phase deadline_phase_;
+  mutable ConnectionReaper::Phase timed_out_;
+
+  // When the request being read began to arrive, and the timings and
+  // count behind read_ns(), write_ns() and bytes_written().
+  uint64_t request_start_ns_;
+  uint64_t read_ns_;
+  mutable uint64_t write_ns_;
+  mutable uint64_t bytes_written_;
 };
 
 }  // namespace hw4
@@ -9,7 +9,7 @@
 namespace hw4 {
 
 // This class represents an HTTP Request. For our website search engine, we
-// will only handle "GET"-style requests, meaning the request will have the
+// mostly handle "GET"-style requests, meaning the request will have the
 // following format:
 //
 // GET [URI] [http_protocol]\r\n
@@ -24,15 +24,29 @@ namespace hw4 {
 // GET /foo/bar?baz=bam HTTP/1.1\r\n
 // Host: www.news.com\r\n
 //
+// A request (typically a "POST") may also carry a body, in which case its
+// headers include "Content-Length: [number of bytes]" and the body follows
+// the blank line.
+//
 class HttpRequest {
  public:
   HttpRequest() { }
   explicit HttpRequest(const std::string& uri) : uri_(uri) { }
   virtual ~HttpRequest() { }
 
+  const std::string& method() const { return method_; }
+  void set_method(const std::string& method) { method_ = method; }
+
   const std::string& uri() const { return uri_; }
   void set_uri(const std::string& uri) { uri_ = uri; }
 
+  // The protocol, such as "HTTP/1.1", from the request line.
+  const std::string& protocol() const { return protocol_; }
+  void set_protocol(const std::string& protocol) { protocol_ = protocol; }
+
+  const std::string& body() const { return body_; }
+  void set_body(const std::string& body) { body_ = body; }
+
   // Returns the value associated with the passed-in header name, or empty
   // string if it does not exist in the header map.  The passed-in name must
   // be entirely lowercase to comply with our implementation of RFC 2616:4.2.
@@ -57,9 +71,18 @@ class HttpRequest {
   }
 
  private:
+  // Which method ("GET", "POST", ...) did the client use?
+  std::string method_;
+
   // Which URI did the client request?
   std::string uri_;
 
+  // Which protocol did the client speak?
+  std::string protocol_;
+
+  // The request body, or empty if the request has none.
+  std::string body_;
+
   // A map from mapping a header name to a header value, which represents the
   // headers a client would supply to us. Due to RFC 2616:4.2 stating that
   // header names are case-insensitive, convert all header names to be
@@ -2,10 +2,16 @@
 #define HW4_HTTPRESPONSE_H_
 
 #include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <unistd.h>
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <sstream>
+#include <vector>
 
 namespace hw4 {
 
@@ -29,9 +35,42 @@ namespace hw4 {
 // Content-length: 10\r\n
 // \r\n
 // Hi there!!
+//
+// A response may instead stream its body: rather than building the whole
+// body up front, the response carries a BodyStream that produces it a
+// piece at a time while it's being written, and the body is sent with
+// "Transfer-Encoding: chunked" in place of a Content-length.  Each chunk
+// is its length in hex, "\r\n", the data and "\r\n"; a zero-length chunk
+// ends the body:
+//
+// HTTP/1.1 200 OK\r\n
+// Transfer-Encoding: chunked\r\n
+// \r\n
+// 4\r\n
+// Hi t\r\n
+// 6\r\n
+// here!!\r\n
+// 0\r\n
+// \r\n
+//
+// Parts of the body may also come from a file (see set_body_file()): they
+// are sent straight from the file when the response is written, so the
+// response never holds them in memory, however large the file.
 
 class HttpResponse {
  public:
+  // A function that produces a streamed body.  It appends to "body" and
+  // calls "flush" whenever it has enough to be worth sending; "flush" sends
+  // and clears "body", and returns false once the client has gone, after
+  // which the function should give up.  Whatever is left in "body" when
+  // the function returns is sent as the final chunk.
+  typedef std::function<void(std::string* body,
+                             const std::function<bool()>& flush)> BodyStream;
+
+  // A function that produces the trailer of a streamed response, once its
+  // body is done: header lines, each ending in "\r\n".
+  typedef std::function<std::string()> TrailerFn;
+
   HttpResponse() { }
   virtual ~HttpResponse() { }
 
@@ -39,30 +78,161 @@ class HttpResponse {
   void set_response_code(uint16_t code) { response_code_ = code; }
   void set_message(const std::string& msg) { message_ = msg; }
   void set_content_type(const std::string& type) { content_type_ = type; }
+  uint16_t response_code() const { return response_code_; }
+  const std::string& content_type() const { return content_type_; }
+
+  // Adds a name -> value mapping to the headers, over-writing any existing
+  // mapping for name.  Content-type and Content-length have their own
+  // setters and shouldn't be added this way.
+  void AddHeader(const std::string& name, const std::string& value) {
+    headers_[name] = value;
+  }
+
+  // Returns the value of a header added with AddHeader(), or empty string
+  // if there's none.
+  std::string GetHeaderValue(const std::string& name) const {
+    auto it = headers_.find(name);
+    return it == headers_.end() ? "" : it->second;
+  }
 
   void AppendToBody(const std::string& body_fragment) {
     body_ += body_fragment;
   }
 
+  // Makes the open file "fd" the source of AppendFileToBody().  The
+  // response takes ownership of "fd", which is closed once the response
+  // and all its copies are gone.
+  void set_body_file(int fd) {
+    body_file_ = std::shared_ptr<int>(new int(fd), [](int* fd) {
+        close(*fd);
+        delete fd;
+      });
+  }
+
+  // Appends "length" bytes of the body file, starting at "offset", to the
+  // body.
+  void AppendFileToBody(off_t offset, uint64_t length) {
+    file_ranges_.push_back(FileRange{body_.size(), offset, length});
+  }
+
+  // A stretch of the body file, sent in place of nothing at "body_pos" in
+  // body_ (so after body_[body_pos - 1]).
+  struct FileRange {
+    size_t body_pos;
+    off_t offset;
+    uint64_t length;
+  };
+  int body_file() const { return body_file_ ? *body_file_ : -1; }
+  const std::vector<FileRange>& file_ranges() const { return file_ranges_; }
+
+  // Returns the size of the body, including its stretches of file.
+  uint64_t content_length() const {
+    uint64_t length = body_.size();
+    for (const FileRange& range : file_ranges_) {
+      length += range.length;
+    }
+    return length;
+  }
+
+  // Returns the body itself, for serializers that append to it in place.
+  const std::string& body() const { return body_; }
+  std::string* mutable_body() { return &body_; }
+
+  // Makes this a streamed response, whose body is produced by "stream"
+  // (and not by AppendToBody()) when the response is written.
+  void set_body_stream(const BodyStream& stream) { body_stream_ = stream; }
+  bool is_streamed() const { return static_cast<bool>(body_stream_); }
+  const BodyStream& body_stream() const { return body_stream_; }
+
+  // Sends the header lines "trailer" produces after a streamed body, for
+  // fields whose values aren't known until the body has been produced.
+  // Announce them with a "Trailer" header.
+  void set_trailer(const TrailerFn& trailer) { trailer_ = trailer; }
+  std::string GenerateTrailerString() const {
+    return trailer_ ? trailer_() : std::string();
+  }
+
   // A method to generate a std::string of the HTTP response, suitable for
   // writing back to the client.
   //
   // The "Content-length:" header is automatically generated, which will be the
   // last header in the block. The value of that Content-length header is the
-  // size of the response body (in bytes).
+  // size of the response body (in bytes).  A 304 (Not Modified) response
+  // has no body, and no Content-length either.
+  //
+  // A streamed response is generated in full, as the chunks it would be
+  // sent as; HttpConnection::WriteResponse() sends each one as it's
+  // produced instead.
   std::string GenerateResponseString() const {
+    std::string resp = GenerateHeaderString();
+    if (!is_streamed()) {
+      size_t pos = 0;
+      for (const FileRange& range : file_ranges_) {
+        resp.append(body_, pos, range.body_pos - pos);
+        pos = range.body_pos;
+        size_t start = resp.size();
+        resp.resize(start + range.length);
+        ssize_t res = pread(*body_file_, &resp[start], range.length,
+                            range.offset);
+        resp.resize(start + (res > 0 ? res : 0));
+      }
+      return resp.append(body_, pos, std::string::npos);
+    }
+    std::string body;
+    body_stream_(&body, [&resp, &body]() {
+        AppendChunk(body, &resp);
+        body.clear();
+        return true;
+      });
+    AppendChunk(body, &resp);
+    AppendLastChunk(GenerateTrailerString(), &resp);
+    return resp;
+  }
+
+  // Generates the status line and headers of the response, through the
+  // blank line that ends them.
+  std::string GenerateHeaderString() const {
     std::stringstream resp;
 
     resp << protocol_ << " " << response_code_ << " " << message_ << "\r\n";
     if (!content_type_.empty()) {
       resp << "Content-type: " << content_type_ << "\r\n";
     }
-    resp << "Content-length: " << body_.size() << "\r\n";
+    for (const auto& header : headers_) {
+      resp << header.first << ": " << header.second << "\r\n";
+    }
+    if (is_streamed()) {
+      resp << "Transfer-Encoding: chunked\r\n";
+    } else if (response_code_ != 304) {
+      // A 304 has no body: a length would describe the one it stands for.
+      resp << "Content-length: " << content_length() << "\r\n";
+    }
     resp << "\r\n";
-    resp << body_;
     return resp.str();
   }
 
+  // Appends "data" to "out" as one chunk of a chunked body.  Empty data
+  // is skipped, since a zero-length chunk would end the body (see
+  // AppendLastChunk()).
+  static void AppendChunk(const std::string& data, std::string* out) {
+    if (data.empty()) {
+      return;
+    }
+    char size[20];
+    int len = snprintf(size, sizeof(size), "%zx\r\n", data.size());
+    out->append(size, len);
+    out->append(data);
+    out->append("\r\n", 2);
+  }
+
+  // Appends the final, zero-length chunk that ends a chunked body to
+  // "out", with the header lines of "trailer" after it.
+  static void AppendLastChunk(const std::string& trailer, std::string* out) {
+    out->append("0\r\n", 3);
+    out->append(trailer);
+    out->append("\r\n", 2);
+  }
+
  private:
   // The HTTP protocol string to pass back in the header.
   std::string protocol_;
@@ -76,8 +246,19 @@ class HttpResponse {
   // The HTTP content type string to pass back in the header.  Optional.
   std::string content_type_;
 
+  // Any other headers to pass back, from header name to value.
+  std::map<std::string, std::string> headers_;
+
   // The body of the response.
   std::string body_;
+
+  // Produces the body of a streamed response, or empty if not streamed.
+  BodyStream body_stream_;
+  TrailerFn trailer_;
+
+  // The file that file_ranges_ come from, if any.
+  std::shared_ptr<int> body_file_;
+  std::vector<FileRange> file_ranges_;
 };
 
 }  // namespace hw4
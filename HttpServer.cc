@@ -1,11 +1,19 @@
 // Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
 
 #include <boost/algorithm/string.hpp>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <sstream>
 
 #include "./FileReader.h"
@@ -13,7 +21,9 @@
 #include "./HttpRequest.h"
 #include "./HttpUtils.h"
 #include "./HttpServer.h"
-#include "./libhw3/QueryProcessor.h"
+#include "./JsonWriter.h"
+#include "./RequestTrace.h"
+#include "./SegmentQueryProcessor.h"
 
 using std::cerr;
 using std::cout;
@@ -48,25 +58,200 @@ static const char* kThreegleStr =
   "</form>\n"
   "</center><p>\n";
 
+// The page size of /api/search if the request doesn't give one, and the
+// largest page a request may ask for.
+static const int kDefaultApiResults = 10;
+static const int kMaxApiResults = 1000;
+
+// The most queries one /api/batch request may hold, and the number of
+// threads that answer them.
+static const size_t kMaxBatchQueries = 1000;
+static const int kBatchThreads = 4;
+
+// How much of a streamed results page to build up before sending it.
+static const size_t kChunkBytes = 16384;
+
+// The most ranges a static file request may ask for, and the separator
+// between them in a multipart/byteranges response.
+static const size_t kMaxRanges = 16;
+static const char* kByteRangesBoundary = "333gle_byteranges_5b1e9d3c";
+
 // static
 const int HttpServer::kNumThreads = 100;
 
+// static
+const int HttpServer::kDefaultCompressionLevel = 6;
+
+// static
+const size_t HttpServer::kGzipCacheBytes = 32 << 20;
+
+// static
+const ConnectionTimeouts HttpServer::kDefaultTimeouts = {
+  15000,  // idle_ms
+  10000,  // read_ms
+  30000,  // write_ms
+};
+
+// static
+const int HttpServer::kDefaultSlowRequestMs = 1000;
+
+// The most accepted connections that may wait for a worker thread, and
+// the CoDel target for how long they wait (see ThreadPool): past these,
+// connections are shed with a 503, and told to retry this much later.
+static const size_t kMaxQueuedConnections = 1000;
+static const int kQueueDelayTargetMs = 10;
+static const int kQueueDelayIntervalMs = 100;
+static const int kRetryAfterSeconds = 1;
+
+// Bodies smaller than this aren't worth compressing on the fly, and
+// static files larger than this are sent uncompressed rather than held
+// in the gzip cache.
+static const size_t kMinCompressBytes = 1024;
+static const uint64_t kMaxGzipFileBytes = 1 << 20;
+
 // This is the function that threads are dispatched into
 // in order to process new client connections.
 static void HttpServer_ThrFn(ThreadPool::Task* t);
 
-// Given a request, produce a response.
+// Reports the stages of "trace" to the client in a Server-Timing header,
+// or, for a streamed response (whose query runs as it's written), in its
+// trailer.
+static void AddServerTiming(const RequestTrace* trace,
+                            HttpResponse* response);
+
+// Returns an access log record of "event" for the client of "hst".
+static AccessLogRecord ClientRecord(const char* event,
+                                    const HttpServerTask& hst);
+
+// Returns why "hc" is being closed: the timeout its client overran, if
+// the reaper shut it down, and "otherwise" if not.
+static const char* CloseReason(const HttpConnection& hc,
+                               const char* otherwise);
+
+// Answers the client on "client_fd" with a 503 and has "reaper" close
+// the connection, without reading its request.
+static void ShedConnection(int client_fd, ConnectionReaper* reaper);
+
+// Answers the client on "client_fd" with a 429, telling it to retry in
+// "retry_after_s" seconds, and has "reaper" close the connection without
+// reading its request.
+static void RefuseConnection(int client_fd, int retry_after_s,
+                             ConnectionReaper* reaper);
+
+// Returns the 429 response to a request for "path" by a client over its
+// rate limit, which may retry in "retry_after_s" seconds.
+static HttpResponse TooManyRequestsResponse(std::string_view path,
+                                            int retry_after_s);
+
+// Answers the client on "client_fd" with "response", which must be
+// small, and hands the connection to "reaper" to close (see
+// HttpConnection::Reject()).
+static void RejectConnection(int client_fd, HttpResponse response,
+                             ConnectionReaper* reaper);
+
+// Given a request, produce a response, noting the time its stages take
+// in "trace".
 static HttpResponse ProcessRequest(const HttpRequest& req,
-                            const string& base_dir,
-                            const list<string>& indices);
+                            const HttpServerTask& hst, RequestTrace* trace);
+
+// Compresses the body of "response" for the client of "req", at zlib
+// "level", if it's worth compressing and the client accepts it.
+static void CompressResponse(const HttpRequest& req, int level,
+                             HttpResponse* response);
 
 // Process a file request.
-static HttpResponse ProcessFileRequest(const string& uri,
-                                const string& base_dir);
+static HttpResponse ProcessFileRequest(const HttpRequest& req,
+                                const HttpServerTask& hst);
+
+// Returns the entity tag of the file described by "info", which changes
+// whenever the file is replaced or modified.
+static string FileETag(const struct stat& info);
+
+// Returns true if "req" asks for the file with "etag" and "mtime" only
+// if it has changed (through If-None-Match or If-Modified-Since), and it
+// hasn't.
+static bool IsNotModified(const HttpRequest& req, const string& etag,
+                          time_t mtime);
+
+// Returns true unless "req" has an If-Range header naming a version of
+// the file (by "etag" or "mtime") other than the current one.
+static bool IfRangeHolds(const HttpRequest& req, const string& etag,
+                         time_t mtime);
+
+// Returns the value of a Content-Range header for "range" of a file of
+// "size" bytes.
+static string ContentRange(const ByteRange& range, uint64_t size);
+
+// Returns the Cache-Control value for "path" from "cache_control" (see
+// HttpServer::SetCacheControl()), or empty if none applies.
+static string CacheControlFor(const string& path,
+                              const map<string, string>& cache_control);
+
+// Process a query request, for the parsed "uri".
+static HttpResponse ProcessQueryRequest(const URLParser& uri,
+                                 const list<string>& indices,
+                                 bool stream, ServerMetrics* metrics,
+                                 RequestTrace* trace);
+
+// Writes the search page for the lower-cased query "terms_str" into
+// "body", calling "flush" (see HttpResponse::BodyStream) once the page
+// header is ready and then as result rows accumulate.  The time each
+// stage takes is recorded in "metrics" and "trace".
+static void WriteQueryPage(const string& terms_str,
+                           const list<string>& indices, string* body,
+                           const std::function<bool()>& flush,
+                           ServerMetrics* metrics, RequestTrace* trace);
+
+// Runs "query" against "indices", returning the matches through "results"
+// (and whether a prefix term was too broad for them to be complete
+// through "truncated") and recording the time each stage takes in
+// "metrics" and "trace".
+//
+// Returns false if the indices couldn't be opened.
+static bool RunQuery(const vector<string>& query, const list<string>& indices,
+                     ServerMetrics* metrics, RequestTrace* trace,
+                     vector<SegmentQueryProcessor::QueryResult>* results,
+                     bool* truncated);
 
-// Process a query request.
-static HttpResponse ProcessQueryRequest(const string& uri,
-                                 const list<string>& indices);
+// Process an autocomplete request: "/suggest?prefix=...&n=..." answers
+// with the JSON object {"prefix": ..., "suggestions": [...]}.
+static HttpResponse ProcessSuggestRequest(const URLParser& uri,
+                                          const Suggester& suggester);
+
+// Process a search API request: "/api/search?terms=...&k=...&offset=...
+// &fields=..." answers with the hit count, whether a prefix term was too
+// broad for the hits to be complete, the timing, and one page of results
+// as JSON.
+static HttpResponse ProcessSearchApiRequest(const URLParser& uri,
+                                            const list<string>& indices,
+                                            ServerMetrics* metrics,
+                                            RequestTrace* trace);
+
+// Process a batch API request: a POST to "/api/batch?k=..." whose body
+// holds one query per line answers with the first k results of each, as
+// JSON, in the same order as the queries.
+static HttpResponse ProcessBatchApiRequest(const HttpRequest& req,
+                                           const URLParser& uri,
+                                           const list<string>& indices);
+
+// Process a metrics request: "/metrics" answers with the server's
+// counters, gauges and histograms in the Prometheus text format.
+static HttpResponse ProcessMetricsRequest(const HttpServerTask& hst);
+
+// Returns a JSON error response {"error": "..."} with status "code".
+static HttpResponse JsonErrorResponse(uint16_t code, const string& message,
+                                      const string& error);
+
+// Splits the "terms" argument of a query into lower-case terms.
+static vector<string> SplitTerms(const string& terms);
+
+// Parses the non-negative integer "arg" into "value", which is left as
+// "default_value" if "arg" is empty.  Returns false if "arg" is malformed.
+static bool ParseCount(const string& arg, int default_value, int* value);
+
+// Returns the link to a result document: the document itself if it was
+// crawled from the web, and its copy under /static/ otherwise.
+static string DocumentUrl(const string& document_name);
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -81,14 +266,57 @@ bool HttpServer::Run(void) {
     return false;
   }
 
+  // Load the vocabulary for autocompletion before taking any requests.
+  cout << "  loading the autocomplete vocabulary..." << endl;
+  if (!suggester_.AddIndices(indices_)) {
+    cerr << "  couldn't read every index; suggestions may be incomplete"
+         << endl;
+  }
+  suggester_.Build();
+
+  // Open the access log before starting the threads that write to it,
+  // so that it outlives them.
+  unique_ptr<AccessLog> access_log;
+  if (access_log_path_.empty()) {
+    access_log.reset(new AccessLog());
+  } else {
+    access_log.reset(new AccessLog(access_log_path_,
+                                   AccessLog::kDefaultMaxBytes,
+                                   AccessLog::kDefaultMaxAgeSeconds));
+    if (!access_log->ok()) {
+      cerr << "  couldn't open the access log " << access_log_path_ << endl;
+      return false;
+    }
+  }
+
   // Spin, accepting connections and dispatching them.  Use a
   // threadpool to dispatch connections into their own thread.
   cout << "  accepting connections..." << endl << endl;
-  ThreadPool tp(kNumThreads);
+  ThreadPool tp(kNumThreads, kMaxQueuedConnections, kQueueDelayTargetMs,
+                kQueueDelayIntervalMs);
+  RegisterMetrics(&tp, access_log.get());
   while (1) {
     HttpServerTask* hst = new HttpServerTask(HttpServer_ThrFn);
+    hst->pool = &tp;
+    hst->metrics = &metrics_;
+    hst->rate_limiter = &rate_limiter_;
     hst->base_dir = static_file_dir_path_;
     hst->indices = &indices_;
+    hst->suggester = &suggester_;
+    hst->cache_control = &cache_control_;
+    hst->compression_level = compression_level_;
+    hst->gzip_cache = &gzip_cache_;
+    hst->reaper = &reaper_;
+    hst->timeouts = timeouts_;
+    hst->access_log = access_log.get();
+    hst->server_timing = server_timing_;
+    hst->slow_request_ms = slow_request_ms_;
+
+    // Wait for a connection first, so that the accept's time doesn't
+    // count the wait.
+    struct pollfd listener = {listen_fd, POLLIN, 0};
+    poll(&listener, 1, -1);
+    uint64_t accept_start_ns = MonotonicNs();
     if (!socket_.Accept(&hst->client_fd,
                     &hst->c_addr,
                     &hst->c_port,
@@ -99,18 +327,132 @@ bool HttpServer::Run(void) {
       // (Will happen when kill command is used to shut down the server.)
       break;
     }
-    // The accept succeeded; dispatch it.
-    tp.Dispatch(hst);
+    metrics_.accept.Record(MonotonicNs() - accept_start_ns);
+
+    // The accept succeeded; dispatch it, unless the client is connecting
+    // too often or we're too far behind to get to it in time.
+    int retry_after_s;
+    if (!rate_limiter_.Allow(hst->c_addr, RateLimiter::kConnect,
+                             &retry_after_s)) {
+      RefuseConnection(hst->client_fd, retry_after_s, &reaper_);
+      AccessLogRecord record = ClientRecord("refused", *hst);
+      record.status = 429;
+      access_log->Log(std::move(record));
+      delete hst;
+    } else if (!tp.Dispatch(hst)) {
+      ShedConnection(hst->client_fd, &reaper_);
+      AccessLogRecord record = ClientRecord("shed", *hst);
+      record.status = 503;
+      access_log->Log(std::move(record));
+      delete hst;
+    }
   }
   return true;
 }
 
+void HttpServer::RegisterMetrics(ThreadPool* pool, const AccessLog* log) {
+  MetricsRegistry& registry = metrics_.registry;
+  ServerMetrics* metrics = &metrics_;
+  registry.AddCounter("http333d_connections_total",
+                      "Connections accepted and served.", "",
+                      &metrics->connections_opened);
+  registry.AddGauge("http333d_active_connections",
+                    "Connections being served.", "", [metrics]() {
+                      return static_cast<double>(
+                          metrics->connections_opened.value())
+                        - metrics->connections_closed.value();
+                    });
+  registry.AddCounter("http333d_requests_total", "Requests answered.", "",
+                      &metrics->requests);
+
+  const char* stage_help = "Time taken by each stage of serving requests.";
+  const std::pair<const char*, const LatencyHistogram*> stages[] = {
+    {"accept", &metrics->accept}, {"queue", &metrics->queue},
+    {"parse", &metrics->parse}, {"open", &metrics->open},
+    {"lookup", &metrics->lookup}, {"postings", &metrics->postings},
+    {"names", &metrics->names}, {"render", &metrics->render},
+    {"write", &metrics->write},
+  };
+  for (const auto& stage : stages) {
+    registry.AddHistogram("http333d_stage_seconds", stage_help,
+                          string("stage=\"") + stage.first + "\"",
+                          stage.second);
+  }
+  registry.AddHistogram("http333d_request_seconds",
+                        "Time from parsing a request to having written "
+                        "its response.", "", &metrics->request);
+
+  registry.AddGauge("http333d_queue_length",
+                    "Connections waiting for a thread.", "",
+                    [pool]() { return pool->queue_length(); });
+  registry.AddCounter("http333d_shed_total",
+                      "Connections answered with a 503.",
+                      "where=\"admission\"",
+                      [pool]() { return pool->num_refused(); });
+  registry.AddCounter("http333d_shed_total",
+                      "Connections answered with a 503.", "where=\"queue\"",
+                      [pool]() { return pool->num_shed(); });
+
+  ConnectionReaper* reaper = &reaper_;
+  const char* phases[] = {"idle", "read", "write"};
+  for (int phase = 0; phase < ConnectionReaper::kNumPhases; phase++) {
+    registry.AddCounter("http333d_timeouts_total",
+                        "Connections shut down for overrunning a timeout.",
+                        string("phase=\"") + phases[phase] + "\"",
+                        [reaper, phase]() {
+                          return reaper->expired(
+                              static_cast<ConnectionReaper::Phase>(phase));
+                        });
+  }
+  registry.AddGauge("http333d_lingering_connections",
+                    "Rejected connections waiting for their clients to "
+                    "close.", "",
+                    [reaper]() { return reaper->lingering(); });
+
+  RateLimiter* limiter = &rate_limiter_;
+  const char* classes[] = {"connect", "static", "query"};
+  for (int c = 0; c < RateLimiter::kNumClasses; c++) {
+    registry.AddCounter("http333d_rate_limited_total",
+                        "Connections and requests answered with a 429.",
+                        string("class=\"") + classes[c] + "\"",
+                        [limiter, c]() {
+                          return limiter->num_limited(
+                              static_cast<RateLimiter::Class>(c));
+                        });
+  }
+  registry.AddGauge("http333d_rate_limited_clients",
+                    "Clients whose rates are being tracked.", "",
+                    [limiter]() { return limiter->num_clients(); });
+
+  CompressedFileCache* gzip_cache = &gzip_cache_;
+  registry.AddGauge("http333d_gzip_cache_bytes",
+                    "Compressed static file bytes held in memory.", "",
+                    [gzip_cache]() { return gzip_cache->size_bytes(); });
+
+  registry.AddCounter("http333d_access_log_written_total",
+                      "Access log records written.", "",
+                      [log]() { return log->written(); });
+  registry.AddCounter("http333d_access_log_dropped_total",
+                      "Access log records dropped for want of room.", "",
+                      [log]() { return log->dropped(); });
+}
+
 static void HttpServer_ThrFn(ThreadPool::Task* t) {
   // Cast back our HttpServerTask structure with all of our new
   // client's information in it.
   unique_ptr<HttpServerTask> hst(static_cast<HttpServerTask*>(t));
-  cout << "  client " << hst->c_dns << ":" << hst->c_port << " "
-       << "(IP address " << hst->c_addr << ")" << " connected." << endl;
+  ServerMetrics* metrics = hst->metrics;
+  metrics->queue.Record(hst->queue_ns_);
+  AccessLog* log = hst->access_log;
+  if (hst->shed_) {
+    ShedConnection(hst->client_fd, hst->reaper);
+    AccessLogRecord record = ClientRecord("shed", *hst);
+    record.status = 503;
+    log->Log(std::move(record));
+    return;
+  }
+  metrics->connections_opened.Increment();
+  log->Log(ClientRecord("connect", *hst));
 
   // Read in the next request, process it, and write the response.
 
@@ -124,45 +466,241 @@ static void HttpServer_ThrFn(ThreadPool::Task* t) {
   // creating/destroying the same connection repeatedly.
 
   // STEP 1:
-  HttpConnection hc = HttpConnection(hst->client_fd);
-  bool done = false;
-  while (!done) {
+  // The reaper shuts down connections that idle, or read or write too
+  // slowly, so no client can hold this thread indefinitely.
+  HttpConnection hc(hst->client_fd, hst->reaper, hst->timeouts);
+  const char* close_reason = nullptr;
+  for (int num_requests = 0; close_reason == nullptr; num_requests++) {
     HttpRequest result;
     if (!hc.GetNextRequest(&result)) {
-      cerr << "Could not get next request" << endl;
+      close_reason = CloseReason(hc, "no further request");
       break;
     }
-    HttpResponse response = ProcessRequest(result,
-                                          hst->base_dir,
-                                          *hst->indices);
+    RequestTrace trace;
+    if (num_requests == 0) {
+      trace.queue_ns = hst->queue_ns_;
+    }
+    trace.parse_ns = hc.read_ns();
+    metrics->parse.Record(trace.parse_ns);
+    uint64_t start_ns = MonotonicNs();
+    HttpResponse response = ProcessRequest(result, *hst, &trace);
+    CompressResponse(result, hst->compression_level, &response);
+    if (hst->server_timing) {
+      AddServerTiming(&trace, &response);
+    }
 
-    if (!hc.WriteResponse(response)) {
-      cerr << "Could not write response" << endl;
+    bool written = hc.WriteResponse(response);
+    uint64_t request_ns = MonotonicNs() - start_ns;
+    AccessLogRecord record = ClientRecord("request", *hst);
+    record.method = result.method();
+    record.uri = result.uri();
+    record.status = response.response_code();
+    record.bytes = hc.bytes_written();
+    record.duration_us = (hc.read_ns() + request_ns) / 1000;
+    if (hst->slow_request_ms > 0
+        && record.duration_us >= hst->slow_request_ms * int64_t(1000)) {
+      AccessLogRecord slow = record;
+      slow.event = "slow";
+      slow.trace = trace.ToJson();
+      log->Log(std::move(slow));
+    }
+    if (!written) {
+      record.detail = "response cut short";
+      log->Log(std::move(record));
+      close_reason = CloseReason(hc, "could not write response");
       break;
     }
+    log->Log(std::move(record));
+    metrics->write.Record(hc.write_ns());
+    metrics->request.Record(request_ns);
+    metrics->requests.Increment();
 
     if (result.GetHeaderValue("connection") == "close") {
-      cerr << "Client is closing connection..." << endl;
-      done = true;
+      close_reason = "client asked to close";
+    }
+  }
+  AccessLogRecord record = ClientRecord("close", *hst);
+  record.detail = close_reason;
+  log->Log(std::move(record));
+  metrics->connections_closed.Increment();
+}
+
+static void AddServerTiming(const RequestTrace* trace,
+                            HttpResponse* response) {
+  if (!response->is_streamed()) {
+    string timing = trace->ServerTiming();
+    if (!timing.empty()) {
+      response->AddHeader("Server-Timing", timing);
     }
+    return;
+  }
+  response->AddHeader("Trailer", "Server-Timing");
+  response->set_trailer([trace]() {
+      string timing = trace->ServerTiming();
+      return timing.empty() ? timing : "Server-Timing: " + timing + "\r\n";
+    });
+}
+
+static const char* CloseReason(const HttpConnection& hc,
+                               const char* otherwise) {
+  switch (hc.timed_out()) {
+    case ConnectionReaper::kIdle:
+      return "idle timeout";
+    case ConnectionReaper::kRead:
+      return "read timeout";
+    case ConnectionReaper::kWrite:
+      return "write timeout";
+    default:
+      return otherwise;
+  }
+}
+
+static AccessLogRecord ClientRecord(const char* event,
+                                    const HttpServerTask& hst) {
+  AccessLogRecord record;
+  record.event = event;
+  record.client = hst.c_addr;
+  record.port = hst.c_port;
+  return record;
+}
+
+static void ShedConnection(int client_fd, ConnectionReaper* reaper) {
+  HttpResponse ret;
+  ret.set_protocol("HTTP/1.1");
+  ret.set_response_code(503);
+  ret.set_message("Service Unavailable");
+  ret.AddHeader("Retry-After", std::to_string(kRetryAfterSeconds));
+  ret.AppendToBody("<html><body>The server is too busy to answer; "
+                   "please try again.</body></html>\n");
+  RejectConnection(client_fd, ret, reaper);
+}
+
+static void RefuseConnection(int client_fd, int retry_after_s,
+                             ConnectionReaper* reaper) {
+  RejectConnection(client_fd, TooManyRequestsResponse("/", retry_after_s),
+                   reaper);
+}
+
+static HttpResponse TooManyRequestsResponse(std::string_view path,
+                                            int retry_after_s) {
+  HttpResponse ret;
+  if (path.compare(0, 5, "/api/") == 0) {
+    ret = JsonErrorResponse(429, "Too Many Requests",
+                            "too many requests; slow down");
+  } else {
+    ret.set_protocol("HTTP/1.1");
+    ret.set_response_code(429);
+    ret.set_message("Too Many Requests");
+    ret.AppendToBody("<html><body>You're sending too many requests; "
+                     "please slow down.</body></html>\n");
   }
-  hc.~HttpConnection();
+  ret.AddHeader("Retry-After", std::to_string(retry_after_s));
+  return ret;
+}
+
+static void RejectConnection(int client_fd, HttpResponse response,
+                             ConnectionReaper* reaper) {
+  response.AddHeader("Connection", "close");
+  HttpConnection::Reject(client_fd, response, reaper);
 }
 
 static HttpResponse ProcessRequest(const HttpRequest& req,
-                            const string& base_dir,
-                            const list<string>& indices) {
+                            const HttpServerTask& hst, RequestTrace* trace) {
+  const list<string>& indices = *hst.indices;
+  int retry_after_s;
+
   // Is the user asking for a static file?
   if (req.uri().substr(0, 8) == "/static/") {
-    return ProcessFileRequest(req.uri(), base_dir);
+    if (!hst.rate_limiter->Allow(hst.c_addr, RateLimiter::kStatic,
+                                 &retry_after_s)) {
+      return TooManyRequestsResponse(req.uri(), retry_after_s);
+    }
+    return ProcessFileRequest(req, hst);
+  }
+
+  // Is the search box asking for completions?  The handlers below all
+  // share this parse of the uri.
+  URLParser parsed_uri;
+  parsed_uri.Parse(req.uri());
+  if (parsed_uri.path() == "/suggest") {
+    return ProcessSuggestRequest(parsed_uri, *hst.suggester);
+  }
+  if (parsed_uri.path() == "/metrics") {
+    return ProcessMetricsRequest(hst);
+  }
+
+  // Everything else reads the indices, so turn away clients over their
+  // rate before doing any of that work.
+  if (!hst.rate_limiter->Allow(hst.c_addr, RateLimiter::kQuery,
+                               &retry_after_s)) {
+    return TooManyRequestsResponse(parsed_uri.path(), retry_after_s);
+  }
+
+  // Is a program asking for results?
+  if (parsed_uri.path() == "/api/search") {
+    return ProcessSearchApiRequest(parsed_uri, indices, hst.metrics, trace);
+  }
+  if (parsed_uri.path() == "/api/batch") {
+    return ProcessBatchApiRequest(req, parsed_uri, indices);
   }
 
   // The user must be asking for a query.
-  return ProcessQueryRequest(req.uri(), indices);
+  // Stream the results to clients that understand chunked encoding.
+  return ProcessQueryRequest(parsed_uri, indices,
+                             req.protocol() == "HTTP/1.1", hst.metrics,
+                             trace);
+}
+
+static void CompressResponse(const HttpRequest& req, int level,
+                             HttpResponse* response) {
+  // Files carry their own encoding (see ProcessFileRequest), and small
+  // bodies would barely shrink.
+  if (level <= 0 || response->response_code() != 200
+      || !response->file_ranges().empty()
+      || !response->GetHeaderValue("Content-Encoding").empty()
+      || !IsCompressibleType(response->content_type())
+      || (!response->is_streamed()
+          && response->body().size() < kMinCompressBytes)) {
+    return;
+  }
+  response->AddHeader("Vary", "Accept-Encoding");
+  string encoding = NegotiateEncoding(req.GetHeaderValue("accept-encoding"));
+  if (encoding.empty()) {
+    return;
+  }
+
+  if (response->is_streamed()) {
+    // Compress each piece as it's flushed, so the client can still show
+    // the page as it arrives.
+    HttpResponse::BodyStream plain_stream = response->body_stream();
+    response->set_body_stream([plain_stream, encoding, level](
+                                  string* body,
+                                  const std::function<bool()>& flush) {
+        StreamCompressor compressor(encoding, level);
+        string plain;
+        plain_stream(&plain, [&]() {
+            compressor.Compress(plain, false, body);
+            plain.clear();
+            return flush();
+          });
+        compressor.Compress(plain, true, body);
+      });
+  } else {
+    string compressed;
+    if (!Compress(response->body().data(), response->body().size(),
+                  encoding, level, &compressed)) {
+      return;
+    }
+    response->mutable_body()->swap(compressed);
+  }
+  response->AddHeader("Content-Encoding", encoding);
 }
 
-static HttpResponse ProcessFileRequest(const string& uri,
-                                const string& base_dir) {
+static HttpResponse ProcessFileRequest(const HttpRequest& req,
+                                const HttpServerTask& hst) {
+  const string& uri = req.uri();
+  const string& base_dir = hst.base_dir;
+
   // The response we'll build up.
   HttpResponse ret;
 
@@ -171,9 +709,9 @@ static HttpResponse ProcessFileRequest(const string& uri,
   //    the user is asking for. Note that we identify a request
   //    as a file request if the URI starts with '/static/'
   //
-  // 2. Use the FileReader class to read the file into memory
+  // 2. Use the FileReader class to open the file
   //
-  // 3. Copy the file content into the ret.body
+  // 3. Send the file content (or the requested ranges) as the body
   //
   // 4. Depending on the file name suffix, set the response
   //    Content-type header as appropriate, e.g.,:
@@ -206,14 +744,13 @@ static HttpResponse ProcessFileRequest(const string& uri,
   //   return ret;
   // }
   FileReader freader(base_dir, file_name);
-  string file_contents;
+  int fd;
+  struct stat info;
 
-  if (freader.ReadFile(&file_contents)) {
-    // We found the file
+  if (freader.Open(&fd, &info)) {
+    // We found the file; it's sent straight from disk, not read in here.
+    ret.set_body_file(fd);
     ret.set_protocol("HTTP/1.1");
-    ret.set_response_code(200);
-    ret.set_message("OK");
-    ret.AppendToBody(file_contents);
 
     // Set response content header
     string suffix = file_name.substr(file_name.find_last_of(".") + 1);
@@ -237,7 +774,115 @@ static HttpResponse ProcessFileRequest(const string& uri,
     } else {
       suffix_header = "text/plain";
     }
-    ret.set_content_type(suffix_header);
+
+
+    // Clients that take gzip get the file's precompressed ".gz" sibling
+    // if it's up to date, and otherwise a copy compressed once and kept
+    // in the gzip cache.  Ranges are always of the file as it is.
+    string etag = FileETag(info);
+    uint64_t size = info.st_size;
+    bool gzip = false, compress = false;
+    if (IsCompressibleType(suffix_header)
+        && req.GetHeaderValue("range").empty()) {
+      ret.AddHeader("Vary", "Accept-Encoding");
+      gzip = NegotiateEncoding(req.GetHeaderValue("accept-encoding"))
+        == kGzipEncoding;
+    }
+    if (gzip) {
+      FileReader gz_reader(base_dir, file_name + ".gz");
+      int gz_fd;
+      struct stat gz_info;
+      bool fresh = false;
+      if (gz_reader.Open(&gz_fd, &gz_info)) {
+        fresh = gz_info.st_mtime >= info.st_mtime;
+        if (fresh) {
+          ret.set_body_file(gz_fd);
+          etag = FileETag(gz_info);
+          size = gz_info.st_size;
+          ret.AddHeader("Content-Encoding", kGzipEncoding);
+        } else {
+          close(gz_fd);
+        }
+      }
+
+      // The cached copy's tag doesn't depend on its contents, so it is
+      // known before (and without) compressing anything.
+      compress = !fresh && hst.compression_level > 0
+        && size <= kMaxGzipFileBytes;
+      if (compress) {
+        etag.insert(etag.size() - 1, "-gzip");
+      }
+    }
+
+    // Tell caches how to revalidate the file, and skip sending it if the
+    // client's copy is still good.
+    ret.AddHeader("ETag", etag);
+    ret.AddHeader("Last-Modified", FormatHttpDate(info.st_mtime));
+    string cache = CacheControlFor("/static/" + file_name,
+                                   *hst.cache_control);
+    if (!cache.empty()) {
+      ret.AddHeader("Cache-Control", cache);
+    }
+    if (IsNotModified(req, etag, info.st_mtime)) {
+      ret.set_response_code(304);
+      ret.set_message("Not Modified");
+      return ret;
+    }
+
+    // Only now is the file compressed, if it has to be; a request with a
+    // Range never is.  If that fails, the file goes out as it is.
+    if (compress) {
+      std::shared_ptr<const string> gzipped =
+        hst.gzip_cache->Get(base_dir + "/" + file_name + FileETag(info), fd,
+                            size, hst.compression_level);
+      if (gzipped != nullptr) {
+        ret.AddHeader("Content-Encoding", kGzipEncoding);
+        ret.set_response_code(200);
+        ret.set_message("OK");
+        ret.set_content_type(suffix_header);
+        ret.AppendToBody(*gzipped);
+        return ret;
+      }
+      ret.AddHeader("ETag", FileETag(info));
+    }
+
+    // Send only the requested ranges, if the client asked for some (of
+    // the version of the file it has, if it said which with If-Range).
+    ret.AddHeader("Accept-Ranges", "bytes");
+    vector<ByteRange> ranges;
+    string range_header = req.GetHeaderValue("range");
+    if (range_header.empty() || !IfRangeHolds(req, etag, info.st_mtime)
+        || !ParseByteRanges(range_header, size, &ranges)
+        || ranges.size() > kMaxRanges) {
+      ret.set_response_code(200);
+      ret.set_message("OK");
+      ret.set_content_type(suffix_header);
+      ret.AppendFileToBody(0, size);
+    } else if (ranges.empty()) {
+      ret.set_response_code(416);
+      ret.set_message("Range Not Satisfiable");
+      ret.AddHeader("Content-Range", "bytes */" + std::to_string(size));
+    } else if (ranges.size() == 1) {
+      ret.set_response_code(206);
+      ret.set_message("Partial Content");
+      ret.set_content_type(suffix_header);
+      ret.AddHeader("Content-Range", ContentRange(ranges[0], size));
+      ret.AppendFileToBody(ranges[0].first,
+                           ranges[0].last - ranges[0].first + 1);
+    } else {
+      ret.set_response_code(206);
+      ret.set_message("Partial Content");
+      ret.set_content_type(string("multipart/byteranges; boundary=")
+                           + kByteRangesBoundary);
+      for (const ByteRange& range : ranges) {
+        ret.AppendToBody(string("\r\n--") + kByteRangesBoundary
+                         + "\r\nContent-Type: " + suffix_header
+                         + "\r\nContent-Range: " + ContentRange(range, size)
+                         + "\r\n\r\n");
+        ret.AppendFileToBody(range.first, range.last - range.first + 1);
+      }
+      ret.AppendToBody(string("\r\n--") + kByteRangesBoundary + "--\r\n");
+    }
     return ret;
   } else {
     // If you couldn't find the file, return an HTTP 404 error.
@@ -251,8 +896,79 @@ static HttpResponse ProcessFileRequest(const string& uri,
   }
 }
 
-static HttpResponse ProcessQueryRequest(const string& uri,
-                                 const list<string>& indices) {
+static bool IfRangeHolds(const HttpRequest& req, const string& etag,
+                         time_t mtime) {
+  string if_range = req.GetHeaderValue("if-range");
+  if (if_range.empty()) {
+    return true;
+  }
+  // Ranges need a strong validator: a weak tag never matches.
+  if (if_range[0] == '"' || if_range.compare(0, 2, "w/") == 0) {
+    return if_range == etag;
+  }
+  time_t date;
+  return ParseHttpDate(if_range, &date) && date == mtime;
+}
+
+static string ContentRange(const ByteRange& range, uint64_t size) {
+  return "bytes " + std::to_string(range.first) + "-"
+    + std::to_string(range.last) + "/" + std::to_string(size);
+}
+
+static string FileETag(const struct stat& info) {
+  char etag[64];
+  uint64_t mtime_ns = static_cast<uint64_t>(info.st_mtim.tv_sec) * 1000000000
+    + info.st_mtim.tv_nsec;
+  snprintf(etag, sizeof(etag), "\"%" PRIx64 "-%" PRIx64 "-%" PRIx64 "\"",
+           static_cast<uint64_t>(info.st_ino), mtime_ns,
+           static_cast<uint64_t>(info.st_size));
+  return etag;
+}
+
+static bool IsNotModified(const HttpRequest& req, const string& etag,
+                          time_t mtime) {
+  // If-None-Match, when present, overrides If-Modified-Since.  Header
+  // values arrive lower-cased, which our tags already are.
+  string if_none_match = req.GetHeaderValue("if-none-match");
+  if (!if_none_match.empty()) {
+    vector<string> tags;
+    boost::split(tags, if_none_match, boost::is_any_of(","));
+    for (string& tag : tags) {
+      boost::algorithm::trim(tag);
+      if (tag.compare(0, 2, "w/") == 0) {
+        tag = tag.substr(2);
+      }
+      if (tag == "*" || tag == etag) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  time_t since;
+  string if_modified_since = req.GetHeaderValue("if-modified-since");
+  return !if_modified_since.empty()
+    && ParseHttpDate(if_modified_since, &since) && mtime <= since;
+}
+
+static string CacheControlFor(const string& path,
+                              const map<string, string>& cache_control) {
+  const string* best = nullptr;
+  size_t best_len = 0;
+  for (const auto& rule : cache_control) {
+    if (path.compare(0, rule.first.size(), rule.first) == 0
+        && (best == nullptr || rule.first.size() > best_len)) {
+      best = &rule.second;
+      best_len = rule.first.size();
+    }
+  }
+  return best == nullptr ? "" : *best;
+}
+
+static HttpResponse ProcessQueryRequest(const URLParser& uri,
+                                 const list<string>& indices,
+                                 bool stream, ServerMetrics* metrics,
+                                 RequestTrace* trace) {
   // The response we're building up.
   HttpResponse ret;
 
@@ -269,69 +985,375 @@ static HttpResponse ProcessQueryRequest(const string& uri,
   //    search terms from a typed-in search query.  convert them
   //    to lower case.
   //
-  // 4. Initialize and use hw3::QueryProcessor to process queries with the
-  //    search indices.
+  // 4. Initialize and use SegmentQueryProcessor to process queries with the
+  //    search indices (index files or segment set directories).
   //
   // 5. With your results, try figuring out how to hyperlink results to file
   //    contents, like in solution_binaries/http333d. (Hint: Look into HTML
   //    tags!)
 
   // STEP 3:
+  // Extract the terms into a string and set to lower
+  string terms_str = uri.arg("terms");
+  boost::algorithm::to_lower(terms_str);
+
+  ret.set_protocol("HTTP/1.1");
+  ret.set_response_code(200);
+  ret.set_message("OK");
+  ret.set_content_type("text/html");
+
+  // A streamed page gets its header and search box out before the query
+  // runs, then its results a chunk at a time.
+  if (stream && !terms_str.empty()) {
+    ret.set_body_stream([terms_str, &indices, metrics, trace](
+                            string* body, const std::function<bool()>& flush) {
+        WriteQueryPage(terms_str, indices, body, flush, metrics, trace);
+      });
+  } else {
+    WriteQueryPage(terms_str, indices, ret.mutable_body(),
+                   []() { return true; }, metrics, trace);
+  }
+  return ret;
+}
+
+static void WriteQueryPage(const string& terms_str,
+                           const list<string>& indices, string* body,
+                           const std::function<bool()>& flush,
+                           ServerMetrics* metrics, RequestTrace* trace) {
+  // Rendering takes whatever time the query and the flushes (which write
+  // the page out) don't.
+  uint64_t start_ns = MonotonicNs();
+  uint64_t other_ns = 0;
+  auto timed_flush = [&flush, &other_ns]() {
+    uint64_t flush_start_ns = MonotonicNs();
+    bool ok = flush();
+    other_ns += MonotonicNs() - flush_start_ns;
+    return ok;
+  };
+  auto record_render = [metrics, trace, start_ns, &other_ns]() {
+    trace->render_ns = MonotonicNs() - start_ns - other_ns;
+    metrics->render.Record(trace->render_ns);
+  };
+
   // Show title and search bar on screen
-  stringstream ss;
-  ss << kThreegleStr;
+  body->append(kThreegleStr);
+  if (terms_str.empty() || !timed_flush()) {
+    record_render();
+    return;
+  }
 
-  // Parse the uri
-  URLParser parsed_uri;
-  parsed_uri.Parse(uri);
-  // Extract the args and check if there are any
-  std::map<std::string, std::string> args = parsed_uri.args();
-  if (!args["terms"].empty()) {
-    // Extract the terms into a string and set to lower
-    string terms_str = args["terms"];
-    boost::algorithm::to_lower(terms_str);
-
-    // Split terms on "+" and store in vector
-    vector<string> terms_vec;
-    string temp_str;
-    stringstream temp_ss(terms_str);
-    while (std::getline(temp_ss, temp_str, ' ')) {
-        // store term string in the vector
-        terms_vec.push_back(temp_str);
+  // Split terms on "+" and store in vector
+  vector<string> terms_vec = SplitTerms(terms_str);
+
+  uint64_t query_start_ns = MonotonicNs();
+  vector<SegmentQueryProcessor::QueryResult> queryR;
+  bool truncated;
+  bool opened = RunQuery(terms_vec, indices, metrics, trace, &queryR,
+                         &truncated);
+  other_ns += MonotonicNs() - query_start_ns;
+  if (!opened) {
+    body->append("<div>The index is unavailable; please try again.</div>");
+    record_render();
+    return;
+  }
+  if (truncated) {
+    string max_terms = std::to_string(SegmentQueryProcessor::kMaxPrefixTerms);
+    body->append("<div>A prefix matched more than " + max_terms
+                 + " words, and only the first " + max_terms
+                 + " were searched; try a longer prefix.</div>");
+  }
+
+  if (queryR.empty()) {
+    body->append("<div>No results found for <b>");
+  } else {
+    body->append("<div>" + std::to_string(queryR.size())
+                 + " results found for <b>");
+  }
+  AppendHtmlEscaped(body, terms_str.data(), terms_str.size());
+  body->append(queryR.empty() ? "</b></div>" : "</b></div><br>");
+  for (const SegmentQueryProcessor::QueryResult &document : queryR) {
+    // Escaped straight into the page, as document names can hold
+    // anything.
+    string url = DocumentUrl(document.document_name);
+    body->append("<div><li><a href=\"");
+    AppendHtmlEscaped(body, url.data(), url.size());
+    body->append("\"");
+    if (url == document.document_name) {
+      body->append(" target=\"_blank\"");
     }
+    body->push_back('>');
+    AppendHtmlEscaped(body, document.document_name.data(),
+                      document.document_name.size());
+    body->append("</a> [" + std::to_string(document.rank) + "]</li></div>");
+    if (body->size() >= kChunkBytes && !timed_flush()) {
+      break;
+    }
+  }
+  record_render();
+}
 
-    hw3::QueryProcessor queryP(indices, true);
-    vector<hw3::QueryProcessor::QueryResult> queryR =
-                    queryP.ProcessQuery(terms_vec);
+static bool RunQuery(const vector<string>& query, const list<string>& indices,
+                     ServerMetrics* metrics, RequestTrace* trace,
+                     vector<SegmentQueryProcessor::QueryResult>* results,
+                     bool* truncated) {
+  uint64_t start_ns = MonotonicNs();
+  SegmentQueryProcessor qp(indices, true);
+  bool opened = qp.Open();
+  trace->open_ns = MonotonicNs() - start_ns;
+  metrics->open.Record(trace->open_ns);
+  trace->terms = query;
+  if (!opened) {
+    return false;
+  }
 
-    if (queryR.empty()) {
-      ss << "<div>No results found for <b>" <<
-            EscapeHtml(terms_str) << "</b></div>";
-    } else {
-      ss << "<div>" << queryR.size() << " results found for <b>" <<
-            EscapeHtml(terms_str) << "</b></div><br>";
+  trace->query = SegmentQueryProcessor::QueryTiming();
+  *results = qp.ProcessQuery(query, &trace->query, truncated);
+  metrics->lookup.Record(trace->query.lookup_ns);
+  metrics->postings.Record(trace->query.postings_ns);
+  metrics->names.Record(trace->query.names_ns);
+  return true;
+}
+
+static HttpResponse ProcessSuggestRequest(const URLParser& uri,
+                                          const Suggester& suggester) {
+  // Words are indexed in lower case.
+  string prefix = uri.arg("prefix");
+  boost::algorithm::to_lower(prefix);
+  int max_results;
+  if (!ParseCount(uri.arg("n"), Suggester::kTopK, &max_results)) {
+    return JsonErrorResponse(400, "Bad Request",
+                             "n must be a non-negative integer");
+  }
+
+  HttpResponse ret;
+  ret.set_protocol("HTTP/1.1");
+  ret.set_response_code(200);
+  ret.set_message("OK");
+  ret.set_content_type("application/json");
+  JsonWriter json(ret.mutable_body());
+  json.BeginObject().Key("prefix").String(prefix)
+      .Key("suggestions").BeginArray();
+  if (!prefix.empty()) {
+    for (const string& word : suggester.Suggest(prefix, max_results)) {
+      json.String(word);
     }
-    for (const hw3::QueryProcessor::QueryResult &document : queryR) {
-      if (document.document_name.find("http://") == 0
-          || document.document_name.find("https://") == 0) {
-        ss << "<div><li><a href=\"" << document.document_name
-            << "\" target=\"_blank\">" << document.document_name
-            << "</a> [" << document.rank << "]</li></div>";
+  }
+  json.EndArray().EndObject();
+  return ret;
+}
+
+static HttpResponse ProcessSearchApiRequest(const URLParser& uri,
+                                            const list<string>& indices,
+                                            ServerMetrics* metrics,
+                                            RequestTrace* trace) {
+  int k, offset;
+  if (!ParseCount(uri.arg("k"), kDefaultApiResults, &k)
+      || !ParseCount(uri.arg("offset"), 0, &offset) || k > kMaxApiResults) {
+    return JsonErrorResponse(400, "Bad Request",
+                             "k and offset must be non-negative integers, "
+                             "and k at most " + std::to_string(kMaxApiResults));
+  }
+
+  // Only the requested fields of each result are sent.
+  bool want_document = true, want_rank = true, want_url = false;
+  string fields_str = uri.arg("fields");
+  if (!fields_str.empty()) {
+    want_document = want_rank = false;
+    vector<string> fields;
+    boost::split(fields, fields_str, boost::is_any_of(","));
+    for (const string& field : fields) {
+      if (field == "document") {
+        want_document = true;
+      } else if (field == "rank") {
+        want_rank = true;
+      } else if (field == "url") {
+        want_url = true;
       } else {
-        ss << "<div><li><a href=\"/static/" << document.document_name
-            << "\">" << document.document_name << "</a> ["
-            << document.rank << "]</li></div>";
+        return JsonErrorResponse(400, "Bad Request",
+                                 "unknown field \"" + field + "\"");
       }
     }
   }
 
+  string terms_str = uri.arg("terms");
+  boost::algorithm::to_lower(terms_str);
+  vector<string> terms = SplitTerms(terms_str);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  vector<SegmentQueryProcessor::QueryResult> results;
+  bool truncated = false;
+  if (!terms.empty()
+      && !RunQuery(terms, indices, metrics, trace, &results, &truncated)) {
+    return JsonErrorResponse(503, "Service Unavailable",
+                             "the index couldn't be opened");
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  int64_t elapsed_us = (end.tv_sec - start.tv_sec) * 1000000
+    + (end.tv_nsec - start.tv_nsec) / 1000;
+
+  HttpResponse ret;
   ret.set_protocol("HTTP/1.1");
   ret.set_response_code(200);
   ret.set_message("OK");
-  ret.AppendToBody(ss.str());
-  ret.set_content_type("text/html");
+  ret.set_content_type("application/json");
+  JsonWriter json(ret.mutable_body());
+  json.BeginObject()
+      .Key("query").String(terms_str)
+      .Key("hits").Int(results.size())
+      .Key("truncated").Bool(truncated)
+      .Key("offset").Int(offset)
+      .Key("k").Int(k)
+      .Key("elapsed_us").Int(elapsed_us)
+      .Key("results").BeginArray();
+  size_t page_end = std::min(results.size(), static_cast<size_t>(offset) + k);
+  for (size_t i = offset; i < page_end; i++) {
+    json.BeginObject();
+    if (want_document) {
+      json.Key("document").String(results[i].document_name);
+    }
+    if (want_rank) {
+      json.Key("rank").Int(results[i].rank);
+    }
+    if (want_url) {
+      json.Key("url").String(DocumentUrl(results[i].document_name));
+    }
+    json.EndObject();
+  }
+  json.EndArray().EndObject();
+  return ret;
+}
+
+static HttpResponse ProcessBatchApiRequest(const HttpRequest& req,
+                                           const URLParser& uri,
+                                           const list<string>& indices) {
+  if (req.method() != "POST") {
+    HttpResponse ret = JsonErrorResponse(405, "Method Not Allowed",
+                                         "/api/batch takes a POST");
+    ret.AddHeader("Allow", "POST");
+    return ret;
+  }
+  int k;
+  if (!ParseCount(uri.arg("k"), kDefaultApiResults, &k) || k > kMaxApiResults) {
+    return JsonErrorResponse(400, "Bad Request",
+                             "k must be a non-negative integer, at most "
+                             + std::to_string(kMaxApiResults));
+  }
+
+  // One query per line; a final newline doesn't start another.
+  vector<string> lines;
+  boost::split(lines, req.body(), boost::is_any_of("\n"));
+  if (!lines.empty() && lines.back().empty()) {
+    lines.pop_back();
+  }
+  if (lines.size() > kMaxBatchQueries) {
+    return JsonErrorResponse(413, "Payload Too Large",
+                             "at most " + std::to_string(kMaxBatchQueries)
+                             + " queries per batch");
+  }
+  vector<vector<string>> queries;
+  for (string& line : lines) {
+    boost::algorithm::trim(line);
+    boost::algorithm::to_lower(line);
+    queries.push_back(SplitTerms(line));
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  SegmentQueryProcessor qp(indices, true);
+  if (!qp.Open()) {
+    return JsonErrorResponse(503, "Service Unavailable",
+                             "the index couldn't be opened");
+  }
+  vector<bool> truncated;
+  vector<vector<SegmentQueryProcessor::QueryResult>> results =
+    qp.ProcessQueries(queries, kBatchThreads, &truncated);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  int64_t elapsed_us = (end.tv_sec - start.tv_sec) * 1000000
+    + (end.tv_nsec - start.tv_nsec) / 1000;
+
+  HttpResponse ret;
+  ret.set_protocol("HTTP/1.1");
+  ret.set_response_code(200);
+  ret.set_message("OK");
+  ret.set_content_type("application/json");
+  JsonWriter json(ret.mutable_body());
+  json.BeginObject()
+      .Key("queries").Int(queries.size())
+      .Key("k").Int(k)
+      .Key("elapsed_us").Int(elapsed_us)
+      .Key("results").BeginArray();
+  for (size_t q = 0; q < queries.size(); q++) {
+    json.BeginObject()
+        .Key("query").String(lines[q])
+        .Key("hits").Int(results[q].size())
+        .Key("truncated").Bool(truncated[q])
+        .Key("results").BeginArray();
+    size_t page_end = std::min(results[q].size(), static_cast<size_t>(k));
+    for (size_t i = 0; i < page_end; i++) {
+      json.BeginObject()
+          .Key("document").String(results[q][i].document_name)
+          .Key("rank").Int(results[q][i].rank)
+          .EndObject();
+    }
+    json.EndArray().EndObject();
+  }
+  json.EndArray().EndObject();
+  return ret;
+}
 
+static HttpResponse ProcessMetricsRequest(const HttpServerTask& hst) {
+  HttpResponse ret;
+  ret.set_protocol("HTTP/1.1");
+  ret.set_response_code(200);
+  ret.set_message("OK");
+  ret.set_content_type("text/plain; version=0.0.4");
+  hst.metrics->registry.Write(ret.mutable_body());
   return ret;
 }
 
+static HttpResponse JsonErrorResponse(uint16_t code, const string& message,
+                                      const string& error) {
+  HttpResponse ret;
+  ret.set_protocol("HTTP/1.1");
+  ret.set_response_code(code);
+  ret.set_message(message);
+  ret.set_content_type("application/json");
+  JsonWriter(ret.mutable_body()).BeginObject().Key("error").String(error)
+      .EndObject();
+  return ret;
+}
+
+static vector<string> SplitTerms(const string& terms) {
+  vector<string> split;
+  string term;
+  stringstream ss(terms);
+  while (std::getline(ss, term, ' ')) {
+    if (!term.empty()) {
+      split.push_back(term);
+    }
+  }
+  return split;
+}
+
+static bool ParseCount(const string& arg, int default_value, int* value) {
+  if (arg.empty()) {
+    *value = default_value;
+    return true;
+  }
+  if (arg.size() > 9
+      || arg.find_first_not_of("0123456789") != string::npos) {
+    return false;
+  }
+  *value = atoi(arg.c_str());
+  return true;
+}
+
+static string DocumentUrl(const string& document_name) {
+  if (document_name.find("http://") == 0
+      || document_name.find("https://") == 0) {
+    return document_name;
+  }
+  return "/static/" + document_name;
+}
+
 }  // namespace hw4
@@ -4,12 +4,37 @@
 #include <stdint.h>
 #include <string>
 #include <list>
+#include <map>
 
+#include "./AccessLog.h"
+#include "./Compression.h"
+#include "./ConnectionReaper.h"
+#include "./Metrics.h"
+#include "./RateLimiter.h"
 #include "./ThreadPool.h"
 #include "./ServerSocket.h"
+#include "./Suggester.h"
 
 namespace hw4 {
 
+// What the server measures about its work, exported at /metrics.
+struct ServerMetrics {
+  MetricsRegistry registry;
+
+  Counter connections_opened;
+  Counter connections_closed;
+  Counter requests;
+
+  // How long each stage of serving a connection takes: accepting it,
+  // waiting in the queue for a thread, reading and parsing each request,
+  // opening the indices, the query's stages (see
+  // SegmentQueryProcessor::QueryTiming), rendering the page, and writing
+  // the response.  "request" is the whole of a request, from its parse
+  // to its last byte written.
+  LatencyHistogram accept, queue, parse, open, lookup, postings, names,
+    render, write, request;
+};
+
 // The HttpServer class contains the main logic for the web server.
 class HttpServer {
  public:
@@ -21,7 +46,9 @@ class HttpServer {
                       const std::string& static_file_dir_path,
                       const std::list<std::string>& indices)
     : socket_(port), static_file_dir_path_(static_file_dir_path),
-      indices_(indices) { }
+      indices_(indices), compression_level_(kDefaultCompressionLevel),
+      gzip_cache_(kGzipCacheBytes), timeouts_(kDefaultTimeouts),
+      server_timing_(false), slow_request_ms_(kDefaultSlowRequestMs) { }
 
   // The destructor closes the listening socket if it is open and
   // also terminates any threads in the threadpool.
@@ -36,11 +63,72 @@ class HttpServer {
   // a SIGTERM signal to the server process (i.e., kill pid, ctrl+C).
   bool Run();
 
+  // Sends "Cache-Control: <value>" with the static files whose request
+  // path starts with "path_prefix", such as "/static/images/"; when
+  // several prefixes match, the longest wins.  Call before Run().
+  void SetCacheControl(const std::string& path_prefix,
+                       const std::string& value) {
+    cache_control_[path_prefix] = value;
+  }
+
+  // Sets the zlib level (1 to 9) at which compressible responses are
+  // gzipped or deflated for the clients that accept it, or turns that off
+  // (0).  Precompressed ".gz" static files are served either way.  Call
+  // before Run().
+  void SetCompressionLevel(int level) { compression_level_ = level; }
+
+  // Sets how long clients may take before their connections are shut
+  // down (see ConnectionTimeouts).  Call before Run().
+  void SetTimeouts(const ConnectionTimeouts& timeouts) {
+    timeouts_ = timeouts;
+  }
+
+  // Limits each client address to "per_second" connections or requests
+  // of "work_class" a second, in bursts of up to "burst"; those over it
+  // are answered with a 429.  Call before Run().
+  void SetRateLimit(RateLimiter::Class work_class, double per_second,
+                    double burst) {
+    rate_limiter_.SetRate(work_class, per_second, burst);
+  }
+
+  // Writes the access log to the file "path", rotating it daily or at
+  // AccessLog::kDefaultMaxBytes, rather than to standard output.  Call
+  // before Run().
+  void SetAccessLog(const std::string& path) { access_log_path_ = path; }
+
+  // Sends each response with a Server-Timing header breaking down where
+  // the request's time went (see RequestTrace).  Call before Run().
+  void SetServerTiming(bool enabled) { server_timing_ = enabled; }
+
+  // Logs requests taking "ms" milliseconds or more to the access log as
+  // "slow" events, with their RequestTrace, or none of them (0).  Call
+  // before Run().
+  void SetSlowRequestThreshold(int ms) { slow_request_ms_ = ms; }
+
  private:
+  // Registers our metrics, and those of "pool" and "log", with
+  // metrics_.registry.
+  void RegisterMetrics(ThreadPool* pool, const AccessLog* log);
+
   ServerSocket socket_;
   std::string static_file_dir_path_;
   std::list<std::string> indices_;
+  Suggester suggester_;
+  std::map<std::string, std::string> cache_control_;
+  int compression_level_;
+  CompressedFileCache gzip_cache_;
+  ConnectionTimeouts timeouts_;
+  ConnectionReaper reaper_;
+  RateLimiter rate_limiter_;
+  ServerMetrics metrics_;
+  std::string access_log_path_;
+  bool server_timing_;
+  int slow_request_ms_;
   static const int kNumThreads;
+  static const int kDefaultCompressionLevel;
+  static const size_t kGzipCacheBytes;
+  static const ConnectionTimeouts kDefaultTimeouts;
+  static const int kDefaultSlowRequestMs;
 };
 
 class HttpServerTask : public ThreadPool::Task {
@@ -53,6 +141,18 @@ class HttpServerTask : public ThreadPool::Task {
   std::string c_addr, c_dns, s_addr, s_dns;
   std::string base_dir;
   std::list<std::string>* indices;
+  const Suggester* suggester;
+  const std::map<std::string, std::string>* cache_control;
+  int compression_level;
+  CompressedFileCache* gzip_cache;
+  ConnectionReaper* reaper;
+  ConnectionTimeouts timeouts;
+  ThreadPool* pool;
+  RateLimiter* rate_limiter;
+  ServerMetrics* metrics;
+  AccessLog* access_log;
+  bool server_timing;
+  int slow_request_ms;
 };
 
 }  // namespace hw4
@@ -7,7 +7,6 @@
 #include <errno.h>
 #include <limits.h>
 #include <netdb.h>
-#include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string.hpp>
 #include <stdint.h>
 #include <stdio.h>
@@ -15,13 +14,20 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <vector>
 #include "./HttpUtils.h"
+#include "./JsonWriter.h"
 
-using boost::algorithm::replace_all;
 using std::cerr;
 using std::endl;
 using std::map;
@@ -32,6 +38,44 @@ using std::string;
 
 namespace hw4 {
 
+// An escape sequence, and its length.
+struct Escape {
+  const char* str;
+  size_t len;
+};
+
+// The escape sequence of each byte that HTML needs escaped, and a null
+// str for the rest.
+static const std::array<Escape, 256> kHtmlEscapes = [] {
+  std::array<Escape, 256> table{};
+  table['&'] = {"&amp;", 5};
+  table['"'] = {"&quot;", 6};
+  table['\''] = {"&apos;", 6};
+  table['<'] = {"&lt;", 4};
+  table['>'] = {"&gt;", 4};
+  return table;
+}();
+
+// The value of each byte as a hex digit (of either case), or -1.
+static const std::array<int8_t, 256> kHexValues = [] {
+  std::array<int8_t, 256> table;
+  table.fill(-1);
+  for (int i = 0; i < 10; i++) {
+    table['0' + i] = i;
+  }
+  for (int i = 0; i < 6; i++) {
+    table['a' + i] = table['A' + i] = 10 + i;
+  }
+  return table;
+}();
+
+// Returns the length of the run of bytes at the start of "from" (of
+// "len" bytes) that are none of the bytes in "needles", so that a clean
+// run can be copied in one go.  With SSE2 it looks at 16 bytes at a time.
+template <size_t N>
+static size_t CleanRun(const char* from, size_t len,
+                       const char (&needles)[N]);
+
 bool IsPathSafe(const string& root_dir, const string& test_file) {
   // rootdir is a directory path. testfile is a path to a file.
   // return whether or not testfile is within rootdir.
@@ -65,120 +109,215 @@ bool IsPathSafe(const string& root_dir, const string& test_file) {
 }
 
 string EscapeHtml(const string& from) {
-  string ret = from;
-  // Read through the passed in string, and replace any unsafe
-  // html tokens with the proper escape codes. The characters
-  // that need to be escaped in HTML are the same five as those
-  // that need to be escaped for XML documents. You can see an
-  // example in the comment for this function in HttpUtils.h and
-  // the rest of the characters that need to be replaced can be
-  // looked up online.
-
-  // STEP 2
-
-  boost::replace_all(ret, "&", "&amp;");
-  boost::replace_all(ret, "\"", "&quot;");
-  boost::replace_all(ret, "\'", "&apos;");
-  boost::replace_all(ret, "<", "&lt;");
-  boost::replace_all(ret, ">", "&gt;");
+  string ret;
+  AppendHtmlEscaped(&ret, from.data(), from.size());
+  return ret;
+}
+
+void AppendHtmlEscaped(string* out, const char* from, size_t len) {
+  out->reserve(out->size() + len);
+  size_t i = 0;
+  while (i < len) {
+    size_t clean = CleanRun(from + i, len - i, "&\"'<>");
+    out->append(from + i, clean);
+    i += clean;
+    if (i < len) {
+      const Escape& escape = kHtmlEscapes[static_cast<uint8_t>(from[i++])];
+      out->append(escape.str, escape.len);
+    }
+  }
+}
 
+string EscapeJson(const string& from) {
+  string ret;
+  ret.reserve(from.size());
+  AppendJsonEscaped(&ret, from.data(), from.size());
   return ret;
 }
 
-// Look for a "%XY" token in the string, where XY is a
-// hex number.  Replace the token with the appropriate ASCII
-// character, but only if 32 <= dec(XY) <= 127.
-string URIDecode(const string& from) {
-  string retstr;
+// The format of an HTTP date, as for strftime() and strptime().
+static const char* kHttpDateFormat = "%a, %d %b %Y %H:%M:%S GMT";
 
-  // Loop through the characters in the string.
-  for (unsigned int pos = 0; pos < from.length(); pos++) {
-    // note: use pos+n<from.length() instead of pos<from.length-n
-    // to avoid overflow problems with unsigned int values
-    char c1 = from[pos];
-    char c2 = (pos+1 < from.length()) ? toupper(from[pos+1]) : ' ';
-    char c3 = (pos+2 < from.length()) ? toupper(from[pos+2]) : ' ';
+string FormatHttpDate(time_t t) {
+  struct tm tm;
+  char buf[64];
+  gmtime_r(&t, &tm);
+  size_t len = strftime(buf, sizeof(buf), kHttpDateFormat, &tm);
+  return string(buf, len);
+}
 
-    // Special case the '+' for old encoders.
-    if (c1 == '+') {
-      retstr.append(1, ' ');
-      continue;
-    }
+bool ParseHttpDate(const string& date, time_t* t) {
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  // Day and month names match in any case, but "GMT" only in upper case.
+  string upper = boost::algorithm::to_upper_copy(date);
+  const char* end = strptime(upper.c_str(), kHttpDateFormat, &tm);
+  if (end == nullptr || *end != '\0') {
+    return false;
+  }
+  *t = timegm(&tm);
+  return true;
+}
 
-    // Is this an escape sequence?
-    if (c1 != '%') {
-      retstr.append(1, c1);
-      continue;
-    }
+// Parses "str", a string of at most 18 decimal digits, into "value".
+static bool ParseOffset(const string& str, uint64_t* value) {
+  if (str.empty() || str.size() > 18
+      || str.find_first_not_of("0123456789") != string::npos) {
+    return false;
+  }
+  *value = std::stoull(str);
+  return true;
+}
 
-    // Yes.  Are the next two characters hex digits?
-    if (!((('0' <= c2) && (c2 <= '9')) ||
-          (('A' <= c2) && (c2 <= 'F')))) {
-      retstr.append(1, c1);
-      continue;
+bool ParseByteRanges(const string& header, uint64_t size,
+                     vector<ByteRange>* ranges) {
+  ranges->clear();
+  if (header.compare(0, 6, "bytes=") != 0) {
+    return false;
+  }
+  vector<string> specs;
+  string spec_list = header.substr(6);
+  boost::split(specs, spec_list, boost::is_any_of(","));
+  for (string& spec : specs) {
+    boost::algorithm::trim(spec);
+    size_t dash = spec.find('-');
+    if (dash == string::npos) {
+      return false;
     }
-    if (!((('0' <= c3) && (c3 <= '9')) ||
-           (('A' <= c3) && (c3 <= 'F')))) {
-      retstr.append(1, c1);
+    string first_str = spec.substr(0, dash), last_str = spec.substr(dash + 1);
+    uint64_t first, last;
+    if (first_str.empty()) {
+      // "-N" is the last N bytes.
+      if (!ParseOffset(last_str, &last)) {
+        return false;
+      }
+      if (last > 0 && size > 0) {
+        ranges->push_back(ByteRange{size > last ? size - last : 0, size - 1});
+      }
       continue;
     }
-
-    // Yes.  Convert to a code.
-    uint8_t code = 0;
-    if (c2 >= 'A') {
-      code = 16 * (10 + (c2 - 'A'));
-    } else {
-      code = 16 * (c2 - '0');
+    if (!ParseOffset(first_str, &first)) {
+      return false;
     }
-    if (c3 >= 'A') {
-      code += 10 + (c3 - 'A');
-    } else {
-      code += (c3 - '0');
+    if (last_str.empty()) {
+      last = UINT64_MAX;
+    } else if (!ParseOffset(last_str, &last) || last < first) {
+      return false;
+    }
+    if (first < size) {
+      ranges->push_back(ByteRange{first, std::min(last, size - 1)});
+    }
+  }
+  return true;
+}
+
+string URIDecode(const string& from) {
+  string ret;
+  AppendURIDecoded(&ret, from.data(), from.size());
+  return ret;
+}
+
+void AppendURIDecoded(string* out, const char* from, size_t len) {
+  out->reserve(out->size() + len);
+  size_t i = 0;
+  while (i < len) {
+    size_t clean = CleanRun(from + i, len - i, "%+");
+    out->append(from + i, clean);
+    i += clean;
+    if (i == len) {
+      break;
     }
 
-    // Is the code reasonable?
-    if (!((code >= 32) && (code <= 127))) {
-      retstr.append(1, c1);
+    // Special case the '+' for old encoders.
+    if (from[i] == '+') {
+      out->push_back(' ');
+      i++;
       continue;
     }
 
-    // Great!  Convert and append.
-    retstr.append(1, static_cast<char>(code));
-    pos += 2;
+    // A '%' is decoded if two hex digits follow it, and they make a
+    // printable character; otherwise it stays as it is.
+    int code = -1;
+    if (i + 2 < len) {
+      int high = kHexValues[static_cast<uint8_t>(from[i + 1])];
+      int low = kHexValues[static_cast<uint8_t>(from[i + 2])];
+      if (high >= 0 && low >= 0) {
+        code = high * 16 + low;
+      }
+    }
+    if (code >= 32 && code <= 127) {
+      out->push_back(static_cast<char>(code));
+      i += 3;
+    } else {
+      out->push_back('%');
+      i++;
+    }
   }
-  return retstr;
 }
 
-void URLParser::Parse(const string& url) {
-  url_ = url;
+// Returns true if "str" has anything for URIDecode() to do.
+static bool NeedsURIDecoding(std::string_view str) {
+  return str.find_first_of("%+") != std::string_view::npos;
+}
 
-  // Split the URL into the path and the args components.
-  vector<string> ps;
-  boost::split(ps, url, boost::is_any_of("?"));
-  if (ps.size() < 1)
+void URLParser::Parse(std::string_view url) {
+  args_.clear();
+
+  // The path runs up to the first '?', and the args from there up to
+  // the next.
+  size_t question = url.find('?');
+  raw_path_ = url.substr(0, question);
+  path_decoded_ = NeedsURIDecoding(raw_path_);
+  if (path_decoded_) {
+    path_.clear();
+    AppendURIDecoded(&path_, raw_path_.data(), raw_path_.size());
+  }
+  if (question == std::string_view::npos) {
     return;
+  }
+  std::string_view query = url.substr(question + 1);
+  query = query.substr(0, query.find('?'));
+
+  // Split the args into each field=val chunk, skipping chunks without
+  // exactly one '='.
+  while (true) {
+    size_t amp = query.find('&');
+    std::string_view chunk = query.substr(0, amp);
+    size_t equals = chunk.find('=');
+    if (equals != std::string_view::npos
+        && chunk.find('=', equals + 1) == std::string_view::npos) {
+      args_.push_back(Arg{chunk.substr(0, equals), chunk.substr(equals + 1)});
+    }
+    if (amp == std::string_view::npos) {
+      break;
+    }
+    query.remove_prefix(amp + 1);
+  }
+}
 
-  // Store the URI-decoded path.
-  path_ = URIDecode(ps[0]);
-
-  if (ps.size() < 2)
-    return;
+string URLParser::arg(std::string_view field) const {
+  string value;
+  const Arg* found = FindArg(field);
+  if (found != nullptr) {
+    AppendURIDecoded(&value, found->value.data(), found->value.size());
+  }
+  return value;
+}
 
-  // Split the args into each field=val; chunk.
-  vector<string> vals;
-  boost::split(vals, ps[1], boost::is_any_of("&"));
-
-  // Iterate through the chunks.
-  for (unsigned int i = 0; i < vals.size(); i++) {
-    // Split the chunk into field, value.
-    string val = vals[i];
-    vector<string> fv;
-    boost::split(fv, val, boost::is_any_of("="));
-    if (fv.size() == 2) {
-      // Add the field, value to the args_ map.
-      args_[URIDecode(fv[0])] = URIDecode(fv[1]);
+const URLParser::Arg* URLParser::FindArg(std::string_view field) const {
+  for (auto it = args_.rbegin(); it != args_.rend(); ++it) {
+    if (it->field == field) {
+      return &*it;
+    }
+    if (NeedsURIDecoding(it->field)) {
+      string decoded;
+      AppendURIDecoded(&decoded, it->field.data(), it->field.size());
+      if (decoded == field) {
+        return &*it;
+      }
     }
   }
+  return nullptr;
 }
 
 uint16_t GetRandPort() {
@@ -266,4 +405,32 @@ bool ConnectToServer(const string& host_name, uint16_t port_num,
   return false;
 }
 
+template <size_t N>
+static size_t CleanRun(const char* from, size_t len,
+                       const char (&needles)[N]) {
+  // "needles" is a string literal, so its last char is the '\0'.
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= len; i += 16) {
+    __m128i block =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+    __m128i found = _mm_setzero_si128();
+    for (size_t n = 0; n + 1 < N; n++) {
+      found = _mm_or_si128(found,
+                           _mm_cmpeq_epi8(block, _mm_set1_epi8(needles[n])));
+    }
+    int mask = _mm_movemask_epi8(found);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif  // __SSE2__
+  for (; i < len; i++) {
+    if (memchr(needles, from[i], N - 1) != nullptr) {
+      return i;
+    }
+  }
+  return len;
+}
+
 }  // namespace hw4
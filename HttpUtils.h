@@ -5,10 +5,13 @@
 #define HW4_HTTPUTILS_H_
 
 #include <stdint.h>
+#include <time.h>
 
 #include <string>
+#include <string_view>
 #include <utility>
 #include <map>
+#include <vector>
 
 namespace hw4 {
 
@@ -39,6 +42,16 @@ bool IsPathSafe(const std::string& root_dir, const std::string& test_file);
 // XSS attacks.
 std::string EscapeHtml(const std::string& from);
 
+// Appends "len" bytes of "from" to "out", HTML-escaped as by EscapeHtml(),
+// so that a page can be built without a temporary string per field.
+void AppendHtmlEscaped(std::string* out, const char* from, size_t len);
+
+// This function escapes a string for use inside a double-quoted JSON
+// string: quotes, backslashes and control characters are replaced with
+// their JSON escape sequences (such as "\"" and "\n").  Other bytes,
+// including UTF-8 sequences, pass through unchanged.
+std::string EscapeJson(const std::string& from);
+
 // This function performs URI decoding.  It scans a string for
 // the "%" escape character and converts the token to the
 // appropriate ASCII character.  See the wikipedia article on
@@ -48,6 +61,32 @@ std::string EscapeHtml(const std::string& from);
 //
 std::string URIDecode(const std::string& from);
 
+// Appends "len" bytes of "from" to "out", URI-decoded as by URIDecode().
+void AppendURIDecoded(std::string* out, const char* from, size_t len);
+
+// These functions convert between times and the date format of HTTP
+// headers such as Last-Modified, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+// ParseHttpDate() accepts any letter case, and returns false if "date"
+// isn't in that format.
+std::string FormatHttpDate(time_t t);
+bool ParseHttpDate(const std::string& date, time_t* t);
+
+// A range of bytes, from "first" through "last" inclusive.
+struct ByteRange {
+  uint64_t first;
+  uint64_t last;
+};
+
+// This function parses the value of a Range header, such as
+// "bytes=0-99,200-,-50", against a file of "size" bytes.  The ranges
+// that overlap the file are returned through "ranges", clipped to it.
+//
+// Returns false if the header is malformed (or not in bytes), in which
+// case it should be ignored.  If it returns true with no ranges, none of
+// them overlapped the file.
+bool ParseByteRanges(const std::string& header, uint64_t size,
+                     std::vector<ByteRange>* ranges);
+
 // A URL that's part of a web request has the following structure:
 //
 //   /foo/bar/baz?field=value&field2=value2
@@ -57,24 +96,52 @@ std::string URIDecode(const std::string& from);
 // This class accepts a URL and splits it into these components and
 // URIDecode()'s them, allowing the caller to access the components
 // through convenient methods.
+//
+// Parsing doesn't copy the URL: the parser keeps views into it, so the
+// URL must outlive the parser (or its next Parse()).  The path is decoded
+// up front only if it needs decoding at all, and an arg's field and value
+// only when that arg is looked up, so a parser can be reused without
+// allocating.
 class URLParser {
  public:
   URLParser() { }
   virtual ~URLParser() { }
 
-  void Parse(const std::string& url);
+  void Parse(std::string_view url);
+
+  // Return the "path" component of the url, post-uri-decoding.  The view
+  // is good until the next Parse().
+  std::string_view path() const {
+    return path_decoded_ ? std::string_view(path_) : raw_path_;
+  }
 
-  // Return the "path" component of the url, post-uri-decoding.
-  std::string path() const { return path_; }
+  // Return the number of "field=value" args, counting repeated fields.
+  size_t num_args() const { return args_.size(); }
 
-  // Return the "args" component of the url post-uri-decoding.
-  // The args component is parsed into a map from field to value.
-  std::map<std::string, std::string> args() const { return args_; }
+  // Return true if the url has an arg named "field" (post-uri-decoding).
+  bool has_arg(std::string_view field) const {
+    return FindArg(field) != nullptr;
+  }
+
+  // Return the value of the arg named "field", post-uri-decoding, or
+  // empty string if there's none.  If a field is repeated, the last one
+  // counts.
+  std::string arg(std::string_view field) const;
 
  private:
-  std::string url_;
+  // An arg, as it appears in the url.
+  struct Arg {
+    std::string_view field;
+    std::string_view value;
+  };
+
+  // Returns the last arg named "field", or nullptr.
+  const Arg* FindArg(std::string_view field) const;
+
+  std::string_view raw_path_;
   std::string path_;
-  std::map<std::string, std::string> args_;
+  bool path_decoded_ = false;
+  std::vector<Arg> args_;
 };
 
 // Return a randomly generated port number between 10000 and 40000.
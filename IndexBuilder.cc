@@ -0,0 +1,630 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+  #include "libhw2/FileParser.h"
+}
+
+#include "./IndexBuilder.h"
+#include "./IndexWriter.h"
+#include "./TermDictionary.h"
+
+using std::string;
+using std::to_string;
+using std::unique_ptr;
+using std::vector;
+
+namespace hw4 {
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants, internal helper functions
+///////////////////////////////////////////////////////////////////////////////
+
+// static
+const size_t IndexBuilder::kDefaultMemoryBudget = 64 << 20;
+
+// static
+const size_t IndexBuilder::kMaxMergeFanIn = 64;
+
+// The stdio buffer given to each run (and the spool) while merging.
+static const size_t kRunBufferBytes = 1 << 16;
+
+// The estimated bookkeeping cost of a buffered word: the hash map node,
+// the std::string, and the (initially empty) vector of postings.
+static const size_t kWordOverheadBytes = 96;
+
+// A run record is one word and all of its buffered postings:
+//
+//   uint16_t word_bytes, word_bytes bytes of word, uint32_t num_docs,
+//   then num_docs times:
+//     uint64_t doc_id, uint32_t num_positions, num_positions uint32_t's.
+//
+// Runs are private to the builder, so they are kept in host byte order.
+static bool WriteRecord(FILE* f, const string& word,
+                        const vector<DocPostings>& docs);
+
+// Reads the next run record from "f".  Returns false at EOF or on error;
+// callers tell the two apart with ferror().
+static bool ReadRecord(FILE* f, string* word, vector<DocPostings>* docs);
+
+// Reads the whole of the file "file_name" into "contents".
+static bool ReadWholeFile(const string& file_name, string* contents);
+
+// Returns the size of the index element that holds "docs" for a word of
+// "word_bytes" bytes.
+static int64_t ElementBytes(size_t word_bytes,
+                            const vector<DocPostings>& docs);
+
+// Returns a docID table element per document in "docs".
+static vector<HashTableElement> DocElements(const vector<DocPostings>& docs);
+
+// An ElementEmitFn for docID table elements; "element.data" points at a
+// DocPostings.
+static bool EmitDocPostings(IndexFileWriter* writer,
+                            const HashTableElement& element);
+
+// A RunReader streams the records of one run file, in word order.
+class RunReader {
+ public:
+  explicit RunReader(FILE* f) : file_(f), error_(false) { }
+  ~RunReader() { fclose(file_); }
+
+  // Advances to the next record.  Returns false when the run is exhausted
+  // or unreadable; error() says which.
+  bool Next() {
+    docs.clear();
+    if (ReadRecord(file_, &word, &docs)) {
+      return true;
+    }
+    error_ = ferror(file_) != 0;
+    return false;
+  }
+
+  bool error() const { return error_; }
+
+  string              word;
+  vector<DocPostings> docs;
+
+ private:
+  FILE* file_;
+  bool error_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexBuilder
+///////////////////////////////////////////////////////////////////////////////
+IndexBuilder::IndexBuilder(const string& file_name, size_t memory_budget)
+  : file_name_(file_name), memory_budget_(memory_budget), buffer_bytes_(0),
+    num_parts_(0), spill_failed_(false) { }
+
+IndexBuilder::~IndexBuilder() {
+  RemoveRuns();
+  RemoveParts();
+}
+
+bool IndexBuilder::AddDirectory(const string& root_dir) {
+  struct dirent** entries;
+  int num_entries = scandir(root_dir.c_str(), &entries, nullptr, alphasort);
+  if (num_entries < 0) {
+    return false;
+  }
+
+  // Visit the entries in sorted order, recursing into subdirectories as
+  // we meet them, which is the order CrawlFileTree() hands out docIDs in.
+  bool ok = true;
+  for (int i = 0; i < num_entries; i++) {
+    const char* name = entries[i]->d_name;
+    if (ok && strcmp(name, ".") != 0 && strcmp(name, "..") != 0) {
+      string path = root_dir + "/" + name;
+      struct stat sb;
+      if (stat(path.c_str(), &sb) == 0) {
+        if (S_ISDIR(sb.st_mode)) {
+          ok = AddDirectory(path);
+        } else if (S_ISREG(sb.st_mode)) {
+          // A file with nothing to index is skipped, not an error, but a
+          // failed spill is.
+          AddFile(path);
+          ok = !spill_failed_;
+        }
+      }
+    }
+    free(entries[i]);
+  }
+  free(entries);
+  return ok;
+}
+
+DocID_t IndexBuilder::AddFile(const string& file_name) {
+  int size = 0;
+  char* contents = ReadFileToString(file_name.c_str(), &size);
+  if (contents == nullptr) {
+    return INVALID_DOCID;
+  }
+
+  // ParseIntoWordPositionsTable takes ownership of the contents.
+  HashTable* table = ParseIntoWordPositionsTable(contents);
+  if (table == nullptr) {
+    return INVALID_DOCID;
+  }
+
+  DocID_t doc_id = AddDocument(file_name);
+  bool ok = true;
+  vector<DocPositionOffset_t> positions;
+  HTIterator* it = HTIterator_Allocate(table);
+  Verify333(it != nullptr);
+  for (; ok && HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    WordPositions* wp = static_cast<WordPositions*>(kv.value);
+
+    positions.clear();
+    LLIterator* pos_it = LLIterator_Allocate(wp->positions);
+    Verify333(pos_it != nullptr);
+    for (; LLIterator_IsValid(pos_it); LLIterator_Next(pos_it)) {
+      LLPayload_t payload;
+      LLIterator_Get(pos_it, &payload);
+      positions.push_back(static_cast<DocPositionOffset_t>(
+          reinterpret_cast<intptr_t>(payload)));
+    }
+    LLIterator_Free(pos_it);
+    ok = AddPostings(wp->word, doc_id, positions);
+  }
+  HTIterator_Free(it);
+  FreeWordPositionsTable(table);
+  return ok ? doc_id : INVALID_DOCID;
+}
+
+DocID_t IndexBuilder::AddDocument(const string& doc_name) {
+  doc_names_.push_back(doc_name);
+  return doc_names_.size();
+}
+
+bool IndexBuilder::AddPostings(const string& word, DocID_t doc_id,
+                               const vector<DocPositionOffset_t>& positions) {
+  auto it = buffer_.find(word);
+  if (it == buffer_.end()) {
+    it = buffer_.emplace(word, vector<DocPostings>()).first;
+    buffer_bytes_ += kWordOverheadBytes + word.size();
+  }
+  it->second.push_back({doc_id, positions});
+  buffer_bytes_ += sizeof(DocPostings)
+    + positions.size() * sizeof(DocPositionOffset_t);
+
+  if (buffer_bytes_ >= memory_budget_) {
+    return SpillRun();
+  }
+  return true;
+}
+
+int IndexBuilder::Finish() {
+  if (spill_failed_ || (!buffer_.empty() && !SpillRun())) {
+    return -1;
+  }
+
+  string spool_name = file_name_ + "." + to_string(getpid()) + ".spool";
+  bool merged = MergeRuns(spool_name);
+  RemoveRuns();
+  merged = merged && PartitionSpool(spool_name);
+  unlink(spool_name.c_str());
+  if (!merged) {
+    RemoveParts();
+    return -1;
+  }
+
+  // Size both tables.  Every word's element size was recorded as it was
+  // merged, so only the directory is needed here, not the postings.
+  vector<HashTableElement> doc_elements;
+  for (size_t i = 0; i < doc_names_.size(); i++) {
+    doc_elements.push_back({i + 1,
+          static_cast<int32_t>(sizeof(hw3::DoctableElementHeader)
+                               + doc_names_[i].size()),
+          doc_names_[i].c_str()});
+  }
+  vector<HashTableElement> word_elements;
+  for (const WordEntry& entry : words_) {
+    word_elements.push_back({entry.key, entry.element_bytes, &entry});
+  }
+  int64_t doctable_bytes = HashTableBytes(doc_elements);
+  int64_t index_bytes = HashTableBytes(word_elements);
+
+  // Stream the file out, reading each word's postings back from its
+  // partition as its element comes up.  The elements come in partition
+  // order, so each partition is read in whole, once, when it's first
+  // needed.
+  TermDictionaryWriter dictionary(file_name_);
+  int loaded_part = -1;
+  string part_bytes;
+  auto emit_word = [this, &loaded_part, &part_bytes, &dictionary](
+                       IndexFileWriter* writer,
+                       const HashTableElement& element) {
+    const WordEntry* entry = static_cast<const WordEntry*>(element.data);
+    if (entry->part != loaded_part) {
+      if (!ReadWholeFile(part_names_[entry->part], &part_bytes)) {
+        return false;
+      }
+      loaded_part = entry->part;
+    }
+    FILE* part = fmemopen(&part_bytes[0], part_bytes.size(), "rb");
+    if (part == nullptr) {
+      return false;
+    }
+    string word;
+    vector<DocPostings> docs;
+    bool read = fseeko(part, entry->part_offset, SEEK_SET) == 0
+      && ReadRecord(part, &word, &docs);
+    fclose(part);
+    if (!read) {
+      return false;
+    }
+    vector<HashTableElement> elements = DocElements(docs);
+    hw3::WordPostingsHeader header(word.size(), HashTableBytes(elements));
+    header.ToDiskFormat();
+    if (!writer->Write(&header, sizeof(header))
+        || !writer->Write(word.data(), word.size())) {
+      return false;
+    }
+    dictionary.Add(word, writer->offset(), docs.size());
+    return WriteHashTable(writer, &elements, &EmitDocPostings);
+  };
+
+  int result = -1;
+  if (sizeof(hw3::IndexFileHeader) + doctable_bytes + index_bytes
+      <= INT32_MAX) {
+    IndexFileWriter writer(file_name_);
+    if (writer.Open()
+        && WriteHashTable(&writer, &doc_elements, &EmitDoctableElement)
+        && WriteHashTable(&writer, &word_elements, emit_word)) {
+      result = writer.Commit(doctable_bytes, index_bytes);
+    }
+    // Without its dictionary the index would still answer queries, but
+    // more slowly and with no prefix matches, so it isn't a success.
+    if (result >= 0 && !dictionary.Commit(writer.checksum())) {
+      unlink(file_name_.c_str());
+      result = -1;
+    }
+  }
+  RemoveParts();
+  words_.clear();
+  return result;
+}
+
+bool IndexBuilder::SpillRun() {
+  string run_name = file_name_ + "." + to_string(getpid()) + ".run"
+    + to_string(run_names_.size());
+  FILE* f = fopen(run_name.c_str(), "wb");
+  if (f == nullptr) {
+    spill_failed_ = true;
+    return false;
+  }
+  run_names_.push_back(run_name);
+
+  vector<const string*> words;
+  words.reserve(buffer_.size());
+  for (const auto& kv : buffer_) {
+    words.push_back(&kv.first);
+  }
+  std::sort(words.begin(), words.end(),
+            [](const string* a, const string* b) { return *a < *b; });
+
+  bool ok = true;
+  for (size_t i = 0; ok && i < words.size(); i++) {
+    ok = WriteRecord(f, *words[i], buffer_[*words[i]]);
+  }
+  ok = (fclose(f) == 0) && ok;
+
+  // Swap rather than clear(), so the map's bucket array is released too.
+  std::unordered_map<string, vector<DocPostings>>().swap(buffer_);
+  buffer_bytes_ = 0;
+  spill_failed_ = !ok;
+  return ok;
+}
+
+bool IndexBuilder::MergeRuns(const string& spool_name) {
+  // Each pass merges the runs kMaxMergeFanIn at a time into longer runs,
+  // removing each group as soon as it's merged, until they're few enough
+  // to merge into the spool at once.
+  for (int pass = 0; run_names_.size() > kMaxMergeFanIn; pass++) {
+    vector<string> merged_names;
+    bool ok = true;
+    for (size_t first = 0; first < run_names_.size();
+         first += kMaxMergeFanIn) {
+      vector<string> group(run_names_.begin() + first,
+                           run_names_.begin()
+                           + std::min(first + kMaxMergeFanIn,
+                                      run_names_.size()));
+      merged_names.push_back(file_name_ + "." + to_string(getpid()) + ".run"
+                             + to_string(pass) + "."
+                             + to_string(merged_names.size()));
+      ok = ok && MergeRunGroup(group, merged_names.back(), false);
+      for (const string& run_name : group) {
+        unlink(run_name.c_str());
+      }
+    }
+    run_names_.swap(merged_names);
+    if (!ok) {
+      return false;
+    }
+  }
+  return MergeRunGroup(run_names_, spool_name, true);
+}
+
+bool IndexBuilder::MergeRunGroup(const vector<string>& run_names,
+                                 const string& out_name, bool spool) {
+  vector<unique_ptr<RunReader>> readers;
+  auto later = [](const RunReader* a, const RunReader* b) {
+    return a->word > b->word;
+  };
+  std::priority_queue<RunReader*, vector<RunReader*>, decltype(later)>
+    heap(later);
+  for (const string& run_name : run_names) {
+    FILE* f = fopen(run_name.c_str(), "rb");
+    if (f == nullptr) {
+      return false;
+    }
+    setvbuf(f, nullptr, _IOFBF, kRunBufferBytes);
+    readers.emplace_back(new RunReader(f));
+    if (readers.back()->Next()) {
+      heap.push(readers.back().get());
+    } else if (readers.back()->error()) {
+      return false;
+    }
+  }
+
+  FILE* out = fopen(out_name.c_str(), "wb");
+  if (out == nullptr) {
+    return false;
+  }
+  setvbuf(out, nullptr, _IOFBF, kRunBufferBytes);
+
+  // Pop every run positioned at the smallest word, concatenate their
+  // postings (each document was added to exactly one run), and advance.
+  bool ok = true;
+  if (spool) {
+    words_.clear();
+  }
+  while (ok && !heap.empty()) {
+    string word = heap.top()->word;
+    vector<DocPostings> docs;
+    while (ok && !heap.empty() && heap.top()->word == word) {
+      RunReader* reader = heap.top();
+      heap.pop();
+      std::move(reader->docs.begin(), reader->docs.end(),
+                std::back_inserter(docs));
+      if (reader->Next()) {
+        heap.push(reader);
+      } else {
+        ok = !reader->error();
+      }
+    }
+
+    if (!spool) {
+      ok = ok && WriteRecord(out, word, docs);
+      continue;
+    }
+    int64_t element_bytes = ElementBytes(word.size(), docs);
+    WordEntry entry = { FNVHash64(reinterpret_cast<unsigned char*>(
+                                      const_cast<char*>(word.data())),
+                                  word.size()),
+                        ftello(out),
+                        static_cast<int32_t>(element_bytes) };
+    ok = ok && element_bytes <= INT32_MAX && WriteRecord(out, word, docs);
+    words_.push_back(entry);
+  }
+  return (fclose(out) == 0) && ok;
+}
+
+bool IndexBuilder::PartitionSpool(const string& spool_name) {
+  FILE* spool = fopen(spool_name.c_str(), "rb");
+  if (spool == nullptr || fseeko(spool, 0, SEEK_END) != 0) {
+    if (spool != nullptr) {
+      fclose(spool);
+    }
+    return false;
+  }
+  int64_t spool_bytes = ftello(spool);
+  rewind(spool);
+  setvbuf(spool, nullptr, _IOFBF, kRunBufferBytes);
+
+  // The order WriteHashTable() will ask for the words in: by bucket, and
+  // in word order within a bucket.
+  int32_t num_buckets = NumBucketsFor(words_.size());
+  vector<size_t> order(words_.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [this, num_buckets](size_t a, size_t b) {
+                     return words_[a].key % num_buckets
+                       < words_[b].key % num_buckets;
+                   });
+
+  // Cut that order into partitions of at most memory_budget_ bytes of
+  // records (or a single record, if it's bigger).
+  auto record_bytes = [this, spool_bytes](size_t i) {
+    return (i + 1 < words_.size() ? words_[i + 1].spool_offset : spool_bytes)
+      - words_[i].spool_offset;
+  };
+  num_parts_ = 0;
+  int64_t part_bytes = 0;
+  for (size_t i : order) {
+    int64_t bytes = record_bytes(i);
+    if (num_parts_ == 0
+        || part_bytes + bytes > static_cast<int64_t>(memory_budget_)) {
+      num_parts_++;
+      part_bytes = 0;
+    }
+    words_[i].part = num_parts_ - 1;
+    part_bytes += bytes;
+  }
+
+  vector<FILE*> parts;
+  bool ok = true;
+  for (size_t p = 0; ok && p < num_parts_; p++) {
+    part_names_.push_back(file_name_ + "." + to_string(getpid()) + ".part"
+                          + to_string(p));
+    FILE* f = fopen(part_names_.back().c_str(), "wb");
+    ok = f != nullptr;
+    if (ok) {
+      setvbuf(f, nullptr, _IOFBF, kRunBufferBytes);
+      parts.push_back(f);
+    }
+  }
+
+  // Copy each record, as is, from the spool to its partition.
+  vector<char> record;
+  for (size_t i = 0; ok && i < words_.size(); i++) {
+    FILE* part = parts[words_[i].part];
+    record.resize(record_bytes(i));
+    words_[i].part_offset = ftello(part);
+    ok = fread(record.data(), 1, record.size(), spool) == record.size()
+      && fwrite(record.data(), 1, record.size(), part) == record.size();
+  }
+  for (FILE* f : parts) {
+    ok = (fclose(f) == 0) && ok;
+  }
+  fclose(spool);
+  return ok;
+}
+
+void IndexBuilder::RemoveParts() {
+  for (const string& part_name : part_names_) {
+    unlink(part_name.c_str());
+  }
+  part_names_.clear();
+}
+
+void IndexBuilder::RemoveRuns() {
+  for (const string& run_name : run_names_) {
+    unlink(run_name.c_str());
+  }
+  run_names_.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Run records
+///////////////////////////////////////////////////////////////////////////////
+static bool WriteRecord(FILE* f, const string& word,
+                        const vector<DocPostings>& docs) {
+  uint16_t word_bytes = word.size();
+  uint32_t num_docs = docs.size();
+  if (fwrite(&word_bytes, sizeof(word_bytes), 1, f) != 1
+      || fwrite(word.data(), 1, word_bytes, f) != word_bytes
+      || fwrite(&num_docs, sizeof(num_docs), 1, f) != 1) {
+    return false;
+  }
+  for (const DocPostings& doc : docs) {
+    uint64_t doc_id = doc.doc_id;
+    uint32_t num_positions = doc.positions.size();
+    if (fwrite(&doc_id, sizeof(doc_id), 1, f) != 1
+        || fwrite(&num_positions, sizeof(num_positions), 1, f) != 1
+        || fwrite(doc.positions.data(), sizeof(DocPositionOffset_t),
+                  num_positions, f) != num_positions) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool ReadRecord(FILE* f, string* word, vector<DocPostings>* docs) {
+  uint16_t word_bytes;
+  uint32_t num_docs;
+  if (fread(&word_bytes, sizeof(word_bytes), 1, f) != 1) {
+    return false;
+  }
+  word->resize(word_bytes);
+  if (fread(&(*word)[0], 1, word_bytes, f) != word_bytes
+      || fread(&num_docs, sizeof(num_docs), 1, f) != 1) {
+    return false;
+  }
+  docs->resize(num_docs);
+  for (DocPostings& doc : *docs) {
+    uint64_t doc_id;
+    uint32_t num_positions;
+    if (fread(&doc_id, sizeof(doc_id), 1, f) != 1
+        || fread(&num_positions, sizeof(num_positions), 1, f) != 1) {
+      return false;
+    }
+    doc.doc_id = doc_id;
+    doc.positions.resize(num_positions);
+    if (fread(doc.positions.data(), sizeof(DocPositionOffset_t),
+              num_positions, f) != num_positions) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool ReadWholeFile(const string& file_name, string* contents) {
+  FILE* f = fopen(file_name.c_str(), "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  bool ok = fseeko(f, 0, SEEK_END) == 0;
+  off_t size = ftello(f);
+  ok = ok && size >= 0;
+  if (ok) {
+    rewind(f);
+    contents->resize(size);
+    ok = fread(&(*contents)[0], 1, size, f) == static_cast<size_t>(size);
+  }
+  fclose(f);
+  return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Index elements
+///////////////////////////////////////////////////////////////////////////////
+static int64_t ElementBytes(size_t word_bytes,
+                            const vector<DocPostings>& docs) {
+  return sizeof(hw3::WordPostingsHeader) + word_bytes
+    + HashTableBytes(DocElements(docs));
+}
+
+static vector<HashTableElement> DocElements(const vector<DocPostings>& docs) {
+  vector<HashTableElement> elements;
+  elements.reserve(docs.size());
+  for (const DocPostings& doc : docs) {
+    elements.push_back({doc.doc_id,
+          static_cast<int32_t>(sizeof(hw3::DocIDElementHeader)
+                               + doc.positions.size()
+                                 * sizeof(hw3::DocIDElementPosition)),
+          &doc});
+  }
+  return elements;
+}
+
+static bool EmitDocPostings(IndexFileWriter* writer,
+                            const HashTableElement& element) {
+  const DocPostings* doc = static_cast<const DocPostings*>(element.data);
+  hw3::DocIDElementHeader header(doc->doc_id, doc->positions.size());
+  header.ToDiskFormat();
+  if (!writer->Write(&header, sizeof(header))) {
+    return false;
+  }
+  for (DocPositionOffset_t offset : doc->positions) {
+    hw3::DocIDElementPosition position(offset);
+    position.ToDiskFormat();
+    if (!writer->Write(&position, sizeof(position))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace hw4
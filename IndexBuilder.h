@@ -0,0 +1,162 @@
+#ifndef HW4_INDEXBUILDER_H_
+#define HW4_INDEXBUILDER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+  #include "libhw2/DocTable.h"
+  #include "libhw2/MemIndex.h"
+}
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// The positions of one word within one document.
+struct DocPostings {
+  DocID_t                          doc_id;
+  std::vector<DocPositionOffset_t> positions;
+};
+
+// An IndexBuilder builds an index file for a corpus that need not fit in
+// memory.  It is the external-memory counterpart of CrawlFileTree() plus
+// WriteIndex(): postings accumulate in memory until "memory_budget" bytes
+// are in use, at which point they are sorted by word and spilled to a run
+// file next to the output.  Finish() k-way merges the runs, at most
+// kMaxMergeFanIn at a time (in several passes, if there are more), deals the
+// merged postings out into budget-sized partitions in the order the index
+// lays words out, and writes the final index through an IndexFileWriter,
+// a partition at a time; every pass over the disk is sequential.
+//
+// Peak memory is the budget plus a small per-document (the document names)
+// and per-word (about 40 bytes of directory) overhead, and the postings of
+// the single largest word, which must be in memory to lay out its
+// embedded docID table.  Merging adds a buffer and a record per run being
+// merged, so no more than kMaxMergeFanIn of each however big the corpus.
+class IndexBuilder {
+ public:
+  // The default memory budget for buffered postings, in bytes.
+  static const size_t kDefaultMemoryBudget;
+
+  // The most runs merged, and so open, at once.
+  static const size_t kMaxMergeFanIn;
+
+  // Arguments:
+  // - file_name: the index file that Finish() will create or replace.
+  // - memory_budget: how many bytes of postings to buffer before
+  //   spilling a run to disk.
+  explicit IndexBuilder(const std::string& file_name,
+                        size_t memory_budget = kDefaultMemoryBudget);
+
+  // Removes any run files that are still on disk.
+  virtual ~IndexBuilder();
+
+  // Crawls the file system subtree rooted at "root_dir", adding every file
+  // that CrawlFileTree() would index, in the same order.
+  //
+  // Returns false if "root_dir" is not a readable directory or if
+  // spilling a run failed.
+  bool AddDirectory(const std::string& root_dir);
+
+  // Reads, parses and adds a single file.
+  //
+  // Returns the docID chosen for it, or INVALID_DOCID if the file could
+  // not be read or contains nothing to index (or if spilling failed).
+  DocID_t AddFile(const std::string& file_name);
+
+  // Registers a document and returns the docID chosen for it.  DocIDs are
+  // handed out sequentially starting at 1.
+  DocID_t AddDocument(const std::string& doc_name);
+
+  // Adds the (ascending) positions of "word" within document "doc_id",
+  // which must have come from AddDocument().  A (word, doc_id) pair may
+  // only be added once.
+  //
+  // Returns false if a run had to be spilled and that failed.
+  bool AddPostings(const std::string& word, DocID_t doc_id,
+                   const std::vector<DocPositionOffset_t>& positions);
+
+  // Spills what's left, merges every run, and writes the index file and
+  // its term dictionary (see TermDictionaryWriter).
+  //
+  // Returns the size of the index file in bytes, or -1 on error.  If the
+  // dictionary can't be written, the index file is removed too.
+  int Finish();
+
+  // Returns the number of documents added so far.
+  size_t num_docs() const { return doc_names_.size(); }
+
+  // Returns the number of runs spilled to disk so far.
+  size_t num_runs() const { return run_names_.size(); }
+
+  // Returns how many partitions the last Finish() dealt the merged
+  // postings into (see PartitionSpool()).
+  size_t num_parts() const { return num_parts_; }
+
+ private:
+  // Sorts the buffered postings by word and writes them to a new run.
+  bool SpillRun();
+
+  // Merges every run into a single spool file, and records a directory
+  // entry per word.  While there are more than kMaxMergeFanIn runs, merges
+  // them that many at a time into longer runs first.
+  bool MergeRuns(const std::string& spool_name);
+
+  // Merges the runs "run_names" into the run "out_name", or into the
+  // spool "out_name" if "spool" is true, recording a directory entry per
+  // word as MergeRuns() does.
+  bool MergeRunGroup(const std::vector<std::string>& run_names,
+                     const std::string& out_name, bool spool);
+
+  // Removes every run file.
+  void RemoveRuns();
+
+  // WriteHashTable() asks for the words in bucket order, but the spool is
+  // in word order.  Rather than seek around the spool for each word, this
+  // reads it once, front to back, and deals its records out to partition
+  // files: each partition is a stretch of the bucket order, no bigger than
+  // the memory budget, so the index can be written by reading in one
+  // partition at a time.  Records each word's partition and offset in it.
+  bool PartitionSpool(const std::string& spool_name);
+
+  // Removes every partition file.
+  void RemoveParts();
+
+  std::string file_name_;
+  size_t memory_budget_;
+
+  // Indexed by docID - 1.
+  std::vector<std::string> doc_names_;
+
+  // The postings buffered since the last spill, and their estimated size.
+  std::unordered_map<std::string, std::vector<DocPostings>> buffer_;
+  size_t buffer_bytes_;
+
+  std::vector<std::string> run_names_;
+  std::vector<std::string> part_names_;
+  size_t num_parts_;
+
+  // Set once a run could not be spilled; the build can't succeed after.
+  bool spill_failed_;
+
+  // One entry per unique word, produced by MergeRuns().
+  struct WordEntry {
+    HTKey_t key;            // FNVHash64() of the word.
+    int64_t spool_offset;   // where its merged record starts in the spool.
+    int32_t element_bytes;  // the size of its element in the index.
+    int32_t part;           // the partition its record was dealt to,
+    int64_t part_offset;    // and where the record starts in it.
+  };
+  std::vector<WordEntry> words_;
+
+  DISALLOW_COPY_AND_ASSIGN(IndexBuilder);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_INDEXBUILDER_H_
@@ -0,0 +1,107 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "./IndexBuilder.h"
+#include "./IndexMerger.h"
+#include "./IndexScanner.h"
+
+using std::list;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace hw4 {
+
+static const int64_t kNanosPerSec = 1000000000;
+
+///////////////////////////////////////////////////////////////////////////////
+// IoThrottle
+///////////////////////////////////////////////////////////////////////////////
+IoThrottle::IoThrottle(int64_t bytes_per_sec)
+  : bytes_per_sec_(bytes_per_sec), consumed_(0) {
+  clock_gettime(CLOCK_MONOTONIC, &start_);
+}
+
+void IoThrottle::Consume(int64_t bytes) {
+  if (bytes_per_sec_ <= 0) {
+    return;
+  }
+  consumed_ += bytes;
+
+  // Sleep until the time at which "consumed_" bytes are within budget.
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t elapsed = (now.tv_sec - start_.tv_sec) * kNanosPerSec
+    + (now.tv_nsec - start_.tv_nsec);
+  int64_t due = static_cast<int64_t>(
+      static_cast<double>(consumed_) / bytes_per_sec_ * kNanosPerSec);
+  if (due > elapsed) {
+    struct timespec pause = { static_cast<time_t>((due - elapsed)
+                                                  / kNanosPerSec),
+                              static_cast<long>((due - elapsed)  // NOLINT
+                                                % kNanosPerSec) };
+    while (nanosleep(&pause, &pause) == -1 && errno == EINTR) { }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MergeIndices
+///////////////////////////////////////////////////////////////////////////////
+int MergeIndices(const list<string>& inputs, const string& output,
+                 const MergeOptions& options) {
+  IndexBuilder builder(output, options.memory_budget);
+  IoThrottle throttle(options.max_read_bytes_per_sec);
+
+  size_t input_num = 0;
+  for (const string& input : inputs) {
+    IndexFileScanner scanner(input);
+    if (!scanner.Open(true)) {
+      return -1;
+    }
+    throttle.Consume(scanner.bytes_read());
+    int64_t reported = scanner.bytes_read();
+
+    // Give every document of this input a docID in the merged index.
+    unordered_map<DocID_t, DocID_t> new_ids;
+    bool ok = scanner.ForEachDocument(
+      [&](DocID_t doc_id, const string& doc_name) {
+        if (!options.skip_document
+            || !options.skip_document(input_num, doc_id)) {
+          new_ids[doc_id] = builder.AddDocument(doc_name);
+        }
+        throttle.Consume(scanner.bytes_read() - reported);
+        reported = scanner.bytes_read();
+        return true;
+      });
+
+    // Then feed its postings through under the new docIDs.
+    ok = ok && scanner.ForEachWord(
+      [&](const string& word, const vector<DocPostings>& docs) {
+        for (const DocPostings& doc : docs) {
+          auto it = new_ids.find(doc.doc_id);
+          if (it != new_ids.end()
+              && !builder.AddPostings(word, it->second, doc.positions)) {
+            return false;
+          }
+        }
+        throttle.Consume(scanner.bytes_read() - reported);
+        reported = scanner.bytes_read();
+        return true;
+      });
+    if (!ok) {
+      return -1;
+    }
+    input_num++;
+  }
+  return builder.Finish();
+}
+
+}  // namespace hw4
@@ -0,0 +1,72 @@
+#ifndef HW4_INDEXMERGER_H_
+#define HW4_INDEXMERGER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <functional>
+#include <list>
+#include <string>
+
+#include "./IndexBuilder.h"
+
+namespace hw4 {
+
+// An IoThrottle paces a stream of I/O so that, on average, no more than
+// "bytes_per_sec" bytes go through it per second.  Callers report the
+// bytes they moved with Consume(), which sleeps whenever the stream is
+// ahead of its budget.
+class IoThrottle {
+ public:
+  // A rate of 0 disables throttling.
+  explicit IoThrottle(int64_t bytes_per_sec);
+  virtual ~IoThrottle() { }
+
+  void Consume(int64_t bytes);
+
+ private:
+  int64_t bytes_per_sec_;
+  int64_t consumed_;
+  struct timespec start_;
+};
+
+// Knobs for MergeIndices().
+struct MergeOptions {
+  // How many bytes of postings to buffer before spilling a run.
+  size_t memory_budget;
+
+  // The cap on the rate at which the inputs are read; 0 means no cap.
+  int64_t max_read_bytes_per_sec;
+
+  // If set, the documents for which this returns true are left out of the
+  // merged index.  "input" is the input's position in the list of inputs.
+  std::function<bool(size_t input, DocID_t doc_id)> skip_document;
+
+  MergeOptions()
+    : memory_budget(IndexBuilder::kDefaultMemoryBudget),
+      max_read_bytes_per_sec(0) { }
+};
+
+// Merges several index files into a single index file, so that queries
+// probe one index instead of many.  Each input is streamed through an
+// IndexFileScanner and its docIDs are remapped onto one sequential docID
+// space; an IndexBuilder bounds the memory used for postings and writes
+// the result.  A document that appears in several inputs is kept once per
+// input, so the merged index answers every query exactly as the list of
+// inputs did.
+//
+// Arguments:
+// - inputs: the index files to merge, which are left untouched.
+// - output: the index file to create or (atomically) replace.  It may be
+//   one of the inputs.
+// - options: memory and I/O limits.
+//
+// Returns the size of the merged index in bytes, or -1 on error.
+int MergeIndices(const std::list<std::string>& inputs,
+                 const std::string& output,
+                 const MergeOptions& options = MergeOptions());
+
+}  // namespace hw4
+
+#endif  // HW4_INDEXMERGER_H_
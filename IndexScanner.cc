@@ -0,0 +1,234 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "./IndexScanner.h"
+#include "./IndexWriter.h"
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// static
+const size_t IndexFileScanner::kDefaultWindowBytes = 1 << 16;
+
+IndexFileScanner::IndexFileScanner(const string& file_name,
+                                   size_t window_bytes)
+  : file_name_(file_name),
+    fd_(-1),
+    window_(new uint8_t[std::max(window_bytes, static_cast<size_t>(1))]),
+    window_capacity_(std::max(window_bytes, static_cast<size_t>(1))),
+    window_offset_(0),
+    window_len_(0),
+    bytes_read_(0) { }
+
+IndexFileScanner::~IndexFileScanner() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+bool IndexFileScanner::Open(bool validate) {
+  fd_ = open(file_name_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    return false;
+  }
+
+  struct stat sb;
+  if (fstat(fd_, &sb) != 0 || !ReadAt(0, &header_, sizeof(header_))) {
+    return false;
+  }
+  header_.ToHostFormat();
+  if (header_.magic_number != hw3::kMagicNumber
+      || header_.doctable_bytes < 0 || header_.index_bytes < 0
+      || sb.st_size != static_cast<off_t>(sizeof(header_))
+                       + header_.doctable_bytes + header_.index_bytes) {
+    return false;
+  }
+  if (!validate || IsChecksumVerified(sb)) {
+    return true;
+  }
+
+  // The checksum covers everything after the header.
+  hw3::CRC32 crc;
+  uint8_t buf[4096];
+  for (int64_t pos = sizeof(header_); pos < sb.st_size; ) {
+    size_t len = std::min(static_cast<int64_t>(sizeof(buf)),
+                          sb.st_size - pos);
+    if (!ReadAt(pos, buf, len)) {
+      return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+      crc.FoldByteIntoCRC(buf[i]);
+    }
+    pos += len;
+  }
+  if (crc.GetFinalCRC() != header_.checksum) {
+    return false;
+  }
+  MarkChecksumVerified(sb);
+  return true;
+}
+
+int IndexFileScanner::ReleaseFd() {
+  int fd = fd_;
+  fd_ = -1;
+  window_len_ = 0;
+  return fd;
+}
+
+bool IndexFileScanner::ForEachDocument(const DocumentFn& fn) {
+  string name;
+  return ForEachElement(sizeof(header_),
+    [this, &fn, &name](hw3::IndexFileOffset_t pos) {
+      hw3::DoctableElementHeader element;
+      if (!ReadAt(pos, &element, sizeof(element))) {
+        return false;
+      }
+      element.ToHostFormat();
+      if (element.file_name_bytes < 0) {
+        return false;
+      }
+      name.resize(element.file_name_bytes);
+      return ReadAt(pos + sizeof(element), &name[0], name.size())
+          && fn(element.doc_id, name);
+    });
+}
+
+bool IndexFileScanner::ForEachWord(const WordFn& fn) {
+  string word;
+  vector<DocPostings> docs;
+  return ForEachElement(sizeof(header_) + header_.doctable_bytes,
+    [this, &fn, &word, &docs](hw3::IndexFileOffset_t pos) {
+      hw3::WordPostingsHeader element;
+      if (!ReadAt(pos, &element, sizeof(element))) {
+        return false;
+      }
+      element.ToHostFormat();
+      if (element.word_bytes < 0) {
+        return false;
+      }
+      word.resize(element.word_bytes);
+      return ReadAt(pos + sizeof(element), &word[0], word.size())
+          && ReadDocIDTable(pos + sizeof(element) + element.word_bytes,
+                            &docs)
+          && fn(word, docs);
+    });
+}
+
+bool IndexFileScanner::ForEachElement(
+    hw3::IndexFileOffset_t table_offset,
+    const std::function<bool(hw3::IndexFileOffset_t)>& fn) {
+  hw3::BucketListHeader table;
+  if (!ReadAt(table_offset, &table, sizeof(table))) {
+    return false;
+  }
+  table.ToHostFormat();
+
+  // A table is laid out as its bucket records, then each chain's element
+  // position records followed by its elements.  Reading all the bucket
+  // records, and then each chain's position records, in one go keeps the
+  // scan moving forward through the file; going back to them between
+  // elements would have the window refilled for nearly every record.
+  int64_t file_bytes = static_cast<int64_t>(sizeof(header_))
+    + header_.doctable_bytes + header_.index_bytes;
+  if (table.num_buckets < 0
+      || table.num_buckets > file_bytes / static_cast<int64_t>(
+                                 sizeof(hw3::BucketRecord))) {
+    return false;
+  }
+  vector<hw3::BucketRecord> buckets(table.num_buckets);
+  if (!ReadAt(table_offset + sizeof(table), buckets.data(),
+              buckets.size() * sizeof(hw3::BucketRecord))) {
+    return false;
+  }
+  int64_t max_elements = file_bytes
+    / static_cast<int64_t>(sizeof(hw3::ElementPositionRecord));
+  vector<hw3::ElementPositionRecord> elements;
+  for (hw3::BucketRecord& bucket : buckets) {
+    bucket.ToHostFormat();
+    if (bucket.chain_num_elements < 0
+        || bucket.chain_num_elements > max_elements) {
+      return false;
+    }
+    elements.resize(bucket.chain_num_elements);
+    if (!ReadAt(bucket.position, elements.data(),
+                elements.size() * sizeof(hw3::ElementPositionRecord))) {
+      return false;
+    }
+    for (hw3::ElementPositionRecord& element : elements) {
+      element.ToHostFormat();
+      if (!fn(element.position)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool IndexFileScanner::ReadDocIDTable(hw3::IndexFileOffset_t table_offset,
+                                      vector<DocPostings>* docs) {
+  docs->clear();
+  return ForEachElement(table_offset,
+    [this, docs](hw3::IndexFileOffset_t pos) {
+      hw3::DocIDElementHeader element;
+      if (!ReadAt(pos, &element, sizeof(element))) {
+        return false;
+      }
+      element.ToHostFormat();
+      if (element.num_positions < 0) {
+        return false;
+      }
+      docs->push_back({element.doc_id,
+                       vector<DocPositionOffset_t>(element.num_positions)});
+      vector<DocPositionOffset_t>& positions = docs->back().positions;
+      if (!ReadAt(pos + sizeof(element), positions.data(),
+                  positions.size() * sizeof(DocPositionOffset_t))) {
+        return false;
+      }
+      for (DocPositionOffset_t& position : positions) {
+        position = ntohl(position);
+      }
+      return true;
+    });
+}
+
+bool IndexFileScanner::ReadAt(int64_t offset, void* buf, size_t len) {
+  uint8_t* out = static_cast<uint8_t*>(buf);
+  while (len > 0) {
+    if (offset < window_offset_
+        || offset >= window_offset_ + static_cast<int64_t>(window_len_)) {
+      // Refill the window starting at the requested byte.
+      ssize_t res;
+      do {
+        res = pread(fd_, window_.get(), window_capacity_, offset);
+      } while (res == -1 && errno == EINTR);
+      if (res <= 0) {
+        return false;
+      }
+      window_offset_ = offset;
+      window_len_ = res;
+      bytes_read_ += res;
+    }
+    size_t skip = offset - window_offset_;
+    size_t chunk = std::min(len, window_len_ - skip);
+    memcpy(out, window_.get() + skip, chunk);
+    out += chunk;
+    offset += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+}  // namespace hw4
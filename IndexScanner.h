@@ -0,0 +1,105 @@
+#ifndef HW4_INDEXSCANNER_H_
+#define HW4_INDEXSCANNER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./IndexBuilder.h"
+#include "./libhw3/LayoutStructs.h"
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// An IndexFileScanner walks every element of an index file, in file order.
+// The hw3 readers can only look up a key they already know; the scanner is
+// what enumerates the documents and words of an existing index, e.g., to
+// merge several indices into one.
+//
+// Reads go through a window buffer, and a scan reads each hash table's
+// bucket records and each chain's position records ahead of the elements
+// they point to, so it moves forward through a file laid out back to back
+// (as both hw3::WriteIndex() and hw4::WriteIndex() lay them out): it reads
+// each byte of the file about once, a window at a time.
+class IndexFileScanner {
+ public:
+  // The default size of the read window, in bytes.
+  static const size_t kDefaultWindowBytes;
+
+  // Arguments:
+  // - file_name: the index file to scan.
+  // - window_bytes: how many bytes to read at a time.
+  explicit IndexFileScanner(const std::string& file_name,
+                            size_t window_bytes = kDefaultWindowBytes);
+  virtual ~IndexFileScanner();
+
+  // Opens the file and checks its header's magic number and section
+  // sizes.  If "validate" is true, the checksum is verified too, which
+  // reads the whole file once, unless this process has already verified
+  // it (see IsChecksumVerified()).
+  //
+  // Unlike hw3::FileIndexReader, a bad file is reported by returning false
+  // rather than by failing a Verify333().
+  bool Open(bool validate = true);
+
+  // Returns the file header; only valid after Open() succeeded.
+  const hw3::IndexFileHeader& header() const { return header_; }
+
+  // Hands the open file over to the caller, who must close() it; the
+  // scanner can't read any more.  Only valid after Open() succeeded.
+  int ReleaseFd();
+
+  // Returns the number of bytes read from the file so far.
+  int64_t bytes_read() const { return bytes_read_; }
+
+  // Invokes "fn" once per document in the doctable.  The scan stops early
+  // if "fn" returns false.
+  //
+  // Returns false on a read error or if "fn" stopped the scan.
+  typedef std::function<bool(DocID_t doc_id,
+                             const std::string& doc_name)> DocumentFn;
+  bool ForEachDocument(const DocumentFn& fn);
+
+  // Invokes "fn" once per word in the index, with all of the word's
+  // postings.  The scan stops early if "fn" returns false.
+  //
+  // Returns false on a read error or if "fn" stopped the scan.
+  typedef std::function<bool(const std::string& word,
+                             const std::vector<DocPostings>& docs)> WordFn;
+  bool ForEachWord(const WordFn& fn);
+
+ private:
+  // Invokes "fn" with the file offset of every element of the hash table
+  // starting at "table_offset".
+  bool ForEachElement(hw3::IndexFileOffset_t table_offset,
+                      const std::function<bool(hw3::IndexFileOffset_t)>& fn);
+
+  // Reads the docID table at "table_offset" into "docs".
+  bool ReadDocIDTable(hw3::IndexFileOffset_t table_offset,
+                      std::vector<DocPostings>* docs);
+
+  // Copies "len" bytes at "offset" into "buf", refilling the window as
+  // needed.
+  bool ReadAt(int64_t offset, void* buf, size_t len);
+
+  std::string file_name_;
+  int fd_;
+  hw3::IndexFileHeader header_;
+
+  std::unique_ptr<uint8_t[]> window_;
+  size_t window_capacity_;
+  int64_t window_offset_;
+  size_t window_len_;
+
+  int64_t bytes_read_;
+
+  DISALLOW_COPY_AND_ASSIGN(IndexFileScanner);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_INDEXSCANNER_H_
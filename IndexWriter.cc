@@ -0,0 +1,479 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "./HttpUtils.h"
+#include "./IndexWriter.h"
+#include "./TermDictionary.h"
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace hw4 {
+
+// static
+const size_t IndexFileWriter::kDefaultBufferBytes = 1 << 20;
+
+// Returns the directory containing "file_name", for fsync()'ing a rename.
+static string DirectoryOf(const string& file_name);
+
+// Writes all of "len" bytes of "buf" at "offset" in "fd", retrying
+// partial writes and EINTR.
+static bool WrappedPwrite(int fd, const uint8_t* buf, size_t len,
+                          off_t offset);
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexFileWriter
+///////////////////////////////////////////////////////////////////////////////
+IndexFileWriter::IndexFileWriter(const string& file_name, size_t buffer_bytes)
+  : file_name_(file_name),
+    tmp_name_(file_name + "." + to_string(getpid()) + ".tmp"),
+    fd_(-1),
+    buffer_(new uint8_t[std::max(buffer_bytes, static_cast<size_t>(1))]),
+    buffer_capacity_(std::max(buffer_bytes, static_cast<size_t>(1))),
+    buffer_len_(0),
+    offset_(0),
+    checksum_(0),
+    committed_(false) { }
+
+IndexFileWriter::~IndexFileWriter() {
+  if (!committed_) {
+    Abort();
+  }
+}
+
+bool IndexFileWriter::Open() {
+  fd_ = open(tmp_name_.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+             S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd_ == -1) {
+    return false;
+  }
+
+  // Reserve the header; it is filled in by Commit() once the checksum
+  // and section sizes are known, and it is not part of the checksum.
+  uint8_t placeholder[sizeof(hw3::IndexFileHeader)] = { 0 };
+  if (WrappedWrite(fd_, placeholder, sizeof(placeholder))
+      != static_cast<int>(sizeof(placeholder))) {
+    return false;
+  }
+  offset_ = sizeof(placeholder);
+  return true;
+}
+
+bool IndexFileWriter::Write(const void* data, size_t len) {
+  if (fd_ == -1 || offset_ + static_cast<int64_t>(len) > INT32_MAX) {
+    return false;
+  }
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  offset_ += len;
+  while (len > 0) {
+    if (buffer_len_ == buffer_capacity_ && !Flush()) {
+      return false;
+    }
+    size_t chunk = std::min(len, buffer_capacity_ - buffer_len_);
+    memcpy(buffer_.get() + buffer_len_, bytes, chunk);
+    buffer_len_ += chunk;
+    bytes += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+int IndexFileWriter::Commit(int32_t doctable_bytes, int32_t index_bytes) {
+  if (fd_ == -1 || !Flush()) {
+    return -1;
+  }
+  if (offset_ != static_cast<int64_t>(sizeof(hw3::IndexFileHeader))
+                 + doctable_bytes + index_bytes) {
+    // The caller's section sizes don't add up to what was written.
+    return -1;
+  }
+
+  // The header goes in last; its magic number is the commit record.
+  checksum_ = crc_.GetFinalCRC();
+  hw3::IndexFileHeader header(hw3::kMagicNumber, checksum_,
+                              doctable_bytes, index_bytes);
+  header.ToDiskFormat();
+  if (!WrappedPwrite(fd_, reinterpret_cast<uint8_t*>(&header),
+                     sizeof(header), 0)) {
+    return -1;
+  }
+
+  // Make sure the data is durable before it becomes visible under the
+  // real name, then make the rename itself durable.  The fd is gone
+  // whether or not close() succeeds, so it's never closed twice.
+  bool synced = fsync(fd_) == 0;
+  bool closed = close(fd_) == 0;
+  fd_ = -1;
+  if (!synced || !closed
+      || rename(tmp_name_.c_str(), file_name_.c_str()) != 0) {
+    Abort();
+    return -1;
+  }
+  committed_ = true;
+
+  int dir_fd = open(DirectoryOf(file_name_).c_str(), O_RDONLY);
+  if (dir_fd != -1) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  return static_cast<int>(offset_);
+}
+
+bool IndexFileWriter::Flush() {
+  for (size_t i = 0; i < buffer_len_; i++) {
+    crc_.FoldByteIntoCRC(buffer_[i]);
+  }
+  if (WrappedWrite(fd_, buffer_.get(), buffer_len_)
+      != static_cast<int>(buffer_len_)) {
+    return false;
+  }
+  buffer_len_ = 0;
+  return true;
+}
+
+void IndexFileWriter::Abort() {
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+  unlink(tmp_name_.c_str());
+}
+
+bool ReplaceFile(const string& file_name, const string& contents) {
+  string tmp_name = file_name + "." + to_string(getpid()) + ".tmp";
+  int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1) {
+    return false;
+  }
+  const unsigned char* bytes =
+    reinterpret_cast<const unsigned char*>(contents.data());
+  bool ok = WrappedWrite(fd, bytes, contents.size())
+              == static_cast<int>(contents.size())
+    && fsync(fd) == 0;
+  ok = (close(fd) == 0) && ok;
+  if (!ok || rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+    unlink(tmp_name.c_str());
+    return false;
+  }
+  return true;
+}
+
+// A file's identity: its device, inode, size, and modification and
+// change times.  A file replaced by rename() has a new inode, and one
+// written in place gets new times.
+typedef std::tuple<dev_t, ino_t, off_t, time_t, long, time_t, long> FileId;
+
+static FileId IdOf(const struct stat& sb) {
+  return FileId(sb.st_dev, sb.st_ino, sb.st_size,
+                sb.st_mtim.tv_sec, sb.st_mtim.tv_nsec,
+                sb.st_ctim.tv_sec, sb.st_ctim.tv_nsec);
+}
+
+static pthread_mutex_t verified_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::set<FileId> verified_files;
+
+void MarkChecksumVerified(const struct stat& sb) {
+  Verify333(pthread_mutex_lock(&verified_lock) == 0);
+  verified_files.insert(IdOf(sb));
+  Verify333(pthread_mutex_unlock(&verified_lock) == 0);
+}
+
+bool IsChecksumVerified(const struct stat& sb) {
+  Verify333(pthread_mutex_lock(&verified_lock) == 0);
+  bool verified = verified_files.count(IdOf(sb)) > 0;
+  Verify333(pthread_mutex_unlock(&verified_lock) == 0);
+  return verified;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// On-disk hash tables
+///////////////////////////////////////////////////////////////////////////////
+int32_t NumBucketsFor(size_t num_elements) {
+  // One bucket per element keeps the expected chain length at one.
+  return std::max(static_cast<int32_t>(num_elements), 1);
+}
+
+int64_t HashTableBytes(const vector<HashTableElement>& elements) {
+  int64_t bytes = sizeof(hw3::BucketListHeader)
+    + NumBucketsFor(elements.size()) * sizeof(hw3::BucketRecord);
+  for (const HashTableElement& element : elements) {
+    bytes += sizeof(hw3::ElementPositionRecord) + element.bytes;
+  }
+  return bytes;
+}
+
+bool WriteHashTable(IndexFileWriter* writer,
+                    vector<HashTableElement>* elements,
+                    const ElementEmitFn& emit) {
+  int32_t num_buckets = NumBucketsFor(elements->size());
+  std::stable_sort(elements->begin(), elements->end(),
+                   [num_buckets](const HashTableElement& a,
+                                 const HashTableElement& b) {
+                     return a.key % num_buckets < b.key % num_buckets;
+                   });
+
+  // Count the chains, so every record can be written before the data
+  // it points to.
+  vector<int32_t> chain_len(num_buckets, 0);
+  vector<int64_t> chain_bytes(num_buckets, 0);
+  for (const HashTableElement& element : *elements) {
+    HTKey_t bucket = element.key % num_buckets;
+    chain_len[bucket]++;
+    chain_bytes[bucket] += sizeof(hw3::ElementPositionRecord) + element.bytes;
+  }
+
+  hw3::BucketListHeader header(num_buckets);
+  header.ToDiskFormat();
+  if (!writer->Write(&header, sizeof(header))) {
+    return false;
+  }
+
+  int64_t chain_pos = writer->offset()
+    + static_cast<int64_t>(num_buckets) * sizeof(hw3::BucketRecord);
+  for (int32_t b = 0; b < num_buckets; b++) {
+    hw3::BucketRecord record(chain_len[b], chain_pos);
+    record.ToDiskFormat();
+    if (!writer->Write(&record, sizeof(record))) {
+      return false;
+    }
+    chain_pos += chain_bytes[b];
+  }
+
+  // Each chain: its element position records, then its elements.
+  size_t next = 0;
+  for (int32_t b = 0; b < num_buckets; b++) {
+    size_t chain_end = next + chain_len[b];
+    int64_t element_pos = writer->offset()
+      + chain_len[b] * sizeof(hw3::ElementPositionRecord);
+    for (size_t i = next; i < chain_end; i++) {
+      hw3::ElementPositionRecord record(element_pos);
+      record.ToDiskFormat();
+      if (!writer->Write(&record, sizeof(record))) {
+        return false;
+      }
+      element_pos += (*elements)[i].bytes;
+    }
+    for (size_t i = next; i < chain_end; i++) {
+      int64_t expected_end = writer->offset() + (*elements)[i].bytes;
+      if (!emit(writer, (*elements)[i])) {
+        return false;
+      }
+      Verify333(writer->offset() == expected_end);
+    }
+    next = chain_end;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteIndex
+///////////////////////////////////////////////////////////////////////////////
+
+// The docID --> positions table for one (word, document) pair.
+struct DocPositions {
+  DocID_t     doc_id;
+  LinkedList* positions;
+};
+
+// A word and its embedded docID table, ready to be laid out.
+struct WordElement {
+  const char*                  word;
+  int16_t                      word_bytes;
+  int32_t                      postings_bytes;
+  vector<DocPositions>         docs;
+  vector<HashTableElement>     doc_elements;
+};
+
+bool EmitDoctableElement(IndexFileWriter* writer,
+                         const HashTableElement& element) {
+  const char* name = static_cast<const char*>(element.data);
+  int16_t name_bytes = element.bytes - sizeof(hw3::DoctableElementHeader);
+  hw3::DoctableElementHeader header(element.key, name_bytes);
+  header.ToDiskFormat();
+  return writer->Write(&header, sizeof(header))
+      && writer->Write(name, name_bytes);
+}
+
+static bool EmitDocIDElement(IndexFileWriter* writer,
+                             const HashTableElement& element) {
+  const DocPositions* doc = static_cast<const DocPositions*>(element.data);
+  hw3::DocIDElementHeader header(doc->doc_id,
+                                 LinkedList_NumElements(doc->positions));
+  header.ToDiskFormat();
+  if (!writer->Write(&header, sizeof(header))) {
+    return false;
+  }
+
+  LLIterator* it = LLIterator_Allocate(doc->positions);
+  Verify333(it != nullptr);
+  bool ok = true;
+  for (; ok && LLIterator_IsValid(it); LLIterator_Next(it)) {
+    LLPayload_t payload;
+    LLIterator_Get(it, &payload);
+    hw3::DocIDElementPosition position(
+        static_cast<DocPositionOffset_t>(reinterpret_cast<intptr_t>(payload)));
+    position.ToDiskFormat();
+    ok = writer->Write(&position, sizeof(position));
+  }
+  LLIterator_Free(it);
+  return ok;
+}
+
+static bool EmitWordElement(IndexFileWriter* writer,
+                            const HashTableElement& element,
+                            TermDictionaryWriter* dictionary) {
+  WordElement* word = static_cast<WordElement*>(
+      const_cast<void*>(element.data));
+  hw3::WordPostingsHeader header(word->word_bytes, word->postings_bytes);
+  header.ToDiskFormat();
+  if (!writer->Write(&header, sizeof(header))
+      || !writer->Write(word->word, word->word_bytes)) {
+    return false;
+  }
+  dictionary->Add(word->word, writer->offset(), word->docs.size());
+  return WriteHashTable(writer, &word->doc_elements, &EmitDocIDElement);
+}
+
+int WriteIndex(MemIndex* mi, DocTable* dt, const char* file_name) {
+  // Size the doctable.
+  vector<HashTableElement> doc_elements;
+  HTIterator* it = HTIterator_Allocate(DT_GetIDToNameTable(dt));
+  Verify333(it != nullptr);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    const char* name = static_cast<const char*>(kv.value);
+    doc_elements.push_back({kv.key,
+          static_cast<int32_t>(sizeof(hw3::DoctableElementHeader)
+                               + strlen(name)),
+          name});
+  }
+  HTIterator_Free(it);
+
+  // Size the index, including every word's embedded docID table.
+  vector<WordElement> words(MemIndex_NumWords(mi));
+  vector<HashTableElement> word_elements;
+  size_t w = 0;
+  it = HTIterator_Allocate(mi);
+  Verify333(it != nullptr);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it), w++) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    WordPostings* wp = static_cast<WordPostings*>(kv.value);
+    WordElement* word = &words[w];
+    word->word = wp->word;
+    word->word_bytes = strlen(wp->word);
+
+    HTIterator* doc_it = HTIterator_Allocate(wp->postings);
+    Verify333(doc_it != nullptr);
+    for (; HTIterator_IsValid(doc_it); HTIterator_Next(doc_it)) {
+      HTKeyValue_t doc_kv;
+      HTIterator_Get(doc_it, &doc_kv);
+      word->docs.push_back({doc_kv.key,
+                            static_cast<LinkedList*>(doc_kv.value)});
+    }
+    HTIterator_Free(doc_it);
+
+    // The docs vector is complete, so its elements can be pointed at.
+    for (const DocPositions& doc : word->docs) {
+      int32_t positions = LinkedList_NumElements(doc.positions);
+      word->doc_elements.push_back({doc.doc_id,
+            static_cast<int32_t>(sizeof(hw3::DocIDElementHeader)
+                                 + positions
+                                   * sizeof(hw3::DocIDElementPosition)),
+            &doc});
+    }
+    int64_t postings_bytes = HashTableBytes(word->doc_elements);
+    int64_t element_bytes = sizeof(hw3::WordPostingsHeader)
+      + word->word_bytes + postings_bytes;
+    if (element_bytes > INT32_MAX) {
+      HTIterator_Free(it);
+      return -1;
+    }
+    word->postings_bytes = postings_bytes;
+    word_elements.push_back({kv.key, static_cast<int32_t>(element_bytes),
+                             word});
+  }
+  HTIterator_Free(it);
+
+  int64_t doctable_bytes = HashTableBytes(doc_elements);
+  int64_t index_bytes = HashTableBytes(word_elements);
+  if (sizeof(hw3::IndexFileHeader) + doctable_bytes + index_bytes
+      > INT32_MAX) {
+    return -1;
+  }
+
+  // Everything is sized; stream it out front to back, noting where each
+  // word's docID table lands for the term dictionary.
+  IndexFileWriter writer(file_name);
+  TermDictionaryWriter dictionary(file_name);
+  auto emit_word = [&dictionary](IndexFileWriter* writer,
+                                 const HashTableElement& element) {
+    return EmitWordElement(writer, element, &dictionary);
+  };
+  if (!writer.Open()
+      || !WriteHashTable(&writer, &doc_elements, &EmitDoctableElement)
+      || !WriteHashTable(&writer, &word_elements, emit_word)) {
+    return -1;
+  }
+  int result = writer.Commit(doctable_bytes, index_bytes);
+
+  // The dictionary only speeds up lookups; without it (or with a stale
+  // one, which won't match the new checksum) readers use the hash table.
+  if (result >= 0) {
+    dictionary.Commit(writer.checksum());
+  }
+  return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions
+///////////////////////////////////////////////////////////////////////////////
+static string DirectoryOf(const string& file_name) {
+  size_t slash = file_name.find_last_of('/');
+  if (slash == string::npos) {
+    return ".";
+  }
+  if (slash == 0) {
+    return "/";
+  }
+  return file_name.substr(0, slash);
+}
+
+static bool WrappedPwrite(int fd, const uint8_t* buf, size_t len,
+                          off_t offset) {
+  size_t written_so_far = 0;
+  while (written_so_far < len) {
+    ssize_t res = pwrite(fd, buf + written_so_far, len - written_so_far,
+                         offset + written_so_far);
+    if (res == -1) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (res == 0)
+      return false;
+    written_so_far += res;
+  }
+  return true;
+}
+
+}  // namespace hw4
@@ -0,0 +1,170 @@
+#ifndef HW4_INDEXWRITER_H_
+#define HW4_INDEXWRITER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+  #include "libhw2/DocTable.h"
+  #include "libhw2/MemIndex.h"
+}
+#include "./libhw3/LayoutStructs.h"
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// An IndexFileWriter emits an index file (in the hw3 on-disk format) in a
+// single sequential pass.  Customers lay the file out front-to-back with
+// Write(); bytes are collected in a large buffer and folded into the
+// header checksum as they go out, so the file never has to be re-read
+// or seeked over.
+//
+// The file is built under a temporary name next to the destination.
+// Commit() stamps the header (the magic number is still the commit
+// record), fsync()s the data, and atomically rename()s the temporary
+// file over the destination, so readers only ever see either the old
+// index or the complete new one.  If the writer is destroyed without a
+// successful Commit(), the temporary file is removed.
+class IndexFileWriter {
+ public:
+  // The default size of the output buffer, in bytes.
+  static const size_t kDefaultBufferBytes;
+
+  // Arguments:
+  // - file_name: the index file that Commit() will create or replace.
+  // - buffer_bytes: how many bytes to collect before each write().
+  explicit IndexFileWriter(const std::string& file_name,
+                           size_t buffer_bytes = kDefaultBufferBytes);
+  virtual ~IndexFileWriter();
+
+  // Creates the temporary file and reserves room for the file header.
+  //
+  // Returns false if the temporary file could not be created.
+  bool Open();
+
+  // Appends "len" bytes to the file body.
+  //
+  // Returns false if the bytes could not be written, or if the file
+  // would grow past what an IndexFileOffset_t can address.
+  bool Write(const void* data, size_t len);
+
+  // Returns the file offset at which the next Write() will land.
+  hw3::IndexFileOffset_t offset() const {
+    return static_cast<hw3::IndexFileOffset_t>(offset_);
+  }
+
+  // Flushes the body, writes the header, syncs the file to disk, and
+  // renames it into place.  "doctable_bytes" and "index_bytes" are the
+  // sizes of the two sections that were written.
+  //
+  // Returns the size of the index file in bytes, or -1 on error.
+  int Commit(int32_t doctable_bytes, int32_t index_bytes);
+
+  // Returns the checksum stamped into the header by a successful Commit().
+  uint32_t checksum() const { return checksum_; }
+
+ private:
+  // Writes out the buffered bytes, folding them into the checksum.
+  bool Flush();
+
+  // Closes and removes the temporary file.
+  void Abort();
+
+  std::string file_name_;
+  std::string tmp_name_;
+  int fd_;
+
+  std::unique_ptr<uint8_t[]> buffer_;
+  size_t buffer_capacity_;
+  size_t buffer_len_;
+
+  // Logical offset within the file, including the header.
+  int64_t offset_;
+
+  hw3::CRC32 crc_;
+  uint32_t checksum_;
+  bool committed_;
+
+  DISALLOW_COPY_AND_ASSIGN(IndexFileWriter);
+};
+
+// Atomically replaces "file_name" with "contents": the bytes go to a
+// temporary file which is fsync()'ed and then renamed into place.  Meant
+// for small files, such as manifests and sidecars, that are built in
+// memory.
+//
+// Returns false on error, in which case "file_name" is untouched.
+bool ReplaceFile(const std::string& file_name, const std::string& contents);
+
+// Index files and their sidecars are only ever replaced whole, never
+// modified in place, so a file whose checksum has been verified needn't
+// be verified again by this process while the same file, as identified
+// by the fstat() of an open descriptor on it, is still there.  These two
+// record such files and look them up; they may be called from several
+// threads.
+void MarkChecksumVerified(const struct stat& sb);
+bool IsChecksumVerified(const struct stat& sb);
+
+// One element of an on-disk hash table: the element's hash key, the number
+// of bytes its serialized form occupies, and an opaque pointer to whatever
+// the emit function needs to serialize it.
+struct HashTableElement {
+  HTKey_t     key;
+  int32_t     bytes;
+  const void* data;
+};
+
+// The function WriteHashTable() calls to serialize one element.  It must
+// Write() exactly element.bytes bytes, and returns false on error.
+typedef std::function<bool(IndexFileWriter* writer,
+                           const HashTableElement& element)> ElementEmitFn;
+
+// Returns the number of buckets used for a table of "num_elements" elements.
+int32_t NumBucketsFor(size_t num_elements);
+
+// Returns the number of bytes a hash table holding "elements" occupies on
+// disk: the bucket list header, the bucket records, and every chain.
+int64_t HashTableBytes(const std::vector<HashTableElement>& elements);
+
+// Writes a hash table (bucket list header, bucket records, then each
+// bucket's chain of element position records and elements) at the
+// writer's current offset.  The elements are reordered into bucket order;
+// "emit" is invoked once per element, in file order.
+//
+// Returns false on error.
+bool WriteHashTable(IndexFileWriter* writer,
+                    std::vector<HashTableElement>* elements,
+                    const ElementEmitFn& emit);
+
+// An ElementEmitFn for doctable elements.  "element.key" is the docID and
+// "element.data" points at the document's C-string name.
+bool EmitDoctableElement(IndexFileWriter* writer,
+                         const HashTableElement& element);
+
+// Writes the contents of a MemIndex and the docid_to_docname mapping of a
+// DocTable into an index file.  This produces the same on-disk format as
+// hw3::WriteIndex() and can be read by the hw3 readers, but it sizes every
+// hash table before it is emitted and so writes the whole file in one
+// sequential pass through an IndexFileWriter.
+//
+// Arguments:
+//   - mi: the MemIndex to write.
+//   - dt: the DocTable to write.
+//   - file_name: a C-style string containing the name of the index
+//     file that we should create.
+//
+// Returns:
+//   - the resulting size of the index file, in bytes, or negative value
+//     on error
+int WriteIndex(MemIndex* mi, DocTable* dt, const char* file_name);
+
+}  // namespace hw4
+
+#endif  // HW4_INDEXWRITER_H_
@@ -0,0 +1,128 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <charconv>
+#include <string>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+}
+#include "./JsonWriter.h"
+
+using std::string;
+
+namespace hw4 {
+
+JsonWriter& JsonWriter::Key(const char* key) {
+  Separator();
+  out_->push_back('"');
+  AppendJsonEscaped(out_, key, strlen(key));
+  out_->append("\":", 2);
+  after_key_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::String(const char* value, size_t len) {
+  Separator();
+  out_->push_back('"');
+  AppendJsonEscaped(out_, value, len);
+  out_->push_back('"');
+  return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+  Separator();
+  char buf[24];
+  std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), value);
+  out_->append(buf, res.ptr - buf);
+  return *this;
+}
+
+JsonWriter& JsonWriter::Double(double value) {
+  // JSON has no NaN or infinity.
+  if (!isfinite(value)) {
+    return Null();
+  }
+  Separator();
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "%.6g", value);
+  out_->append(buf, len);
+  return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+  Separator();
+  out_->append(value ? "true" : "false");
+  return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+  Separator();
+  out_->append("null", 4);
+  return *this;
+}
+
+JsonWriter& JsonWriter::Raw(const std::string& json) {
+  Separator();
+  out_->append(json);
+  return *this;
+}
+
+void JsonWriter::Separator() {
+  if (after_key_) {
+    // The value of a member follows its key directly.
+    after_key_ = false;
+    return;
+  }
+  if (depth_ > 0) {
+    uint64_t bit = UINT64_C(1) << (depth_ - 1);
+    if (has_items_ & bit) {
+      out_->push_back(',');
+    }
+    has_items_ |= bit;
+  }
+}
+
+JsonWriter& JsonWriter::Open(char bracket) {
+  Verify333(depth_ < kMaxDepth);
+  Separator();
+  out_->push_back(bracket);
+  depth_++;
+  has_items_ &= ~(UINT64_C(1) << (depth_ - 1));
+  return *this;
+}
+
+JsonWriter& JsonWriter::Close(char bracket) {
+  Verify333(depth_ > 0);
+  depth_--;
+  out_->push_back(bracket);
+  return *this;
+}
+
+void AppendJsonEscaped(string* out, const char* from, size_t len) {
+  static const char kHex[] = "0123456789abcdef";
+  for (size_t i = 0; i < len; i++) {
+    char c = from[i];
+    switch (c) {
+      case '"':  out->append("\\\"", 2); break;
+      case '\\': out->append("\\\\", 2); break;
+      case '\n': out->append("\\n", 2); break;
+      case '\r': out->append("\\r", 2); break;
+      case '\t': out->append("\\t", 2); break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escape[6] = { '\\', 'u', '0', '0', kHex[(c >> 4) & 0xf],
+                             kHex[c & 0xf] };
+          out->append(escape, sizeof(escape));
+        } else {
+          out->push_back(c);
+        }
+    }
+  }
+}
+
+}  // namespace hw4
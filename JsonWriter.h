@@ -0,0 +1,76 @@
+#ifndef HW4_JSONWRITER_H_
+#define HW4_JSONWRITER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+
+namespace hw4 {
+
+// A JsonWriter serializes JSON straight onto the end of a string (usually
+// an HttpResponse's body), with no intermediate document or temporary
+// strings: values are escaped and formatted in place, and the only
+// allocations are the string's own amortized growth.
+//
+// The writer inserts the commas and colons; the caller is responsible for
+// balancing Begin/End calls and for giving every object member a Key().
+// Nesting is limited to kMaxDepth levels.
+//
+//   JsonWriter json(&body);
+//   json.BeginObject().Key("hits").Int(2)
+//       .Key("words").BeginArray().String("a").String("b").EndArray()
+//       .EndObject();
+//
+// appends {"hits":2,"words":["a","b"]}.
+class JsonWriter {
+ public:
+  static const int kMaxDepth = 64;
+
+  explicit JsonWriter(std::string* out)
+    : out_(out), depth_(0), has_items_(0), after_key_(false) { }
+  virtual ~JsonWriter() { }
+
+  JsonWriter& BeginObject() { return Open('{'); }
+  JsonWriter& EndObject() { return Close('}'); }
+  JsonWriter& BeginArray() { return Open('['); }
+  JsonWriter& EndArray() { return Close(']'); }
+
+  // Starts an object member; the next call supplies its value.
+  JsonWriter& Key(const char* key);
+
+  JsonWriter& String(const char* value, size_t len);
+  JsonWriter& String(const std::string& value) {
+    return String(value.data(), value.size());
+  }
+  JsonWriter& Int(int64_t value);
+  JsonWriter& Double(double value);
+  JsonWriter& Bool(bool value);
+  JsonWriter& Null();
+
+  // Appends "json", which must be a whole value already serialized (as
+  // by another JsonWriter), verbatim.
+  JsonWriter& Raw(const std::string& json);
+
+ private:
+  // Emits the comma that separates this value from the previous one.
+  void Separator();
+
+  JsonWriter& Open(char bracket);
+  JsonWriter& Close(char bracket);
+
+  std::string* out_;
+  int depth_;
+
+  // Bit i is set once the container at depth i has an item.
+  uint64_t has_items_;
+  bool after_key_;
+};
+
+// Appends "len" bytes of "from" to "out", escaped for the inside of a
+// double-quoted JSON string.
+void AppendJsonEscaped(std::string* out, const char* from, size_t len);
+
+}  // namespace hw4
+
+#endif  // HW4_JSONWRITER_H_
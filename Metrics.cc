@@ -0,0 +1,256 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+}
+#include "./Metrics.h"
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+uint64_t MonotonicNs() {
+  struct timespec now;
+  Verify333(clock_gettime(CLOCK_MONOTONIC, &now) == 0);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+int ThreadShard() {
+  // Deal the shards out to threads as they first record something.
+  static std::atomic<int> next_shard(0);
+  static thread_local int shard = next_shard++ % kMetricShards;
+  return shard;
+}
+
+// Appends "value" to "out" as Prometheus expects numbers.
+static void AppendNumber(double value, string* out) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9g", value);
+  out->append(buf);
+}
+
+// Appends "name{labels}" to "out", with "extra" (like 'le="1"') added to
+// the labels.
+static void AppendSeriesName(const string& name, const string& labels,
+                             const string& extra, string* out) {
+  out->append(name);
+  if (labels.empty() && extra.empty()) {
+    return;
+  }
+  out->append("{" + labels);
+  if (!labels.empty() && !extra.empty()) {
+    out->append(",");
+  }
+  out->append(extra + "}");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Counter
+///////////////////////////////////////////////////////////////////////////////
+Counter::Counter() {
+  for (Shard& shard : shards_) {
+    shard.value = 0;
+  }
+}
+
+uint64_t Counter::value() const {
+  uint64_t total = 0;
+  for (const Shard& shard : shards_) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LatencyHistogram
+///////////////////////////////////////////////////////////////////////////////
+LatencyHistogram::LatencyHistogram() {
+  for (Shard& shard : shards_) {
+    for (std::atomic<uint64_t>& count : shard.counts) {
+      count = 0;
+    }
+    shard.sum_ns = 0;
+  }
+}
+
+void LatencyHistogram::Record(uint64_t ns) {
+  Shard& shard = shards_[ThreadShard()];
+  shard.counts[BucketFor(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+  uint64_t total = 0;
+  for (uint64_t count : Counts()) {
+    total += count;
+  }
+  return total;
+}
+
+uint64_t LatencyHistogram::sum_ns() const {
+  uint64_t total = 0;
+  for (const Shard& shard : shards_) {
+    total += shard.sum_ns.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+uint64_t LatencyHistogram::CountBelow(int bits) const {
+  // The buckets below 2^bits us are exactly those before the first
+  // bucket of that power of two.
+  int end = bits < kSubBucketBits ? 1 << bits
+    : kSubBuckets * (bits - kSubBucketBits + 1);
+  vector<uint64_t> counts = Counts();
+  uint64_t total = 0;
+  for (int i = 0; i < end && i < kNumBuckets; i++) {
+    total += counts[i];
+  }
+  return total;
+}
+
+uint64_t LatencyHistogram::Quantile(double quantile) const {
+  vector<uint64_t> counts = Counts();
+  uint64_t total = 0;
+  for (uint64_t count : counts) {
+    total += count;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(ceil(quantile * total));
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets - 1; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return BucketEnd(i) * 1000;
+    }
+  }
+  return (uint64_t(1) << kMaxBits) * 1000;
+}
+
+// static
+int LatencyHistogram::BucketFor(uint64_t us) {
+  // The first power of two is split one bucket per microsecond.
+  if (us < kSubBuckets) {
+    return us;
+  }
+  int bits = 63 - __builtin_clzll(us);
+  if (bits >= kMaxBits) {
+    return kNumBuckets - 1;  // the overflow bucket
+  }
+  int sub = (us >> (bits - kSubBucketBits)) & (kSubBuckets - 1);
+  return kSubBuckets * (bits - kSubBucketBits + 1) + sub;
+}
+
+// static
+uint64_t LatencyHistogram::BucketEnd(int bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket + 1;
+  }
+  int bits = bucket / kSubBuckets + kSubBucketBits - 1;
+  int sub = bucket % kSubBuckets;
+  return static_cast<uint64_t>(kSubBuckets + sub + 1)
+    << (bits - kSubBucketBits);
+}
+
+vector<uint64_t> LatencyHistogram::Counts() const {
+  vector<uint64_t> counts(kNumBuckets, 0);
+  for (const Shard& shard : shards_) {
+    for (int i = 0; i < kNumBuckets; i++) {
+      counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+    }
+  }
+  return counts;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MetricsRegistry
+///////////////////////////////////////////////////////////////////////////////
+void MetricsRegistry::AddCounter(const string& name, const string& help,
+                                 const string& labels,
+                                 const Counter* counter) {
+  AddCounter(name, help, labels, [counter]() { return counter->value(); });
+}
+
+void MetricsRegistry::AddCounter(const string& name, const string& help,
+                                 const string& labels,
+                                 std::function<uint64_t()> read) {
+  Add(name, help, "counter",
+      {labels, [read]() { return static_cast<double>(read()); }, nullptr});
+}
+
+void MetricsRegistry::AddGauge(const string& name, const string& help,
+                               const string& labels,
+                               std::function<double()> read) {
+  Add(name, help, "gauge", {labels, read, nullptr});
+}
+
+void MetricsRegistry::AddHistogram(const string& name, const string& help,
+                                   const string& labels,
+                                   const LatencyHistogram* histogram) {
+  Add(name, help, "histogram", {labels, nullptr, histogram});
+}
+
+void MetricsRegistry::Add(const string& name, const string& help,
+                          const string& type, const Series& series) {
+  auto it = by_name_.find(name);
+  if (it == by_name_.end()) {
+    it = by_name_.emplace(name, families_.size()).first;
+    families_.push_back({name, help, type, {}});
+  }
+  Verify333(families_[it->second].type == type);
+  families_[it->second].series.push_back(series);
+}
+
+void MetricsRegistry::Write(string* out) const {
+  for (const Family& family : families_) {
+    out->append("# HELP " + family.name + " " + family.help + "\n");
+    out->append("# TYPE " + family.name + " " + family.type + "\n");
+    for (const Series& series : family.series) {
+      if (series.histogram == nullptr) {
+        AppendSeriesName(family.name, series.labels, "", out);
+        out->append(" ");
+        AppendNumber(series.read(), out);
+        out->append("\n");
+        continue;
+      }
+
+      // Prometheus buckets are cumulative; export one per power of two,
+      // where our buckets' edges line up with them exactly.  Overflow is
+      // only counted in +Inf.
+      const LatencyHistogram& histogram = *series.histogram;
+      string bucket_name = family.name + "_bucket";
+      for (int bits = 0; bits <= LatencyHistogram::kMaxBits; bits++) {
+        string le;
+        AppendNumber((uint64_t(1) << bits) / 1e6, &le);
+        AppendSeriesName(bucket_name, series.labels, "le=\"" + le + "\"",
+                         out);
+        out->append(" " + std::to_string(histogram.CountBelow(bits)) + "\n");
+      }
+      uint64_t count = histogram.count();
+      AppendSeriesName(bucket_name, series.labels, "le=\"+Inf\"", out);
+      out->append(" " + std::to_string(count) + "\n");
+      AppendSeriesName(family.name + "_sum", series.labels, "", out);
+      out->append(" ");
+      AppendNumber(histogram.sum_ns() / 1e9, out);
+      out->append("\n");
+      AppendSeriesName(family.name + "_count", series.labels, "", out);
+      out->append(" " + std::to_string(count) + "\n");
+    }
+  }
+}
+
+}  // namespace hw4
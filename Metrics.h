@@ -0,0 +1,168 @@
+#ifndef HW4_METRICS_H_
+#define HW4_METRICS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// Returns the time on the monotonic clock in nanoseconds.
+uint64_t MonotonicNs();
+
+// The number of shards each Counter and LatencyHistogram is split into.
+// A thread always records into the same shard, and each shard sits on
+// its own cache lines, so threads recording at once rarely touch the
+// same memory; reading a value sums the shards.
+static const int kMetricShards = 16;
+
+// Returns the shard for the calling thread.
+int ThreadShard();
+
+// A Counter counts up from zero.  It's safe to use from many threads at
+// once.
+class Counter {
+ public:
+  Counter();
+  virtual ~Counter() { }
+
+  void Increment(uint64_t n = 1) {
+    shards_[ThreadShard()].value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  uint64_t value() const;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value;
+  };
+
+  Shard shards_[kMetricShards];
+
+  DISALLOW_COPY_AND_ASSIGN(Counter);
+};
+
+// A LatencyHistogram counts durations in HDR-style buckets: a power of
+// two's worth of microseconds is split into kSubBuckets equal buckets,
+// so every bucket is within 1/kSubBuckets of its values whether they're
+// microseconds or minutes, using a hundred or so counters in all.
+// Durations are recorded from 1us up to kMaxBits powers of two; longer
+// ones are counted in an overflow bucket of their own, past the last.
+//
+// It's safe to use from many threads at once.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+  virtual ~LatencyHistogram() { }
+
+  // Counts a duration of "ns" nanoseconds.
+  void Record(uint64_t ns);
+
+  // Returns the number of durations recorded, and their sum.
+  uint64_t count() const;
+  uint64_t sum_ns() const;
+
+  // Returns the number of durations recorded under 2^"bits"
+  // microseconds, for "bits" from 0 to kMaxBits.
+  uint64_t CountBelow(int bits) const;
+
+  // Returns an upper bound, within a bucket, on the "quantile" (0 to 1)
+  // of the durations recorded, in nanoseconds; 0 if there are none.  A
+  // quantile that falls in the overflow bucket is reported as 2^kMaxBits
+  // microseconds, though it's longer.
+  uint64_t Quantile(double quantile) const;
+
+  static const int kSubBucketBits = 2;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kMaxBits = 27;  // about two minutes
+  static const int kNumBuckets = kSubBuckets * (kMaxBits - 1) + 1;
+
+ private:
+  // Returns the bucket for a duration of "us" microseconds, and the
+  // first duration past bucket "bucket".
+  static int BucketFor(uint64_t us);
+  static uint64_t BucketEnd(int bucket);
+
+  // Returns the counts of all the shards, summed.
+  std::vector<uint64_t> Counts() const;
+
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> counts[kNumBuckets];
+    std::atomic<uint64_t> sum_ns;
+  };
+
+  Shard shards_[kMetricShards];
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+};
+
+// A MetricsRegistry names a server's counters, gauges and histograms,
+// and writes them all out in the Prometheus text exposition format.
+// Metrics that share a name but have different labels (such as
+// {stage="parse"} and {stage="write"}) are written as one family.
+//
+// The registered metrics and functions must outlive the registry.
+// Register everything before anything calls Write(); after that, Write()
+// is safe to call from many threads at once.
+class MetricsRegistry {
+ public:
+  MetricsRegistry() { }
+  virtual ~MetricsRegistry() { }
+
+  // Registers "counter", or "read" (which returns a count), as the
+  // counter "name" with "labels", which is either empty or like
+  // 'stage="parse"'.
+  void AddCounter(const std::string& name, const std::string& help,
+                  const std::string& labels, const Counter* counter);
+  void AddCounter(const std::string& name, const std::string& help,
+                  const std::string& labels,
+                  std::function<uint64_t()> read);
+
+  // Registers "read", which returns the current value, as a gauge.
+  void AddGauge(const std::string& name, const std::string& help,
+                const std::string& labels, std::function<double()> read);
+
+  // Registers "histogram" as a histogram, exported in seconds.
+  void AddHistogram(const std::string& name, const std::string& help,
+                    const std::string& labels,
+                    const LatencyHistogram* histogram);
+
+  // Appends every metric's current value to "out".
+  void Write(std::string* out) const;
+
+ private:
+  struct Series {
+    std::string labels;
+    std::function<double()> read;
+    const LatencyHistogram* histogram;
+  };
+
+  struct Family {
+    std::string name;
+    std::string help;
+    std::string type;
+    std::vector<Series> series;
+  };
+
+  // Adds "series" to the family "name", creating it if need be.
+  void Add(const std::string& name, const std::string& help,
+           const std::string& type, const Series& series);
+
+  // The families in the order they were first registered, and an index
+  // into them by name.
+  std::vector<Family> families_;
+  std::map<std::string, size_t> by_name_;
+
+  DISALLOW_COPY_AND_ASSIGN(MetricsRegistry);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_METRICS_H_
@@ -0,0 +1,327 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+}
+#include "./OAHashTable.h"
+
+namespace hw4 {
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants, internal helper functions
+///////////////////////////////////////////////////////////////////////////////
+
+// Control words are probed a group at a time.
+static const uint64_t kGroupWidth = 16;
+
+// Control word values.  A full slot's control word is the low 7 bits of
+// its key's hash, so it is never negative.
+static const int8_t kEmpty = -128;
+static const int8_t kDeleted = -2;
+
+struct oaht {
+  int8_t*       ctrl;          // one control word per slot.
+  HTKeyValue_t* slots;
+  uint64_t      num_groups;    // always a power of two.
+  int           num_elements;
+  uint64_t      num_deleted;   // slots holding a tombstone.
+};
+
+struct oaht_it {
+  OAHashTable* table;
+  uint64_t     index;          // the current slot, or capacity if invalid.
+};
+
+static inline uint64_t Capacity(const OAHashTable* table) {
+  return table->num_groups * kGroupWidth;
+}
+
+// The largest number of full and deleted slots allowed before growing.
+static inline uint64_t MaxLoad(uint64_t capacity) {
+  return capacity - capacity / 8;
+}
+
+// Keys are often already hashes, but docIDs are small sequential integers,
+// so scramble every key (with MurmurHash3's finalizer) before using it.
+static inline uint64_t Mix(HTKey_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+// The hash bits stored in a full slot's control word.
+static inline int8_t H2(uint64_t hash) {
+  return static_cast<int8_t>(hash & 0x7f);
+}
+
+// The first group of "hash"'s probe sequence.
+static inline uint64_t FirstGroup(const OAHashTable* table, uint64_t hash) {
+  return (hash >> 7) & (table->num_groups - 1);
+}
+
+// Returns a bitmask of the control words in the group at "ctrl" equal
+// to "value".
+static inline uint32_t MatchByte(const int8_t* ctrl, int8_t value) {
+#ifdef __SSE2__
+  __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+  uint32_t mask = 0;
+  for (uint64_t i = 0; i < kGroupWidth; i++) {
+    mask |= static_cast<uint32_t>(ctrl[i] == value) << i;
+  }
+  return mask;
+#endif
+}
+
+// Returns a bitmask of the empty or deleted slots in the group at "ctrl".
+static inline uint32_t MatchFree(const int8_t* ctrl) {
+#ifdef __SSE2__
+  return _mm_movemask_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl)));
+#else
+  uint32_t mask = 0;
+  for (uint64_t i = 0; i < kGroupWidth; i++) {
+    mask |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+  }
+  return mask;
+#endif
+}
+
+// Returns the slot holding "key", or -1 if it isn't in the table.
+static int64_t FindSlot(const OAHashTable* table, HTKey_t key,
+                        uint64_t hash) {
+  uint64_t group = FirstGroup(table, hash);
+  for (uint64_t step = 1; ; step++) {
+    const int8_t* ctrl = table->ctrl + group * kGroupWidth;
+    for (uint32_t mask = MatchByte(ctrl, H2(hash)); mask != 0;
+         mask &= mask - 1) {
+      uint64_t slot = group * kGroupWidth + __builtin_ctz(mask);
+      if (table->slots[slot].key == key) {
+        return slot;
+      }
+    }
+    // A key is never placed beyond a group that had an empty slot.
+    if (MatchByte(ctrl, kEmpty) != 0) {
+      return -1;
+    }
+    group = (group + step) & (table->num_groups - 1);
+  }
+}
+
+// Places "keyvalue", which must not be in the table already, in the first
+// free slot of its probe sequence.
+static void InsertNew(OAHashTable* table, HTKeyValue_t keyvalue,
+                      uint64_t hash) {
+  uint64_t group = FirstGroup(table, hash);
+  for (uint64_t step = 1; ; step++) {
+    uint32_t mask = MatchFree(table->ctrl + group * kGroupWidth);
+    if (mask != 0) {
+      uint64_t slot = group * kGroupWidth + __builtin_ctz(mask);
+      if (table->ctrl[slot] == kDeleted) {
+        table->num_deleted--;
+      }
+      table->ctrl[slot] = H2(hash);
+      table->slots[slot] = keyvalue;
+      table->num_elements++;
+      return;
+    }
+    group = (group + step) & (table->num_groups - 1);
+  }
+}
+
+// Empties "slot".  Tombstones are only needed where a probe sequence may
+// have passed through a full group.
+static void EraseSlot(OAHashTable* table, uint64_t slot) {
+  const int8_t* ctrl = table->ctrl + (slot / kGroupWidth) * kGroupWidth;
+  if (MatchByte(ctrl, kEmpty) != 0) {
+    table->ctrl[slot] = kEmpty;
+  } else {
+    table->ctrl[slot] = kDeleted;
+    table->num_deleted++;
+  }
+  table->num_elements--;
+}
+
+// Rehashes the table into "num_groups" groups, dropping the tombstones.
+static void Rehash(OAHashTable* table, uint64_t num_groups) {
+  int8_t* old_ctrl = table->ctrl;
+  HTKeyValue_t* old_slots = table->slots;
+  uint64_t old_capacity = Capacity(table);
+
+  table->num_groups = num_groups;
+  table->ctrl = new int8_t[Capacity(table)];
+  memset(table->ctrl, kEmpty, Capacity(table));
+  table->slots = new HTKeyValue_t[Capacity(table)];
+  table->num_elements = 0;
+  table->num_deleted = 0;
+  for (uint64_t i = 0; i < old_capacity; i++) {
+    if (old_ctrl[i] >= 0) {
+      InsertNew(table, old_slots[i], Mix(old_slots[i].key));
+    }
+  }
+  delete[] old_ctrl;
+  delete[] old_slots;
+}
+
+// Moves "iter" to the first full slot at or after "index".
+static void SeekFull(OAHTIterator* iter, uint64_t index) {
+  uint64_t capacity = Capacity(iter->table);
+  while (index < capacity && iter->table->ctrl[index] < 0) {
+    index++;
+  }
+  iter->index = index;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// OAHashTable
+///////////////////////////////////////////////////////////////////////////////
+OAHashTable* OAHashTable_Allocate(int num_buckets) {
+  Verify333(num_buckets > 0);
+
+  uint64_t num_groups = 1;
+  while (MaxLoad(num_groups * kGroupWidth)
+         < static_cast<uint64_t>(num_buckets)) {
+    num_groups *= 2;
+  }
+  OAHashTable* table = new OAHashTable;
+  table->num_groups = num_groups;
+  table->ctrl = new int8_t[Capacity(table)];
+  memset(table->ctrl, kEmpty, Capacity(table));
+  table->slots = new HTKeyValue_t[Capacity(table)];
+  table->num_elements = 0;
+  table->num_deleted = 0;
+  return table;
+}
+
+void OAHashTable_Free(OAHashTable* table,
+                      ValueFreeFnPtr value_free_function) {
+  Verify333(table != nullptr);
+  Verify333(value_free_function != nullptr);
+
+  for (uint64_t i = 0; i < Capacity(table); i++) {
+    if (table->ctrl[i] >= 0) {
+      value_free_function(table->slots[i].value);
+    }
+  }
+  delete[] table->ctrl;
+  delete[] table->slots;
+  delete table;
+}
+
+int OAHashTable_NumElements(OAHashTable* table) {
+  Verify333(table != nullptr);
+  return table->num_elements;
+}
+
+bool OAHashTable_Insert(OAHashTable* table,
+                        HTKeyValue_t newkeyvalue,
+                        HTKeyValue_t* oldkeyvalue) {
+  Verify333(table != nullptr);
+
+  uint64_t hash = Mix(newkeyvalue.key);
+  int64_t slot = FindSlot(table, newkeyvalue.key, hash);
+  if (slot >= 0) {
+    *oldkeyvalue = table->slots[slot];
+    table->slots[slot] = newkeyvalue;
+    return true;
+  }
+
+  // Make room first.  If tombstones are most of the load, rehashing at
+  // the same size is enough.
+  uint64_t used = table->num_elements + table->num_deleted + 1;
+  if (used > MaxLoad(Capacity(table))) {
+    bool grow = static_cast<uint64_t>(table->num_elements + 1)
+      > MaxLoad(Capacity(table)) / 2;
+    Rehash(table, grow ? table->num_groups * 2 : table->num_groups);
+  }
+  InsertNew(table, newkeyvalue, hash);
+  return false;
+}
+
+bool OAHashTable_Find(OAHashTable* table,
+                      HTKey_t key,
+                      HTKeyValue_t* keyvalue) {
+  Verify333(table != nullptr);
+
+  int64_t slot = FindSlot(table, key, Mix(key));
+  if (slot < 0) {
+    return false;
+  }
+  *keyvalue = table->slots[slot];
+  return true;
+}
+
+bool OAHashTable_Remove(OAHashTable* table,
+                        HTKey_t key,
+                        HTKeyValue_t* keyvalue) {
+  Verify333(table != nullptr);
+
+  int64_t slot = FindSlot(table, key, Mix(key));
+  if (slot < 0) {
+    return false;
+  }
+  *keyvalue = table->slots[slot];
+  EraseSlot(table, slot);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// OAHTIterator
+///////////////////////////////////////////////////////////////////////////////
+OAHTIterator* OAHTIterator_Allocate(OAHashTable* table) {
+  Verify333(table != nullptr);
+
+  OAHTIterator* iter = new OAHTIterator;
+  iter->table = table;
+  SeekFull(iter, 0);
+  return iter;
+}
+
+void OAHTIterator_Free(OAHTIterator* iter) {
+  Verify333(iter != nullptr);
+  delete iter;
+}
+
+bool OAHTIterator_IsValid(OAHTIterator* iter) {
+  Verify333(iter != nullptr);
+  return iter->index < Capacity(iter->table);
+}
+
+bool OAHTIterator_Next(OAHTIterator* iter) {
+  if (!OAHTIterator_IsValid(iter)) {
+    return false;
+  }
+  SeekFull(iter, iter->index + 1);
+  return OAHTIterator_IsValid(iter);
+}
+
+bool OAHTIterator_Get(OAHTIterator* iter, HTKeyValue_t* keyvalue) {
+  if (!OAHTIterator_IsValid(iter)) {
+    return false;
+  }
+  *keyvalue = iter->table->slots[iter->index];
+  return true;
+}
+
+bool OAHTIterator_Remove(OAHTIterator* iter, HTKeyValue_t* keyvalue) {
+  if (!OAHTIterator_IsValid(iter)) {
+    return false;
+  }
+  // Removal never moves other elements, so the iterator stays usable.
+  *keyvalue = iter->table->slots[iter->index];
+  EraseSlot(iter->table, iter->index);
+  SeekFull(iter, iter->index + 1);
+  return true;
+}
+
+}  // namespace hw4
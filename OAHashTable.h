@@ -0,0 +1,92 @@
+#ifndef HW4_OAHASHTABLE_H_
+#define HW4_OAHASHTABLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+extern "C" {
+  #include "libhw1/HashTable.h"
+}
+
+namespace hw4 {
+
+// An OAHashTable is a drop-in replacement for libhw1's HashTable: every
+// OAHashTable_* and OAHTIterator_* function has the same arguments, return
+// values and ownership rules as its HashTable_* / HTIterator_* twin, so
+// switching a caller over is a matter of renaming.
+//
+// Where HashTable hangs a LinkedList of heap-allocated nodes off every
+// bucket, an OAHashTable uses open addressing in the style of a "Swiss
+// table": the (key,value) pairs live in one flat array of slots, beside a
+// parallel array of one-byte control words.  A control word says whether
+// its slot is empty, deleted, or full, and for a full slot also holds 7
+// bits of the key's hash.  Lookups probe groups of 16 control words at a
+// time (with one SSE2 compare where available), and only touch the slots
+// whose 7 hash bits match, so a lookup is usually one or two cache lines.
+//
+// The table grows (doubling) once 7/8 of its slots are full or deleted.
+typedef struct oaht OAHashTable;
+
+// Allocate and return a new OAHashTable with room for at least
+// "num_buckets" elements; "num_buckets" MUST be greater than zero.
+OAHashTable* OAHashTable_Allocate(int num_buckets);
+
+// Free an OAHashTable, calling "value_free_function" once on each value.
+void OAHashTable_Free(OAHashTable* table, ValueFreeFnPtr value_free_function);
+
+// Returns the number of elements in the table.
+int OAHashTable_NumElements(OAHashTable* table);
+
+// Inserts "newkeyvalue", replacing any (key,value) with the same key.
+//
+// Returns true if an old (key,value) was replaced and returned through
+// "oldkeyvalue" (the caller now owns it), false otherwise.
+bool OAHashTable_Insert(OAHashTable* table,
+                        HTKeyValue_t newkeyvalue,
+                        HTKeyValue_t* oldkeyvalue);
+
+// Looks up "key", copying its (key,value) into "keyvalue" if present.
+//
+// Returns true if the key was found, false otherwise.
+bool OAHashTable_Find(OAHashTable* table,
+                      HTKey_t key,
+                      HTKeyValue_t* keyvalue);
+
+// Removes "key", returning its (key,value) through "keyvalue".
+//
+// Returns true if the key was found and removed, false otherwise.
+bool OAHashTable_Remove(OAHashTable* table,
+                        HTKey_t key,
+                        HTKeyValue_t* keyvalue);
+
+///////////////////////////////////////////////////////////////////////////////
+// OAHashTable iterator
+//
+// As with HTIterator, the order of iteration is undefined and mutating
+// the table other than through OAHTIterator_Remove invalidates iterators.
+typedef struct oaht_it OAHTIterator;
+
+// Returns an iterator at the table's "first" element, or past the end if
+// the table is empty.  The caller must OAHTIterator_Free it.
+OAHTIterator* OAHTIterator_Allocate(OAHashTable* table);
+
+// Frees the iterator.
+void OAHTIterator_Free(OAHTIterator* iter);
+
+// Returns true if the iterator points at an element.
+bool OAHTIterator_IsValid(OAHTIterator* iter);
+
+// Advances the iterator.  Returns true if it still points at an element.
+bool OAHTIterator_Next(OAHTIterator* iter);
+
+// Copies the current (key,value) into "keyvalue".  Returns false if the
+// iterator is past the end.
+bool OAHTIterator_Get(OAHTIterator* iter, HTKeyValue_t* keyvalue);
+
+// Removes the current (key,value), returning it through "keyvalue", and
+// advances the iterator.  Returns false if the iterator is past the end.
+bool OAHTIterator_Remove(OAHTIterator* iter, HTKeyValue_t* keyvalue);
+
+}  // namespace hw4
+
+#endif  // HW4_OAHASHTABLE_H_
@@ -0,0 +1,117 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+}
+#include "./Metrics.h"
+#include "./RateLimiter.h"
+
+using std::string;
+
+namespace hw4 {
+
+// static
+const size_t RateLimiter::kDefaultMaxClients = 100000;
+
+RateLimiter::RateLimiter(size_t max_clients)
+  : rates_(),
+    max_clients_per_shard_(std::max(max_clients / kNumShards, size_t(1))) {
+  for (Shard& shard : shards_) {
+    Verify333(pthread_mutex_init(&shard.lock, nullptr) == 0);
+  }
+  for (std::atomic<uint64_t>& count : num_limited_) {
+    count = 0;
+  }
+}
+
+RateLimiter::~RateLimiter() {
+  for (Shard& shard : shards_) {
+    Verify333(pthread_mutex_destroy(&shard.lock) == 0);
+  }
+}
+
+void RateLimiter::SetRate(Class work_class, double per_second,
+                          double burst) {
+  rates_[work_class].per_second = per_second;
+  rates_[work_class].burst = std::max(burst, 1.0);
+}
+
+bool RateLimiter::Allow(const string& client, Class work_class,
+                        int* retry_after_s) {
+  if (!IsLimited(work_class)) {
+    return true;
+  }
+  return Allow(client, work_class, MonotonicNs(), retry_after_s);
+}
+
+bool RateLimiter::Allow(const string& client, Class work_class,
+                        uint64_t now_ns, int* retry_after_s) {
+  const Rate& rate = rates_[work_class];
+  if (rate.per_second <= 0) {
+    return true;
+  }
+
+  Shard& shard = shards_[std::hash<string>()(client) % kNumShards];
+  Verify333(pthread_mutex_lock(&shard.lock) == 0);
+
+  // Find the client, moving it to the front, or start it off with full
+  // buckets in place of the client heard from least recently.
+  auto it = shard.index.find(client);
+  if (it != shard.index.end()) {
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+  } else {
+    if (shard.lru.size() >= max_clients_per_shard_) {
+      shard.index.erase(shard.lru.back().address);
+      shard.lru.pop_back();
+    }
+    shard.lru.emplace_front();
+    Client& fresh = shard.lru.front();
+    fresh.address = client;
+    for (int c = 0; c < kNumClasses; c++) {
+      fresh.buckets[c].tokens = rates_[c].burst;
+      fresh.buckets[c].updated_ns = now_ns;
+    }
+    shard.index[client] = shard.lru.begin();
+  }
+
+  // Top up the bucket for the time since it was last used.
+  Bucket& bucket = shard.lru.front().buckets[work_class];
+  if (now_ns > bucket.updated_ns) {
+    bucket.tokens = std::min(rate.burst, bucket.tokens
+                             + (now_ns - bucket.updated_ns) / 1e9
+                               * rate.per_second);
+    bucket.updated_ns = now_ns;
+  }
+  bool allowed = bucket.tokens >= 1;
+  if (allowed) {
+    bucket.tokens -= 1;
+  } else if (retry_after_s != nullptr) {
+    *retry_after_s = static_cast<int>(ceil((1 - bucket.tokens)
+                                           / rate.per_second));
+  }
+  Verify333(pthread_mutex_unlock(&shard.lock) == 0);
+
+  if (!allowed) {
+    num_limited_[work_class]++;
+  }
+  return allowed;
+}
+
+size_t RateLimiter::num_clients() {
+  size_t count = 0;
+  for (Shard& shard : shards_) {
+    Verify333(pthread_mutex_lock(&shard.lock) == 0);
+    count += shard.lru.size();
+    Verify333(pthread_mutex_unlock(&shard.lock) == 0);
+  }
+  return count;
+}
+
+}  // namespace hw4
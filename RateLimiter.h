@@ -0,0 +1,111 @@
+#ifndef HW4_RATELIMITER_H_
+#define HW4_RATELIMITER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// A RateLimiter keeps a token bucket per client address for each class of
+// work, and says whether a client may do some more: each bucket fills at
+// its class's rate up to its burst size, and each connection or request
+// takes a token from it.
+//
+// The buckets live in a table split into shards, each with its own lock,
+// so that threads serving different clients rarely contend.  The table
+// holds a bounded number of clients; past that, each shard forgets the
+// client it heard from least recently, whose buckets would be nearly
+// full again anyway.
+//
+// It's safe to use from many threads at once, once the rates are set.
+class RateLimiter {
+ public:
+  // The classes of work, each with its own rate.
+  enum Class {
+    kConnect = 0,  // accepting a connection
+    kStatic,       // a request for a static file
+    kQuery,        // a request that reads the indices
+    kNumClasses
+  };
+
+  // Arguments:
+  // - max_clients: the most clients to track at once.
+  explicit RateLimiter(size_t max_clients = kDefaultMaxClients);
+  virtual ~RateLimiter();
+
+  // Lets each client do "per_second" of "work_class" a second, in bursts
+  // of up to "burst"; a rate of 0 (the default) means no limit.  Call
+  // before the first Allow().
+  void SetRate(Class work_class, double per_second, double burst);
+
+  // Returns true if a rate is set for "work_class".
+  bool IsLimited(Class work_class) const {
+    return rates_[work_class].per_second > 0;
+  }
+
+  // Takes a token from "client"'s bucket for "work_class" and returns
+  // true, or returns false if the bucket is empty, setting
+  // "retry_after_s" (if not null) to the seconds until it won't be.
+  bool Allow(const std::string& client, Class work_class,
+             int* retry_after_s = nullptr);
+
+  // Like the above, but at "now_ns" on the monotonic clock.
+  bool Allow(const std::string& client, Class work_class, uint64_t now_ns,
+             int* retry_after_s);
+
+  // Returns the number of times Allow() said no for "work_class".
+  uint64_t num_limited(Class work_class) const {
+    return num_limited_[work_class];
+  }
+
+  // Returns the number of clients being tracked.
+  size_t num_clients();
+
+  static const size_t kDefaultMaxClients;
+
+ private:
+  struct Rate {
+    double per_second;
+    double burst;
+  };
+
+  struct Bucket {
+    double tokens;
+    uint64_t updated_ns;
+  };
+
+  struct Client {
+    std::string address;
+    Bucket buckets[kNumClasses];
+  };
+
+  // A shard of the table: its clients, most recently seen first, with an
+  // index into them by address.
+  struct Shard {
+    pthread_mutex_t lock;
+    std::list<Client> lru;
+    std::unordered_map<std::string, std::list<Client>::iterator> index;
+  };
+
+  static const size_t kNumShards = 16;
+
+  Rate rates_[kNumClasses];
+  size_t max_clients_per_shard_;
+  Shard shards_[kNumShards];
+  std::atomic<uint64_t> num_limited_[kNumClasses];
+
+  DISALLOW_COPY_AND_ASSIGN(RateLimiter);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_RATELIMITER_H_
@@ -0,0 +1,78 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "./JsonWriter.h"
+#include "./RequestTrace.h"
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// The stages of a request, in the order it goes through them.
+static const char* kStageNames[] = {
+  "queue", "parse", "open", "lookup", "postings", "names", "render",
+};
+static const int kNumStages = sizeof(kStageNames) / sizeof(kStageNames[0]);
+
+// Returns the time "trace" spent in each stage of kStageNames.
+static vector<uint64_t> StageTimes(const RequestTrace& trace) {
+  return {trace.queue_ns, trace.parse_ns, trace.open_ns,
+          trace.query.lookup_ns, trace.query.postings_ns,
+          trace.query.names_ns, trace.render_ns};
+}
+
+string RequestTrace::ServerTiming() const {
+  string timing;
+  vector<uint64_t> times = StageTimes(*this);
+  for (int i = 0; i < kNumStages; i++) {
+    if (times[i] == 0) {
+      continue;
+    }
+    char dur[32];
+    snprintf(dur, sizeof(dur), ";dur=%.3f", times[i] / 1e6);
+    if (!timing.empty()) {
+      timing.append(", ");
+    }
+    timing.append(kStageNames[i]).append(dur);
+  }
+  return timing;
+}
+
+string RequestTrace::ToJson() const {
+  string out;
+  JsonWriter json(&out);
+  json.BeginObject();
+  vector<uint64_t> times = StageTimes(*this);
+  for (int i = 0; i < kNumStages; i++) {
+    if (times[i] != 0) {
+      json.Key((string(kStageNames[i]) + "_us").c_str()).Int(times[i] / 1000);
+    }
+  }
+  if (!terms.empty()) {
+    json.Key("terms").BeginArray();
+    for (const string& term : terms) {
+      json.String(term);
+    }
+    json.EndArray().Key("indices").BeginArray();
+    for (const auto& segment : query.segments) {
+      json.BeginObject()
+          .Key("index").String(segment.index)
+          .Key("lookup_us").Int(segment.lookup_ns / 1000)
+          .Key("postings_us").Int(segment.postings_ns / 1000)
+          .Key("names_us").Int(segment.names_ns / 1000)
+          .Key("results").Int(segment.num_results)
+          .EndObject();
+    }
+    json.EndArray();
+  }
+  json.EndObject();
+  return out;
+}
+
+}  // namespace hw4
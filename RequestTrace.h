@@ -0,0 +1,47 @@
+#ifndef HW4_REQUESTTRACE_H_
+#define HW4_REQUESTTRACE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "./SegmentQueryProcessor.h"
+
+namespace hw4 {
+
+// A RequestTrace follows one request through the server, noting how long
+// each stage of answering it took, in nanoseconds, so that a slow request
+// can say where its time went: to the client in a Server-Timing header,
+// and to the slow query log.  Stages the request didn't go through are
+// left at zero.
+struct RequestTrace {
+  // Waiting for a thread; only the connection's first request waits.
+  uint64_t queue_ns = 0;
+
+  // Reading and parsing the request.
+  uint64_t parse_ns = 0;
+
+  // Opening the indices, and running the query in them (with each index
+  // file's share in query.segments).
+  uint64_t open_ns = 0;
+  SegmentQueryProcessor::QueryTiming query;
+
+  // Rendering the results, not counting the query or writing them.
+  uint64_t render_ns = 0;
+
+  // The query's terms, if the request ran one.
+  std::vector<std::string> terms;
+
+  // Returns the stages as the value of a Server-Timing header, such as
+  // "parse;dur=0.041, lookup;dur=1.250", in milliseconds.
+  std::string ServerTiming() const;
+
+  // Returns the trace as a JSON object, with the stages in microseconds
+  // and the query's terms and per-index breakdown.
+  std::string ToJson() const;
+};
+
+}  // namespace hw4
+
+#endif  // HW4_REQUESTTRACE_H_
@@ -0,0 +1,510 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./IndexScanner.h"
+#include "./Metrics.h"
+#include "./SegmentQueryProcessor.h"
+
+using std::list;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// static
+const size_t SegmentQueryProcessor::kMaxPrefixTerms = 256;
+
+// Returns true if "term" is a prefix query, such as "buff*".
+static bool IsPrefixTerm(const string& term) {
+  return term.size() > 1 && term.back() == '*';
+}
+
+// Calls "fn" with each of 0 .. n-1, on the calling thread plus up to
+// num_threads - 1 more.
+static void ParallelFor(size_t n, int num_threads,
+                        const std::function<void(size_t)>& fn) {
+  struct Worker {
+    std::atomic<size_t>* next;
+    size_t n;
+    const std::function<void(size_t)>* fn;
+
+    static void* Run(void* arg) {
+      Worker* self = static_cast<Worker*>(arg);
+      for (size_t i; (i = (*self->next)++) < self->n; ) {
+        (*self->fn)(i);
+      }
+      return nullptr;
+    }
+  };
+
+  std::atomic<size_t> next(0);
+  Worker worker{&next, n, &fn};
+  size_t num_workers = std::min(n, static_cast<size_t>(num_threads));
+  vector<pthread_t> threads(num_workers > 1 ? num_workers - 1 : 0);
+  for (pthread_t& thread : threads) {
+    Verify333(pthread_create(&thread, nullptr, &Worker::Run, &worker) == 0);
+  }
+  Worker::Run(&worker);
+  for (pthread_t& thread : threads) {
+    Verify333(pthread_join(thread, nullptr) == 0);
+  }
+}
+
+// Returns a second stream on the file open as "f", or nullptr on error.
+static FILE* DupFile(FILE* f) {
+  int fd = dup(fileno(f));
+  FILE* copy = fd == -1 ? nullptr : fdopen(fd, "rb");
+  if (fd != -1 && copy == nullptr) {
+    close(fd);
+  }
+  return copy;
+}
+
+// How many times to try opening a segment set whose manifest changes
+// underneath us (because a merge replaced some of its segments) before
+// giving up, and how long to wait before the first retry; the wait
+// doubles with each one.
+static const int kManifestAttempts = 5;
+static const int64_t kManifestBackoffNs = 1000000;
+
+SegmentQueryProcessor::Segment::~Segment() {
+  if (file != nullptr) {
+    fclose(file);
+  }
+  delete dict;
+  delete itr;
+  delete dtr;
+}
+
+SegmentQueryProcessor::SegmentQueryProcessor(const list<string>& index_list,
+                                             bool validate)
+  : index_list_(index_list), validate_(validate) { }
+
+SegmentQueryProcessor::~SegmentQueryProcessor() {
+  RemoveSegments(0);
+}
+
+bool SegmentQueryProcessor::Open() {
+  for (const string& index : index_list_) {
+    struct stat sb;
+    bool ok;
+    if (stat(index.c_str(), &sb) == 0 && S_ISDIR(sb.st_mode)) {
+      ok = AddSegmentSet(index);
+    } else {
+      ok = AddSegment(index, "");
+    }
+    if (!ok) {
+      RemoveSegments(0);
+      return false;
+    }
+  }
+  return true;
+}
+
+vector<SegmentQueryProcessor::QueryResult>
+SegmentQueryProcessor::ProcessQuery(const vector<string>& query,
+                                    QueryTiming* timing,
+                                    bool* truncated) const {
+  vector<QueryResult> final_result;
+  if (truncated != nullptr) {
+    *truncated = false;
+  }
+  if (query.empty()) {
+    return final_result;
+  }
+
+  // Charges the time since the last call to "stage" of "timing".
+  QueryTiming unused;
+  if (timing == nullptr) {
+    timing = &unused;
+  }
+  uint64_t last = MonotonicNs();
+  auto charge = [&last](uint64_t* stage) {
+    uint64_t now = MonotonicNs();
+    *stage += now - last;
+    last = now;
+  };
+
+  for (const Segment* segment : segments_) {
+    // The segment's share is what the totals grow by while searching it.
+    QueryTiming::SegmentTiming segment_timing;
+    segment_timing.index = segment->file_name;
+    segment_timing.lookup_ns = timing->lookup_ns;
+    segment_timing.postings_ns = timing->postings_ns;
+    segment_timing.names_ns = timing->names_ns;
+
+    // Rank the documents matching the first term, then keep those that
+    // match every other term too.
+    Postings ranks;
+    for (size_t i = 0; i < query.size() && (i == 0 || !ranks.empty()); i++) {
+      if (IsPrefixTerm(query[i])) {
+        Postings matches;
+        if (!MatchPrefix(segment, query[i].substr(0, query[i].size() - 1),
+                         &matches) && truncated != nullptr) {
+          *truncated = true;
+        }
+        charge(&timing->postings_ns);
+        if (i == 0) {
+          ranks.swap(matches);
+        } else {
+          Intersect(matches, &ranks);
+        }
+        continue;
+      }
+
+      hw3::DocIDTableReader* ditr = LookupWord(segment, query[i]);
+      charge(&timing->lookup_ns);
+      if (ditr == nullptr) {
+        ranks.clear();
+        break;
+      }
+      if (i == 0) {
+        ranks = LivePostings(segment, ditr);
+      } else {
+        size_t kept = 0;
+        for (const auto& doc : ranks) {
+          list<DocPositionOffset_t> positions;
+          if (ditr->LookupDocID(doc.first, &positions)) {
+            ranks[kept++] = {doc.first,
+                             doc.second + static_cast<int>(positions.size())};
+          }
+        }
+        ranks.resize(kept);
+      }
+      delete ditr;
+      charge(&timing->postings_ns);
+    }
+
+    for (const auto& doc : ranks) {
+      QueryResult result;
+      Verify333(segment->dtr->LookupDocID(doc.first, &result.document_name));
+      result.rank = doc.second;
+      final_result.push_back(result);
+    }
+    charge(&timing->names_ns);
+
+    segment_timing.lookup_ns = timing->lookup_ns - segment_timing.lookup_ns;
+    segment_timing.postings_ns =
+      timing->postings_ns - segment_timing.postings_ns;
+    segment_timing.names_ns = timing->names_ns - segment_timing.names_ns;
+    segment_timing.num_results = ranks.size();
+    timing->segments.push_back(std::move(segment_timing));
+  }
+
+  std::sort(final_result.begin(), final_result.end());
+  return final_result;
+}
+
+vector<vector<SegmentQueryProcessor::QueryResult>>
+SegmentQueryProcessor::ProcessQueries(const vector<vector<string>>& queries,
+                                      int num_threads,
+                                      vector<bool>* truncated) const {
+  // Number the distinct terms of the batch.
+  map<string, size_t> term_ids;
+  vector<vector<size_t>> query_terms(queries.size());
+  for (size_t q = 0; q < queries.size(); q++) {
+    for (const string& term : queries[q]) {
+      query_terms[q].push_back(
+        term_ids.emplace(term, term_ids.size()).first->second);
+    }
+  }
+  vector<const string*> terms(term_ids.size());
+  for (const auto& term : term_ids) {
+    terms[term.second] = &term.first;
+  }
+
+  // Look every term up once in each segment.  A segment's readers share
+  // file handles, so each segment is read by a single thread.
+  vector<vector<Postings>> postings(segments_.size());
+  vector<vector<char>> term_truncated(segments_.size(),
+                                      vector<char>(terms.size(), false));
+  ParallelFor(segments_.size(), num_threads, [&](size_t s) {
+      postings[s].reserve(terms.size());
+      for (size_t t = 0; t < terms.size(); t++) {
+        bool cut = false;
+        postings[s].push_back(ReadPostings(segments_[s], *terms[t], &cut));
+        term_truncated[s][t] = cut;
+      }
+    });
+  if (truncated != nullptr) {
+    truncated->assign(queries.size(), false);
+    for (size_t q = 0; q < queries.size(); q++) {
+      for (size_t s = 0; s < segments_.size(); s++) {
+        for (size_t t : query_terms[q]) {
+          if (term_truncated[s][t]) {
+            (*truncated)[q] = true;
+          }
+        }
+      }
+    }
+  }
+
+  // Intersect each query's postings in each segment, starting from the
+  // shortest.  These touch no files, so every query can run at once.
+  vector<vector<Postings>> hits(queries.size(),
+                                vector<Postings>(segments_.size()));
+  ParallelFor(queries.size(), num_threads, [&](size_t q) {
+      if (query_terms[q].empty()) {
+        return;
+      }
+      for (size_t s = 0; s < segments_.size(); s++) {
+        vector<size_t> order = query_terms[q];
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return postings[s][a].size() < postings[s][b].size();
+          });
+        Postings ranks = postings[s][order[0]];
+        for (size_t i = 1; i < order.size() && !ranks.empty(); i++) {
+          Intersect(postings[s][order[i]], &ranks);
+        }
+        hits[q][s].swap(ranks);
+      }
+    });
+
+  // Name the matching documents, once each per segment.
+  vector<map<DocID_t, string>> names(segments_.size());
+  ParallelFor(segments_.size(), num_threads, [&](size_t s) {
+      for (size_t q = 0; q < queries.size(); q++) {
+        for (const auto& doc : hits[q][s]) {
+          auto name = names[s].emplace(doc.first, string());
+          if (name.second) {
+            Verify333(segments_[s]->dtr->LookupDocID(doc.first,
+                                                     &name.first->second));
+          }
+        }
+      }
+    });
+
+  vector<vector<QueryResult>> results(queries.size());
+  ParallelFor(queries.size(), num_threads, [&](size_t q) {
+      for (size_t s = 0; s < segments_.size(); s++) {
+        for (const auto& doc : hits[q][s]) {
+          QueryResult result;
+          result.document_name = names[s].at(doc.first);
+          result.rank = doc.second;
+          results[q].push_back(result);
+        }
+      }
+      std::sort(results[q].begin(), results[q].end());
+    });
+  return results;
+}
+
+bool SegmentQueryProcessor::AddSegment(const string& file_name,
+                                       const string& bitmap_name) {
+  // Every reader works from a descriptor opened (and checked) here, so the
+  // segment stays readable even if a merge unlinks its files later.
+  IndexFileScanner scanner(file_name);
+  if (!scanner.Open(validate_)) {
+    return false;
+  }
+  Segment* segment = new Segment;
+  segment->file_name = file_name;
+  int fd = scanner.ReleaseFd();
+  segment->file = fdopen(fd, "rb");
+  if (segment->file == nullptr) {
+    close(fd);
+    delete segment;
+    return false;
+  }
+  if (!bitmap_name.empty() && !segment->deleted.Load(bitmap_name)) {
+    delete segment;
+    return false;
+  }
+
+  // The hw3 readers each take a stream of their own.
+  FILE* doctable = DupFile(segment->file);
+  FILE* index = doctable == nullptr ? nullptr : DupFile(segment->file);
+  if (index == nullptr) {
+    if (doctable != nullptr) {
+      fclose(doctable);
+    }
+    delete segment;
+    return false;
+  }
+  const hw3::IndexFileHeader& header = scanner.header();
+  segment->dtr = new hw3::DocTableReader(doctable, sizeof(header));
+  segment->itr = new hw3::IndexTableReader(index, sizeof(header)
+                                                  + header.doctable_bytes);
+
+  segment->dict = new TermDictionary(file_name);
+  if (!segment->dict->Open(header.checksum, validate_)) {
+    delete segment->dict;
+    segment->dict = nullptr;
+  }
+  segments_.push_back(segment);
+  return true;
+}
+
+hw3::DocIDTableReader* SegmentQueryProcessor::LookupWord(
+    const Segment* segment, const string& word) const {
+  if (segment->dict == nullptr) {
+    return segment->itr->LookupWord(word);
+  }
+  TermInfo info;
+  if (!segment->dict->Lookup(word, &info)) {
+    return nullptr;
+  }
+  return OpenPostings(segment, info.postings_offset);
+}
+
+SegmentQueryProcessor::Postings SegmentQueryProcessor::ReadPostings(
+    const Segment* segment, const string& term, bool* truncated) const {
+  Postings postings;
+  if (IsPrefixTerm(term)) {
+    *truncated = !MatchPrefix(segment, term.substr(0, term.size() - 1),
+                              &postings);
+  } else {
+    hw3::DocIDTableReader* ditr = LookupWord(segment, term);
+    if (ditr != nullptr) {
+      postings = LivePostings(segment, ditr);
+      delete ditr;
+    }
+  }
+  return postings;
+}
+
+bool SegmentQueryProcessor::MatchPrefix(const Segment* segment,
+                                        const string& prefix,
+                                        Postings* matches) const {
+  matches->clear();
+  // Without a dictionary there's no way to enumerate the words.
+  if (segment->dict == nullptr) {
+    return true;
+  }
+  vector<TermInfo> terms;
+  bool complete = segment->dict->ExpandPrefix(prefix, kMaxPrefixTerms, &terms);
+
+  vector<Postings> lists;
+  lists.reserve(terms.size());
+  for (const TermInfo& term : terms) {
+    hw3::DocIDTableReader* ditr = OpenPostings(segment, term.postings_offset);
+    lists.push_back(LivePostings(segment, ditr));
+    delete ditr;
+  }
+
+  // Union the expansions' postings in one merge, summing the ranks of the
+  // documents several of them share.  The heap holds the next docID of
+  // each list that has any left, and the list's index.
+  typedef pair<DocID_t, size_t> Head;
+  std::priority_queue<Head, vector<Head>, std::greater<Head>> heap;
+  vector<size_t> next(lists.size(), 0);
+  for (size_t l = 0; l < lists.size(); l++) {
+    if (!lists[l].empty()) {
+      heap.push({lists[l][0].first, l});
+    }
+  }
+  while (!heap.empty()) {
+    size_t l = heap.top().second;
+    heap.pop();
+    const pair<DocID_t, int>& doc = lists[l][next[l]++];
+    if (!matches->empty() && matches->back().first == doc.first) {
+      matches->back().second += doc.second;
+    } else {
+      matches->push_back(doc);
+    }
+    if (next[l] < lists[l].size()) {
+      heap.push({lists[l][next[l]].first, l});
+    }
+  }
+  return complete;
+}
+
+hw3::DocIDTableReader* SegmentQueryProcessor::OpenPostings(
+    const Segment* segment, hw3::IndexFileOffset_t offset) const {
+  // The reader takes ownership of (and closes) its FILE*.
+  FILE* f = DupFile(segment->file);
+  Verify333(f != nullptr);
+  return new hw3::DocIDTableReader(f, offset);
+}
+
+SegmentQueryProcessor::Postings SegmentQueryProcessor::LivePostings(
+    const Segment* segment, hw3::DocIDTableReader* ditr) const {
+  Postings postings;
+  for (const hw3::DocIDElementHeader& header : ditr->GetDocIDList()) {
+    if (!segment->deleted.IsDeleted(header.doc_id)) {
+      postings.push_back({header.doc_id, header.num_positions});
+    }
+  }
+  // The table is a hash table, so it lists the docIDs by bucket.
+  std::sort(postings.begin(), postings.end());
+  return postings;
+}
+
+// static
+void SegmentQueryProcessor::Intersect(const Postings& other,
+                                      Postings* ranks) {
+  auto from = other.begin();
+  size_t kept = 0;
+  for (const auto& doc : *ranks) {
+    from = std::lower_bound(from, other.end(),
+                            pair<DocID_t, int>(doc.first, 0));
+    if (from != other.end() && from->first == doc.first) {
+      (*ranks)[kept++] = {doc.first, doc.second + from->second};
+    }
+  }
+  ranks->resize(kept);
+}
+
+bool SegmentQueryProcessor::AddSegmentSet(const string& dir) {
+  // A merge may retire segments, unlinking their files, at any time.  It
+  // rewrites the manifest first, though, and segment names are never
+  // reused, so if the manifest is unchanged once we've opened everything
+  // it names, each segment (and its deletion bitmap) was opened before it
+  // could have been retired.
+  size_t first = segments_.size();
+  struct timespec pause = {0, kManifestBackoffNs};
+  for (int attempt = 0; attempt < kManifestAttempts; attempt++) {
+    if (attempt > 0) {
+      RemoveSegments(first);
+      while (nanosleep(&pause, &pause) == -1 && errno == EINTR) { }
+      pause.tv_nsec = kManifestBackoffNs << attempt;
+    }
+
+    vector<SegmentInfo> manifest, reread;
+    if (!SegmentSet::ReadManifest(dir, &manifest)) {
+      continue;
+    }
+    bool ok = true;
+    for (size_t i = 0; ok && i < manifest.size(); i++) {
+      ok = AddSegment(dir + "/" + manifest[i].name,
+                      dir + "/" + SegmentSet::BitmapName(manifest[i].name));
+    }
+    if (ok && SegmentSet::ReadManifest(dir, &reread)
+        && reread.size() == manifest.size()
+        && std::equal(manifest.begin(), manifest.end(), reread.begin(),
+                      [](const SegmentInfo& a, const SegmentInfo& b) {
+                        return a.name == b.name;
+                      })) {
+      return true;
+    }
+  }
+  RemoveSegments(first);
+  return false;
+}
+
+void SegmentQueryProcessor::RemoveSegments(size_t first) {
+  for (size_t i = first; i < segments_.size(); i++) {
+    delete segments_[i];
+  }
+  segments_.resize(std::min(first, segments_.size()));
+}
+
+}  // namespace hw4
@@ -0,0 +1,189 @@
+#ifndef HW4_SEGMENTQUERYPROCESSOR_H_
+#define HW4_SEGMENTQUERYPROCESSOR_H_
+
+#include <stdint.h>
+#include <cstdio>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./SegmentSet.h"
+#include "./TermDictionary.h"
+#include "./libhw3/DocTableReader.h"
+#include "./libhw3/IndexTableReader.h"
+#include "./libhw3/QueryProcessor.h"
+
+namespace hw4 {
+
+// A SegmentQueryProcessor answers queries like hw3::QueryProcessor, but
+// also understands SegmentSet directories: each index in its list is
+// either a plain index file or a directory holding a segment set, in which
+// case every segment named by the set's manifest is searched and the
+// documents in the segments' deletion bitmaps are skipped.
+//
+// Words are looked up through an index's TermDictionary when it has a
+// current one, and through the index's own hash table otherwise.
+//
+// The manifest is read once, when the SegmentQueryProcessor is opened, and
+// every file it names is held open from then on, so a query sees a
+// consistent snapshot of the set even while it is being updated or merged.
+class SegmentQueryProcessor {
+ public:
+  typedef hw3::QueryProcessor::QueryResult QueryResult;
+
+  // Where the time of a ProcessQuery() call went, in nanoseconds.
+  struct QueryTiming {
+    // Finding each term's docID table, through the term dictionary or
+    // the index's hash table.
+    uint64_t lookup_ns = 0;
+
+    // Reading the docID tables and intersecting them.  Expanding prefix
+    // terms counts here, since it reads every matching word's table.
+    uint64_t postings_ns = 0;
+
+    // Looking up the names of the matching documents.
+    uint64_t names_ns = 0;
+
+    // The same stages in each index file, in the order they're searched,
+    // with the number of matching documents each held.
+    struct SegmentTiming {
+      std::string index;
+      uint64_t lookup_ns = 0;
+      uint64_t postings_ns = 0;
+      uint64_t names_ns = 0;
+      size_t num_results = 0;
+    };
+    std::vector<SegmentTiming> segments;
+  };
+
+  // The most words a prefix term expands to, per index.
+  static const size_t kMaxPrefixTerms;
+
+  // Arguments:
+  // - index_list: index files and/or segment set directories.
+  // - validate: whether to validate the checksums of the index files.
+  explicit SegmentQueryProcessor(const std::list<std::string>& index_list,
+                                 bool validate = true);
+  virtual ~SegmentQueryProcessor();
+
+  // Opens every index file.
+  //
+  // Returns false if one of them is missing or corrupt, or a segment set's
+  // manifest can't be read or keeps changing while its segments are being
+  // opened.  The processor then searches nothing, rather than just some of
+  // the indices.
+  bool Open();
+
+  // Returns the documents matching every term of "query", sorted in
+  // descending order of rank.  A term ending in '*' (such as "buff*") is a
+  // prefix term: it matches any word starting with what precedes the '*',
+  // and its rank in a document is the sum over all the words it matched.
+  // Prefix terms are expanded through the term dictionary, so they match
+  // nothing in an index without one, and only the first kMaxPrefixTerms
+  // matching words (in sorted order) of each index are searched.
+  //
+  // If "timing" isn't null, the time spent in each stage of the query is
+  // added to it, and each index file's share appended to its segments.
+  //
+  // If "truncated" isn't null, it is set to whether a prefix term matched
+  // more than kMaxPrefixTerms words in some index, so that the results
+  // may be incomplete.
+  std::vector<QueryResult> ProcessQuery(
+      const std::vector<std::string>& query,
+      QueryTiming* timing = nullptr, bool* truncated = nullptr) const;
+
+  // Answers a batch of queries at once, returning ProcessQuery(queries[i])
+  // as element i.  The batch's distinct terms are each looked up once per
+  // index file rather than once per query that uses them, and the work is
+  // spread over up to "num_threads" threads: the lookups in different
+  // index files proceed in parallel, as do the queries themselves.
+  //
+  // If "truncated" isn't null, element i is set to whether ProcessQuery()
+  // would report queries[i] as truncated.
+  std::vector<std::vector<QueryResult>> ProcessQueries(
+      const std::vector<std::vector<std::string>>& queries,
+      int num_threads, std::vector<bool>* truncated = nullptr) const;
+
+  // Returns the number of index files being searched.
+  size_t num_segments() const { return segments_.size(); }
+
+ private:
+  // The live documents holding a term: (docID, rank) pairs in ascending
+  // order of docID.
+  typedef std::vector<std::pair<DocID_t, int>> Postings;
+
+  struct Segment {
+    Segment() : dtr(nullptr), itr(nullptr), dict(nullptr), file(nullptr) { }
+    ~Segment();
+
+    std::string            file_name;
+    hw3::DocTableReader*   dtr;
+    hw3::IndexTableReader* itr;
+    DeletionBitmap         deleted;
+
+    // The segment's term dictionary, or nullptr if it has none, plus an
+    // open handle on the index for reading the docID tables it points at.
+    TermDictionary*        dict;
+    FILE*                  file;
+  };
+
+  // Returns the docID table for "word" in "segment", or nullptr if the
+  // word isn't there.  Uses the term dictionary if the segment has one.
+  hw3::DocIDTableReader* LookupWord(const Segment* segment,
+                                    const std::string& word) const;
+
+  // Sets "matches" to the postings of every document in "segment" that
+  // holds a word starting with "prefix", ranked by the positions of all
+  // those words together.
+  //
+  // Returns false if more than kMaxPrefixTerms words start with "prefix",
+  // in which case only the first kMaxPrefixTerms were matched.
+  bool MatchPrefix(const Segment* segment, const std::string& prefix,
+                   Postings* matches) const;
+
+  // Returns the postings of "term", which may be a prefix term, in
+  // "segment", setting "*truncated" if MatchPrefix() truncated them.
+  Postings ReadPostings(const Segment* segment, const std::string& term,
+                        bool* truncated) const;
+
+  // Returns a reader for the docID table at "offset" in "segment", which
+  // must have a term dictionary.
+  hw3::DocIDTableReader* OpenPostings(const Segment* segment,
+                                      hw3::IndexFileOffset_t offset) const;
+
+  // Returns the postings of the live documents in "ditr", ranked by their
+  // number of positions.
+  Postings LivePostings(const Segment* segment,
+                        hw3::DocIDTableReader* ditr) const;
+
+  // Keeps the documents of "ranks" that are in "other" too, adding their
+  // ranks in "other" to their own.
+  static void Intersect(const Postings& other, Postings* ranks);
+
+  // Opens the index file "file_name", with deletions from "bitmap_name"
+  // (if not empty).
+  //
+  // Returns false if the file is missing or corrupt.
+  bool AddSegment(const std::string& file_name,
+                  const std::string& bitmap_name);
+
+  // Opens every segment of the set in "dir".
+  //
+  // Returns false if the segments named by one manifest couldn't all be
+  // opened.
+  bool AddSegmentSet(const std::string& dir);
+
+  // Closes segments_[first] onwards.
+  void RemoveSegments(size_t first);
+
+  std::list<std::string> index_list_;
+  bool validate_;
+  std::vector<Segment*> segments_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentQueryProcessor);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_SEGMENTQUERYPROCESSOR_H_
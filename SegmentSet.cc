@@ -0,0 +1,385 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "./IndexBuilder.h"
+#include "./IndexMerger.h"
+#include "./IndexScanner.h"
+#include "./IndexWriter.h"
+#include "./SegmentSet.h"
+#include "./TermDictionary.h"
+
+using std::list;
+using std::set;
+using std::string;
+using std::stringstream;
+using std::to_string;
+using std::vector;
+
+namespace hw4 {
+
+// static
+const char* SegmentSet::kManifestName = "MANIFEST";
+
+static const char* kSegmentPrefix = "seg_";
+static const char* kSegmentSuffix = ".idx";
+
+///////////////////////////////////////////////////////////////////////////////
+// DeletionBitmap
+///////////////////////////////////////////////////////////////////////////////
+void DeletionBitmap::Delete(DocID_t doc_id) {
+  if (doc_id / 8 >= bits_.size()) {
+    bits_.resize(doc_id / 8 + 1, 0);
+  }
+  if ((bits_[doc_id / 8] & (1 << (doc_id % 8))) == 0) {
+    bits_[doc_id / 8] |= 1 << (doc_id % 8);
+    num_deleted_++;
+  }
+}
+
+bool DeletionBitmap::Load(const string& file_name) {
+  bits_.clear();
+  num_deleted_ = 0;
+  std::ifstream in(file_name, std::ios::binary);
+  if (!in) {
+    return errno == ENOENT;
+  }
+  bits_.assign(std::istreambuf_iterator<char>(in),
+               std::istreambuf_iterator<char>());
+  for (uint8_t byte : bits_) {
+    num_deleted_ += __builtin_popcount(byte);
+  }
+  return !in.bad();
+}
+
+bool DeletionBitmap::Save(const string& file_name) const {
+  return ReplaceFile(file_name, string(bits_.begin(), bits_.end()));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SegmentSet
+///////////////////////////////////////////////////////////////////////////////
+SegmentSet::SegmentSet(const string& dir, size_t merge_factor)
+  : dir_(dir), merge_factor_(merge_factor < 2 ? 2 : merge_factor),
+    next_segment_(1), merging_(false), merge_thread_running_(false),
+    terminate_merge_thread_(false), merge_wanted_(false) {
+  Verify333(pthread_mutex_init(&lock_, nullptr) == 0);
+  Verify333(pthread_cond_init(&cond_, nullptr) == 0);
+}
+
+SegmentSet::~SegmentSet() {
+  if (merge_thread_running_) {
+    Verify333(pthread_mutex_lock(&lock_) == 0);
+    terminate_merge_thread_ = true;
+    Verify333(pthread_cond_broadcast(&cond_) == 0);
+    Verify333(pthread_mutex_unlock(&lock_) == 0);
+    Verify333(pthread_join(merge_thread_, nullptr) == 0);
+  }
+  Verify333(pthread_cond_destroy(&cond_) == 0);
+  Verify333(pthread_mutex_destroy(&lock_) == 0);
+}
+
+bool SegmentSet::Open() {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  bool ok = true;
+  if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+    ok = false;
+  } else if (!ReadManifest(dir_, &segments_)) {
+    // A brand new set.
+    segments_.clear();
+    ok = WriteManifestLocked();
+  }
+
+  for (size_t i = 0; ok && i < segments_.size(); i++) {
+    const string& name = segments_[i].name;
+    uint64_t number = strtoull(name.c_str() + strlen(kSegmentPrefix),
+                               nullptr, 10);
+    if (number >= next_segment_) {
+      next_segment_ = number + 1;
+    }
+    ok = deleted_[name].Load(PathOf(BitmapName(name)))
+      && LoadDocNames(name);
+  }
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return ok;
+}
+
+bool SegmentSet::AddDocuments(const vector<string>& file_names) {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+
+  // Index the new versions first; nothing changes until that works.
+  string name = kSegmentPrefix + to_string(next_segment_++) + kSegmentSuffix;
+  IndexBuilder builder(PathOf(name));
+  vector<DocID_t> doc_ids;
+  for (const string& file_name : file_names) {
+    doc_ids.push_back(builder.AddFile(file_name));
+  }
+  bool ok = builder.num_docs() == 0 || builder.Finish() >= 0;
+
+  // List the new segment before deleting the old versions, so a crash in
+  // between leaves a document indexed twice rather than not at all.
+  if (ok && builder.num_docs() > 0) {
+    segments_.push_back({name, builder.num_docs()});
+    ok = WriteManifestLocked();
+  }
+
+  set<string> dirty;
+  for (size_t i = 0; ok && i < file_names.size(); i++) {
+    DeleteLocked(file_names[i], &dirty);
+    if (doc_ids[i] != INVALID_DOCID) {
+      docs_[file_names[i]] = {name, doc_ids[i]};
+    }
+  }
+  for (const string& segment : dirty) {
+    ok = ok && deleted_[segment].Save(PathOf(BitmapName(segment)));
+  }
+
+  merge_wanted_ = true;
+  Verify333(pthread_cond_signal(&cond_) == 0);
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return ok;
+}
+
+bool SegmentSet::RemoveDocuments(const vector<string>& file_names) {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  set<string> dirty;
+  for (const string& file_name : file_names) {
+    DeleteLocked(file_name, &dirty);
+  }
+  bool ok = true;
+  for (const string& segment : dirty) {
+    ok = deleted_[segment].Save(PathOf(BitmapName(segment))) && ok;
+  }
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return ok;
+}
+
+bool SegmentSet::MaybeMerge() {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  if (merging_) {
+    Verify333(pthread_mutex_unlock(&lock_) == 0);
+    return false;
+  }
+
+  // Bucket the segments into tiers by their number of live documents.
+  std::map<size_t, vector<size_t>> tiers;
+  vector<size_t>* victims = nullptr;
+  for (size_t i = 0; i < segments_.size() && victims == nullptr; i++) {
+    size_t live = segments_[i].num_docs
+      - deleted_[segments_[i].name].num_deleted();
+    size_t tier = 0;
+    for (; live >= merge_factor_; live /= merge_factor_) {
+      tier++;
+    }
+    tiers[tier].push_back(i);
+    if (tiers[tier].size() == merge_factor_) {
+      victims = &tiers[tier];
+    }
+  }
+  if (victims == nullptr) {
+    Verify333(pthread_mutex_unlock(&lock_) == 0);
+    return false;
+  }
+
+  // Take what the merge needs, copying the bitmaps, so that adds and
+  // removals can carry on while it runs without the lock.
+  set<string> merged;
+  list<string> inputs;
+  vector<DeletionBitmap> bitmaps;
+  size_t live = 0;
+  for (size_t i : *victims) {
+    merged.insert(segments_[i].name);
+    inputs.push_back(PathOf(segments_[i].name));
+    bitmaps.push_back(deleted_[segments_[i].name]);
+    live += segments_[i].num_docs - bitmaps.back().num_deleted();
+  }
+  string name = kSegmentPrefix + to_string(next_segment_++) + kSegmentSuffix;
+  merging_ = true;
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+
+  // Merge the tier into one segment, leaving out the deleted documents,
+  // and list the documents that it ended up with.
+  MergeOptions options;
+  options.skip_document = [&bitmaps](size_t input, DocID_t doc_id) {
+    return bitmaps[input].IsDeleted(doc_id);
+  };
+  bool ok = live == 0 || MergeIndices(inputs, PathOf(name), options) >= 0;
+  vector<DocLocation> merged_docs;
+  vector<string> merged_names;
+  if (ok && live > 0) {
+    IndexFileScanner scanner(PathOf(name));
+    ok = scanner.Open(false) && scanner.ForEachDocument(
+      [&name, &merged_docs, &merged_names](DocID_t doc_id,
+                                           const string& doc_name) {
+        merged_docs.push_back({name, doc_id});
+        merged_names.push_back(doc_name);
+        return true;
+      });
+  }
+
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  merging_ = false;
+
+  // A document removed or replaced during the merge is still in the
+  // merged segment, so delete it there; the rest move over to it.
+  DeletionBitmap deleted;
+  for (size_t i = 0; ok && i < merged_docs.size(); i++) {
+    auto it = docs_.find(merged_names[i]);
+    if (it == docs_.end() || merged.count(it->second.segment) == 0) {
+      deleted.Delete(merged_docs[i].doc_id);
+    }
+  }
+  if (ok && deleted.num_deleted() > 0) {
+    ok = deleted.Save(PathOf(BitmapName(name)));
+  }
+
+  // Swap the merged segment in for its inputs.
+  if (ok) {
+    vector<SegmentInfo> remaining;
+    for (const SegmentInfo& segment : segments_) {
+      if (merged.count(segment.name) == 0) {
+        remaining.push_back(segment);
+      }
+    }
+    if (live > 0) {
+      remaining.push_back({name, merged_docs.size()});
+    }
+    segments_.swap(remaining);
+    ok = WriteManifestLocked();
+    if (!ok) {
+      segments_.swap(remaining);
+    }
+  }
+  if (ok) {
+    for (size_t i = 0; i < merged_docs.size(); i++) {
+      if (!deleted.IsDeleted(merged_docs[i].doc_id)) {
+        docs_[merged_names[i]] = merged_docs[i];
+      }
+    }
+    if (live > 0) {
+      deleted_[name] = deleted;
+    }
+    for (const string& segment : merged) {
+      unlink(PathOf(segment).c_str());
+      unlink(PathOf(BitmapName(segment)).c_str());
+      unlink(TermDictionary::DictionaryName(PathOf(segment)).c_str());
+      deleted_.erase(segment);
+    }
+  } else {
+    unlink(PathOf(name).c_str());
+    unlink(PathOf(BitmapName(name)).c_str());
+    unlink(TermDictionary::DictionaryName(PathOf(name)).c_str());
+  }
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return ok;
+}
+
+void SegmentSet::StartBackgroundMerging() {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  if (!merge_thread_running_) {
+    Verify333(pthread_create(&merge_thread_, nullptr, &MergeLoop,
+                             static_cast<void*>(this)) == 0);
+    merge_thread_running_ = true;
+    merge_wanted_ = true;
+  }
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+}
+
+vector<SegmentInfo> SegmentSet::segments() {
+  Verify333(pthread_mutex_lock(&lock_) == 0);
+  vector<SegmentInfo> copy = segments_;
+  Verify333(pthread_mutex_unlock(&lock_) == 0);
+  return copy;
+}
+
+// static
+bool SegmentSet::ReadManifest(const string& dir,
+                              vector<SegmentInfo>* segments) {
+  std::ifstream in(dir + "/" + kManifestName);
+  if (!in) {
+    return false;
+  }
+  segments->clear();
+  string line;
+  while (std::getline(in, line)) {
+    stringstream ss(line);
+    SegmentInfo segment;
+    if (ss >> segment.name >> segment.num_docs) {
+      segments->push_back(segment);
+    }
+  }
+  return !in.bad();
+}
+
+// static
+string SegmentSet::BitmapName(const string& segment_name) {
+  return segment_name.substr(0, segment_name.size() - strlen(kSegmentSuffix))
+    + ".del";
+}
+
+bool SegmentSet::LoadDocNames(const string& segment_name) {
+  IndexFileScanner scanner(PathOf(segment_name));
+  const DeletionBitmap& deleted = deleted_[segment_name];
+  return scanner.Open(false) && scanner.ForEachDocument(
+    [this, &segment_name, &deleted](DocID_t doc_id, const string& doc_name) {
+      if (!deleted.IsDeleted(doc_id)) {
+        docs_[doc_name] = {segment_name, doc_id};
+      }
+      return true;
+    });
+}
+
+void SegmentSet::DeleteLocked(const string& file_name, set<string>* dirty) {
+  auto it = docs_.find(file_name);
+  if (it != docs_.end()) {
+    deleted_[it->second.segment].Delete(it->second.doc_id);
+    dirty->insert(it->second.segment);
+    docs_.erase(it);
+  }
+}
+
+bool SegmentSet::WriteManifestLocked() {
+  stringstream ss;
+  for (const SegmentInfo& segment : segments_) {
+    ss << segment.name << " " << segment.num_docs << "\n";
+  }
+  return ReplaceFile(PathOf(kManifestName), ss.str());
+}
+
+// static
+void* SegmentSet::MergeLoop(void* set) {
+  SegmentSet* self = static_cast<SegmentSet*>(set);
+  Verify333(pthread_mutex_lock(&self->lock_) == 0);
+  while (!self->terminate_merge_thread_) {
+    if (!self->merge_wanted_) {
+      Verify333(pthread_cond_wait(&self->cond_, &self->lock_) == 0);
+      continue;
+    }
+    self->merge_wanted_ = false;
+
+    // Keep merging until no tier is full, one merge at a time.
+    Verify333(pthread_mutex_unlock(&self->lock_) == 0);
+    while (self->MaybeMerge()) { }
+    Verify333(pthread_mutex_lock(&self->lock_) == 0);
+  }
+  Verify333(pthread_mutex_unlock(&self->lock_) == 0);
+  return nullptr;
+}
+
+}  // namespace hw4
@@ -0,0 +1,188 @@
+#ifndef HW4_SEGMENTSET_H_
+#define HW4_SEGMENTSET_H_
+
+extern "C" {
+#include <pthread.h>  // for the pthread threading/mutex functions
+}
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+  #include "libhw2/DocTable.h"
+}
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// A DeletionBitmap records which docIDs of one segment have been deleted.
+// Segments hand out docIDs sequentially from 1, so one bit per document
+// is enough.
+class DeletionBitmap {
+ public:
+  DeletionBitmap() : num_deleted_(0) { }
+  virtual ~DeletionBitmap() { }
+
+  // Returns true if "doc_id" has been deleted.
+  bool IsDeleted(DocID_t doc_id) const {
+    return doc_id / 8 < bits_.size()
+      && (bits_[doc_id / 8] & (1 << (doc_id % 8))) != 0;
+  }
+
+  // Marks "doc_id" as deleted.
+  void Delete(DocID_t doc_id);
+
+  // Returns the number of deleted documents.
+  size_t num_deleted() const { return num_deleted_; }
+
+  // Reads the bitmap from "file_name".  A missing file is an empty bitmap.
+  //
+  // Returns false if the file exists but can't be read.
+  bool Load(const std::string& file_name);
+
+  // Atomically replaces "file_name" with the bitmap.
+  //
+  // Returns false on error.
+  bool Save(const std::string& file_name) const;
+
+ private:
+  std::vector<uint8_t> bits_;
+  size_t num_deleted_;
+};
+
+// One segment of a SegmentSet, as listed in its manifest.
+struct SegmentInfo {
+  std::string name;      // the segment's index file, relative to the set.
+  size_t      num_docs;  // documents in the segment, deleted or not.
+};
+
+// A SegmentSet is a directory of small index files ("segments") that
+// together form one logical index, so that the corpus can change without
+// rebuilding everything:
+//
+//  - new and changed documents are indexed into a new segment;
+//  - removed (and the old versions of changed) documents are marked in
+//    their segment's deletion bitmap, which queries consult;
+//  - a tiered merge policy compacts segments of similar size, dropping
+//    deleted documents as it goes.
+//
+// The directory holds a MANIFEST listing the live segments, the segments'
+// ".idx" files, and a ".del" bitmap beside each segment with deletions.
+// The manifest and the bitmaps are replaced atomically, and a segment is
+// never modified once written, so readers (see SegmentQueryProcessor) can
+// use the directory at any time.
+//
+// SegmentSet methods may be called from several threads.
+class SegmentSet {
+ public:
+  // The name of the manifest within the set's directory.
+  static const char* kManifestName;
+
+  // Arguments:
+  // - dir: the directory holding the set.
+  // - merge_factor: how many segments of one tier trigger a merge; a
+  //   segment's tier is floor(log_merge_factor(live documents)).
+  explicit SegmentSet(const std::string& dir, size_t merge_factor = 4);
+
+  // Stops the background merge thread, if it was started.
+  virtual ~SegmentSet();
+
+  // Loads the manifest (creating an empty set if there is none) and the
+  // name of every live document.
+  //
+  // Returns false if the directory or a segment can't be read.
+  bool Open();
+
+  // Indexes "file_names" into a new segment.  A file that is already in
+  // the set is treated as changed: its old version is deleted.
+  //
+  // Returns false on error.
+  bool AddDocuments(const std::vector<std::string>& file_names);
+
+  // Deletes "file_names" from the set.  Names that aren't in the set are
+  // ignored.
+  //
+  // Returns false if a deletion bitmap couldn't be saved.
+  bool RemoveDocuments(const std::vector<std::string>& file_names);
+
+  // Merges one tier, if any tier has reached "merge_factor" segments.
+  // The merge runs without holding up AddDocuments() and
+  // RemoveDocuments(); documents they delete from the tier meanwhile are
+  // deleted from the merged segment too.  Only one merge runs at a time.
+  //
+  // Returns true if a merge was done, false otherwise (or on error, or if
+  // another merge is under way).
+  bool MaybeMerge();
+
+  // Starts a thread that runs MaybeMerge() whenever a new segment is
+  // added, until the SegmentSet is destroyed.
+  void StartBackgroundMerging();
+
+  // Returns a copy of the manifest.
+  std::vector<SegmentInfo> segments();
+
+  // Reads the manifest of the set in "dir" into "segments".
+  //
+  // Returns false if there is no readable manifest.
+  static bool ReadManifest(const std::string& dir,
+                           std::vector<SegmentInfo>* segments);
+
+  // Returns the deletion bitmap file for segment "segment_name".
+  static std::string BitmapName(const std::string& segment_name);
+
+ private:
+  // Where a live document is.
+  struct DocLocation {
+    std::string segment;
+    DocID_t     doc_id;
+  };
+
+  // Records every document of segment "segment_name" in docs_.
+  bool LoadDocNames(const std::string& segment_name);
+
+  // Marks "file_name" deleted in its segment, if it is in the set, and
+  // adds that segment to "dirty".  Must hold lock_.
+  void DeleteLocked(const std::string& file_name,
+                    std::set<std::string>* dirty);
+
+  // Atomically rewrites the manifest from segments_.  Must hold lock_.
+  bool WriteManifestLocked();
+
+  // Returns the full path of "name" within dir_.
+  std::string PathOf(const std::string& name) const {
+    return dir_ + "/" + name;
+  }
+
+  // The background merge thread's start routine.
+  static void* MergeLoop(void* set);
+
+  std::string dir_;
+  size_t merge_factor_;
+
+  // Guards everything below.
+  pthread_mutex_t lock_;
+  pthread_cond_t  cond_;
+
+  std::vector<SegmentInfo> segments_;
+  std::unordered_map<std::string, DeletionBitmap> deleted_;
+  std::unordered_map<std::string, DocLocation> docs_;
+  uint64_t next_segment_;
+  bool merging_;  // whether a MaybeMerge() is under way.
+
+  bool merge_thread_running_;
+  bool terminate_merge_thread_;
+  bool merge_wanted_;
+  pthread_t merge_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentSet);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_SEGMENTSET_H_
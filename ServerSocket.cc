@@ -5,6 +5,7 @@
 #include <sys/types.h>   // for socket(), getaddrinfo(), etc.
 #include <sys/socket.h>  // for socket(), getaddrinfo(), etc.
 #include <arpa/inet.h>   // for inet_ntop()
+#include <netinet/tcp.h> // for TCP_NODELAY
 #include <netdb.h>       // for getaddrinfo()
 #include <errno.h>       // for errno, used by strerror()
 #include <string.h>      // for memset, strerror()
@@ -172,6 +173,12 @@ bool ServerSocket::Accept(int* const accepted_fd,
     break;
   }
 
+  // Responses go out in several writes (the headers, then the body a
+  // chunk at a time), so don't let Nagle's algorithm hold each one back
+  // until the client acknowledges the last.
+  int one = 1;
+  setsockopt(*accepted_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
   char hname[1024];
 
   // Get client IP address and port
@@ -0,0 +1,181 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./IndexScanner.h"
+#include "./SegmentSet.h"
+#include "./Suggester.h"
+#include "./TermDictionary.h"
+
+using std::list;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// static
+const size_t Suggester::kTopK = 10;
+
+void Suggester::AddWord(const string& word, int64_t num_docs) {
+  pending_[word] += num_docs;
+}
+
+bool Suggester::AddIndices(const list<string>& indices) {
+  for (const string& index : indices) {
+    struct stat sb;
+    if (stat(index.c_str(), &sb) != 0) {
+      return false;
+    }
+    if (!S_ISDIR(sb.st_mode)) {
+      if (!AddIndexFile(index)) {
+        return false;
+      }
+      continue;
+    }
+    vector<SegmentInfo> segments;
+    if (!SegmentSet::ReadManifest(index, &segments)) {
+      return false;
+    }
+    for (const SegmentInfo& segment : segments) {
+      if (!AddIndexFile(index + "/" + segment.name)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void Suggester::Build() {
+  vector<pair<string, int64_t>> words(pending_.begin(), pending_.end());
+  pending_.clear();
+  std::sort(words.begin(), words.end());
+  words_.clear();
+  num_docs_.clear();
+  for (auto& word : words) {
+    if (!word.first.empty()) {
+      words_.push_back(std::move(word.first));
+      num_docs_.push_back(word.second);
+    }
+  }
+
+  // Lay the trie out in preorder.  The words are sorted, so each one only
+  // adds nodes below the part it shares with its predecessor, and always
+  // as the last child of its parent.
+  nodes_.assign(1, Node{0, 0, 0, 0, '\0'});
+  vector<int32_t> node_word(1, -1);
+  vector<uint32_t> last_child(1, 0);
+  vector<uint32_t> path{0};
+  for (size_t w = 0; w < words_.size(); w++) {
+    const string& word = words_[w];
+    size_t shared = 0;
+    if (w > 0) {
+      const string& prev = words_[w - 1];
+      while (shared < prev.size() && shared < word.size()
+             && prev[shared] == word[shared]) {
+        shared++;
+      }
+    }
+    path.resize(shared + 1);
+    for (size_t d = shared; d < word.size(); d++) {
+      uint32_t parent = path[d];
+      uint32_t node = nodes_.size();
+      nodes_.push_back(Node{0, 0, 0, 0, word[d]});
+      node_word.push_back(-1);
+      last_child.push_back(0);
+      if (last_child[parent] == 0) {
+        nodes_[parent].first_child = node;
+      } else {
+        nodes_[last_child[parent]].next_sibling = node;
+      }
+      last_child[parent] = node;
+      path.push_back(node);
+    }
+    node_word[path.back()] = w;
+  }
+
+  // Fill in the top-k lists bottom up: children come after their parents,
+  // so walking backwards finishes every child before its parent, and a
+  // node's list is the best of its own word and its children's lists.
+  auto more_frequent = [this](uint32_t a, uint32_t b) {
+    return num_docs_[a] != num_docs_[b] ? num_docs_[a] > num_docs_[b]
+                                        : a < b;
+  };
+  top_.clear();
+  vector<uint32_t> candidates;
+  for (size_t n = nodes_.size(); n-- > 0; ) {
+    candidates.clear();
+    if (node_word[n] >= 0) {
+      candidates.push_back(node_word[n]);
+    }
+    for (uint32_t c = nodes_[n].first_child; c != 0;
+         c = nodes_[c].next_sibling) {
+      candidates.insert(candidates.end(),
+                        top_.begin() + nodes_[c].top_begin,
+                        top_.begin() + nodes_[c].top_begin
+                          + nodes_[c].top_len);
+    }
+    size_t keep = std::min(candidates.size(), kTopK);
+    std::partial_sort(candidates.begin(), candidates.begin() + keep,
+                      candidates.end(), more_frequent);
+    nodes_[n].top_begin = top_.size();
+    nodes_[n].top_len = keep;
+    top_.insert(top_.end(), candidates.begin(), candidates.begin() + keep);
+  }
+}
+
+vector<string> Suggester::Suggest(const string& prefix,
+                                  size_t max_results) const {
+  vector<string> results;
+  if (nodes_.empty()) {
+    return results;
+  }
+  uint32_t node = 0;
+  for (char c : prefix) {
+    uint32_t child = nodes_[node].first_child;
+    while (child != 0 && nodes_[child].label != c) {
+      child = nodes_[child].next_sibling;
+    }
+    if (child == 0) {
+      return results;
+    }
+    node = child;
+  }
+
+  size_t count = std::min(max_results,
+                          static_cast<size_t>(nodes_[node].top_len));
+  for (size_t i = 0; i < count; i++) {
+    results.push_back(words_[top_[nodes_[node].top_begin + i]]);
+  }
+  return results;
+}
+
+bool Suggester::AddIndexFile(const string& file_name) {
+  IndexFileScanner scanner(file_name);
+  if (!scanner.Open(false)) {
+    return false;
+  }
+
+  TermDictionary dict(file_name);
+  if (dict.Open(scanner.header().checksum, false)) {
+    dict.ForEachTerm([this](const TermInfo& term) {
+        AddWord(term.word, term.num_docs);
+        return true;
+      });
+    return true;
+  }
+  return scanner.ForEachWord(
+    [this](const string& word, const vector<DocPostings>& docs) {
+      AddWord(word, docs.size());
+      return true;
+    });
+}
+
+}  // namespace hw4
@@ -0,0 +1,81 @@
+#ifndef HW4_SUGGESTER_H_
+#define HW4_SUGGESTER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// A Suggester completes search-box prefixes with the indexed vocabulary,
+// most common words first.  It holds every word in an in-memory trie in
+// which each node carries a precomputed list of the kTopK words below it
+// with the highest document frequency, so answering a prefix is a walk
+// down the trie plus a copy of one short list: no disk access and no
+// enumeration of the subtree.
+//
+// Customers AddWord() (or AddIndices()) the vocabulary, call Build() once,
+// and may then call Suggest() from any number of threads.
+class Suggester {
+ public:
+  // The most completions kept, and returned, per prefix.
+  static const size_t kTopK;
+
+  Suggester() { }
+  virtual ~Suggester() { }
+
+  // Adds "num_docs" to the document frequency of "word".
+  void AddWord(const std::string& word, int64_t num_docs);
+
+  // Adds the vocabulary of each of "indices", which are index files or
+  // segment set directories.  Words are read from an index's term
+  // dictionary when it has one, and from the index itself otherwise.
+  // Document frequencies don't discount deleted documents.
+  //
+  // Returns false if an index couldn't be read.
+  bool AddIndices(const std::list<std::string>& indices);
+
+  // Builds the trie from the words added so far.
+  void Build();
+
+  // Returns up to "max_results" (at most kTopK) words starting with
+  // "prefix", by descending document frequency and then alphabetically.
+  std::vector<std::string> Suggest(const std::string& prefix,
+                                   size_t max_results) const;
+
+  // Returns the number of words in the trie.
+  size_t num_words() const { return words_.size(); }
+
+ private:
+  // Adds the vocabulary of one index file.
+  bool AddIndexFile(const std::string& file_name);
+
+  // A trie node.  Nodes are stored in preorder, so every node's children
+  // come after it, and siblings are in ascending order of label.
+  struct Node {
+    uint32_t first_child;   // 0 if none; the root is never a child.
+    uint32_t next_sibling;  // 0 if none.
+    uint32_t top_begin;     // this node's slice of top_.
+    uint8_t  top_len;
+    char     label;
+  };
+
+  std::unordered_map<std::string, int64_t> pending_;
+
+  std::vector<std::string> words_;  // sorted.
+  std::vector<int64_t> num_docs_;   // parallel to words_.
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> top_;       // indices into words_.
+
+  DISALLOW_COPY_AND_ASSIGN(Suggester);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_SUGGESTER_H_
@@ -0,0 +1,166 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "./HttpUtils.h"
+#include "./IndexWriter.h"
+#include "./SyntheticCorpus.h"
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// The fewest letters in a word, so that words look like words to the
+// parser and the query processor.
+static const int kMinWordLength = 3;
+
+// How many documents go in each of the corpus's directories.
+static const int kDocsPerDirectory = 1000;
+
+// Returns the directory document "doc" of a corpus in "doc_dir" is in.
+static string DirectoryFor(const string& doc_dir, int doc);
+
+SyntheticCorpus::SyntheticCorpus(const CorpusOptions& options)
+  : options_(options), cdf_(options.vocabulary_size) {
+  double total = 0;
+  for (int i = 0; i < options_.vocabulary_size; i++) {
+    total += 1.0 / pow(i + 1, options_.zipf_exponent);
+    cdf_[i] = total;
+  }
+  for (double& p : cdf_) {
+    p /= total;
+  }
+}
+
+// static
+string SyntheticCorpus::Word(int rank) {
+  // The rank in base 26, with 'a' to 'z' for digits, padded with 'a's.
+  string word;
+  for (int n = rank;
+       n > 0 || static_cast<int>(word.size()) < kMinWordLength; n /= 26) {
+    word.push_back('a' + n % 26);
+  }
+  std::reverse(word.begin(), word.end());
+  return word;
+}
+
+// static
+int SyntheticCorpus::MaxPositionsPerDoc(int vocabulary_size) {
+  // Each word takes up at most its length plus a space.
+  uint64_t word_bytes = Word(std::max(vocabulary_size - 1, 0)).size() + 1;
+  return std::min<uint64_t>(UINT32_MAX / word_bytes, INT32_MAX);
+}
+
+string SyntheticCorpus::DocName(int doc) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/%08d.txt", doc);
+  return DirectoryFor(options_.doc_dir, doc) + name;
+}
+
+vector<int> SyntheticCorpus::DocumentWords(int doc) const {
+  std::seed_seq seed{options_.seed, static_cast<uint32_t>(doc)};
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  vector<int> words(options_.positions_per_doc);
+  for (int& word : words) {
+    auto it = std::upper_bound(cdf_.begin(), cdf_.end(), uniform(rng));
+    word = std::min<int>(it - cdf_.begin(), cdf_.size() - 1);
+  }
+  return words;
+}
+
+string SyntheticCorpus::DocumentText(int doc) const {
+  string text;
+  for (int word : DocumentWords(doc)) {
+    if (!text.empty()) {
+      text.push_back(' ');
+    }
+    text.append(Word(word));
+  }
+  text.push_back('\n');
+  return text;
+}
+
+int SyntheticCorpus::WriteIndex(int first_doc, int num_docs,
+                                const string& file_name) const {
+  DocTable* dt = DocTable_Allocate();
+  MemIndex* mi = MemIndex_Allocate();
+  for (int doc = first_doc; doc < first_doc + num_docs; doc++) {
+    string doc_name = DocName(doc);
+    DocID_t doc_id = DocTable_Add(dt, const_cast<char*>(doc_name.c_str()));
+
+    // Gather each word's positions (the byte offsets DocumentText() puts
+    // it at), then hand them to the MemIndex, which takes ownership.
+    map<int, LinkedList*> postings;
+    DocPositionOffset_t offset = 0;
+    for (int word : DocumentWords(doc)) {
+      LinkedList*& positions = postings[word];
+      if (positions == nullptr) {
+        positions = LinkedList_Allocate();
+      }
+      LinkedList_Append(positions, reinterpret_cast<LLPayload_t>(
+          static_cast<uint64_t>(offset)));
+      offset += Word(word).size() + 1;
+    }
+    for (const auto& word : postings) {
+      MemIndex_AddPostingList(mi, strdup(Word(word.first).c_str()), doc_id,
+                              word.second);
+    }
+  }
+
+  int size = hw4::WriteIndex(mi, dt, file_name.c_str());
+  MemIndex_Free(mi);
+  DocTable_Free(dt);
+  return size;
+}
+
+bool SyntheticCorpus::WriteCorpus() const {
+  if (mkdir(options_.doc_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+    return false;
+  }
+  for (int doc = 0; doc < options_.num_docs; doc++) {
+    if (doc % kDocsPerDirectory == 0) {
+      string dir = DirectoryFor(options_.doc_dir, doc);
+      if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+      }
+    }
+    int fd = open(DocName(doc).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+      return false;
+    }
+    string text = DocumentText(doc);
+    int written = WrappedWrite(fd, reinterpret_cast<const unsigned char*>(
+        text.data()), text.size());
+    close(fd);
+    if (written != static_cast<int>(text.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static string DirectoryFor(const string& doc_dir, int doc) {
+  char dir[16];
+  snprintf(dir, sizeof(dir), "/%05d", doc / kDocsPerDirectory);
+  return doc_dir + dir;
+}
+
+}  // namespace hw4
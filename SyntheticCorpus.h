@@ -0,0 +1,97 @@
+#ifndef HW4_SYNTHETICCORPUS_H_
+#define HW4_SYNTHETICCORPUS_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// What a SyntheticCorpus should look like.
+struct CorpusOptions {
+  // How many documents, and how many distinct words they draw from.
+  int num_docs = 1000;
+  int vocabulary_size = 10000;
+
+  // How many words each document has.  Must be at most
+  // SyntheticCorpus::MaxPositionsPerDoc().
+  int positions_per_doc = 100;
+
+  // The word of rank r (counting from 1) turns up in proportion to
+  // 1 / r^zipf_exponent; 1.0 is close to natural language.
+  double zipf_exponent = 1.0;
+
+  // Two corpora with the same options and seed are identical.
+  uint32_t seed = 333;
+
+  // The directory the documents are named as being in (and that
+  // WriteCorpus() writes them to).
+  std::string doc_dir = "synthetic";
+};
+
+// A SyntheticCorpus is a made-up collection of documents, for measuring
+// the index readers and the server at scale: each document is a string of
+// words picked at random, with Zipf-distributed frequencies, from a
+// vocabulary of all-lowercase words.  Documents are generated on demand
+// rather than stored, each from its own seed, so a corpus of any size
+// costs nothing to hold, and any part of it can be generated on its own.
+//
+// WriteIndex() indexes a range of the documents through the same path as
+// a crawled corpus (a MemIndex and DocTable, written by WriteIndex() in
+// IndexWriter.h), and WriteCorpus() writes the documents themselves out as
+// text files that crawl to the same index.
+class SyntheticCorpus {
+ public:
+  explicit SyntheticCorpus(const CorpusOptions& options);
+  virtual ~SyntheticCorpus() { }
+
+  const CorpusOptions& options() const { return options_; }
+
+  // Returns the word of rank "rank" (0 is the most frequent).  Words are
+  // at least three letters long, and more frequent words are shorter.
+  static std::string Word(int rank);
+
+  // Returns the largest positions_per_doc for which the byte offsets of a
+  // document's words still fit in a DocPositionOffset_t.
+  static int MaxPositionsPerDoc(int vocabulary_size);
+
+  // Returns the name of document "doc" (counting from 0), a path under
+  // doc_dir.
+  std::string DocName(int doc) const;
+
+  // Returns the ranks of the words of document "doc", in order.
+  std::vector<int> DocumentWords(int doc) const;
+
+  // Returns the text of document "doc": its words, separated by spaces.
+  std::string DocumentText(int doc) const;
+
+  // Indexes documents "first_doc" through "first_doc + num_docs - 1" into
+  // the index file "file_name".  The whole range is held in memory (as a
+  // MemIndex) while it's written, and an index file can't grow past 2 GiB,
+  // so a big corpus should be split across several indices.
+  //
+  // Returns the size of the index file in bytes, or -1 on error.
+  int WriteIndex(int first_doc, int num_docs,
+                 const std::string& file_name) const;
+
+  // Writes every document to its DocName(), creating the directories
+  // needed.
+  //
+  // Returns false if a file couldn't be written.
+  bool WriteCorpus() const;
+
+ private:
+  CorpusOptions options_;
+
+  // The cumulative distribution of word ranks, for sampling.
+  std::vector<double> cdf_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyntheticCorpus);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_SYNTHETICCORPUS_H_
@@ -0,0 +1,268 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "./IndexWriter.h"
+#include "./TermDictionary.h"
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+///////////////////////////////////////////////////////////////////////////////
+// Constants, internal helper functions
+///////////////////////////////////////////////////////////////////////////////
+static const uint32_t kDictionaryMagic = 0xD1C7F00D;
+
+// The header is six u32 fields.
+static const size_t kHeaderBytes = 6 * sizeof(uint32_t);
+
+// Words per front-coded block.  A lookup scans at most one block.
+static const uint32_t kTermsPerBlock = 16;
+
+static void PutU16(string* out, uint16_t value) {
+  out->push_back(static_cast<char>(value >> 8));
+  out->push_back(static_cast<char>(value));
+}
+
+static void PutU32(string* out, uint32_t value) {
+  PutU16(out, value >> 16);
+  PutU16(out, value);
+}
+
+static uint16_t GetU16(const uint8_t* pos) {
+  return (static_cast<uint16_t>(pos[0]) << 8) | pos[1];
+}
+
+static uint32_t GetU32(const uint8_t* pos) {
+  return (static_cast<uint32_t>(GetU16(pos)) << 16) | GetU16(pos + 2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TermDictionaryWriter
+///////////////////////////////////////////////////////////////////////////////
+TermDictionaryWriter::TermDictionaryWriter(const string& index_file_name)
+  : file_name_(TermDictionary::DictionaryName(index_file_name)) { }
+
+void TermDictionaryWriter::Add(const string& word,
+                               hw3::IndexFileOffset_t postings_offset,
+                               int32_t num_docs) {
+  terms_.push_back({word, postings_offset, num_docs});
+}
+
+bool TermDictionaryWriter::Commit(uint32_t index_checksum) {
+  std::sort(terms_.begin(), terms_.end(),
+            [](const TermInfo& a, const TermInfo& b) {
+              return a.word < b.word;
+            });
+
+  string blocks, offsets;
+  const string* prev = nullptr;
+  for (size_t i = 0; i < terms_.size(); i++) {
+    const string& word = terms_[i].word;
+    if (word.size() > UINT16_MAX) {
+      return false;
+    }
+    size_t shared = 0;
+    if (i % kTermsPerBlock == 0) {
+      PutU32(&offsets, blocks.size());
+    } else {
+      while (shared < prev->size() && shared < word.size()
+             && (*prev)[shared] == word[shared]) {
+        shared++;
+      }
+    }
+    PutU16(&blocks, shared);
+    PutU16(&blocks, word.size() - shared);
+    blocks.append(word, shared, string::npos);
+    PutU32(&blocks, terms_[i].postings_offset);
+    PutU32(&blocks, terms_[i].num_docs);
+    prev = &word;
+  }
+
+  hw3::CRC32 crc;
+  for (const string* section : {&blocks, &offsets}) {
+    for (char c : *section) {
+      crc.FoldByteIntoCRC(static_cast<uint8_t>(c));
+    }
+  }
+  string contents;
+  PutU32(&contents, kDictionaryMagic);
+  PutU32(&contents, crc.GetFinalCRC());
+  PutU32(&contents, index_checksum);
+  PutU32(&contents, terms_.size());
+  PutU32(&contents, offsets.size() / sizeof(uint32_t));
+  PutU32(&contents, blocks.size());
+  return ReplaceFile(file_name_, contents + blocks + offsets);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TermDictionary
+///////////////////////////////////////////////////////////////////////////////
+TermDictionary::TermDictionary(const string& index_file_name)
+  : file_name_(DictionaryName(index_file_name)), map_(nullptr),
+    map_bytes_(0), blocks_(nullptr), offsets_(nullptr), num_terms_(0),
+    num_blocks_(0) { }
+
+TermDictionary::~TermDictionary() {
+  if (map_ != nullptr) {
+    munmap(const_cast<uint8_t*>(map_), map_bytes_);
+  }
+}
+
+bool TermDictionary::Open(uint32_t index_checksum, bool validate) {
+  int fd = open(file_name_.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || static_cast<size_t>(sb.st_size) < kHeaderBytes) {
+    close(fd);
+    return false;
+  }
+  void* map = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  map_ = static_cast<const uint8_t*>(map);
+  map_bytes_ = sb.st_size;
+
+  uint32_t checksum = GetU32(map_ + 4);
+  num_terms_ = GetU32(map_ + 12);
+  num_blocks_ = GetU32(map_ + 16);
+  uint32_t blocks_bytes = GetU32(map_ + 20);
+  blocks_ = map_ + kHeaderBytes;
+  offsets_ = blocks_ + blocks_bytes;
+  if (GetU32(map_) != kDictionaryMagic
+      || GetU32(map_ + 8) != index_checksum
+      || num_blocks_ != (num_terms_ + kTermsPerBlock - 1) / kTermsPerBlock
+      || map_bytes_ != kHeaderBytes + blocks_bytes
+                       + static_cast<size_t>(num_blocks_) * sizeof(uint32_t)) {
+    num_terms_ = num_blocks_ = 0;
+    return false;
+  }
+
+  // Verifying the checksum reads the whole dictionary, so it's done once
+  // per file rather than on every open.
+  if (validate && !IsChecksumVerified(sb)) {
+    hw3::CRC32 crc;
+    for (const uint8_t* pos = blocks_; pos < map_ + map_bytes_; pos++) {
+      crc.FoldByteIntoCRC(*pos);
+    }
+    if (crc.GetFinalCRC() != checksum) {
+      num_terms_ = num_blocks_ = 0;
+      return false;
+    }
+    MarkChecksumVerified(sb);
+  }
+  return true;
+}
+
+bool TermDictionary::Lookup(const string& word, TermInfo* info) const {
+  if (num_terms_ == 0) {
+    return false;
+  }
+  uint32_t block = FindBlock(word);
+  const uint8_t* pos = Block(block);
+  TermInfo term;
+  for (uint32_t i = 0; i < BlockTerms(block); i++) {
+    DecodeTerm(&pos, &term);
+    int cmp = term.word.compare(word);
+    if (cmp == 0) {
+      *info = term;
+      return true;
+    }
+    if (cmp > 0) {
+      break;
+    }
+  }
+  return false;
+}
+
+bool TermDictionary::ExpandPrefix(const string& prefix, size_t max_terms,
+                                  vector<TermInfo>* terms) const {
+  if (num_terms_ == 0) {
+    return true;
+  }
+
+  // The first match is in the block that would hold "prefix" itself; the
+  // rest follow it, possibly across several blocks.
+  size_t found = 0;
+  TermInfo term;
+  for (uint32_t block = FindBlock(prefix); block < num_blocks_; block++) {
+    const uint8_t* pos = Block(block);
+    for (uint32_t i = 0; i < BlockTerms(block); i++) {
+      DecodeTerm(&pos, &term);
+      if (term.word.compare(0, prefix.size(), prefix) == 0) {
+        if (found++ == max_terms) {
+          return false;
+        }
+        terms->push_back(term);
+      } else if (term.word > prefix) {
+        return true;
+      }
+    }
+  }
+  return true;
+}
+
+void TermDictionary::ForEachTerm(
+    const std::function<bool(const TermInfo&)>& fn) const {
+  TermInfo term;
+  for (uint32_t block = 0; block < num_blocks_; block++) {
+    const uint8_t* pos = Block(block);
+    for (uint32_t i = 0; i < BlockTerms(block); i++) {
+      DecodeTerm(&pos, &term);
+      if (!fn(term)) {
+        return;
+      }
+    }
+  }
+}
+
+void TermDictionary::DecodeTerm(const uint8_t** pos, TermInfo* term) const {
+  uint16_t shared = GetU16(*pos);
+  uint16_t suffix = GetU16(*pos + 2);
+  term->word.resize(shared);
+  term->word.append(reinterpret_cast<const char*>(*pos + 4), suffix);
+  *pos += 4 + suffix;
+  term->postings_offset = static_cast<hw3::IndexFileOffset_t>(GetU32(*pos));
+  term->num_docs = static_cast<int32_t>(GetU32(*pos + 4));
+  *pos += 8;
+}
+
+uint32_t TermDictionary::FindBlock(const string& word) const {
+  uint32_t lo = 0, hi = num_blocks_;
+  while (hi - lo > 1) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    const uint8_t* first = Block(mid);
+    if (word.compare(0, word.size(), reinterpret_cast<const char*>(first + 4),
+                     GetU16(first + 2)) >= 0) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+const uint8_t* TermDictionary::Block(uint32_t block) const {
+  return blocks_ + GetU32(offsets_ + block * sizeof(uint32_t));
+}
+
+uint32_t TermDictionary::BlockTerms(uint32_t block) const {
+  return std::min(kTermsPerBlock, num_terms_ - block * kTermsPerBlock);
+}
+
+}  // namespace hw4
@@ -0,0 +1,138 @@
+#ifndef HW4_TERMDICTIONARY_H_
+#define HW4_TERMDICTIONARY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "./libhw3/LayoutStructs.h"
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// One word of a TermDictionary.
+struct TermInfo {
+  std::string            word;
+  hw3::IndexFileOffset_t postings_offset;  // the word's docID table.
+  int32_t                num_docs;         // documents holding the word.
+};
+
+// A term dictionary is a sidecar file ("<index>.dict") holding every word
+// of an index file in sorted order, along with the offset of the word's
+// docID table inside the index.  It turns a word lookup from a walk of
+// the index's hash chains (bucket record, element positions, then each
+// chained word compared in turn) into a binary search over memory-mapped
+// blocks, and since it is sorted it can also enumerate words by prefix.
+//
+// The index format itself can't grow a new section (the hw3 readers
+// insist that the file is exactly a header, a doctable and an index), so
+// the dictionary lives beside it and records the index's checksum; a
+// dictionary that doesn't match its index is ignored.
+//
+// On-disk layout (all fields big-endian):
+//
+//   header:  magic, checksum (of everything after the header),
+//            index_checksum, num_terms, num_blocks, blocks_bytes
+//   blocks:  runs of up to kTermsPerBlock words, front-coded: each word
+//            is u16 shared_prefix_len, u16 suffix_len, the suffix bytes,
+//            then i32 postings_offset and i32 num_docs.  The first word
+//            of a block shares nothing with its predecessor.
+//   offsets: num_blocks u32 offsets of the blocks, relative to the first.
+class TermDictionaryWriter {
+ public:
+  // Arguments:
+  // - index_file_name: the index this dictionary describes.
+  explicit TermDictionaryWriter(const std::string& index_file_name);
+  virtual ~TermDictionaryWriter() { }
+
+  // Adds a word, in any order.
+  void Add(const std::string& word, hw3::IndexFileOffset_t postings_offset,
+           int32_t num_docs);
+
+  // Sorts the words and atomically writes the dictionary.  Call this once
+  // the index is committed, with the checksum from its header.
+  //
+  // Returns false on error.
+  bool Commit(uint32_t index_checksum);
+
+ private:
+  std::string file_name_;
+  std::vector<TermInfo> terms_;
+
+  DISALLOW_COPY_AND_ASSIGN(TermDictionaryWriter);
+};
+
+// A TermDictionary reads a dictionary written by TermDictionaryWriter.
+// The file is mmap()'ed, so a lookup costs a binary search over the block
+// offsets plus a scan of one small block, without any system calls.
+class TermDictionary {
+ public:
+  // Returns the name of the dictionary of "index_file_name".
+  static std::string DictionaryName(const std::string& index_file_name) {
+    return index_file_name + ".dict";
+  }
+
+  explicit TermDictionary(const std::string& index_file_name);
+  virtual ~TermDictionary();
+
+  // Maps the dictionary.
+  //
+  // Arguments:
+  // - index_checksum: the checksum in the index file's header.
+  // - validate: whether to verify the dictionary's own checksum, if this
+  //   process hasn't already (see IsChecksumVerified()).
+  //
+  // Returns false if the dictionary is missing, malformed, or belongs to
+  // a different version of the index.
+  bool Open(uint32_t index_checksum, bool validate = true);
+
+  // Looks "word" up, returning its entry through "info".
+  //
+  // Returns true if the word is in the dictionary, false otherwise.
+  bool Lookup(const std::string& word, TermInfo* info) const;
+
+  // Appends the words that start with "prefix" to "terms", in sorted
+  // order, stopping after "max_terms" of them.
+  //
+  // Returns false if there were more than "max_terms" matches.
+  bool ExpandPrefix(const std::string& prefix, size_t max_terms,
+                    std::vector<TermInfo>* terms) const;
+
+  // Calls "fn" on every word, in sorted order, until it returns false.
+  void ForEachTerm(const std::function<bool(const TermInfo&)>& fn) const;
+
+  // Returns the number of words in the dictionary.
+  size_t num_terms() const { return num_terms_; }
+
+ private:
+  // Decodes the word at "*pos", whose predecessor in its block is
+  // already in "term->word", and advances "*pos" past it.
+  void DecodeTerm(const uint8_t** pos, TermInfo* term) const;
+
+  // Returns the block that would hold "word": the last block whose first
+  // word is <= "word" (or block 0).
+  uint32_t FindBlock(const std::string& word) const;
+
+  // Returns the start of block "block".
+  const uint8_t* Block(uint32_t block) const;
+
+  // Returns the number of words in block "block".
+  uint32_t BlockTerms(uint32_t block) const;
+
+  std::string file_name_;
+  const uint8_t* map_;
+  size_t map_bytes_;
+  const uint8_t* blocks_;
+  const uint8_t* offsets_;
+  uint32_t num_terms_;
+  uint32_t num_blocks_;
+
+  DISALLOW_COPY_AND_ASSIGN(TermDictionary);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_TERMDICTIONARY_H_
@@ -1,6 +1,7 @@
 #include <unistd.h>
 #include <iostream>
 
+#include "./Metrics.h"
 #include "./ThreadPool.h"
 
 extern "C" {
@@ -13,10 +14,19 @@ namespace hw4 {
 // are born into.
 void* ThreadLoop(void* t_pool);
 
-ThreadPool::ThreadPool(uint32_t num_threads) {
+ThreadPool::ThreadPool(uint32_t num_threads, size_t max_queue_length,
+                       int target_delay_ms, int interval_ms) {
   // Initialize our member variables.
   num_threads_running_ = 0;
   terminate_threads_ = false;
+  max_queue_length_ = max_queue_length;
+  target_delay_ns_ = static_cast<uint64_t>(target_delay_ms) * 1000000;
+  interval_ns_ = static_cast<uint64_t>(interval_ms) * 1000000;
+  min_delay_ns_ = 0;
+  interval_end_ns_ = 0;
+  overloaded_ = false;
+  num_refused_ = 0;
+  num_shed_ = 0;
   Verify333(pthread_mutex_init(&q_lock_, nullptr) == 0);
   Verify333(pthread_cond_init(&q_cond_, nullptr) == 0);
 
@@ -81,12 +91,77 @@ ThreadPool:: ~ThreadPool() {
 }
 
 // Enqueue a Task for dispatch.
-void ThreadPool::Dispatch(Task* t) {
+bool ThreadPool::Dispatch(Task* t) {
+  uint64_t now = MonotonicNs();
   Verify333(pthread_mutex_lock(&q_lock_) == 0);
   Verify333(terminate_threads_ == false);
+
+  // If every thread is stuck, nothing is dequeued to notice the queue
+  // standing, but a head that has waited out a whole interval shows it.
+  uint64_t head_delay_ns =
+    work_queue_.empty() ? 0 : now - work_queue_.front()->enqueue_ns_;
+  if (target_delay_ns_ != 0
+      && head_delay_ns > interval_ns_ + target_delay_ns_) {
+    overloaded_ = true;
+  }
+
+  // Turn the Task away now if the queue is full, or if we're overloaded
+  // and the Task at the head of the queue has already waited too long:
+  // this one would wait longer still.
+  bool full = max_queue_length_ != 0
+    && work_queue_.size() >= max_queue_length_;
+  bool stale = overloaded_ && head_delay_ns > 2 * target_delay_ns_;
+  if (full || stale) {
+    num_refused_++;
+    Verify333(pthread_mutex_unlock(&q_lock_) == 0);
+    return false;
+  }
+
+  t->enqueue_ns_ = now;
   work_queue_.push_back(t);
   Verify333(pthread_cond_signal(&q_cond_) == 0);
   Verify333(pthread_mutex_unlock(&q_lock_) == 0);
+  return true;
+}
+
+size_t ThreadPool::queue_length() {
+  Verify333(pthread_mutex_lock(&q_lock_) == 0);
+  size_t length = work_queue_.size();
+  Verify333(pthread_mutex_unlock(&q_lock_) == 0);
+  return length;
+}
+
+uint64_t ThreadPool::num_refused() {
+  Verify333(pthread_mutex_lock(&q_lock_) == 0);
+  uint64_t count = num_refused_;
+  Verify333(pthread_mutex_unlock(&q_lock_) == 0);
+  return count;
+}
+
+uint64_t ThreadPool::num_shed() {
+  Verify333(pthread_mutex_lock(&q_lock_) == 0);
+  uint64_t count = num_shed_;
+  Verify333(pthread_mutex_unlock(&q_lock_) == 0);
+  return count;
+}
+
+bool ThreadPool::ShouldShed(uint64_t delay_ns) {
+  if (target_delay_ns_ == 0) {
+    return false;
+  }
+  // Once per interval, decide whether the queue is standing: whether
+  // even the luckiest Task of the interval waited longer than the
+  // target.  While it is, shed the Tasks that waited twice the target,
+  // which drains the queue back down to a short one quickly.
+  uint64_t now = MonotonicNs();
+  if (now > interval_end_ns_) {
+    overloaded_ = interval_end_ns_ != 0 && min_delay_ns_ > target_delay_ns_;
+    min_delay_ns_ = delay_ns;
+    interval_end_ns_ = now + interval_ns_;
+  } else if (delay_ns < min_delay_ns_) {
+    min_delay_ns_ = delay_ns;
+  }
+  return overloaded_ && delay_ns > 2 * target_delay_ns_;
 }
 
 // This is the main loop that all worker threads are born into.  They
@@ -110,6 +185,11 @@ void* ThreadLoop(void* t_pool) {
     while (!pool->work_queue_.empty() && (pool->terminate_threads_ == false)) {
       ThreadPool::Task* nextTask = pool->work_queue_.front();
       pool->work_queue_.pop_front();
+      nextTask->queue_ns_ = MonotonicNs() - nextTask->enqueue_ns_;
+      if (pool->ShouldShed(nextTask->queue_ns_)) {
+        nextTask->shed_ = true;
+        pool->num_shed_++;
+      }
 
       // We picked up a Task, so invoke the task function with the
       // lock released, then check so see if more tasks are waiting to
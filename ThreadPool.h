@@ -5,6 +5,7 @@ extern "C" {
 #include <pthread.h>  // for the pthread threading/mutex functions
 }
 
+#include <stddef.h>   // for size_t
 #include <stdint.h>   // for uint32_t, etc.
 #include <list>       // for std::list
 
@@ -23,7 +24,17 @@ class ThreadPool {
   // threads.  Arguments:
   //
   //  - num_threads:  the number of threads in the pool.
-  explicit ThreadPool(uint32_t num_threads);
+  //
+  //  - max_queue_length:  the most Tasks that may wait for a thread;
+  //    Dispatch() refuses more.  0 means no limit.
+  //
+  //  - target_delay_ms:  if not 0, the pool sheds load CoDel-style
+  //    (see Task::shed_) whenever Tasks have waited longer than this
+  //    for a thread throughout the last "interval_ms" milliseconds:
+  //    the queue is standing rather than absorbing a burst, so the
+  //    Tasks at its tail won't be served in time to be of use.
+  explicit ThreadPool(uint32_t num_threads, size_t max_queue_length = 0,
+                      int target_delay_ms = 0, int interval_ms = 100);
   virtual ~ThreadPool();
 
   // This inner class defines what a Task is.  A worker thread will
@@ -39,15 +50,36 @@ class ThreadPool {
    public:
     // "f" is the task function that a worker thread should invoke to
     // process the task.
-    explicit Task(thread_task_fn func) : func_(func) { }
+    explicit Task(thread_task_fn func)
+      : func_(func), shed_(false), enqueue_ns_(0), queue_ns_(0) { }
 
     // The dispatch function.
     thread_task_fn func_;
+
+    // Set when the pool is overloaded and this Task waited too long for
+    // a thread; the dispatch function should then do as little as it
+    // can, such as telling the client to come back later.
+    bool shed_;
+
+    // When the Task was queued, on the monotonic clock, and how long it
+    // then waited for a thread.
+    uint64_t enqueue_ns_;
+    uint64_t queue_ns_;
   };
 
   // Customers use Dispatch() to enqueue a Task for dispatch to a
-  // worker thread.
-  void Dispatch(Task* t);
+  // worker thread.  Returns false, and leaves "t" with the caller, if
+  // the queue is full or the pool is overloaded and "t" would wait too
+  // long; the customer should then shed the Task itself.
+  bool Dispatch(Task* t);
+
+  // Returns the number of Tasks waiting for a thread.
+  size_t queue_length();
+
+  // Returns the number of Tasks Dispatch() refused, and the number
+  // dispatched with shed_ set.
+  uint64_t num_refused();
+  uint64_t num_shed();
 
   // A lock and condition variable that worker threads and the
   // Dispatch function use to guard the Task queue.
@@ -70,8 +102,29 @@ class ThreadPool {
   uint32_t num_threads_running_;
 
  private:
+  friend void* ThreadLoop(void* t_pool);
+
+  // Returns true if a Task that has waited "delay_ns" should be shed,
+  // updating the CoDel state.  Call with q_lock_ held.
+  bool ShouldShed(uint64_t delay_ns);
+
   // The pthreads pthread_t structures representing each thread.
   pthread_t* thread_array_;
+
+  // The queue limits; see the constructor.
+  size_t max_queue_length_;
+  uint64_t target_delay_ns_;
+  uint64_t interval_ns_;
+
+  // The CoDel state: the shortest wait seen in the current interval,
+  // when that interval ends, and whether the last interval's shortest
+  // wait was over the target.
+  uint64_t min_delay_ns_;
+  uint64_t interval_end_ns_;
+  bool overloaded_;
+
+  uint64_t num_refused_;
+  uint64_t num_shed_;
 };
 
 }  // namespace hw4
@@ -0,0 +1,121 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <stdint.h>
+
+#include <list>
+#include <utility>
+
+#include "./TimerWheel.h"
+
+using std::list;
+
+namespace hw4 {
+
+// The level of a timer that's been taken out of its slot to be fired.
+static const int kFiring = -1;
+
+TimerWheel::TimerWheel(uint64_t now) : now_(now), next_id_(1) { }
+
+TimerWheel::TimerId TimerWheel::Schedule(uint64_t expiry, Callback callback) {
+  TimerId id = next_id_++;
+  Timer& timer = timers_[id];
+  timer.expiry = expiry;
+  timer.callback = std::move(callback);
+  Place(id, &timer);
+  return id;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+  auto it = timers_.find(id);
+  if (it == timers_.end()) {
+    return false;
+  }
+  // A timer about to fire is only in Advance()'s list, which skips ids
+  // that are no longer pending.
+  if (it->second.level != kFiring) {
+    slots_[it->second.level][it->second.slot].erase(it->second.position);
+  }
+  timers_.erase(it);
+  return true;
+}
+
+size_t TimerWheel::Advance(uint64_t now) {
+  size_t num_fired = 0;
+  while (now_ < now) {
+    if (timers_.empty()) {
+      now_ = now;
+      break;
+    }
+    list<TimerId> due;
+    Tick(&due);
+    for (TimerId id : due) {
+      auto it = timers_.find(id);
+      if (it == timers_.end()) {
+        continue;
+      }
+      Callback callback = std::move(it->second.callback);
+      timers_.erase(it);
+      callback();
+      num_fired++;
+    }
+  }
+  return num_fired;
+}
+
+void TimerWheel::Place(TimerId id, Timer* timer) {
+  // Anything overdue goes in the very next slot.
+  uint64_t expiry = timer->expiry > now_ ? timer->expiry : now_ + 1;
+
+  // Find the finest level whose current rotation reaches the expiry.  A
+  // timer beyond the last level's reach waits in the slot the last level
+  // visits last, and is placed again from there.
+  int level = kLevels - 1;
+  int slot = (now_ >> (kSlotBits * level)) & (kSlots - 1);
+  for (int l = 0; l < kLevels; l++) {
+    int shift = kSlotBits * (l + 1);
+    if ((expiry >> shift) == (now_ >> shift)) {
+      level = l;
+      slot = (expiry >> (kSlotBits * l)) & (kSlots - 1);
+      break;
+    }
+  }
+  list<TimerId>& slot_list = slots_[level][slot];
+  timer->level = level;
+  timer->slot = slot;
+  timer->position = slot_list.insert(slot_list.end(), id);
+}
+
+void TimerWheel::Tick(list<TimerId>* fired) {
+  now_++;
+
+  // When a level's slots come around to zero, the next slot up is due to
+  // be spread over the levels below; go from the top down so timers can
+  // fall more than one level.
+  for (int level = kLevels - 1; level > 0; level--) {
+    int shift = kSlotBits * level;
+    if ((now_ & ((uint64_t(1) << shift) - 1)) != 0) {
+      continue;
+    }
+    list<TimerId> cascade;
+    cascade.swap(slots_[level][(now_ >> shift) & (kSlots - 1)]);
+    for (TimerId id : cascade) {
+      // A timer due on the boundary itself fires now; placing it again
+      // would put it off to the next tick.
+      Timer& timer = timers_[id];
+      if (timer.expiry <= now_) {
+        timer.level = kFiring;
+        fired->push_back(id);
+      } else {
+        Place(id, &timer);
+      }
+    }
+  }
+
+  list<TimerId>& slot_list = slots_[0][now_ & (kSlots - 1)];
+  for (TimerId id : slot_list) {
+    timers_[id].level = kFiring;
+  }
+  fired->splice(fired->end(), slot_list);
+}
+
+}  // namespace hw4
@@ -0,0 +1,93 @@
+#ifndef HW4_TIMERWHEEL_H_
+#define HW4_TIMERWHEEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+
+#include "./libhw3/Utils.h"
+
+namespace hw4 {
+
+// A TimerWheel keeps a set of timers, each of which runs a callback once
+// the wheel's clock passes its expiry, and does so in constant time per
+// timer however many are pending: scheduling and canceling a timer just
+// link it into or out of a slot, and advancing the clock one tick only
+// visits the timers due then.
+//
+// Time is counted in ticks, whose length is up to the caller.  The wheel
+// is hierarchical: the first level has a slot for each of the next
+// kSlots ticks, the second a slot for each of the next kSlots runs of
+// kSlots ticks, and so on.  A timer lives in the finest level that can
+// tell its expiry apart from now, and is moved down a level ("cascaded")
+// when the clock reaches its slot, so timers far in the future cost
+// nothing until they draw near.
+//
+// A TimerWheel is not safe to use from several threads at once.
+class TimerWheel {
+ public:
+  typedef uint64_t TimerId;
+  typedef std::function<void()> Callback;
+
+  // Creates an empty wheel whose clock reads "now".
+  explicit TimerWheel(uint64_t now = 0);
+  virtual ~TimerWheel() { }
+
+  // Schedules "callback" to run once the clock reaches "expiry"; an
+  // expiry that has already passed fires on the next tick.  Returns an
+  // id for Cancel(), which is never 0.
+  TimerId Schedule(uint64_t expiry, Callback callback);
+
+  // Cancels timer "id" if it hasn't fired yet.  Returns true if it was
+  // pending.
+  bool Cancel(TimerId id);
+
+  // Moves the clock forward to "now", firing (in order of expiry) the
+  // timers that come due.  The callbacks may schedule and cancel timers.
+  // Returns the number of timers fired.
+  size_t Advance(uint64_t now);
+
+  // Returns the clock's reading.
+  uint64_t now() const { return now_; }
+
+  // Returns the number of pending timers.
+  size_t size() const { return timers_.size(); }
+
+  // The number of slots in each level, and the number of levels: with
+  // 64 slots and 4 levels, timers up to 2^24 ticks out are placed
+  // exactly, and later ones wait in the last level until they're in
+  // range.
+  static const int kSlotBits = 6;
+  static const int kSlots = 1 << kSlotBits;
+  static const int kLevels = 4;
+
+ private:
+  struct Timer {
+    uint64_t expiry;
+    Callback callback;
+    int level;
+    int slot;
+    std::list<TimerId>::iterator position;
+  };
+
+  // Links "timer" (whose id is "id") into the slot for its expiry.
+  void Place(TimerId id, Timer* timer);
+
+  // Moves the clock forward one tick, appending the timers that come due
+  // to "fired".
+  void Tick(std::list<TimerId>* fired);
+
+  uint64_t now_;
+  TimerId next_id_;
+  std::list<TimerId> slots_[kLevels][kSlots];
+  std::unordered_map<TimerId, Timer> timers_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace hw4
+
+#endif  // HW4_TIMERWHEEL_H_
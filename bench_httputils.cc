@@ -0,0 +1,122 @@
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "./HttpConnection.h"
+#include "./HttpRequest.h"
+#include "./HttpResponse.h"
+#include "./HttpUtils.h"
+#include "./libhw3/Utils.h"
+
+#include "./bench_suite.h"
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// A query string with some escaping, as a browser would send it.
+static const char* kQueryUri =
+  "/query?terms=the+quick%20brown+fox%3A+%22jumped%22&page=2&sort=score";
+
+// Text with nothing to escape, and text with plenty.
+static const char* kPlainText =
+  "Sherlock Holmes took his bottle from the corner of the mantel-piece, "
+  "and his hypodermic syringe from its neat morocco case.";
+static const char* kMarkupText =
+  "<a href=\"/query?terms=a&b\">Tom's &amp; Jerry's</a> <b>\"bold\"</b>";
+
+// A request as curl sends it.
+static const char* kRequest =
+  "GET /query?terms=sherlock+holmes HTTP/1.1\r\n"
+  "Host: localhost:5555\r\n"
+  "User-Agent: curl/7.88.1\r\n"
+  "Accept: */*\r\n"
+  "Accept-Encoding: gzip, deflate\r\n"
+  "Connection: keep-alive\r\n"
+  "\r\n";
+
+static void BM_URIDecode(benchmark::State& state) {
+  string uri(kQueryUri);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(URIDecode(uri));
+  }
+  state.SetBytesProcessed(state.iterations() * uri.size());
+}
+BENCHMARK(BM_URIDecode);
+
+static void BM_EscapeHtml(benchmark::State& state, const char* text) {
+  string from(text);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(EscapeHtml(from));
+  }
+  state.SetBytesProcessed(state.iterations() * from.size());
+}
+BENCHMARK_CAPTURE(BM_EscapeHtml, plain, kPlainText);
+BENCHMARK_CAPTURE(BM_EscapeHtml, markup, kMarkupText);
+
+static void BM_URLParserParse(benchmark::State& state) {
+  string uri(kQueryUri);
+  for (auto _ : state) {
+    URLParser parser;
+    parser.Parse(uri);
+    benchmark::DoNotOptimize(parser);
+  }
+}
+BENCHMARK(BM_URLParserParse);
+
+// Parses a query's url and reads its terms, as the server does.
+static void BM_URLParserTerms(benchmark::State& state) {
+  string uri(kQueryUri);
+  URLParser parser;
+  for (auto _ : state) {
+    parser.Parse(uri);
+    benchmark::DoNotOptimize(parser.arg("terms"));
+  }
+}
+BENCHMARK(BM_URLParserTerms);
+
+static void BM_ParseRequest(benchmark::State& state) {
+  string request(kRequest);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(HttpConnection::ParseRequest(request));
+  }
+  state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_ParseRequest);
+
+// Generates a 200 response with a body of state.range(0) bytes.
+static void BM_GenerateResponseString(benchmark::State& state) {
+  HttpResponse rep;
+  rep.set_protocol("HTTP/1.1");
+  rep.set_response_code(200);
+  rep.set_message("OK");
+  rep.set_content_type("text/html");
+  rep.AddHeader("Cache-Control", "no-cache");
+  rep.AppendToBody(string(state.range(0), 'x'));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(rep.GenerateResponseString());
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GenerateResponseString)->Arg(0)->Arg(1 << 10)->Arg(64 << 10);
+
+// Checksums state.range(0) bytes, as the index writer does.
+static void BM_CRC32(benchmark::State& state) {
+  vector<uint8_t> data(state.range(0));
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = i * 31;
+  }
+  for (auto _ : state) {
+    hw3::CRC32 crc;
+    for (uint8_t byte : data) {
+      crc.FoldByteIntoCRC(byte);
+    }
+    benchmark::DoNotOptimize(crc.GetFinalCRC());
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_CRC32)->Arg(64)->Arg(64 << 10);
+
+}  // namespace hw4
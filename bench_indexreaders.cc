@@ -0,0 +1,62 @@
+#include <list>
+#include <memory>
+#include <string>
+
+#include "./libhw3/FileIndexReader.h"
+#include "./libhw3/IndexTableReader.h"
+#include "./libhw3/DocIDTableReader.h"
+
+#include "./bench_suite.h"
+
+using std::list;
+using std::string;
+using std::unique_ptr;
+
+namespace hw4 {
+
+// Looks up every word of the synthetic index in turn, so that common and
+// rare words (short and long docID tables) both count.
+static void BM_LookupWord(benchmark::State& state) {
+  const BenchIndex& index = GetBenchIndex();
+  hw3::FileIndexReader fir(index.file_name, false);
+  unique_ptr<hw3::IndexTableReader> itr(fir.NewIndexTableReader());
+  size_t i = 0;
+  for (auto _ : state) {
+    unique_ptr<hw3::DocIDTableReader> ddtr(itr->LookupWord(index.words[i]));
+    benchmark::DoNotOptimize(ddtr.get());
+    i = (i + 1) % index.words.size();
+  }
+}
+BENCHMARK(BM_LookupWord);
+
+// Looks up words that aren't in the index.
+static void BM_LookupWordMiss(benchmark::State& state) {
+  const BenchIndex& index = GetBenchIndex();
+  hw3::FileIndexReader fir(index.file_name, false);
+  unique_ptr<hw3::IndexTableReader> itr(fir.NewIndexTableReader());
+  size_t i = 0;
+  for (auto _ : state) {
+    unique_ptr<hw3::DocIDTableReader> ddtr(
+        itr->LookupWord("missing" + std::to_string(i++)));
+    benchmark::DoNotOptimize(ddtr.get());
+  }
+}
+BENCHMARK(BM_LookupWordMiss);
+
+// Looks up every docID in the docID table of the index's most common
+// word, which is in nearly every document.
+static void BM_LookupDocID(benchmark::State& state) {
+  const BenchIndex& index = GetBenchIndex();
+  hw3::FileIndexReader fir(index.file_name, false);
+  unique_ptr<hw3::IndexTableReader> itr(fir.NewIndexTableReader());
+  unique_ptr<hw3::DocIDTableReader> ddtr(itr->LookupWord(index.words[0]));
+  DocID_t doc_id = 1;
+  for (auto _ : state) {
+    list<DocPositionOffset_t> positions;
+    benchmark::DoNotOptimize(ddtr->LookupDocID(doc_id, &positions));
+    doc_id = doc_id % index.num_docs + 1;
+  }
+}
+BENCHMARK(BM_LookupDocID);
+
+}  // namespace hw4
@@ -0,0 +1,113 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./bench_suite.h"
+#include "./SyntheticCorpus.h"
+#include "./TermDictionary.h"
+
+extern "C" {
+  #include "libhw1/CSE333.h"
+}
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// The synthetic index's size, by default; --index_docs and --index_words
+// override them.
+static const int kDefaultIndexDocs = 5000;
+static const int kDefaultIndexWords = 10000;
+
+// How many words each synthetic document has.
+static const int kWordsPerDoc = 100;
+
+static int index_docs = kDefaultIndexDocs;
+static int index_words = kDefaultIndexWords;
+static std::unique_ptr<BenchIndex> bench_index;
+
+// Removes the synthetic index's files, if it was generated.
+static void RemoveBenchIndex();
+
+const BenchIndex& GetBenchIndex() {
+  if (bench_index) {
+    return *bench_index;
+  }
+  bench_index.reset(new BenchIndex);
+  bench_index->file_name =
+    "./bench_suite_" + std::to_string(getpid()) + ".idx";
+  bench_index->num_docs = index_docs;
+  for (int i = 0; i < index_words; i++) {
+    bench_index->words.push_back(SyntheticCorpus::Word(i));
+  }
+
+  CorpusOptions options;
+  options.num_docs = index_docs;
+  options.vocabulary_size = index_words;
+  options.positions_per_doc = kWordsPerDoc;
+  SyntheticCorpus corpus(options);
+  Verify333(corpus.WriteIndex(0, index_docs, bench_index->file_name) > 0);
+  atexit(&RemoveBenchIndex);
+  return *bench_index;
+}
+
+static void RemoveBenchIndex() {
+  unlink(bench_index->file_name.c_str());
+  unlink(TermDictionary::DictionaryName(bench_index->file_name).c_str());
+}
+
+}  // namespace hw4
+
+// Takes this suite's own flags out of argv, leaving Google Benchmark's.
+static void ParseIndexFlags(int* argc, char** argv) {
+  int kept = 1;
+  for (int i = 1; i < *argc; i++) {
+    if (strncmp(argv[i], "--index_docs=", 13) == 0) {
+      hw4::index_docs = atoi(argv[i] + 13);
+    } else if (strncmp(argv[i], "--index_words=", 14) == 0) {
+      hw4::index_words = atoi(argv[i] + 14);
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  *argc = kept;
+}
+
+int main(int argc, char** argv) {
+  ParseIndexFlags(&argc, argv);
+  if (hw4::index_docs <= 0 || hw4::index_words <= 0) {
+    fprintf(stderr, "Usage: %s [--index_docs=N] [--index_words=N] "
+            "[benchmark flags]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Unless told otherwise, report JSON, and the mean, median and spread
+  // of a few repetitions rather than one noisy number, so that runs can
+  // be compared by a script.  Flags given later on the command line win.
+  vector<char*> args = {argv[0],
+                        const_cast<char*>("--benchmark_format=json"),
+                        const_cast<char*>("--benchmark_repetitions=5"),
+                        const_cast<char*>(
+                            "--benchmark_report_aggregates_only=true")};
+  args.insert(args.end(), argv + 1, argv + argc);
+  int args_count = args.size();
+  benchmark::Initialize(&args_count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(args_count, args.data())) {
+    return EXIT_FAILURE;
+  }
+  benchmark::AddCustomContext("index_docs",
+                              std::to_string(hw4::index_docs));
+  benchmark::AddCustomContext("index_words",
+                              std::to_string(hw4::index_words));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,32 @@
+#ifndef HW4_BENCH_SUITE_H_
+#define HW4_BENCH_SUITE_H_
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace hw4 {
+
+// A synthetic index (of a SyntheticCorpus) for the index readers'
+// benchmarks, generated on first use (outside any timing) and removed when
+// bench_suite exits.  Its size comes from bench_suite's --index_docs and
+// --index_words flags, and its contents from a fixed seed, so every run
+// reads the same index.
+struct BenchIndex {
+  // The index file.
+  std::string file_name;
+
+  // Its documents are numbered 1 to num_docs.
+  int num_docs;
+
+  // Every word in the index, most frequent first.
+  std::vector<std::string> words;
+};
+
+// Returns the synthetic index, generating it if need be.
+const BenchIndex& GetBenchIndex();
+
+}  // namespace hw4
+
+#endif  // HW4_BENCH_SUITE_H_
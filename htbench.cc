@@ -0,0 +1,151 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <stdint.h>
+#include <time.h>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "libhw1/HashTable.h"
+}
+#include "./OAHashTable.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Compares the insert/find/remove throughput of libhw1's chained HashTable
+// with hw4's open-addressing OAHashTable.  Keys are FNV hashes of decimal
+// strings, like the word keys of a MemIndex.
+
+// The HashTable_* API, for either implementation.
+template <typename Table>
+struct TableOps {
+  Table* (*allocate)(int);
+  void (*free)(Table*, ValueFreeFnPtr);
+  bool (*insert)(Table*, HTKeyValue_t, HTKeyValue_t*);
+  bool (*find)(Table*, HTKey_t, HTKeyValue_t*);
+  bool (*remove)(Table*, HTKey_t, HTKeyValue_t*);
+};
+
+// Print out program usage, and exit() with EXIT_FAILURE.
+static void Usage(char* prog_name);
+
+// Returns the number of seconds on the monotonic clock.
+static double Now();
+
+// Times "num_keys" inserts, hits, misses and removes against one table,
+// printing one line per operation.
+template <typename Table>
+static void Bench(const char* name, const TableOps<Table>& ops,
+                  const vector<HTKey_t>& keys, const vector<HTKey_t>& misses);
+
+static void NoOpFree(HTValue_t value) { }
+
+int main(int argc, char** argv) {
+  vector<int> sizes{1000, 100000, 1000000};
+  if (argc > 2) {
+    Usage(argv[0]);
+  } else if (argc == 2) {
+    int size = atoi(argv[1]);
+    if (size <= 0) {
+      Usage(argv[0]);
+    }
+    sizes = {size};
+  }
+
+  TableOps<HashTable> chained{&HashTable_Allocate, &HashTable_Free,
+                              &HashTable_Insert, &HashTable_Find,
+                              &HashTable_Remove};
+  TableOps<hw4::OAHashTable> open{&hw4::OAHashTable_Allocate,
+                                  &hw4::OAHashTable_Free,
+                                  &hw4::OAHashTable_Insert,
+                                  &hw4::OAHashTable_Find,
+                                  &hw4::OAHashTable_Remove};
+
+  cout << std::left << std::setw(12) << "table" << std::setw(10) << "keys"
+       << std::setw(10) << "op" << std::right << std::setw(12) << "ns/op"
+       << std::setw(12) << "Mops/s" << endl;
+  for (int size : sizes) {
+    vector<HTKey_t> keys, misses;
+    for (int i = 0; i < size; i++) {
+      string hit = std::to_string(i), miss = "x" + hit;
+      keys.push_back(FNVHash64(reinterpret_cast<unsigned char*>(&hit[0]),
+                               hit.size()));
+      misses.push_back(FNVHash64(reinterpret_cast<unsigned char*>(&miss[0]),
+                                 miss.size()));
+    }
+    Bench("HashTable", chained, keys, misses);
+    Bench("OAHashTable", open, keys, misses);
+  }
+  return EXIT_SUCCESS;
+}
+
+static void Usage(char* prog_name) {
+  cerr << "Usage: " << prog_name << " [num_keys]";
+  cerr << endl;
+  exit(EXIT_FAILURE);
+}
+
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Prints one result line.
+static void Report(const char* name, size_t num_keys, const char* op,
+                   double seconds) {
+  cout << std::left << std::setw(12) << name << std::setw(10) << num_keys
+       << std::setw(10) << op << std::right << std::fixed
+       << std::setprecision(1) << std::setw(12) << seconds * 1e9 / num_keys
+       << std::setprecision(2) << std::setw(12) << num_keys / seconds / 1e6
+       << endl;
+}
+
+template <typename Table>
+static void Bench(const char* name, const TableOps<Table>& ops,
+                  const vector<HTKey_t>& keys,
+                  const vector<HTKey_t>& misses) {
+  // Start small, as the indexer does, so that resizing is measured too.
+  Table* table = ops.allocate(2);
+  HTKeyValue_t kv, old;
+
+  double start = Now();
+  for (HTKey_t key : keys) {
+    kv.key = key;
+    kv.value = reinterpret_cast<HTValue_t>(key);
+    ops.insert(table, kv, &old);
+  }
+  Report(name, keys.size(), "insert", Now() - start);
+
+  // Keep the compiler from discarding the lookups.
+  uint64_t found = 0;
+  start = Now();
+  for (HTKey_t key : keys) {
+    found += ops.find(table, key, &kv);
+  }
+  Report(name, keys.size(), "find-hit", Now() - start);
+
+  start = Now();
+  for (HTKey_t key : misses) {
+    found += ops.find(table, key, &kv);
+  }
+  Report(name, misses.size(), "find-miss", Now() - start);
+
+  start = Now();
+  for (HTKey_t key : keys) {
+    found += ops.remove(table, key, &kv);
+  }
+  Report(name, keys.size(), "remove", Now() - start);
+
+  if (found != 2 * keys.size()) {
+    cerr << name << ": lost keys!" << endl;
+  }
+  ops.free(table, &NoOpFree);
+}
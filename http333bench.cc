@@ -0,0 +1,569 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "./Metrics.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Replays a workload of requests against one or more running servers
+// (such as our http333d and solution_binaries/http333d, started on two
+// ports) and reports each one's throughput and latency percentiles.
+//
+// The workload is a JSON lines file, like requests.jsonl, with one request
+// per line:
+//
+//   {"uri": "/query?terms=apple", "weight": 5}
+//   {"method": "POST", "uri": "/api/batch?k=5", "body": "apple\nbanana\n"}
+//
+// "method" defaults to GET, and "weight" (how often the request comes up
+// relative to the others) to 1.  Every server gets the same sequence.
+//
+// Requests are sent open loop: the i-th is due i / rate seconds in,
+// whether or not the server has kept up.  One that can't go out on time,
+// because every connection has its fill of requests outstanding, is late
+// through no fault of its own; timing it from when it was finally sent
+// would hide exactly the stalls we want to see (coordinated omission).
+// So latency is measured from when each request was due ("corrected"),
+// and, for comparison, from when it was sent ("uncorrected").
+
+// How long to wait for the last responses once every request is due.
+static const uint64_t kDrainNs = uint64_t(10) * 1000000000;
+
+// The longest to wait for the connections between checks on the time.
+static const uint64_t kMaxWaitNs = 100000000;
+
+// The percentiles reported, besides the maximum.
+static const double kPercentiles[] = {50, 90, 99, 99.9, 99.99};
+
+struct Options {
+  double rate = 100;
+  int connections = 8;
+
+  // The most requests outstanding on a connection at once; 1 waits for
+  // each response before sending the next (plain keep-alive), and 0
+  // opens a new connection for every request.
+  int depth = 1;
+  double duration_s = 10;
+};
+
+// A request of the workload, ready to send.
+struct WorkItem {
+  string request;
+  double weight;
+};
+
+// A request sent and awaiting its response: when it was due, and when it
+// actually went out.
+struct InFlight {
+  uint64_t due_ns;
+  uint64_t sent_ns;
+};
+
+struct Connection {
+  int fd = -1;
+  string out;  // not yet written
+  string in;   // read but not yet parsed
+  std::deque<InFlight> in_flight;
+  bool closing = false;  // no more requests go out on it
+};
+
+struct Result {
+  uint64_t sent = 0;
+  uint64_t answered = 0;
+  uint64_t not_ok = 0;  // answered, but not with a 2xx or 304
+  uint64_t failed = 0;
+  double elapsed_s = 0;
+  hw4::LatencyHistogram corrected, uncorrected;
+  uint64_t max_corrected_ns = 0, max_uncorrected_ns = 0;
+};
+
+// Print out program usage, and exit() with EXIT_FAILURE.
+static void Usage(char* prog_name);
+
+// Reads the workload file "path" into "items", serializing the requests
+// for "host", with "Connection: close" if "close".  Returns false on
+// failure, having said why.
+static bool ReadWorkload(const string& path, const string& host, bool close,
+                         vector<WorkItem>* items);
+
+// Resolves "target" (host:port) into "addr".
+static bool Resolve(const string& target, struct sockaddr_storage* addr,
+                    socklen_t* addr_len);
+
+// Sends "items" to the server at "addr" as "options" say, tallying the
+// outcome in "result".
+static void Run(const Options& options, const vector<WorkItem>& items,
+                const struct sockaddr_storage& addr, socklen_t addr_len,
+                Result* result);
+
+// Returns the length of the HTTP response at the start of "buf", or 0 if
+// it isn't all there yet, or string::npos if it's malformed.  Sets
+// "status" to its status code, and "close" if the server will close the
+// connection after it.  "eof" says the connection has closed, which ends
+// a body of no stated length.
+static size_t ParseResponse(const string& buf, bool eof, int* status,
+                            bool* close);
+
+// Prints the heading, and then the rows for "target", of the results
+// table.
+static void PrintHeading();
+static void PrintResult(const string& target, const Result& result);
+
+int main(int argc, char** argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "+r:c:d:t:")) != -1) {
+    char* end = optarg;
+    switch (opt) {
+      case 'r':
+        options.rate = strtod(optarg, &end);
+        break;
+      case 'c':
+        options.connections = strtol(optarg, &end, 10);
+        break;
+      case 'd':
+        options.depth = strtol(optarg, &end, 10);
+        break;
+      case 't':
+        options.duration_s = strtod(optarg, &end);
+        break;
+      default:
+        Usage(argv[0]);
+    }
+    if (end == optarg || *end != '\0') {
+      Usage(argv[0]);
+    }
+  }
+  if (argc - optind < 2 || options.rate <= 0 || options.connections <= 0
+      || options.depth < 0 || options.duration_s <= 0) {
+    Usage(argv[0]);
+  }
+
+  string workload = argv[optind];
+  vector<string> targets(argv + optind + 1, argv + argc);
+  cout << "sending " << options.rate << " requests/s for "
+       << options.duration_s << "s over " << options.connections
+       << " connections, ";
+  if (options.depth == 0) {
+    cout << "one request each" << endl;
+  } else {
+    cout << "up to " << options.depth << " outstanding on each" << endl;
+  }
+
+  vector<std::unique_ptr<Result>> results;
+  for (const string& target : targets) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    vector<WorkItem> items;
+    if (!Resolve(target, &addr, &addr_len)) {
+      cerr << "can't resolve " << target << endl;
+      return EXIT_FAILURE;
+    }
+    if (!ReadWorkload(workload, target, options.depth == 0, &items)) {
+      return EXIT_FAILURE;
+    }
+    results.emplace_back(new Result);
+    Run(options, items, addr, addr_len, results.back().get());
+  }
+
+  cout << endl;
+  PrintHeading();
+  for (size_t i = 0; i < targets.size(); i++) {
+    PrintResult(targets[i], *results[i]);
+  }
+  return EXIT_SUCCESS;
+}
+
+static void Usage(char* prog_name) {
+  cerr << "Usage: " << prog_name << " [-r requests_per_second]"
+       << " [-c connections] [-d pipelining_depth] [-t seconds]"
+       << " workload.jsonl host:port+" << endl;
+  cerr << "  A depth of 0 opens a new connection for every request."
+       << endl;
+  exit(EXIT_FAILURE);
+}
+
+static bool ReadWorkload(const string& path, const string& host, bool close,
+                         vector<WorkItem>* items) {
+  std::ifstream in(path);
+  if (!in) {
+    cerr << "can't read " << path << endl;
+    return false;
+  }
+  string line;
+  for (int line_num = 1; std::getline(in, line); line_num++) {
+    if (boost::algorithm::trim_copy(line).empty()) {
+      continue;
+    }
+    boost::property_tree::ptree entry;
+    try {
+      std::istringstream line_in(line);
+      boost::property_tree::read_json(line_in, entry);
+    } catch (const boost::property_tree::json_parser_error& e) {
+      cerr << path << ":" << line_num << ": " << e.message() << endl;
+      return false;
+    }
+    string uri = entry.get<string>("uri", "");
+    string body = entry.get<string>("body", "");
+    double weight = entry.get<double>("weight", 1);
+    if (uri.empty() || uri[0] != '/' || weight <= 0) {
+      cerr << path << ":" << line_num
+           << ": needs a \"uri\" starting with '/', and a positive weight"
+           << endl;
+      return false;
+    }
+
+    string request = entry.get<string>("method", "GET") + " " + uri
+      + " HTTP/1.1\r\nHost: " + host + "\r\n";
+    if (!body.empty()) {
+      request += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    if (close) {
+      request += "Connection: close\r\n";
+    }
+    items->push_back({request + "\r\n" + body, weight});
+  }
+  if (items->empty()) {
+    cerr << path << " has no requests" << endl;
+    return false;
+  }
+  return true;
+}
+
+static bool Resolve(const string& target, struct sockaddr_storage* addr,
+                    socklen_t* addr_len) {
+  size_t colon = target.rfind(':');
+  if (colon == string::npos) {
+    return false;
+  }
+  string host = target.substr(0, colon), port = target.substr(colon + 1);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);
+  }
+
+  struct addrinfo hints = {}, *info;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0) {
+    return false;
+  }
+  memcpy(addr, info->ai_addr, info->ai_addrlen);
+  *addr_len = info->ai_addrlen;
+  freeaddrinfo(info);
+  return true;
+}
+
+// Opens "conn" to the server at "addr", returning false on failure.
+static bool Connect(const struct sockaddr_storage& addr, socklen_t addr_len,
+                    Connection* conn) {
+  int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+  if (fd == -1) {
+    return false;
+  }
+  if (connect(fd, reinterpret_cast<const struct sockaddr*>(&addr),
+              addr_len) != 0) {
+    close(fd);
+    return false;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  conn->fd = fd;
+  return true;
+}
+
+// Closes "conn", counting whatever it still awaited as failed.
+static void Disconnect(Connection* conn, Result* result) {
+  result->failed += conn->in_flight.size();
+  close(conn->fd);
+  *conn = Connection();
+}
+
+// Reads what has arrived on "conn", recording the responses it completes.
+static void ReadResponses(Connection* conn, Result* result) {
+  bool eof = false;
+  char buf[65536];
+  while (true) {
+    ssize_t res = read(conn->fd, buf, sizeof(buf));
+    if (res > 0) {
+      conn->in.append(buf, res);
+      continue;
+    }
+    if (res == -1 && errno == EINTR) {
+      continue;
+    }
+    eof = res == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+    break;
+  }
+
+  uint64_t now_ns = hw4::MonotonicNs();
+  bool close = false;
+  while (!conn->in_flight.empty() && !close) {
+    int status;
+    size_t len = ParseResponse(conn->in, eof, &status, &close);
+    if (len == 0) {
+      break;
+    }
+    if (len == string::npos) {
+      eof = true;
+      break;
+    }
+    conn->in.erase(0, len);
+    const InFlight& request = conn->in_flight.front();
+    uint64_t corrected_ns = now_ns - request.due_ns;
+    uint64_t uncorrected_ns = now_ns - request.sent_ns;
+    result->corrected.Record(corrected_ns);
+    result->uncorrected.Record(uncorrected_ns);
+    result->max_corrected_ns = std::max(result->max_corrected_ns,
+                                        corrected_ns);
+    result->max_uncorrected_ns = std::max(result->max_uncorrected_ns,
+                                          uncorrected_ns);
+    result->answered++;
+    if ((status < 200 || status > 299) && status != 304) {
+      result->not_ok++;
+    }
+    conn->in_flight.pop_front();
+  }
+  if (eof || close) {
+    Disconnect(conn, result);
+  }
+}
+
+static void Run(const Options& options, const vector<WorkItem>& items,
+                const struct sockaddr_storage& addr, socklen_t addr_len,
+                Result* result) {
+  // Every server gets the same sequence of requests.
+  std::mt19937 random(333);
+  vector<double> weights;
+  for (const WorkItem& item : items) {
+    weights.push_back(item.weight);
+  }
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+
+  size_t max_in_flight = std::max(options.depth, 1);
+  vector<Connection> conns(options.connections);
+  std::deque<uint64_t> backlog;  // when each request waiting to go was due
+  uint64_t interval_ns = static_cast<uint64_t>(1e9 / options.rate);
+  uint64_t num_requests =
+    static_cast<uint64_t>(options.rate * options.duration_s);
+  uint64_t num_due = 0;
+  uint64_t start_ns = hw4::MonotonicNs();
+  uint64_t give_up_ns = start_ns + num_requests * interval_ns + kDrainNs;
+
+  while (true) {
+    uint64_t now_ns = hw4::MonotonicNs();
+    while (num_due < num_requests
+           && start_ns + num_due * interval_ns <= now_ns) {
+      backlog.push_back(start_ns + num_due * interval_ns);
+      num_due++;
+    }
+    size_t num_in_flight = 0;
+    for (const Connection& conn : conns) {
+      num_in_flight += conn.in_flight.size();
+    }
+    if (num_due == num_requests && backlog.empty() && num_in_flight == 0) {
+      break;
+    }
+    if (now_ns >= give_up_ns) {
+      result->failed += backlog.size();
+      for (Connection& conn : conns) {
+        if (conn.fd != -1) {
+          Disconnect(&conn, result);
+        }
+      }
+      break;
+    }
+
+    // Send what's due on the connections with room for it.
+    for (Connection& conn : conns) {
+      while (!backlog.empty() && !conn.closing
+             && conn.in_flight.size() < max_in_flight) {
+        if (conn.fd == -1 && !Connect(addr, addr_len, &conn)) {
+          result->failed++;
+          backlog.pop_front();
+          continue;
+        }
+        conn.out += items[pick(random)].request;
+        conn.in_flight.push_back({backlog.front(), now_ns});
+        backlog.pop_front();
+        result->sent++;
+        conn.closing = options.depth == 0;
+      }
+    }
+
+    // Wait for the connections, or until the next request is due.
+    vector<struct pollfd> fds;
+    vector<Connection*> fd_conns;
+    for (Connection& conn : conns) {
+      if (conn.fd != -1) {
+        short events = POLLIN | (conn.out.empty() ? 0 : POLLOUT);  // NOLINT
+        fds.push_back({conn.fd, events, 0});
+        fd_conns.push_back(&conn);
+      }
+    }
+    // (ppoll() rather than poll(), whose whole milliseconds would send
+    // requests late, and so add to their latency.)
+    uint64_t timeout_ns = kMaxWaitNs;
+    if (num_due < num_requests) {
+      uint64_t next_ns = start_ns + num_due * interval_ns;
+      timeout_ns = next_ns <= now_ns ? 0
+        : std::min(next_ns - now_ns, kMaxWaitNs);
+    }
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ns / 1000000000;
+    timeout.tv_nsec = timeout_ns % 1000000000;
+    if (ppoll(fds.data(), fds.size(), &timeout, nullptr) <= 0) {
+      continue;
+    }
+
+    for (size_t i = 0; i < fds.size(); i++) {
+      Connection* conn = fd_conns[i];
+      if (fds[i].revents & POLLOUT) {
+        ssize_t res = send(conn->fd, conn->out.data(), conn->out.size(),
+                           MSG_NOSIGNAL);
+        if (res > 0) {
+          conn->out.erase(0, res);
+        } else if (res == -1 && errno != EAGAIN && errno != EWOULDBLOCK
+                   && errno != EINTR) {
+          Disconnect(conn, result);
+          continue;
+        }
+      }
+      if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        ReadResponses(conn, result);
+      }
+    }
+  }
+  result->elapsed_s = (hw4::MonotonicNs() - start_ns) / 1e9;
+}
+
+static size_t ParseResponse(const string& buf, bool eof, int* status,
+                            bool* close) {
+  size_t header_end = buf.find("\r\n\r\n");
+  if (header_end == string::npos) {
+    return 0;
+  }
+  header_end += 4;
+  string header = boost::algorithm::to_lower_copy(buf.substr(0, header_end));
+  if (header.compare(0, 5, "http/") != 0) {
+    return string::npos;
+  }
+  size_t space = header.find(' ');
+  *status = atoi(header.c_str() + space + 1);
+  bool http10 = header.compare(0, 8, "http/1.0") == 0;
+  *close = http10 ? header.find("\r\nconnection: keep-alive") == string::npos
+    : header.find("\r\nconnection: close") != string::npos;
+
+  if (header.find("\r\ntransfer-encoding: chunked") != string::npos) {
+    // Walk the chunks to the zero-length one, then past the trailer.
+    size_t pos = header_end;
+    while (true) {
+      size_t line_end = buf.find("\r\n", pos);
+      if (line_end == string::npos) {
+        return 0;
+      }
+      size_t size = strtoul(buf.c_str() + pos, nullptr, 16);
+      pos = line_end + 2;
+      if (size == 0) {
+        if (buf.compare(pos, 2, "\r\n") == 0) {
+          return pos + 2;
+        }
+        size_t trailer_end = buf.find("\r\n\r\n", pos);
+        return trailer_end == string::npos ? 0 : trailer_end + 4;
+      }
+      pos += size + 2;
+      if (pos > buf.size()) {
+        return 0;
+      }
+    }
+  }
+
+  size_t length_pos = header.find("\r\ncontent-length:");
+  if (length_pos != string::npos) {
+    size_t length = strtoul(header.c_str() + length_pos + 17, nullptr, 10);
+    return buf.size() >= header_end + length ? header_end + length : 0;
+  }
+  if (*status == 304 || *status == 204 || (*status >= 100 && *status < 200)) {
+    return header_end;
+  }
+
+  // The body runs until the server closes the connection.
+  *close = true;
+  return eof ? buf.size() : 0;
+}
+
+// Prints "ns" as milliseconds in a column.
+static void PrintMs(uint64_t ns) {
+  cout << std::setw(10) << ns / 1e6;
+}
+
+static void PrintHeading() {
+  cout << std::left << std::setw(22) << "target" << std::setw(13) << "latency"
+       << std::right << std::setw(10) << "req/s";
+  for (double percentile : kPercentiles) {
+    std::ostringstream label;
+    label << "p" << percentile;
+    cout << std::setw(10) << label.str();
+  }
+  cout << std::setw(10) << "max" << "   (ms)" << endl;
+}
+
+static void PrintResult(const string& target, const Result& result) {
+  cout << std::fixed << std::setprecision(3);
+  const hw4::LatencyHistogram* histograms[] = {&result.corrected,
+                                               &result.uncorrected};
+  const char* kinds[] = {"corrected", "uncorrected"};
+  uint64_t maxes[] = {result.max_corrected_ns, result.max_uncorrected_ns};
+  for (int i = 0; i < 2; i++) {
+    cout << std::left << std::setw(22) << (i == 0 ? target : "")
+         << std::setw(13) << kinds[i] << std::right << std::setw(10)
+         << std::setprecision(1);
+    if (i == 0) {
+      cout << result.answered / result.elapsed_s;
+    } else {
+      cout << "";
+    }
+    cout << std::setprecision(3);
+    for (double percentile : kPercentiles) {
+      PrintMs(histograms[i]->Quantile(percentile / 100));
+    }
+    PrintMs(maxes[i]);
+    cout << endl;
+  }
+  cout << std::left << std::setw(22) << "" << result.sent << " sent, "
+       << result.answered << " answered (" << result.not_ok
+       << " not 2xx), " << result.failed << " failed" << std::right
+       << endl;
+  cout.unsetf(std::ios::fixed);
+}
@@ -6,25 +6,44 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <signal.h>
+#include <climits>
 #include <cstdlib>
 #include <cstdio>
 #include <iostream>
 #include <list>
+#include <map>
+#include <string>
 
 #include "./ServerSocket.h"
 #include "./HttpServer.h"
+#include "./SegmentSet.h"
 
 using std::cerr;
 using std::cout;
 using std::endl;
 using std::list;
+using std::map;
 using std::string;
 
 // Print out program usage, and exit() with EXIT_FAILURE.
 static void Usage(char* prog_name);
 
 // Parse command-line arguments to get port, path, and indices to use
-// for your http333d server.
+// for your http333d server.  Options come first:
+//
+//   -c prefix=value  send "Cache-Control: value" with static files whose
+//                    request path starts with prefix (repeatable)
+//   -z level         compress responses on the fly at zlib level 1-9, or
+//                    not at all (0)
+//   -r class=rate[/burst]
+//                    limit each client to "rate" connections (class
+//                    "connect") or requests ("static" or "query") a
+//                    second, in bursts of up to "burst" (repeatable)
+//   -l path          write the access log to the file "path", rather than
+//                    to standard output
+//   -t               send Server-Timing headers breaking down each request
+//   -s ms            log requests taking at least "ms" milliseconds as
+//                    "slow" events with their breakdown, or none (0)
 //
 // Params:
 // - argc: number of argumnets
@@ -32,6 +51,12 @@ static void Usage(char* prog_name);
 // - port: output parameter returning the port number to listen on
 // - path: output parameter returning the directory with our static files
 // - indices: output parameter returning the list of index file names
+// - cache_control: output parameter returning the -c rules
+// - compression_level: output parameter returning the -z level, if given
+// - rate_limits: output parameter returning the -r rates and bursts
+// - access_log: output parameter returning the -l path, if given
+// - server_timing: output parameter set if -t is given
+// - slow_request_ms: output parameter returning the -s threshold, if given
 //
 // Calls Usage() on failure. Possible errors include:
 // - path is not a readable directory
@@ -40,7 +65,14 @@ static void GetPortAndPath(int argc,
                     char** argv,
                     uint16_t* const port,
                     string* const path,
-                    list<string>* const indices);
+                    list<string>* const indices,
+                    map<string, string>* const cache_control,
+                    int* const compression_level,
+                    map<hw4::RateLimiter::Class,
+                        std::pair<double, double>>* const rate_limits,
+                    string* const access_log,
+                    bool* const server_timing,
+                    int* const slow_request_ms);
 
 int main(int argc, char** argv) {
   // Print out welcome message.
@@ -59,12 +91,36 @@ int main(int argc, char** argv) {
   uint16_t port_num;
   string static_dir;
   list<string> indices;
-  GetPortAndPath(argc, argv, &port_num, &static_dir, &indices);
+  map<string, string> cache_control;
+  int compression_level = -1;
+  map<hw4::RateLimiter::Class, std::pair<double, double>> rate_limits;
+  string access_log;
+  bool server_timing = false;
+  int slow_request_ms = -1;
+  GetPortAndPath(argc, argv, &port_num, &static_dir, &indices,
+                 &cache_control, &compression_level, &rate_limits,
+                 &access_log, &server_timing, &slow_request_ms);
   cout << "    port: " << port_num << endl;
   cout << "    path: " << static_dir << endl;
 
   // Run the server.
   hw4::HttpServer hs(port_num, static_dir, indices);
+  for (const auto& rule : cache_control) {
+    hs.SetCacheControl(rule.first, rule.second);
+  }
+  if (compression_level >= 0) {
+    hs.SetCompressionLevel(compression_level);
+  }
+  for (const auto& limit : rate_limits) {
+    hs.SetRateLimit(limit.first, limit.second.first, limit.second.second);
+  }
+  if (!access_log.empty()) {
+    hs.SetAccessLog(access_log);
+  }
+  hs.SetServerTiming(server_timing);
+  if (slow_request_ms >= 0) {
+    hs.SetSlowRequestThreshold(slow_request_ms);
+  }
   if (!hs.Run()) {
     cerr << "  server failed to run!?" << endl;
   }
@@ -75,7 +131,10 @@ int main(int argc, char** argv) {
 
 
 static void Usage(char* prog_name) {
-  cerr << "Usage: " << prog_name << " port staticfiles_directory indices+";
+  cerr << "Usage: " << prog_name << " [-c path_prefix=cache_control]..."
+       << " [-z compression_level] [-r class=rate[/burst]]..."
+       << " [-l access_log] [-t] [-s slow_request_ms]"
+       << " port staticfiles_directory indices+";
   cerr << endl;
   exit(EXIT_FAILURE);
 }
@@ -84,7 +143,14 @@ static void GetPortAndPath(int argc,
                     char** argv,
                     uint16_t* const port,
                     string* const path,
-                    list<string>* const indices) {
+                    list<string>* const indices,
+                    map<string, string>* const cache_control,
+                    int* const compression_level,
+                    map<hw4::RateLimiter::Class,
+                        std::pair<double, double>>* const rate_limits,
+                    string* const access_log,
+                    bool* const server_timing,
+                    int* const slow_request_ms) {
   // Here are some considerations when implementing this function:
   // - There is a reasonable number of command line arguments
   // - The port number is reasonable
@@ -92,29 +158,96 @@ static void GetPortAndPath(int argc,
   // - You have at least 1 index, and all indices are readable files
 
   // STEP 1:
+  // Pick off the options, leaving the positional arguments
+  char* prog_name = argv[0];
+  int opt;
+  while ((opt = getopt(argc, argv, "+c:z:r:l:ts:")) != -1) {
+    if (opt == 'r') {
+      // class=rate[/burst], where the burst defaults to the rate.
+      string limit = optarg;
+      size_t equals = limit.find('=');
+      string name = limit.substr(0, equals);
+      hw4::RateLimiter::Class work_class;
+      if (name == "connect") {
+        work_class = hw4::RateLimiter::kConnect;
+      } else if (name == "static") {
+        work_class = hw4::RateLimiter::kStatic;
+      } else if (name == "query") {
+        work_class = hw4::RateLimiter::kQuery;
+      } else {
+        Usage(prog_name);
+      }
+      char* end;
+      double rate = strtod(limit.c_str() + equals + 1, &end);
+      double burst = rate;
+      if (*end == '/') {
+        burst = strtod(end + 1, &end);
+      }
+      if (*end != '\0' || rate <= 0 || burst < 1) {
+        Usage(prog_name);
+      }
+      (*rate_limits)[work_class] = std::make_pair(rate, burst);
+      continue;
+    }
+    if (opt == 't') {
+      *server_timing = true;
+      continue;
+    }
+    if (opt == 's') {
+      char* end;
+      long ms = strtol(optarg, &end, 10);  // NOLINT(runtime/int)
+      if (*optarg == '\0' || *end != '\0' || ms < 0 || ms > INT_MAX) {
+        Usage(prog_name);
+      }
+      *slow_request_ms = static_cast<int>(ms);
+      continue;
+    }
+    if (opt == 'l') {
+      *access_log = optarg;
+      continue;
+    }
+    if (opt == 'z') {
+      string level = optarg;
+      if (level.size() != 1 || level[0] < '0' || level[0] > '9') {
+        Usage(prog_name);
+      }
+      *compression_level = level[0] - '0';
+      continue;
+    }
+    string rule = opt == 'c' ? optarg : "";
+    size_t equals = rule.find('=');
+    if (equals == string::npos || equals == 0) {
+      Usage(prog_name);
+    }
+    (*cache_control)[rule.substr(0, equals)] = rule.substr(equals + 1);
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
+
   // Checks if there is a reasonable number of command line arguments
   if (argc < 3) {
-    Usage(argv[0]);
+    Usage(prog_name);
   }
   // Checks if the port number is reasonable
   *port = static_cast<uint16_t>(std::stoi(argv[1]));
   if (*port < 0 || *port > 65535) {
     cerr << "portnum WRONG" << endl;
-    Usage(argv[0]);
+    Usage(prog_name);
   }
   // Checks if The path (i.e., argv[2]) is a readable directory
   struct stat sb;
   if (stat(argv[2], &sb) != 0) {
     cerr << "path WRONG" << endl;
-    Usage(argv[0]);
+    Usage(prog_name);
   }
   *path = string(argv[2]);
-  // Checks if all indices are readable files
+  // Checks if all indices are readable files or segment set directories
   for (int i = 3; i < argc; i++) {
-    if (stat(static_cast<string>(argv[i]).c_str(), &sb)
-          != 0 || (sb.st_mode & S_IFDIR)) {
+    string manifest = string(argv[i]) + "/" + hw4::SegmentSet::kManifestName;
+    if (stat(static_cast<string>(argv[i]).c_str(), &sb) != 0
+        || ((sb.st_mode & S_IFDIR) && access(manifest.c_str(), R_OK) != 0)) {
       cerr << "indicies WRONG" << endl;
-      Usage(argv[0]);
+      Usage(prog_name);
     }
     indices->push_back(string(argv[i]));
   }
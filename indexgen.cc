@@ -0,0 +1,144 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <unistd.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "./SyntheticCorpus.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+// Print out program usage, and exit() with EXIT_FAILURE.
+static void Usage(char* prog_name);
+
+// Parse command-line arguments to get the corpus options, the number of
+// indices to split it into, whether to write the documents out too, and
+// the output index.
+//
+// Calls Usage() on failure. Possible errors include:
+// - an unknown option, or an option value out of range
+// - no output index
+static void GetOptions(int argc,
+                       char** argv,
+                       hw4::CorpusOptions* const options,
+                       int* const num_indices,
+                       bool* const write_corpus,
+                       string* const output);
+
+// Returns the name of index "i" of "num_indices" named after "output":
+// "output" itself if there's just one, and "out-0.idx", "out-1.idx" and so
+// on for an "output" of "out.idx" if there are more.
+static string IndexName(const string& output, int i, int num_indices);
+
+int main(int argc, char** argv) {
+  hw4::CorpusOptions options;
+  int num_indices = 1;
+  bool write_corpus = false;
+  string output;
+  GetOptions(argc, argv, &options, &num_indices, &write_corpus, &output);
+  hw4::SyntheticCorpus corpus(options);
+
+  if (write_corpus) {
+    cout << "writing " << options.num_docs << " documents to "
+         << options.doc_dir << "/..." << endl;
+    if (!corpus.WriteCorpus()) {
+      cerr << "  couldn't write the documents!" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Each index gets an equal share of the documents, give or take one.
+  int64_t total = 0;
+  for (int i = 0; i < num_indices; i++) {
+    int first = static_cast<int64_t>(options.num_docs) * i / num_indices;
+    int end = static_cast<int64_t>(options.num_docs) * (i + 1) / num_indices;
+    string name = IndexName(output, i, num_indices);
+    cout << "indexing documents " << first << " to " << end - 1 << " into "
+         << name << "..." << endl;
+    int size = corpus.WriteIndex(first, end - first, name);
+    if (size < 0) {
+      cerr << "  write failed (an index can't grow past 2 GiB;"
+           << " try more indices with -n)!" << endl;
+      return EXIT_FAILURE;
+    }
+    total += size;
+  }
+  cout << "wrote " << total << " bytes." << endl;
+  return EXIT_SUCCESS;
+}
+
+static void Usage(char* prog_name) {
+  cerr << "Usage: " << prog_name << " [-d num_docs] [-w vocabulary_size]"
+       << " [-p positions_per_doc] [-z zipf_exponent] [-s seed]"
+       << " [-n num_indices] [-c corpus_dir] output_index";
+  cerr << endl;
+  exit(EXIT_FAILURE);
+}
+
+static void GetOptions(int argc,
+                       char** argv,
+                       hw4::CorpusOptions* const options,
+                       int* const num_indices,
+                       bool* const write_corpus,
+                       string* const output) {
+  int opt;
+  while ((opt = getopt(argc, argv, "d:w:p:z:s:n:c:")) != -1) {
+    switch (opt) {
+      case 'd':
+        options->num_docs = atoi(optarg);
+        break;
+      case 'w':
+        options->vocabulary_size = atoi(optarg);
+        break;
+      case 'p':
+        options->positions_per_doc = atoi(optarg);
+        break;
+      case 'z':
+        options->zipf_exponent = atof(optarg);
+        break;
+      case 's':
+        options->seed = strtoul(optarg, nullptr, 10);
+        break;
+      case 'n':
+        *num_indices = atoi(optarg);
+        break;
+      case 'c':
+        options->doc_dir = optarg;
+        *write_corpus = true;
+        break;
+      default:
+        Usage(argv[0]);
+    }
+  }
+  if (options->num_docs <= 0 || options->vocabulary_size <= 0
+      || options->positions_per_doc <= 0
+      || options->positions_per_doc > hw4::SyntheticCorpus::MaxPositionsPerDoc(
+             options->vocabulary_size)
+      || options->zipf_exponent < 0 || *num_indices <= 0
+      || *num_indices > options->num_docs) {
+    Usage(argv[0]);
+  }
+
+  if (argc - optind != 1) {
+    Usage(argv[0]);
+  }
+  *output = argv[optind];
+}
+
+static string IndexName(const string& output, int i, int num_indices) {
+  if (num_indices == 1) {
+    return output;
+  }
+  string base = output;
+  string suffix = ".idx";
+  if (base.size() > suffix.size()
+      && base.compare(base.size() - suffix.size(), suffix.size(), suffix)
+         == 0) {
+    base.resize(base.size() - suffix.size());
+  }
+  return base + "-" + std::to_string(i) + suffix;
+}
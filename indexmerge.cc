@@ -0,0 +1,89 @@
+// Jolie Davison jdavi@cs.washington.edu Copyright 2024 Jolie Davison
+
+#include <unistd.h>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <string>
+
+#include "./IndexMerger.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::list;
+using std::string;
+
+// Print out program usage, and exit() with EXIT_FAILURE.
+static void Usage(char* prog_name);
+
+// Parse command-line arguments to get the merge options, the output index
+// and the input indices.
+//
+// Calls Usage() on failure. Possible errors include:
+// - an unknown option, or an option value that isn't a positive number
+// - fewer than one input index
+static void GetOptions(int argc,
+                       char** argv,
+                       hw4::MergeOptions* const options,
+                       string* const output,
+                       list<string>* const inputs);
+
+int main(int argc, char** argv) {
+  hw4::MergeOptions options;
+  string output;
+  list<string> inputs;
+  GetOptions(argc, argv, &options, &output, &inputs);
+
+  // This is a background compaction job, so stay out of the way of the
+  // servers reading these indices: lower our CPU priority, and let the
+  // -r flag cap our read bandwidth.
+  if (nice(10) == -1) {
+    cerr << "  couldn't lower priority; continuing anyway" << endl;
+  }
+
+  cout << "merging " << inputs.size() << " indices into " << output
+       << "..." << endl;
+  int size = hw4::MergeIndices(inputs, output, options);
+  if (size < 0) {
+    cerr << "  merge failed!" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << "wrote " << size << " bytes." << endl;
+  return EXIT_SUCCESS;
+}
+
+static void Usage(char* prog_name) {
+  cerr << "Usage: " << prog_name << " [-m budget_mb] [-r read_mb_per_sec]"
+       << " output_index input_indices+";
+  cerr << endl;
+  exit(EXIT_FAILURE);
+}
+
+static void GetOptions(int argc,
+                       char** argv,
+                       hw4::MergeOptions* const options,
+                       string* const output,
+                       list<string>* const inputs) {
+  int opt;
+  while ((opt = getopt(argc, argv, "m:r:")) != -1) {
+    double mb = (opt == 'm' || opt == 'r') ? atof(optarg) : 0;
+    if (mb <= 0) {
+      Usage(argv[0]);
+    }
+    if (opt == 'm') {
+      options->memory_budget = static_cast<size_t>(mb * (1 << 20));
+    } else {
+      options->max_read_bytes_per_sec = static_cast<int64_t>(mb * (1 << 20));
+    }
+  }
+
+  // The output, then at least one input.
+  if (argc - optind < 2) {
+    Usage(argv[0]);
+  }
+  *output = argv[optind];
+  for (int i = optind + 1; i < argc; i++) {
+    inputs->push_back(argv[i]);
+  }
+}
@@ -0,0 +1,167 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "./AccessLog.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+// Returns the lines of the file "path".
+static vector<string> ReadLines(const string& path) {
+  std::ifstream in(path);
+  vector<string> lines;
+  string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// Returns a scratch file name for "test", with no file there yet.
+static string ScratchLog(const string& test) {
+  string path = "./test_accesslog_" + test + "_"
+    + std::to_string(getpid()) + ".log";
+  unlink(path.c_str());
+  for (int i = 1; i <= AccessLog::kKeepFiles; i++) {
+    unlink((path + "." + std::to_string(i)).c_str());
+  }
+  return path;
+}
+
+TEST(Test_AccessLog, WritesJsonLines) {
+  string path = ScratchLog("json");
+  {
+    AccessLog log(path, 0, 0);
+    ASSERT_TRUE(log.ok());
+
+    AccessLogRecord connect;
+    connect.event = "connect";
+    connect.client = "::1";
+    connect.port = 4242;
+    log.Log(std::move(connect));
+
+    AccessLogRecord request;
+    request.event = "request";
+    request.client = "::1";
+    request.method = "GET";
+    request.uri = "/query?terms=\"quoted\"";
+    request.status = 200;
+    request.bytes = 1234;
+    request.duration_us = 56;
+    request.time_ns = uint64_t(1700000000) * 1000000000 + 123456789;
+    log.Log(std::move(request));
+  }
+
+  vector<string> lines = ReadLines(path);
+  ASSERT_EQ(2U, lines.size());
+  ASSERT_EQ(0U, lines[0].find("{\"time\":\""));
+  ASSERT_NE(string::npos, lines[0].find(
+      "\"event\":\"connect\",\"client\":\"::1\",\"port\":4242}"));
+  ASSERT_EQ("{\"time\":\"2023-11-14T22:13:20.123Z\",\"event\":\"request\","
+            "\"client\":\"::1\",\"method\":\"GET\","
+            "\"uri\":\"/query?terms=\\\"quoted\\\"\",\"status\":200,"
+            "\"bytes\":1234,\"us\":56}", lines[1]);
+  unlink(path.c_str());
+}
+
+// Logs kRecordsPerThread records to the AccessLog "log".
+static const int kRecordsPerThread = 500;
+static void* LogRecords(void* log) {
+  for (int i = 0; i < kRecordsPerThread; i++) {
+    AccessLogRecord record;
+    record.event = "request";
+    record.status = i;
+    static_cast<AccessLog*>(log)->Log(std::move(record));
+    if (i % 100 == 0) {
+      usleep(1000);
+    }
+  }
+  return nullptr;
+}
+
+TEST(Test_AccessLog, ManyThreads) {
+  static const int kNumThreads = 8;
+  string path = ScratchLog("threads");
+  {
+    AccessLog log(path, 0, 0);
+    pthread_t threads[kNumThreads];
+    for (pthread_t& thread : threads) {
+      ASSERT_EQ(0, pthread_create(&thread, nullptr, &LogRecords, &log));
+    }
+    for (pthread_t& thread : threads) {
+      ASSERT_EQ(0, pthread_join(thread, nullptr));
+    }
+    usleep(3 * AccessLog::kFlushMs * 1000);
+    ASSERT_EQ(uint64_t(kNumThreads * kRecordsPerThread), log.written());
+    ASSERT_EQ(0U, log.dropped());
+  }
+
+  vector<string> lines = ReadLines(path);
+  ASSERT_EQ(size_t(kNumThreads * kRecordsPerThread), lines.size());
+  unlink(path.c_str());
+}
+
+TEST(Test_AccessLog, CountsDrops) {
+  string path = ScratchLog("drops");
+  uint64_t num_logged = 3 * AccessLog::kRingSize;
+  uint64_t written, dropped;
+  {
+    AccessLog log(path, 0, 0);
+    for (uint64_t i = 0; i < num_logged; i++) {
+      AccessLogRecord record;
+      record.event = "request";
+      log.Log(std::move(record));
+    }
+    usleep(3 * AccessLog::kFlushMs * 1000);
+    written = log.written();
+    dropped = log.dropped();
+  }
+
+  // Nothing goes missing without being counted, and the log says so.
+  ASSERT_GT(dropped, 0U);
+  ASSERT_EQ(num_logged, written + dropped);
+  vector<string> lines = ReadLines(path);
+  ASSERT_EQ(written + 1, lines.size());
+  ASSERT_NE(string::npos, lines.back().find(
+      "\"event\":\"dropped\",\"detail\":\"" + std::to_string(dropped)
+      + " records dropped\""));
+  unlink(path.c_str());
+}
+
+TEST(Test_AccessLog, RotatesBySize) {
+  string path = ScratchLog("rotate");
+  {
+    AccessLog log(path, 1000, 0);
+    for (int batch = 0; batch < 3; batch++) {
+      for (int i = 0; i < 20; i++) {
+        AccessLogRecord record;
+        record.event = "request";
+        record.uri = "/static/a/fairly/long/path/to/a/file.html";
+        log.Log(std::move(record));
+      }
+      usleep(2 * AccessLog::kFlushMs * 1000);
+    }
+  }
+
+  // Each batch overflows the limit, so starts a file of its own.
+  ASSERT_EQ(20U, ReadLines(path).size());
+  ASSERT_EQ(20U, ReadLines(path + ".1").size());
+  ASSERT_EQ(20U, ReadLines(path + ".2").size());
+  ASSERT_TRUE(ReadLines(path + ".3").empty());
+  unlink(path.c_str());
+  unlink((path + ".1").c_str());
+  unlink((path + ".2").c_str());
+}
+
+}  // namespace hw4
@@ -0,0 +1,126 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "./Compression.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::shared_ptr;
+using std::string;
+
+namespace hw4 {
+
+// Decompresses gzip or zlib data "in", returning false on error.
+static bool Decompress(const string& in, string* out) {
+  z_stream stream = {};
+  // 32 means detect either header.
+  if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+    return false;
+  }
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  stream.avail_in = in.size();
+  out->clear();
+  int res;
+  do {
+    char buf[4096];
+    stream.next_out = reinterpret_cast<Bytef*>(buf);
+    stream.avail_out = sizeof(buf);
+    res = inflate(&stream, Z_NO_FLUSH);
+    out->append(buf, sizeof(buf) - stream.avail_out);
+  } while (res == Z_OK && stream.avail_in > 0);
+  inflateEnd(&stream);
+  return res == Z_STREAM_END || (res == Z_OK && stream.avail_in == 0);
+}
+
+TEST(Test_Compression, NegotiateEncoding) {
+  ASSERT_EQ("gzip", NegotiateEncoding("gzip, deflate, br"));
+  ASSERT_EQ("gzip", NegotiateEncoding("deflate, gzip"));
+  ASSERT_EQ("deflate", NegotiateEncoding("deflate"));
+  ASSERT_EQ("deflate", NegotiateEncoding("gzip;q=0.5, deflate;q=0.8"));
+  ASSERT_EQ("deflate", NegotiateEncoding("gzip;q=0, *"));
+  ASSERT_EQ("gzip", NegotiateEncoding("*"));
+  ASSERT_EQ("gzip", NegotiateEncoding("x-gzip"));
+  ASSERT_EQ("", NegotiateEncoding(""));
+  ASSERT_EQ("", NegotiateEncoding("identity, br"));
+  ASSERT_EQ("", NegotiateEncoding("gzip;q=0, deflate;q=0"));
+  ASSERT_EQ("", NegotiateEncoding("*;q=0"));
+}
+
+TEST(Test_Compression, CompressibleTypes) {
+  ASSERT_TRUE(IsCompressibleType("text/html"));
+  ASSERT_TRUE(IsCompressibleType("application/json"));
+  ASSERT_TRUE(IsCompressibleType("application/xml"));
+  ASSERT_FALSE(IsCompressibleType("image/png"));
+  ASSERT_FALSE(IsCompressibleType("multipart/byteranges; boundary=x"));
+  ASSERT_FALSE(IsCompressibleType(""));
+}
+
+TEST(Test_Compression, RoundTrips) {
+  string text;
+  for (int i = 0; i < 2000; i++) {
+    text += "<div>result " + std::to_string(i) + "</div>\n";
+  }
+  for (const char* encoding : {kGzipEncoding, kDeflateEncoding}) {
+    string compressed, decompressed;
+    ASSERT_TRUE(Compress(text.data(), text.size(), encoding, 6,
+                         &compressed));
+    ASSERT_LT(compressed.size(), text.size() / 4);
+    ASSERT_EQ(string(encoding) == kGzipEncoding,
+              compressed.compare(0, 2, "\x1f\x8b") == 0);
+    ASSERT_TRUE(Decompress(compressed, &decompressed));
+    ASSERT_EQ(text, decompressed);
+  }
+
+  // A stream decompresses up to each flush as soon as it arrives.
+  StreamCompressor stream(kGzipEncoding, 6);
+  string out, decompressed;
+  ASSERT_TRUE(stream.Compress(text.substr(0, 1000), false, &out));
+  ASSERT_TRUE(Decompress(out, &decompressed));
+  ASSERT_EQ(text.substr(0, 1000), decompressed);
+  ASSERT_TRUE(stream.Compress(text.substr(1000), false, &out));
+  ASSERT_TRUE(stream.Compress("", true, &out));
+  ASSERT_TRUE(Decompress(out, &decompressed));
+  ASSERT_EQ(text, decompressed);
+}
+
+TEST(Test_Compression, CompressedFileCache) {
+  string file = "test_files/gzip_cache.txt";
+  string text(50000, 'x');
+  {
+    std::ofstream out(file);
+    out << text;
+  }
+  int fd = open(file.c_str(), O_RDONLY);
+  ASSERT_NE(-1, fd);
+
+  CompressedFileCache cache(1000);
+  shared_ptr<const string> first = cache.Get("a", fd, text.size(), 6);
+  ASSERT_NE(nullptr, first);
+  string decompressed;
+  ASSERT_TRUE(Decompress(*first, &decompressed));
+  ASSERT_EQ(text, decompressed);
+  ASSERT_EQ(first->size(), cache.size_bytes());
+
+  // A hit hands back the same copy.
+  ASSERT_EQ(first, cache.Get("a", fd, text.size(), 6));
+
+  // Going over the limit drops the least recently used entries.
+  size_t per_entry = first->size();
+  int fits = 1000 / per_entry;
+  for (int i = 0; i < fits; i++) {
+    cache.Get("b" + std::to_string(i), fd, text.size(), 6);
+  }
+  ASSERT_LE(cache.size_bytes(), 1000U);
+  ASSERT_NE(first, cache.Get("a", fd, text.size(), 6));
+
+  close(fd);
+  unlink(file.c_str());
+}
+
+}  // namespace hw4
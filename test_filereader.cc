@@ -1,3 +1,5 @@
+#include <sys/stat.h>
+
 #include "./FileReader.h"
 
 #include "gtest/gtest.h"
@@ -36,4 +38,19 @@ TEST(Test_FileReader, TestFileReaderBasic) {
   HW4Environment::AddPoints(5);
 }
 
+TEST(Test_FileReader, Stat) {
+  struct stat info;
+  FileReader f(".", "test_files/transparent.gif");
+  ASSERT_TRUE(f.Stat(&info));
+  ASSERT_EQ(43, info.st_size);
+
+  // Directories, missing files and paths outside base_dir are refused.
+  f = FileReader(".", "test_files");
+  ASSERT_FALSE(f.Stat(&info));
+  f = FileReader(".", "non-existent");
+  ASSERT_FALSE(f.Stat(&info));
+  f = FileReader("./libhw2", "./libhw2/../cpplint.py");
+  ASSERT_FALSE(f.Stat(&info));
+}
+
 }  // namespace hw4
@@ -2,10 +2,17 @@ extern "C" {
 #include <pthread.h>  // for the pthread threading/mutex functions
 }
 
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
 #include <unistd.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <fstream>
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "./HttpConnection.h"
 
@@ -13,9 +20,11 @@ extern "C" {
 #include "./HttpRequest.h"
 #include "./HttpResponse.h"
 #include "./HttpUtils.h"
+#include "./Metrics.h"
 #include "./test_suite.h"
 
 using std::string;
+using std::vector;
 
 namespace hw4 {
 
@@ -147,6 +156,263 @@ TEST(Test_HttpConnection, TestHttpConnectionBasic) {
   HW4Environment::AddPoints(10);
 }
 
+TEST(Test_HttpConnection, RequestBodies) {
+  int spair[2] = {-1, -1};
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, spair));
+  HttpConnection hc(spair[0]);
+
+  // A POST with a body, pipelined with a GET that has none.
+  string reqs = "POST /api/batch HTTP/1.1\r\n";
+  reqs += "Content-Length: 19\r\n";
+  reqs += "\r\n";
+  reqs += "apple\r\n\r\nbanana pie";
+  reqs += "GET /foo HTTP/1.1\r\n";
+  reqs += "\r\n";
+  reqs += "POST /bar HTTP/1.1\r\n";
+  reqs += "Content-Length: 12x\r\n";
+  reqs += "\r\n";
+  ASSERT_EQ(static_cast<int>(reqs.size()),
+            WrappedWrite(spair[1],
+                         (unsigned char*) reqs.c_str(),
+                         static_cast<int>(reqs.size())));
+
+  HttpRequest post, get, bad;
+  ASSERT_TRUE(hc.GetNextRequest(&post));
+  ASSERT_EQ("POST", post.method());
+  ASSERT_EQ("/api/batch", post.uri());
+  ASSERT_EQ("apple\r\n\r\nbanana pie", post.body());
+
+  ASSERT_TRUE(hc.GetNextRequest(&get));
+  ASSERT_EQ("GET", get.method());
+  ASSERT_EQ("/foo", get.uri());
+  ASSERT_EQ("", get.body());
+
+  // A malformed length can't be skipped over, so it ends the connection.
+  ASSERT_FALSE(hc.GetNextRequest(&bad));
+
+  close(spair[1]);
+}
+
+TEST(Test_HttpConnection, Timeouts) {
+  ConnectionReaper reaper(10);
+  ConnectionTimeouts timeouts = {100, 200, 100};
+  int spair[2] = {-1, -1};
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, spair));
+  HttpConnection hc(spair[0], &reaper, timeouts);
+
+  // A prompt request is answered however long the client idled first.
+  string req = "GET /foo HTTP/1.1\r\n\r\n";
+  ASSERT_EQ(static_cast<int>(req.size()),
+            WrappedWrite(spair[1], (unsigned char*) req.c_str(),
+                         static_cast<int>(req.size())));
+  HttpRequest request;
+  ASSERT_TRUE(hc.GetNextRequest(&request));
+  ASSERT_EQ("/foo", request.uri());
+  ASSERT_EQ(0U, reaper.armed());
+  ASSERT_EQ(ConnectionReaper::kNumPhases, hc.timed_out());
+
+  // A request that never finishes runs into the read timeout, even
+  // though the client keeps sending.
+  req = "GET /bar HTTP/1.1\r\nX-Slow: ";
+  ASSERT_EQ(static_cast<int>(req.size()),
+            WrappedWrite(spair[1], (unsigned char*) req.c_str(),
+                         static_cast<int>(req.size())));
+  pthread_t trickler;
+  ASSERT_EQ(0, pthread_create(&trickler, nullptr, [](void* fd) -> void* {
+      // Send a byte every 50ms until the connection is shut down.
+      while (send(*static_cast<int*>(fd), "x", 1, MSG_NOSIGNAL) == 1) {
+        usleep(50000);
+      }
+      return nullptr;
+    }, &spair[1]));
+  ASSERT_FALSE(hc.GetNextRequest(&request));
+  ASSERT_EQ(ConnectionReaper::kRead, hc.timed_out());
+  ASSERT_EQ(1U, reaper.expired(ConnectionReaper::kRead));
+  ASSERT_EQ(0U, reaper.expired(ConnectionReaper::kIdle));
+  ASSERT_EQ(0, pthread_join(trickler, nullptr));
+  close(spair[1]);
+
+  // A silent client runs into the idle timeout.
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, spair));
+  {
+    HttpConnection idle(spair[0], &reaper, timeouts);
+    ASSERT_FALSE(idle.GetNextRequest(&request));
+    ASSERT_EQ(ConnectionReaper::kIdle, idle.timed_out());
+    ASSERT_EQ(1U, reaper.expired(ConnectionReaper::kIdle));
+  }
+  close(spair[1]);
+
+  // A client that closes without a request hasn't timed out.
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, spair));
+  {
+    HttpConnection closed(spair[0], &reaper, timeouts);
+    close(spair[1]);
+    ASSERT_FALSE(closed.GetNextRequest(&request));
+    ASSERT_EQ(ConnectionReaper::kNumPhases, closed.timed_out());
+  }
+}
+
+TEST(Test_HttpConnection, Rejections) {
+  ConnectionReaper reaper(10);
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_NE(-1, listen_fd);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(0, bind(listen_fd, reinterpret_cast<sockaddr*>(&addr),
+                    addr_len));
+  ASSERT_EQ(0, listen(listen_fd, 128));
+  ASSERT_EQ(0, getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr),
+                           &addr_len));
+  auto Connect = [&addr]() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&addr),
+                         sizeof(addr)));
+    return fd;
+  };
+
+  HttpResponse response;
+  response.set_protocol("HTTP/1.1");
+  response.set_response_code(503);
+  response.set_message("Service Unavailable");
+  response.AddHeader("Connection", "close");
+
+  // Flood the listener with clients that send part of a request and then
+  // wait, never closing their ends, and queue a well-behaved client
+  // behind them.
+  const int kFlood = 100;
+  string req = "POST / HTTP/1.1\r\nContent-Length: 100000\r\n\r\nxyz";
+  vector<int> flood;
+  for (int i = 0; i < kFlood; i++) {
+    flood.push_back(Connect());
+    ASSERT_EQ(static_cast<ssize_t>(req.size()),
+              send(flood.back(), req.data(), req.size(), 0));
+  }
+  int client_fd = Connect();
+
+  // Turning the flood away doesn't hold up accepting the client.
+  uint64_t start_ns = MonotonicNs();
+  for (int i = 0; i < kFlood; i++) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    ASSERT_NE(-1, fd);
+    HttpConnection::Reject(fd, response, &reaper);
+  }
+  int accepted_fd = accept(listen_fd, nullptr, nullptr);
+  ASSERT_NE(-1, accepted_fd);
+  ASSERT_LT(MonotonicNs() - start_ns, 100000000U);
+  ASSERT_EQ(static_cast<uint64_t>(kFlood), reaper.lingering());
+  close(accepted_fd);
+  close(client_fd);
+  close(listen_fd);
+
+  // Each rejected client reads its response, not a reset, and the
+  // connection is closed once the client closes its end.
+  struct timeval timeout = {5, 0};
+  char buf[64];
+  for (int fd : flood) {
+    ASSERT_EQ(0, setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                            sizeof(timeout)));
+    ASSERT_EQ(12, recv(fd, buf, 12, MSG_WAITALL));
+    ASSERT_EQ("HTTP/1.1 503", string(buf, 12));
+  }
+  for (int i = 0; i < kFlood - 1; i++) {
+    close(flood[i]);
+  }
+  for (int i = 0; i < 100 && reaper.lingering() > 1; i++) {
+    usleep(10000);
+  }
+  ASSERT_EQ(1U, reaper.lingering());
+
+  // A client that never closes is given up on.
+  usleep(ConnectionReaper::kLingerMs * 1000);
+  for (int i = 0; i < 100 && reaper.lingering() > 0; i++) {
+    usleep(10000);
+  }
+  ASSERT_EQ(0U, reaper.lingering());
+  close(flood.back());
+}
+
+TEST(Test_HttpConnection, StreamedResponses) {
+  int spair[2] = {-1, -1};
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, spair));
+  HttpConnection hc(spair[0]);
+
+  HttpResponse rep;
+  rep.set_protocol("HTTP/1.1");
+  rep.set_response_code(200);
+  rep.set_message("OK");
+  rep.set_content_type("text/plain");
+  rep.set_body_stream([](string* body, const std::function<bool()>& flush) {
+      body->append("Hi t");
+      ASSERT_TRUE(flush());
+      ASSERT_TRUE(flush());  // nothing to send
+      body->append("here, ");
+      ASSERT_TRUE(flush());
+      body->append("everyone!!");
+    });
+  string expected = "HTTP/1.1 200 OK\r\n";
+  expected += "Content-type: text/plain\r\n";
+  expected += "Transfer-Encoding: chunked\r\n\r\n";
+  expected += "4\r\nHi t\r\n";
+  expected += "6\r\nhere, \r\n";
+  expected += "a\r\neveryone!!\r\n";
+  expected += "0\r\n\r\n";
+  ASSERT_EQ(expected, rep.GenerateResponseString());
+
+  ASSERT_TRUE(hc.WriteResponse(rep));
+  unsigned char buf[1024] = { 0 };
+  int len = 0;
+  while (len < static_cast<int>(expected.size())) {
+    int res = WrappedRead(spair[1], buf + len, sizeof(buf) - len);
+    ASSERT_LT(0, res);
+    len += res;
+  }
+  ASSERT_EQ(expected, string(reinterpret_cast<char*>(buf), len));
+
+  close(spair[1]);
+}
+
+TEST(Test_HttpConnection, FileBodies) {
+  int spair[2] = {-1, -1};
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, spair));
+  HttpConnection hc(spair[0]);
+
+  // "0123456789" around a stretch of file and after another.
+  string file = "test_files/file_body.txt";
+  {
+    std::ofstream out(file);
+    out << "abcdefghijklmnopqrstuvwxyz";
+  }
+  HttpResponse rep;
+  rep.set_protocol("HTTP/1.1");
+  rep.set_response_code(206);
+  rep.set_message("Partial Content");
+  rep.set_body_file(open(file.c_str(), O_RDONLY));
+  rep.AppendToBody("01234");
+  rep.AppendFileToBody(2, 3);
+  rep.AppendToBody("56789");
+  rep.AppendFileToBody(20, 6);
+  ASSERT_EQ(19U, rep.content_length());
+  string expected = "HTTP/1.1 206 Partial Content\r\n";
+  expected += "Content-length: 19\r\n\r\n";
+  expected += "01234cde56789uvwxyz";
+  ASSERT_EQ(expected, rep.GenerateResponseString());
+
+  ASSERT_TRUE(hc.WriteResponse(rep));
+  unsigned char buf[1024] = { 0 };
+  int len = 0;
+  while (len < static_cast<int>(expected.size())) {
+    int res = WrappedRead(spair[1], buf + len, sizeof(buf) - len);
+    ASSERT_LT(0, res);
+    len += res;
+  }
+  ASSERT_EQ(expected, string(reinterpret_cast<char*>(buf), len));
+
+  close(spair[1]);
+  unlink(file.c_str());
+}
+
 TEST(Test_HttpConnection, TestHttpConnectionPartialRead) {
   HW4Environment::OpenTestCase();
 
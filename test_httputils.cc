@@ -3,6 +3,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string>
+#include <vector>
 
 #include "./HttpUtils.h"
 #include "./FileReader.h"
@@ -11,6 +12,7 @@
 #include "./test_suite.h"
 
 using std::string;
+using std::vector;
 
 namespace hw4 {
 
@@ -32,6 +34,33 @@ TEST(Test_HttpUtils, TestHttpUtilsURIDecode) {
   ASSERT_EQ(string("  blah blah"), URIDecode(spacey));
 }
 
+TEST(Test_HttpUtils, TestHttpUtilsAppendEscaped) {
+  // Escaping and decoding append to what's there already.
+  string out("<b>");
+  AppendHtmlEscaped(&out, "Tom's <&> \"Jerry\"", 17);
+  ASSERT_EQ("<b>Tom&apos;s &lt;&amp;&gt; &quot;Jerry&quot;", out);
+  out = "q=";
+  AppendURIDecoded(&out, "a+b%20c%2", 9);
+  ASSERT_EQ("q=a b c%2", out);
+
+  // Bytes that need work are found wherever they fall in a long string,
+  // including either side of each 16-byte block.
+  for (size_t pos = 0; pos < 40; pos++) {
+    string clean(40, 'x');
+    string html = clean, uri = clean;
+    html[pos] = '<';
+    uri.replace(pos, 1, "%41");
+    ASSERT_EQ(clean.substr(0, pos) + "&lt;" + clean.substr(pos + 1),
+              EscapeHtml(html));
+    ASSERT_EQ(clean.substr(0, pos) + "A" + clean.substr(pos + 1),
+              URIDecode(uri));
+  }
+  string upper(100, '%');
+  ASSERT_EQ(upper, URIDecode(upper));
+  ASSERT_EQ(string(50, ' '), URIDecode(string(50, '+')));
+  ASSERT_EQ("%1z%G0\x80", URIDecode("%1z%G0\x80"));
+}
+
 TEST(Test_HttpUtils, TestHttpUtilsURLParser) {
   // Test out URL parsing.
   string easy("/foo/bar");
@@ -43,28 +72,63 @@ TEST(Test_HttpUtils, TestHttpUtilsURLParser) {
   URLParser p;
   p.Parse(easy);
   ASSERT_EQ("/foo/bar", p.path());
-  ASSERT_EQ((unsigned) 0, p.args().size());
+  ASSERT_EQ((unsigned) 0, p.num_args());
 
   p.Parse(tricky);
   ASSERT_EQ("/foo/bar", p.path());
-  ASSERT_EQ((unsigned) 0, p.args().size());
+  ASSERT_EQ((unsigned) 0, p.num_args());
 
   p.Parse(query);
   ASSERT_EQ("/foo/bar", p.path());
-  ASSERT_EQ((unsigned) 1, p.args().size());
-  ASSERT_EQ("blah blah", p.args()["foo"]);
+  ASSERT_EQ((unsigned) 1, p.num_args());
+  ASSERT_EQ("blah blah", p.arg("foo"));
 
   p.Parse(many);
   ASSERT_EQ("/foo/bar", p.path());
-  ASSERT_EQ((unsigned) 2, p.args().size());
-  ASSERT_EQ("bar", p.args()["foo"]);
-  ASSERT_EQ("baz", p.args()["bam"]);
+  ASSERT_EQ((unsigned) 2, p.num_args());
+  ASSERT_EQ("bar", p.arg("foo"));
+  ASSERT_EQ("baz", p.arg("bam"));
 
   p.Parse(manyshort);
   ASSERT_EQ("/foo/bar", p.path());
-  ASSERT_EQ((unsigned) 2, p.args().size());
-  ASSERT_EQ("\"bar\"", p.args()["foo"]);
-  ASSERT_EQ("baz", p.args()["bam"]);
+  ASSERT_EQ((unsigned) 2, p.num_args());
+  ASSERT_EQ("\"bar\"", p.arg("foo"));
+  ASSERT_EQ("baz", p.arg("bam"));
+}
+
+TEST(Test_HttpUtils, TestHttpUtilsURLParserArgs) {
+  URLParser p;
+
+  // The path and args are views into the url, decoded only as needed.
+  string url("/foo/bar?terms=a+b&n=3");
+  p.Parse(url);
+  ASSERT_EQ("/foo/bar", p.path());
+  ASSERT_EQ(url.data(), p.path().data());
+  ASSERT_EQ("a b", p.arg("terms"));
+  ASSERT_EQ("3", p.arg("n"));
+  ASSERT_TRUE(p.has_arg("n"));
+  ASSERT_FALSE(p.has_arg("missing"));
+  ASSERT_EQ("", p.arg("missing"));
+  string encoded("/a%20b?%74erms=%22x%22");
+  p.Parse(encoded);
+  ASSERT_EQ("/a b", p.path());
+  ASSERT_EQ("\"x\"", p.arg("terms"));
+
+  // Chunks without exactly one '=' are skipped, and so is anything after
+  // a second '?'.  The last of a repeated field wins.
+  p.Parse("/p?a&b=1=2&c=&=d&e=5?f=6");
+  ASSERT_EQ((unsigned) 3, p.num_args());
+  ASSERT_FALSE(p.has_arg("a"));
+  ASSERT_FALSE(p.has_arg("b"));
+  ASSERT_TRUE(p.has_arg("c"));
+  ASSERT_EQ("", p.arg("c"));
+  ASSERT_EQ("d", p.arg(""));
+  ASSERT_EQ("5", p.arg("e"));
+  ASSERT_FALSE(p.has_arg("f"));
+  p.Parse("/p?k=1&k=2&%6B=3&k=4");
+  ASSERT_EQ("4", p.arg("k"));
+  p.Parse("/p?k=1&%6B=3");
+  ASSERT_EQ("3", p.arg("k"));
 }
 
 TEST(Test_HttpUtils, TestHttpUtilsIsPathSafe) {
@@ -134,6 +198,60 @@ TEST(Test_HttpUtils, TestEscapeHtml) {
   HW4Environment::AddPoints(15);
 }
 
+TEST(Test_HttpUtils, TestEscapeJson) {
+  ASSERT_EQ("plain text", EscapeJson("plain text"));
+  ASSERT_EQ("say \\\"hi\\\"", EscapeJson("say \"hi\""));
+  ASSERT_EQ("C:\\\\dir", EscapeJson("C:\\dir"));
+  ASSERT_EQ("a\\nb\\tc\\u0001", EscapeJson("a\nb\tc\x01"));
+  ASSERT_EQ("caf\xc3\xa9", EscapeJson("caf\xc3\xa9"));
+}
+
+TEST(Test_HttpUtils, TestHttpDates) {
+  ASSERT_EQ("Sun, 06 Nov 1994 08:49:37 GMT", FormatHttpDate(784111777));
+  time_t t;
+  ASSERT_TRUE(ParseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", &t));
+  ASSERT_EQ(784111777, t);
+  ASSERT_TRUE(ParseHttpDate("sun, 06 nov 1994 08:49:37 gmt", &t));
+  ASSERT_EQ(784111777, t);
+  ASSERT_FALSE(ParseHttpDate("Sun, 06 Nov 1994", &t));
+  ASSERT_FALSE(ParseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT trailing", &t));
+  ASSERT_FALSE(ParseHttpDate("", &t));
+}
+
+// Flattens "ranges" to "first-last,first-last,...".
+static string RangesString(const vector<ByteRange>& ranges) {
+  string out;
+  for (const ByteRange& range : ranges) {
+    out += (out.empty() ? "" : ",") + std::to_string(range.first) + "-"
+      + std::to_string(range.last);
+  }
+  return out;
+}
+
+TEST(Test_HttpUtils, TestParseByteRanges) {
+  vector<ByteRange> ranges;
+  ASSERT_TRUE(ParseByteRanges("bytes=0-99", 1000, &ranges));
+  ASSERT_EQ("0-99", RangesString(ranges));
+  ASSERT_TRUE(ParseByteRanges("bytes=900-, -50, 10-20", 1000, &ranges));
+  ASSERT_EQ("900-999,950-999,10-20", RangesString(ranges));
+
+  // Ranges are clipped to the file, and those past its end dropped.
+  ASSERT_TRUE(ParseByteRanges("bytes=990-2000,-5000,1000-", 1000, &ranges));
+  ASSERT_EQ("990-999,0-999", RangesString(ranges));
+  ASSERT_TRUE(ParseByteRanges("bytes=1000-1999,-0", 1000, &ranges));
+  ASSERT_TRUE(ranges.empty());
+  ASSERT_TRUE(ParseByteRanges("bytes=0-", 0, &ranges));
+  ASSERT_TRUE(ranges.empty());
+
+  // Malformed headers are rejected outright.
+  ASSERT_FALSE(ParseByteRanges("bytes=5-1", 1000, &ranges));
+  ASSERT_FALSE(ParseByteRanges("bytes=-", 1000, &ranges));
+  ASSERT_FALSE(ParseByteRanges("bytes=1-2,x", 1000, &ranges));
+  ASSERT_FALSE(ParseByteRanges("items=0-1", 1000, &ranges));
+  ASSERT_FALSE(ParseByteRanges("bytes=99999999999999999999-", 1000,
+                               &ranges));
+}
+
 TEST(Test_HttpUtils, TestHttpUtilsWrappedReadWrite) {
   string filedata = "This is a test; this is only a test.\n";
 
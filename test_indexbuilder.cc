@@ -0,0 +1,110 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <list>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "libhw2/CrawlFileTree.h"
+}
+#include "./IndexBuilder.h"
+#include "./TermDictionary.h"
+#include "./libhw3/QueryProcessor.h"
+#include "./libhw3/WriteIndex.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::list;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+static const char* kBuiltIndex = "test_files/built.idx";
+static const char* kReferenceIndex = "test_files/reference.idx";
+
+// Checks that every word in "mi" gets the same answer from both indices.
+static void ExpectSameAnswers(MemIndex* mi, const char* index_a,
+                              const char* index_b) {
+  hw3::QueryProcessor a(list<string>{index_a}, true);
+  hw3::QueryProcessor b(list<string>{index_b}, true);
+  HTIterator* it = HTIterator_Allocate(mi);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    vector<string> query{static_cast<WordPostings*>(kv.value)->word};
+    vector<hw3::QueryProcessor::QueryResult> ra = a.ProcessQuery(query);
+    vector<hw3::QueryProcessor::QueryResult> rb = b.ProcessQuery(query);
+    ASSERT_EQ(rb.size(), ra.size());
+    for (size_t i = 0; i < ra.size(); i++) {
+      EXPECT_EQ(rb[i].document_name, ra[i].document_name);
+      EXPECT_EQ(rb[i].rank, ra[i].rank);
+    }
+  }
+  HTIterator_Free(it);
+}
+
+TEST(Test_IndexBuilder, TestSpillAndMerge) {
+  char root[] = "test_files";
+  DocTable* dt;
+  MemIndex* mi;
+  ASSERT_TRUE(CrawlFileTree(root, &dt, &mi));
+  ASSERT_LT(0, hw3::WriteIndex(mi, dt, kReferenceIndex));
+
+  // A budget large enough to never spill until Finish().
+  {
+    IndexBuilder builder(kBuiltIndex);
+    ASSERT_TRUE(builder.AddDirectory(root));
+    ASSERT_EQ(static_cast<size_t>(DocTable_NumDocs(dt)), builder.num_docs());
+    ASSERT_EQ(0U, builder.num_runs());
+    ASSERT_LT(0, builder.Finish());
+    ASSERT_EQ(1U, builder.num_parts());
+  }
+  ExpectSameAnswers(mi, kBuiltIndex, kReferenceIndex);
+
+  // A tiny budget, so that nearly every posting list spills its own run
+  // and the merge has to combine postings for a word across runs, over
+  // more than one pass.
+  {
+    IndexBuilder builder(kBuiltIndex, 128);
+    ASSERT_TRUE(builder.AddDirectory(root));
+    ASSERT_LT(IndexBuilder::kMaxMergeFanIn, builder.num_runs());
+    int size = builder.Finish();
+    ASSERT_LT(0, size);
+
+    // The postings were written back a budget's worth at a time.
+    ASSERT_LT(10U, builder.num_parts());
+
+    struct stat sb;
+    ASSERT_EQ(0, stat(kBuiltIndex, &sb));
+    ASSERT_EQ(size, sb.st_size);
+  }
+  ExpectSameAnswers(mi, kBuiltIndex, kReferenceIndex);
+
+  // A build whose dictionary can't be written fails, and leaves no index
+  // behind.
+  {
+    string dict_name = TermDictionary::DictionaryName(kBuiltIndex);
+    unlink(dict_name.c_str());
+    ASSERT_EQ(0, mkdir(dict_name.c_str(), 0700));
+    IndexBuilder builder(kBuiltIndex);
+    ASSERT_TRUE(builder.AddDirectory(root));
+    ASSERT_EQ(-1, builder.Finish());
+    ASSERT_EQ(0, rmdir(dict_name.c_str()));
+    struct stat sb;
+    ASSERT_EQ(-1, stat(kBuiltIndex, &sb));
+  }
+
+  // Not a directory.
+  IndexBuilder builder(kBuiltIndex);
+  ASSERT_FALSE(builder.AddDirectory("test_files/hextext.txt"));
+
+  MemIndex_Free(mi);
+  DocTable_Free(dt);
+  unlink(kBuiltIndex);
+  unlink(TermDictionary::DictionaryName(kBuiltIndex).c_str());
+  unlink(kReferenceIndex);
+}
+
+}  // namespace hw4
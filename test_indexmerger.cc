@@ -0,0 +1,177 @@
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <list>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+  #include "libhw2/CrawlFileTree.h"
+}
+#include "./IndexMerger.h"
+#include "./IndexScanner.h"
+#include "./IndexWriter.h"
+#include "./SyntheticCorpus.h"
+#include "./TermDictionary.h"
+#include "./libhw3/QueryProcessor.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::list;
+using std::pair;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+static const char* kTinyIndex = "unit_test_indices/tiny.idx";
+static const char* kCrawledIndex = "test_files/crawled.idx";
+static const char* kMergedIndex = "test_files/merged.idx";
+static const char* kSyntheticIndex = "test_files/scanned.idx";
+
+// Returns the (rank, document) pairs for "query", in a canonical order.
+static vector<pair<int, string>> Answers(const hw3::QueryProcessor& qp,
+                                         const vector<string>& query) {
+  vector<pair<int, string>> answers;
+  for (const hw3::QueryProcessor::QueryResult& r : qp.ProcessQuery(query)) {
+    answers.push_back({r.rank, r.document_name});
+  }
+  std::sort(answers.begin(), answers.end());
+  return answers;
+}
+
+TEST(Test_IndexMerger, TestScanner) {
+  IndexFileScanner scanner(kTinyIndex);
+  ASSERT_TRUE(scanner.Open(true));
+
+  set<string> docs;
+  ASSERT_TRUE(scanner.ForEachDocument(
+    [&docs](DocID_t doc_id, const string& name) {
+      docs.insert(name);
+      return true;
+    }));
+  ASSERT_EQ(2U, docs.size());
+  ASSERT_EQ(1U, docs.count("test_tree/tiny/buffalo.txt"));
+
+  int num_words = 0;
+  ASSERT_TRUE(scanner.ForEachWord(
+    [&num_words](const string& word, const vector<DocPostings>& postings) {
+      num_words++;
+      if (word == "buffalo") {
+        // Once in home-on-the-range.txt, eight times in buffalo.txt.
+        EXPECT_EQ(2U, postings.size());
+        EXPECT_EQ(9U, postings[0].positions.size()
+                      + postings[1].positions.size());
+      }
+      return true;
+    }));
+  ASSERT_EQ(9, num_words);
+
+  // A file that isn't an index is rejected rather than aborting.
+  IndexFileScanner missing("test_files/hextext.txt");
+  ASSERT_FALSE(missing.Open(true));
+}
+
+TEST(Test_IndexMerger, TestScannerReadsOnce) {
+  CorpusOptions options;
+  options.num_docs = 2000;
+  options.vocabulary_size = 5000;
+  options.positions_per_doc = 20;
+  SyntheticCorpus corpus(options);
+  int size = corpus.WriteIndex(0, options.num_docs, kSyntheticIndex);
+  ASSERT_LT(0, size);
+
+  // A full scan reads each byte of the file about once, even through a
+  // window much smaller than the file and its tables.
+  IndexFileScanner scanner(kSyntheticIndex, 4096);
+  ASSERT_TRUE(scanner.Open(false));
+  int num_docs = 0, num_postings = 0;
+  ASSERT_TRUE(scanner.ForEachDocument(
+    [&num_docs](DocID_t doc_id, const string& name) {
+      num_docs++;
+      return true;
+    }));
+  ASSERT_TRUE(scanner.ForEachWord(
+    [&num_postings](const string& word, const vector<DocPostings>& docs) {
+      num_postings += docs.size();
+      return true;
+    }));
+  ASSERT_EQ(options.num_docs, num_docs);
+  ASSERT_LT(options.num_docs, num_postings);
+  ASSERT_LE(size, scanner.bytes_read());
+  ASSERT_GT(size * 1.1, scanner.bytes_read());
+
+  // Once a file's checksum has been verified, opening it again doesn't
+  // read the whole file.
+  IndexFileScanner first(kSyntheticIndex, 4096), again(kSyntheticIndex, 4096);
+  ASSERT_TRUE(first.Open(true));
+  ASSERT_LE(size, first.bytes_read());
+  ASSERT_TRUE(again.Open(true));
+  ASSERT_GE(4096, again.bytes_read());
+
+  unlink(kSyntheticIndex);
+  unlink(TermDictionary::DictionaryName(kSyntheticIndex).c_str());
+}
+
+TEST(Test_IndexMerger, TestMergeIndices) {
+  char root[] = "test_files";
+  DocTable* dt;
+  MemIndex* mi;
+  ASSERT_TRUE(CrawlFileTree(root, &dt, &mi));
+  ASSERT_LT(0, WriteIndex(mi, dt, kCrawledIndex));
+  MemIndex_Free(mi);
+  DocTable_Free(dt);
+
+  MergeOptions options;
+  options.memory_budget = 1024;
+  list<string> inputs{kTinyIndex, kCrawledIndex};
+  ASSERT_LT(0, MergeIndices(inputs, kMergedIndex, options));
+
+  // Every word of either input gets the same answer from the merged index
+  // as from the pair of inputs.
+  set<string> words;
+  for (const string& input : inputs) {
+    IndexFileScanner scanner(input);
+    ASSERT_TRUE(scanner.Open(false));
+    ASSERT_TRUE(scanner.ForEachWord(
+      [&words](const string& word, const vector<DocPostings>& docs) {
+        words.insert(word);
+        return true;
+      }));
+  }
+  hw3::QueryProcessor separate(inputs, true);
+  hw3::QueryProcessor merged(list<string>{kMergedIndex}, true);
+  for (const string& word : words) {
+    vector<string> query{word};
+    ASSERT_EQ(Answers(separate, query), Answers(merged, query));
+  }
+  vector<string> query{"the", "home"};
+  ASSERT_EQ(Answers(separate, query), Answers(merged, query));
+
+  unlink(kCrawledIndex);
+  unlink(TermDictionary::DictionaryName(kCrawledIndex).c_str());
+  unlink(kMergedIndex);
+  unlink(TermDictionary::DictionaryName(kMergedIndex).c_str());
+}
+
+TEST(Test_IndexMerger, TestIoThrottle) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  IoThrottle throttle(1 << 20);
+  for (int i = 0; i < 4; i++) {
+    throttle.Consume(1 << 16);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec)
+    + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  // 256KB at 1MB/s takes about a quarter of a second.
+  ASSERT_LE(0.2, elapsed);
+  ASSERT_GT(2.0, elapsed);
+}
+
+}  // namespace hw4
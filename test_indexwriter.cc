@@ -0,0 +1,113 @@
+#include <sys/stat.h>
+#include <unistd.h>
+#include <list>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "libhw2/CrawlFileTree.h"
+}
+#include "./IndexWriter.h"
+#include "./TermDictionary.h"
+#include "./libhw3/FileIndexReader.h"
+#include "./libhw3/QueryProcessor.h"
+#include "./libhw3/WriteIndex.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::list;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+static const char* kStreamedIndex = "test_files/streamed.idx";
+static const char* kReferenceIndex = "test_files/reference.idx";
+
+// Returns every word in "mi".
+static vector<string> AllWords(MemIndex* mi) {
+  vector<string> words;
+  HTIterator* it = HTIterator_Allocate(mi);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    words.push_back(static_cast<WordPostings*>(kv.value)->word);
+  }
+  HTIterator_Free(it);
+  return words;
+}
+
+TEST(Test_IndexWriter, TestWriteIndexMatchesHw3) {
+  char root[] = "test_files";
+  DocTable* dt;
+  MemIndex* mi;
+  ASSERT_TRUE(CrawlFileTree(root, &dt, &mi));
+
+  int size = WriteIndex(mi, dt, kStreamedIndex);
+  ASSERT_LT(0, size);
+  ASSERT_LT(0, hw3::WriteIndex(mi, dt, kReferenceIndex));
+
+  // The file is complete and no temporary file was left behind.
+  struct stat sb;
+  ASSERT_EQ(0, stat(kStreamedIndex, &sb));
+  ASSERT_EQ(size, sb.st_size);
+  string tmp = string(kStreamedIndex) + "." + std::to_string(getpid())
+    + ".tmp";
+  ASSERT_NE(0, stat(tmp.c_str(), &sb));
+
+  // Both indices answer every single-word and a few multi-word queries
+  // identically, and the checksum validates.
+  {
+    hw3::QueryProcessor streamed(list<string>{kStreamedIndex}, true);
+    hw3::QueryProcessor reference(list<string>{kReferenceIndex}, true);
+    vector<string> words = AllWords(mi);
+    ASSERT_LT(0U, words.size());
+    for (size_t i = 0; i < words.size(); i++) {
+      vector<string> query{words[i]};
+      if (i % 3 == 0 && i + 1 < words.size()) {
+        query.push_back(words[i + 1]);
+      }
+      vector<hw3::QueryProcessor::QueryResult> a = streamed.ProcessQuery(query);
+      vector<hw3::QueryProcessor::QueryResult> b =
+        reference.ProcessQuery(query);
+      ASSERT_EQ(b.size(), a.size());
+      for (size_t j = 0; j < a.size(); j++) {
+        ASSERT_EQ(b[j].document_name, a[j].document_name);
+        ASSERT_EQ(b[j].rank, a[j].rank);
+      }
+    }
+    vector<string> missing{"notawordinthecorpus"};
+    ASSERT_EQ(0U, streamed.ProcessQuery(missing).size());
+  }
+
+  // Rewriting atomically replaces the existing file.
+  ASSERT_EQ(size, WriteIndex(mi, dt, kStreamedIndex));
+  hw3::FileIndexReader fir(kStreamedIndex, true);
+  ASSERT_EQ(DocTable_NumDocs(dt) > 0, fir.getHeader().doctable_bytes > 0);
+
+  MemIndex_Free(mi);
+  DocTable_Free(dt);
+  unlink(kStreamedIndex);
+  unlink(TermDictionary::DictionaryName(kStreamedIndex).c_str());
+  unlink(kReferenceIndex);
+}
+
+TEST(Test_IndexWriter, TestFailedCommitRemovesTemporary) {
+  // A directory in the way makes the final rename() fail.
+  static const char* kBlocked = "test_files/blocked.idx";
+  ASSERT_EQ(0, mkdir(kBlocked, 0755));
+  string tmp = string(kBlocked) + "." + std::to_string(getpid()) + ".tmp";
+  struct stat sb;
+  {
+    IndexFileWriter writer(kBlocked);
+    ASSERT_TRUE(writer.Open());
+    ASSERT_EQ(0, stat(tmp.c_str(), &sb));
+    ASSERT_EQ(-1, writer.Commit(0, 0));
+    ASSERT_NE(0, stat(tmp.c_str(), &sb));
+  }
+  ASSERT_NE(0, stat(tmp.c_str(), &sb));
+  ASSERT_EQ(0, rmdir(kBlocked));
+}
+
+}  // namespace hw4
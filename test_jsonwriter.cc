@@ -0,0 +1,65 @@
+#include <limits>
+#include <string>
+
+#include "./JsonWriter.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::string;
+
+namespace hw4 {
+
+TEST(Test_JsonWriter, NestedContainers) {
+  string out;
+  JsonWriter json(&out);
+  json.BeginObject()
+      .Key("hits").Int(2)
+      .Key("results").BeginArray()
+        .BeginObject().Key("document").String("a.txt").EndObject()
+        .BeginObject().Key("document").String("b.txt").EndObject()
+      .EndArray()
+      .Key("empty").BeginArray().EndArray()
+      .Key("nested").BeginObject().EndObject()
+      .EndObject();
+  ASSERT_EQ("{\"hits\":2,\"results\":[{\"document\":\"a.txt\"},"
+            "{\"document\":\"b.txt\"}],\"empty\":[],\"nested\":{}}", out);
+}
+
+TEST(Test_JsonWriter, AppendsToExistingString) {
+  string out = "prefix ";
+  JsonWriter(&out).BeginArray().Int(1).Int(-2).EndArray();
+  ASSERT_EQ("prefix [1,-2]", out);
+}
+
+TEST(Test_JsonWriter, RawValues) {
+  string inner, out;
+  JsonWriter(&inner).BeginObject().Key("a").Int(1).EndObject();
+  JsonWriter(&out).BeginObject().Key("x").Raw(inner).Key("y").Int(2)
+      .EndObject();
+  ASSERT_EQ("{\"x\":{\"a\":1},\"y\":2}", out);
+}
+
+TEST(Test_JsonWriter, Scalars) {
+  string out;
+  JsonWriter json(&out);
+  json.BeginArray()
+      .Int(std::numeric_limits<int64_t>::min())
+      .Double(0.5).Double(std::numeric_limits<double>::infinity())
+      .Bool(true).Bool(false).Null()
+      .EndArray();
+  ASSERT_EQ("[-9223372036854775808,0.5,null,true,false,null]", out);
+}
+
+TEST(Test_JsonWriter, EscapesStrings) {
+  string out;
+  JsonWriter json(&out);
+  json.BeginObject()
+      .Key("q\"uote").String("back\\slash\nline\ttab\x01")
+      .Key("utf8").String("caf\xc3\xa9")
+      .EndObject();
+  ASSERT_EQ("{\"q\\\"uote\":\"back\\\\slash\\nline\\ttab\\u0001\","
+            "\"utf8\":\"caf\xc3\xa9\"}", out);
+}
+
+}  // namespace hw4
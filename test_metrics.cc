@@ -0,0 +1,133 @@
+#include <pthread.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "./Metrics.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+TEST(Test_Metrics, Counter) {
+  Counter counter;
+  ASSERT_EQ(0U, counter.value());
+
+  // Every thread's increments are counted, whichever shard they land in.
+  vector<pthread_t> threads(8);
+  for (pthread_t& thread : threads) {
+    ASSERT_EQ(0, pthread_create(&thread, nullptr, [](void* c) -> void* {
+        for (int i = 0; i < 10000; i++) {
+          static_cast<Counter*>(c)->Increment();
+        }
+        return nullptr;
+      }, &counter));
+  }
+  for (pthread_t& thread : threads) {
+    ASSERT_EQ(0, pthread_join(thread, nullptr));
+  }
+  counter.Increment(5);
+  ASSERT_EQ(80005U, counter.value());
+}
+
+TEST(Test_Metrics, LatencyHistogram) {
+  LatencyHistogram histogram;
+  ASSERT_EQ(0U, histogram.count());
+  ASSERT_EQ(0U, histogram.Quantile(0.5));
+
+  // 1us through 1000us, once each.
+  for (uint64_t us = 1; us <= 1000; us++) {
+    histogram.Record(us * 1000);
+  }
+  ASSERT_EQ(1000U, histogram.count());
+  ASSERT_EQ(500500000U, histogram.sum_ns());
+  ASSERT_EQ(0U, histogram.CountBelow(0));
+  ASSERT_EQ(1U, histogram.CountBelow(1));
+  ASSERT_EQ(511U, histogram.CountBelow(9));
+  ASSERT_EQ(1000U, histogram.CountBelow(10));
+  ASSERT_EQ(1000U, histogram.CountBelow(LatencyHistogram::kMaxBits));
+
+  // Quantiles are bounded above to within a bucket, 25% at most.
+  const double quantiles[] = {0.5, 0.9, 0.99};
+  for (double q : quantiles) {
+    uint64_t exact = q * 1000 * 1000;
+    uint64_t bound = histogram.Quantile(q);
+    ASSERT_GE(bound, exact);
+    ASSERT_LE(bound, exact * 5 / 4);
+  }
+
+  // Durations too long for the last bucket still count, but not as
+  // under any power of two.
+  histogram.Record(uint64_t(1000) * 1000000000);
+  ASSERT_EQ(1001U, histogram.count());
+  ASSERT_EQ(1000U, histogram.CountBelow(LatencyHistogram::kMaxBits));
+  ASSERT_EQ(uint64_t(1) << LatencyHistogram::kMaxBits,
+            histogram.Quantile(1.0) / 1000);
+}
+
+TEST(Test_Metrics, Registry) {
+  MetricsRegistry registry;
+  Counter requests;
+  requests.Increment(3);
+  LatencyHistogram parse, write;
+  parse.Record(1500);
+  parse.Record(3000000);
+
+  registry.AddCounter("requests_total", "Requests.", "", &requests);
+  registry.AddGauge("queue_length", "Queued.", "", []() { return 2.5; });
+  registry.AddHistogram("stage_seconds", "Stages.", "stage=\"parse\"",
+                        &parse);
+  registry.AddHistogram("stage_seconds", "Stages.", "stage=\"write\"",
+                        &write);
+  registry.AddCounter("shed_total", "Shed.", "where=\"queue\"",
+                      []() { return uint64_t(7); });
+
+  string out;
+  registry.Write(&out);
+  ASSERT_EQ(0U, out.find("# HELP requests_total Requests.\n"
+                         "# TYPE requests_total counter\n"
+                         "requests_total 3\n"
+                         "# HELP queue_length Queued.\n"
+                         "# TYPE queue_length gauge\n"
+                         "queue_length 2.5\n"
+                         "# HELP stage_seconds Stages.\n"
+                         "# TYPE stage_seconds histogram\n"
+                         "stage_seconds_bucket{stage=\"parse\",le=\"1e-06\"}"
+                         " 0\n"
+                         "stage_seconds_bucket{stage=\"parse\",le=\"2e-06\"}"
+                         " 1\n"));
+  ASSERT_NE(string::npos,
+            out.find("stage_seconds_bucket{stage=\"parse\",le=\"0.002048\"}"
+                     " 1\n"
+                     "stage_seconds_bucket{stage=\"parse\",le=\"0.004096\"}"
+                     " 2\n"));
+  ASSERT_NE(string::npos,
+            out.find("stage_seconds_bucket{stage=\"parse\",le=\"+Inf\"} 2\n"
+                     "stage_seconds_sum{stage=\"parse\"} 0.0030015\n"
+                     "stage_seconds_count{stage=\"parse\"} 2\n"
+                     "stage_seconds_bucket{stage=\"write\",le=\"1e-06\"}"
+                     " 0\n"));
+  ASSERT_NE(string::npos,
+            out.find("# TYPE shed_total counter\n"
+                     "shed_total{where=\"queue\"} 7\n"));
+
+  // A family's HELP and TYPE appear once.
+  ASSERT_EQ(out.find("# TYPE stage_seconds"),
+            out.rfind("# TYPE stage_seconds"));
+
+  // A duration past the last power of two is only under +Inf.
+  parse.Record(uint64_t(1000) * 1000000000);
+  out.clear();
+  registry.Write(&out);
+  ASSERT_NE(string::npos,
+            out.find("stage_seconds_bucket{stage=\"parse\",le=\"134.217728\"}"
+                     " 2\n"
+                     "stage_seconds_bucket{stage=\"parse\",le=\"+Inf\"} 3\n"));
+}
+
+}  // namespace hw4
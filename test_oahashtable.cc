@@ -0,0 +1,105 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <unordered_map>
+
+#include "./OAHashTable.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::unordered_map;
+
+namespace hw4 {
+
+static int num_freed = 0;
+static void CountingFree(HTValue_t value) { num_freed++; }
+
+TEST(Test_OAHashTable, MatchesUnorderedMap) {
+  OAHashTable* table = OAHashTable_Allocate(1);
+  unordered_map<HTKey_t, uint64_t> expected;
+  HTKeyValue_t kv, old;
+
+  // A mix of inserts, replacements and removals over a small key space,
+  // so that the table grows and collects tombstones.
+  srand(333);
+  for (int i = 0; i < 200000; i++) {
+    HTKey_t key = rand() % 5000;
+    if (rand() % 3 == 0) {
+      bool removed = OAHashTable_Remove(table, key, &kv);
+      ASSERT_EQ(expected.count(key) == 1, removed);
+      if (removed) {
+        ASSERT_EQ(expected[key], reinterpret_cast<uint64_t>(kv.value));
+        expected.erase(key);
+      }
+    } else {
+      kv.key = key;
+      kv.value = reinterpret_cast<HTValue_t>(static_cast<uint64_t>(i));
+      bool replaced = OAHashTable_Insert(table, kv, &old);
+      ASSERT_EQ(expected.count(key) == 1, replaced);
+      if (replaced) {
+        ASSERT_EQ(key, old.key);
+        ASSERT_EQ(expected[key], reinterpret_cast<uint64_t>(old.value));
+      }
+      expected[key] = i;
+    }
+    ASSERT_EQ(expected.size(),
+              static_cast<size_t>(OAHashTable_NumElements(table)));
+  }
+
+  for (HTKey_t key = 0; key < 5000; key++) {
+    ASSERT_EQ(expected.count(key) == 1, OAHashTable_Find(table, key, &kv));
+    if (expected.count(key) == 1) {
+      ASSERT_EQ(key, kv.key);
+      ASSERT_EQ(expected[key], reinterpret_cast<uint64_t>(kv.value));
+    }
+  }
+
+  num_freed = 0;
+  int num_elements = OAHashTable_NumElements(table);
+  OAHashTable_Free(table, &CountingFree);
+  ASSERT_EQ(num_elements, num_freed);
+}
+
+TEST(Test_OAHashTable, Iterator) {
+  OAHashTable* table = OAHashTable_Allocate(10);
+  HTKeyValue_t kv, old;
+
+  OAHTIterator* iter = OAHTIterator_Allocate(table);
+  ASSERT_FALSE(OAHTIterator_IsValid(iter));
+  ASSERT_FALSE(OAHTIterator_Get(iter, &kv));
+  OAHTIterator_Free(iter);
+
+  for (HTKey_t key = 0; key < 100; key++) {
+    kv.key = key;
+    kv.value = nullptr;
+    ASSERT_FALSE(OAHashTable_Insert(table, kv, &old));
+  }
+
+  // Every element is visited once; removing the odd ones as we go leaves
+  // just the even ones behind.
+  uint64_t seen = 0, sum = 0;
+  iter = OAHTIterator_Allocate(table);
+  while (OAHTIterator_IsValid(iter)) {
+    ASSERT_TRUE(OAHTIterator_Get(iter, &kv));
+    seen++;
+    sum += kv.key;
+    if (kv.key % 2 == 1) {
+      ASSERT_TRUE(OAHTIterator_Remove(iter, &old));
+      ASSERT_EQ(kv.key, old.key);
+    } else {
+      OAHTIterator_Next(iter);
+    }
+  }
+  ASSERT_FALSE(OAHTIterator_Next(iter));
+  ASSERT_FALSE(OAHTIterator_Remove(iter, &old));
+  OAHTIterator_Free(iter);
+  ASSERT_EQ(100U, seen);
+  ASSERT_EQ(99U * 100 / 2, sum);
+  ASSERT_EQ(50, OAHashTable_NumElements(table));
+  ASSERT_FALSE(OAHashTable_Find(table, 33, &kv));
+  ASSERT_TRUE(OAHashTable_Find(table, 32, &kv));
+
+  OAHashTable_Free(table, &CountingFree);
+}
+
+}  // namespace hw4
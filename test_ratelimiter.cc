@@ -0,0 +1,78 @@
+#include <stdint.h>
+
+#include <string>
+
+#include "./RateLimiter.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::string;
+
+namespace hw4 {
+
+static const uint64_t kSecondNs = 1000000000;
+
+TEST(Test_RateLimiter, TokenBuckets) {
+  RateLimiter limiter;
+  limiter.SetRate(RateLimiter::kQuery, 2, 5);
+  ASSERT_TRUE(limiter.IsLimited(RateLimiter::kQuery));
+  ASSERT_FALSE(limiter.IsLimited(RateLimiter::kStatic));
+
+  // A client starts with a full burst.
+  uint64_t now = 100 * kSecondNs;
+  int retry_after_s = 0;
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(limiter.Allow("1.2.3.4", RateLimiter::kQuery, now,
+                              &retry_after_s));
+  }
+  ASSERT_FALSE(limiter.Allow("1.2.3.4", RateLimiter::kQuery, now,
+                             &retry_after_s));
+  ASSERT_EQ(1, retry_after_s);
+  ASSERT_EQ(1U, limiter.num_limited(RateLimiter::kQuery));
+
+  // Other clients, and unlimited classes, are unaffected.
+  ASSERT_TRUE(limiter.Allow("5.6.7.8", RateLimiter::kQuery, now, nullptr));
+  ASSERT_TRUE(limiter.Allow("1.2.3.4", RateLimiter::kStatic, now, nullptr));
+
+  // The bucket refills at the rate, and never past the burst.
+  now += kSecondNs / 2;
+  ASSERT_TRUE(limiter.Allow("1.2.3.4", RateLimiter::kQuery, now, nullptr));
+  ASSERT_FALSE(limiter.Allow("1.2.3.4", RateLimiter::kQuery, now, nullptr));
+  now += 60 * kSecondNs;
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(limiter.Allow("1.2.3.4", RateLimiter::kQuery, now,
+                              nullptr));
+  }
+  ASSERT_FALSE(limiter.Allow("1.2.3.4", RateLimiter::kQuery, now, nullptr));
+  ASSERT_EQ(3U, limiter.num_limited(RateLimiter::kQuery));
+}
+
+TEST(Test_RateLimiter, RetryAfter) {
+  RateLimiter limiter;
+  limiter.SetRate(RateLimiter::kConnect, 0.1, 1);
+  int retry_after_s = 0;
+  ASSERT_TRUE(limiter.Allow("::1", RateLimiter::kConnect, 0, nullptr));
+  ASSERT_FALSE(limiter.Allow("::1", RateLimiter::kConnect, kSecondNs,
+                             &retry_after_s));
+  ASSERT_EQ(9, retry_after_s);
+}
+
+TEST(Test_RateLimiter, EvictsIdleClients) {
+  RateLimiter limiter(160);
+  limiter.SetRate(RateLimiter::kQuery, 1, 1);
+  ASSERT_TRUE(limiter.Allow("busy", RateLimiter::kQuery, 0, nullptr));
+  ASSERT_FALSE(limiter.Allow("busy", RateLimiter::kQuery, 0, nullptr));
+
+  // The table stays bounded however many clients come along.
+  for (int i = 0; i < 10000; i++) {
+    limiter.Allow("client" + std::to_string(i), RateLimiter::kQuery, 0,
+                  nullptr);
+  }
+  ASSERT_LE(limiter.num_clients(), 160U);
+
+  // The busy client was idle longest, so it's been forgotten.
+  ASSERT_TRUE(limiter.Allow("busy", RateLimiter::kQuery, 0, nullptr));
+}
+
+}  // namespace hw4
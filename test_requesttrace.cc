@@ -0,0 +1,47 @@
+#include <stdint.h>
+
+#include <string>
+
+#include "./RequestTrace.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::string;
+
+namespace hw4 {
+
+TEST(Test_RequestTrace, ServerTiming) {
+  RequestTrace trace;
+  ASSERT_EQ("", trace.ServerTiming());
+
+  // Stages come out in order, in milliseconds, skipping those not run.
+  trace.parse_ns = 41000;
+  trace.query.lookup_ns = 1250000;
+  trace.render_ns = 3000000000;
+  ASSERT_EQ("parse;dur=0.041, lookup;dur=1.250, render;dur=3000.000",
+            trace.ServerTiming());
+}
+
+TEST(Test_RequestTrace, ToJson) {
+  RequestTrace trace;
+  trace.queue_ns = 2000;
+  trace.parse_ns = 3500;
+  ASSERT_EQ("{\"queue_us\":2,\"parse_us\":3}", trace.ToJson());
+
+  // A query adds its terms and each index's share.
+  trace.terms = {"apple", "ban*"};
+  trace.query.postings_ns = 9000;
+  SegmentQueryProcessor::QueryTiming::SegmentTiming segment;
+  segment.index = "a.idx";
+  segment.lookup_ns = 1000;
+  segment.postings_ns = 9000;
+  segment.num_results = 4;
+  trace.query.segments.push_back(segment);
+  ASSERT_EQ("{\"queue_us\":2,\"parse_us\":3,\"postings_us\":9,"
+            "\"terms\":[\"apple\",\"ban*\"],\"indices\":[{\"index\":\"a.idx\","
+            "\"lookup_us\":1,\"postings_us\":9,\"names_us\":0,"
+            "\"results\":4}]}", trace.ToJson());
+}
+
+}  // namespace hw4
@@ -0,0 +1,219 @@
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "./SegmentQueryProcessor.h"
+#include "./SegmentSet.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::list;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+static const char* kSetDir = "test_files_segments";
+static const char* kDocDir = "test_files_segdocs";
+
+// Writes "contents" to document "name" of kDocDir, returning its path.
+static string WriteDoc(const string& name, const string& contents) {
+  string path = string(kDocDir) + "/" + name;
+  std::ofstream out(path);
+  out << contents;
+  return path;
+}
+
+// Removes "dir" and the files within it.
+static void RemoveDir(const string& dir) {
+  DIR* d = opendir(dir.c_str());
+  if (d == nullptr) {
+    return;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(d)) != nullptr) {
+    if (entry->d_name[0] != '.') {
+      unlink((dir + "/" + entry->d_name).c_str());
+    }
+  }
+  closedir(d);
+  rmdir(dir.c_str());
+}
+
+// Returns the sorted names of the documents in the set matching "query".
+static vector<string> Matches(const string& query) {
+  SegmentQueryProcessor qp(list<string>{kSetDir}, true);
+  EXPECT_TRUE(qp.Open());
+  vector<string> names;
+  for (const auto& result : qp.ProcessQuery(vector<string>{query})) {
+    names.push_back(result.document_name);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+TEST(Test_SegmentSet, UpdateAndMerge) {
+  RemoveDir(kSetDir);
+  RemoveDir(kDocDir);
+  ASSERT_EQ(0, mkdir(kDocDir, 0755));
+  string a = WriteDoc("a.txt", "apple banana\n");
+  string b = WriteDoc("b.txt", "banana cherry\n");
+
+  {
+    SegmentSet set(kSetDir, 2);
+    ASSERT_TRUE(set.Open());
+    ASSERT_TRUE(set.AddDocuments({a}));
+    ASSERT_TRUE(set.AddDocuments({b}));
+    ASSERT_EQ(2U, set.segments().size());
+    ASSERT_EQ((vector<string>{a, b}), Matches("banana"));
+
+    // Re-adding a changed document hides its old version.
+    WriteDoc("a.txt", "cherry\n");
+    ASSERT_TRUE(set.AddDocuments({a}));
+    ASSERT_EQ(3U, set.segments().size());
+    ASSERT_EQ((vector<string>{b}), Matches("banana"));
+    ASSERT_EQ((vector<string>{a, b}), Matches("cherry"));
+    ASSERT_EQ(vector<string>{}, Matches("apple"));
+
+    ASSERT_TRUE(set.RemoveDocuments({b, "not_in_the_set.txt"}));
+    ASSERT_EQ((vector<string>{a}), Matches("cherry"));
+
+    // The first two segments have no live documents left, so merging
+    // them leaves nothing behind.
+    ASSERT_TRUE(set.MaybeMerge());
+    ASSERT_FALSE(set.MaybeMerge());
+    ASSERT_EQ(1U, set.segments().size());
+    ASSERT_EQ((vector<string>{a}), Matches("cherry"));
+  }
+
+  // The set survives being reopened.
+  SegmentSet reopened(kSetDir, 2);
+  ASSERT_TRUE(reopened.Open());
+  ASSERT_EQ(1U, reopened.segments().size());
+  ASSERT_TRUE(reopened.RemoveDocuments({a}));
+  ASSERT_EQ(vector<string>{}, Matches("cherry"));
+
+  RemoveDir(kSetDir);
+  RemoveDir(kDocDir);
+}
+
+TEST(Test_SegmentSet, BackgroundMerge) {
+  RemoveDir(kSetDir);
+  RemoveDir(kDocDir);
+  ASSERT_EQ(0, mkdir(kDocDir, 0755));
+
+  SegmentSet set(kSetDir, 2);
+  ASSERT_TRUE(set.Open());
+  set.StartBackgroundMerging();
+  vector<string> docs;
+  for (int i = 0; i < 4; i++) {
+    docs.push_back(WriteDoc("doc" + std::to_string(i) + ".txt",
+                            "common word" + std::to_string(i) + "\n"));
+    ASSERT_TRUE(set.AddDocuments({docs.back()}));
+  }
+
+  // Four one-document segments cascade into a single segment.
+  for (int i = 0; i < 500 && set.segments().size() > 1; i++) {
+    usleep(10000);
+  }
+  ASSERT_EQ(1U, set.segments().size());
+  ASSERT_EQ(4U, set.segments()[0].num_docs);
+  ASSERT_EQ(docs, Matches("common"));
+
+  RemoveDir(kSetDir);
+  RemoveDir(kDocDir);
+}
+
+TEST(Test_SegmentSet, QueriesDuringMerges) {
+  RemoveDir(kSetDir);
+  RemoveDir(kDocDir);
+  ASSERT_EQ(0, mkdir(kDocDir, 0755));
+
+  // Every query sees exactly the live documents, however the background
+  // merges interleave with opening the segments.
+  SegmentSet set(kSetDir, 2);
+  ASSERT_TRUE(set.Open());
+  set.StartBackgroundMerging();
+  vector<string> live;
+  for (int i = 0; i < 12; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "doc%02d.txt", i);
+    live.push_back(WriteDoc(name, "common\n"));
+    ASSERT_TRUE(set.AddDocuments({live.back()}));
+    if (i % 3 == 2) {
+      ASSERT_TRUE(set.RemoveDocuments({live[live.size() - 2]}));
+      live.erase(live.end() - 2);
+    }
+    for (int j = 0; j < 3; j++) {
+      ASSERT_EQ(live, Matches("common"));
+    }
+  }
+
+  // Removals made while a merge is running carry over to its output.
+  ASSERT_TRUE(set.RemoveDocuments(live));
+  ASSERT_EQ(vector<string>{}, Matches("common"));
+  for (int i = 0; i < 500 && set.MaybeMerge(); i++) { }
+  ASSERT_EQ(vector<string>{}, Matches("common"));
+
+  RemoveDir(kSetDir);
+  RemoveDir(kDocDir);
+}
+
+TEST(Test_SegmentSet, BatchedQueries) {
+  RemoveDir(kSetDir);
+  RemoveDir(kDocDir);
+  ASSERT_EQ(0, mkdir(kDocDir, 0755));
+
+  SegmentSet set(kSetDir, 8);
+  ASSERT_TRUE(set.Open());
+  ASSERT_TRUE(set.AddDocuments({WriteDoc("a.txt", "apple banana apple\n"),
+                                WriteDoc("b.txt", "banana cherry\n")}));
+  ASSERT_TRUE(set.AddDocuments({WriteDoc("c.txt", "cherry apricot\n"),
+                                WriteDoc("d.txt", "banana banana\n")}));
+  ASSERT_TRUE(set.RemoveDocuments({string(kDocDir) + "/b.txt"}));
+  ASSERT_EQ(2U, set.segments().size());
+
+  // Each query of the batch gets the results it would get on its own.
+  vector<vector<string>> queries{
+    {"banana"}, {"apple", "banana"}, {"ap*"}, {"banana", "ap*"},
+    {"banana", "banana"}, {"durian"}, {"cherry", "durian"}, {}};
+  SegmentQueryProcessor qp(list<string>{kSetDir}, true);
+  ASSERT_TRUE(qp.Open());
+  for (int num_threads : {1, 4}) {
+    auto batch = qp.ProcessQueries(queries, num_threads);
+    ASSERT_EQ(queries.size(), batch.size());
+    for (size_t q = 0; q < queries.size(); q++) {
+      std::map<string, int> expected, actual;
+      for (const auto& result : qp.ProcessQuery(queries[q])) {
+        expected[result.document_name] = result.rank;
+      }
+      for (const auto& result : batch[q]) {
+        actual[result.document_name] = result.rank;
+      }
+      ASSERT_EQ(expected, actual);
+      ASSERT_EQ(expected.size(), batch[q].size());
+    }
+  }
+  ASSERT_EQ(2U, qp.ProcessQueries(queries, 2)[4].size());  // a.txt, d.txt
+
+  // A timed query breaks its time and results down by segment.
+  SegmentQueryProcessor::QueryTiming timing;
+  ASSERT_EQ(2U, qp.ProcessQuery({"banana"}, &timing).size());
+  ASSERT_EQ(2U, timing.segments.size());
+  for (const auto& segment : timing.segments) {
+    ASSERT_EQ(1U, segment.num_results);
+    ASSERT_EQ(0U, segment.index.find(kSetDir));
+  }
+
+  RemoveDir(kSetDir);
+  RemoveDir(kDocDir);
+}
+
+}  // namespace hw4
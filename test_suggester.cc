@@ -0,0 +1,62 @@
+#include <list>
+#include <string>
+#include <vector>
+
+#include "./Suggester.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::list;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+TEST(Test_Suggester, RanksByDocumentFrequency) {
+  Suggester suggester;
+  suggester.AddWord("search", 40);
+  suggester.AddWord("sea", 25);
+  suggester.AddWord("seal", 25);
+  suggester.AddWord("season", 3);
+  suggester.AddWord("server", 90);
+  suggester.AddWord("apple", 7);
+  suggester.AddWord("sea", 5);  // counts accumulate
+  suggester.Build();
+  ASSERT_EQ(6U, suggester.num_words());
+
+  ASSERT_EQ((vector<string>{"server", "search", "sea", "seal", "season"}),
+            suggester.Suggest("s", 10));
+  ASSERT_EQ((vector<string>{"search", "sea"}), suggester.Suggest("sea", 2));
+  ASSERT_EQ((vector<string>{"seal"}), suggester.Suggest("seal", 10));
+  ASSERT_EQ(vector<string>{}, suggester.Suggest("seals", 10));
+  ASSERT_EQ(vector<string>{}, suggester.Suggest("b", 10));
+  ASSERT_EQ(vector<string>{}, suggester.Suggest("s", 0));
+
+  // Only the kTopK best are kept for a prefix.
+  Suggester many;
+  for (int i = 0; i < 50; i++) {
+    many.AddWord("w" + std::to_string(i), i);
+  }
+  many.Build();
+  vector<string> top = many.Suggest("w", 100);
+  ASSERT_EQ(Suggester::kTopK, top.size());
+  ASSERT_EQ("w49", top[0]);
+  ASSERT_EQ("w40", top[9]);
+  ASSERT_EQ((vector<string>{"w49", "w48"}), many.Suggest("w4", 2));
+}
+
+TEST(Test_Suggester, LoadsIndices) {
+  Suggester suggester;
+  ASSERT_TRUE(suggester.AddIndices(list<string>{"unit_test_indices/tiny.idx"}));
+  suggester.Build();
+  ASSERT_EQ(9U, suggester.num_words());
+
+  // "buffalo" is in both documents of the tiny index.
+  ASSERT_EQ((vector<string>{"buffalo"}), suggester.Suggest("buf", 10));
+
+  Suggester missing;
+  ASSERT_FALSE(missing.AddIndices(list<string>{"no/such/index.idx"}));
+}
+
+}  // namespace hw4
@@ -0,0 +1,148 @@
+#include <unistd.h>
+
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "libhw2/CrawlFileTree.h"
+}
+#include "./IndexWriter.h"
+#include "./SyntheticCorpus.h"
+#include "./TermDictionary.h"
+#include "./libhw3/QueryProcessor.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::list;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+static const char* kSyntheticIndex = "test_files/synthetic.idx";
+static const char* kCrawledIndex = "test_files/synthetic_crawled.idx";
+static const char* kCorpusDir = "test_synthetic_corpus";
+
+// Removes the documents "corpus" wrote, and their directories.
+static void RemoveCorpus(const SyntheticCorpus& corpus) {
+  for (int doc = 0; doc < corpus.options().num_docs; doc++) {
+    string name = corpus.DocName(doc);
+    unlink(name.c_str());
+    rmdir(name.substr(0, name.rfind('/')).c_str());
+  }
+  rmdir(corpus.options().doc_dir.c_str());
+}
+
+TEST(Test_SyntheticCorpus, Words) {
+  ASSERT_EQ("aaa", SyntheticCorpus::Word(0));
+  ASSERT_EQ("aab", SyntheticCorpus::Word(1));
+  ASSERT_EQ("aba", SyntheticCorpus::Word(26));
+  ASSERT_EQ("zzz", SyntheticCorpus::Word(26 * 26 * 26 - 1));
+  ASSERT_EQ("baaa", SyntheticCorpus::Word(26 * 26 * 26));
+
+  // Byte offsets of a document's words have to fit in 32 bits.
+  ASSERT_EQ(UINT32_MAX / 4, SyntheticCorpus::MaxPositionsPerDoc(1000));
+  ASSERT_EQ(UINT32_MAX / 5, SyntheticCorpus::MaxPositionsPerDoc(100000));
+}
+
+TEST(Test_SyntheticCorpus, Documents) {
+  CorpusOptions options;
+  options.num_docs = 200;
+  options.vocabulary_size = 500;
+  options.positions_per_doc = 50;
+  SyntheticCorpus corpus(options), same(options);
+  options.seed++;
+  SyntheticCorpus other(options);
+
+  // Documents depend only on the options, and differ from each other.
+  vector<int> counts(500);
+  for (int doc = 0; doc < 200; doc++) {
+    vector<int> words = corpus.DocumentWords(doc);
+    ASSERT_EQ(50U, words.size());
+    ASSERT_EQ(words, same.DocumentWords(doc));
+    ASSERT_NE(words, other.DocumentWords(doc));
+    ASSERT_NE(words, corpus.DocumentWords(doc + 1));
+    for (int word : words) {
+      ASSERT_LE(0, word);
+      ASSERT_GT(500, word);
+      counts[word]++;
+    }
+  }
+  ASSERT_EQ("synthetic/00000/00000007.txt", corpus.DocName(7));
+  ASSERT_EQ("synthetic/00001/00001234.txt", corpus.DocName(1234));
+
+  // Frequencies fall off with rank: with an exponent of 1, the top word
+  // is about 1 / H(500) = 15% of all words, and the 10th a tenth of that.
+  ASSERT_NEAR(0.147 * 200 * 50, counts[0], 150);
+  ASSERT_NEAR(0.0147 * 200 * 50, counts[9], 50);
+  ASSERT_GT(counts[0], counts[1]);
+  ASSERT_GT(counts[1], counts[99]);
+}
+
+TEST(Test_SyntheticCorpus, IndexMatchesCrawledCorpus) {
+  CorpusOptions options;
+  options.num_docs = 150;
+  options.vocabulary_size = 2000;
+  options.positions_per_doc = 80;
+  options.doc_dir = kCorpusDir;
+  SyntheticCorpus corpus(options);
+  int size = corpus.WriteIndex(0, options.num_docs, kSyntheticIndex);
+  ASSERT_LT(0, size);
+
+  // The documents, crawled and indexed as usual, make the same index.
+  ASSERT_TRUE(corpus.WriteCorpus());
+  DocTable* dt;
+  MemIndex* mi;
+  ASSERT_TRUE(CrawlFileTree(const_cast<char*>(kCorpusDir), &dt, &mi));
+  ASSERT_EQ(options.num_docs, DocTable_NumDocs(dt));
+  ASSERT_EQ(size, WriteIndex(mi, dt, kCrawledIndex));
+  MemIndex_Free(mi);
+  DocTable_Free(dt);
+  {
+    hw3::QueryProcessor synthetic(list<string>{kSyntheticIndex}, true);
+    hw3::QueryProcessor crawled(list<string>{kCrawledIndex}, true);
+    for (int rank : {0, 1, 5, 50, 500, 1999}) {
+      vector<string> query{SyntheticCorpus::Word(rank)};
+      if (rank % 2 == 1) {
+        query.push_back(SyntheticCorpus::Word(0));
+      }
+      vector<hw3::QueryProcessor::QueryResult> a =
+        synthetic.ProcessQuery(query);
+      vector<hw3::QueryProcessor::QueryResult> b = crawled.ProcessQuery(query);
+      ASSERT_EQ(b.size(), a.size());
+      set<string> a_docs, b_docs;
+      for (size_t i = 0; i < a.size(); i++) {
+        ASSERT_EQ(b[i].rank, a[i].rank);
+        a_docs.insert(a[i].document_name);
+        b_docs.insert(b[i].document_name);
+      }
+      ASSERT_EQ(b_docs, a_docs);
+    }
+  }
+
+  // An index of just part of the corpus has just those documents.
+  ASSERT_LT(0, corpus.WriteIndex(100, 50, kSyntheticIndex));
+  {
+    hw3::QueryProcessor part(list<string>{kSyntheticIndex}, true);
+    vector<string> query{SyntheticCorpus::Word(0)};
+    vector<hw3::QueryProcessor::QueryResult> results =
+      part.ProcessQuery(query);
+    ASSERT_LT(0U, results.size());
+    for (const auto& result : results) {
+      ASSERT_LE(corpus.DocName(100), result.document_name);
+    }
+  }
+
+  unlink(kSyntheticIndex);
+  unlink(TermDictionary::DictionaryName(kSyntheticIndex).c_str());
+  unlink(kCrawledIndex);
+  unlink(TermDictionary::DictionaryName(kCrawledIndex).c_str());
+  RemoveCorpus(corpus);
+  ASSERT_NE(0, access(kCorpusDir, F_OK));
+}
+
+}  // namespace hw4
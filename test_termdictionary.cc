@@ -0,0 +1,209 @@
+#include <unistd.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "libhw2/CrawlFileTree.h"
+}
+#include "./IndexWriter.h"
+#include "./SegmentQueryProcessor.h"
+#include "./TermDictionary.h"
+#include "./libhw3/DocIDTableReader.h"
+#include "./libhw3/FileIndexReader.h"
+#include "./libhw3/QueryProcessor.h"
+#include "./libhw3/WriteIndex.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::list;
+using std::string;
+using std::vector;
+
+namespace hw4 {
+
+static const char* kDictIndex = "test_files/dict.idx";
+static const char* kNoDictIndex = "test_files/nodict.idx";
+
+// Returns the sorted docIDs in "ditr", and frees it.
+static vector<DocID_t> DocIDs(hw3::DocIDTableReader* ditr) {
+  vector<DocID_t> ids;
+  for (const hw3::DocIDElementHeader& header : ditr->GetDocIDList()) {
+    ids.push_back(header.doc_id);
+  }
+  delete ditr;
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+TEST(Test_TermDictionary, LookupMatchesHashTable) {
+  char root[] = "test_files";
+  DocTable* dt;
+  MemIndex* mi;
+  ASSERT_TRUE(CrawlFileTree(root, &dt, &mi));
+  ASSERT_LT(0, WriteIndex(mi, dt, kDictIndex));
+  ASSERT_LT(0, hw3::WriteIndex(mi, dt, kNoDictIndex));
+
+  hw3::FileIndexReader fir(kDictIndex, true);
+  TermDictionary dict(kDictIndex);
+  ASSERT_TRUE(dict.Open(fir.getHeader().checksum, true));
+  ASSERT_EQ(static_cast<size_t>(MemIndex_NumWords(mi)), dict.num_terms());
+
+  // Every word leads to the same docID table the hash table does.
+  hw3::IndexTableReader* itr = fir.NewIndexTableReader();
+  HTIterator* it = HTIterator_Allocate(mi);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    string word = static_cast<WordPostings*>(kv.value)->word;
+
+    TermInfo info;
+    ASSERT_TRUE(dict.Lookup(word, &info));
+    ASSERT_EQ(word, info.word);
+    vector<DocID_t> expected = DocIDs(itr->LookupWord(word));
+    ASSERT_EQ(expected.size(), static_cast<size_t>(info.num_docs));
+    FILE* f = fopen(kDictIndex, "rb");
+    ASSERT_EQ(expected,
+              DocIDs(new hw3::DocIDTableReader(f, info.postings_offset)));
+  }
+  HTIterator_Free(it);
+  delete itr;
+
+  TermInfo info;
+  ASSERT_FALSE(dict.Lookup("notawordinthecorpus", &info));
+  ASSERT_FALSE(dict.Lookup("", &info));
+  ASSERT_FALSE(dict.Lookup("\xff\xff", &info));
+
+  // A dictionary for some other version of the index is refused, and an
+  // index written by hw3 has none.
+  TermDictionary stale(kDictIndex);
+  ASSERT_FALSE(stale.Open(fir.getHeader().checksum + 1, true));
+  hw3::FileIndexReader no_dict_fir(kNoDictIndex, true);
+  TermDictionary missing(kNoDictIndex);
+  ASSERT_FALSE(missing.Open(no_dict_fir.getHeader().checksum, true));
+
+  // Queries give the same answers with and without the dictionary.
+  SegmentQueryProcessor with(list<string>{kDictIndex}, true);
+  ASSERT_TRUE(with.Open());
+  hw3::QueryProcessor without(list<string>{kNoDictIndex}, true);
+  for (const vector<string>& query : vector<vector<string>>{
+         {"this"}, {"this", "file"}, {"private"}, {"nosuchword"}}) {
+    vector<hw3::QueryProcessor::QueryResult> a = with.ProcessQuery(query);
+    vector<hw3::QueryProcessor::QueryResult> b = without.ProcessQuery(query);
+    ASSERT_EQ(b.size(), a.size());
+    for (size_t i = 0; i < a.size(); i++) {
+      ASSERT_EQ(b[i].rank, a[i].rank);
+    }
+  }
+
+  MemIndex_Free(mi);
+  DocTable_Free(dt);
+  unlink(kDictIndex);
+  unlink(TermDictionary::DictionaryName(kDictIndex).c_str());
+  unlink(kNoDictIndex);
+}
+
+TEST(Test_TermDictionary, PrefixQueries) {
+  char root[] = "test_files";
+  DocTable* dt;
+  MemIndex* mi;
+  ASSERT_TRUE(CrawlFileTree(root, &dt, &mi));
+  ASSERT_LT(0, WriteIndex(mi, dt, kDictIndex));
+  vector<string> words;
+  HTIterator* it = HTIterator_Allocate(mi);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    words.push_back(static_cast<WordPostings*>(kv.value)->word);
+  }
+  HTIterator_Free(it);
+  std::sort(words.begin(), words.end());
+
+  hw3::FileIndexReader fir(kDictIndex, true);
+  TermDictionary dict(kDictIndex);
+  ASSERT_TRUE(dict.Open(fir.getHeader().checksum, true));
+  hw3::QueryProcessor qp(list<string>{kDictIndex}, true);
+  SegmentQueryProcessor sqp(list<string>{kDictIndex}, true);
+  ASSERT_TRUE(sqp.Open());
+
+  for (const string prefix : {"p", "sh", "c", "zzzz", ""}) {
+    // The expansion is exactly the sorted words with the prefix...
+    vector<string> expected;
+    for (const string& word : words) {
+      if (word.compare(0, prefix.size(), prefix) == 0) {
+        expected.push_back(word);
+      }
+    }
+    vector<TermInfo> terms;
+    ASSERT_TRUE(dict.ExpandPrefix(prefix, words.size(), &terms));
+    vector<string> expanded;
+    for (const TermInfo& term : terms) {
+      expanded.push_back(term.word);
+    }
+    ASSERT_EQ(expected, expanded);
+
+    // ...or its first "max_terms" words.
+    if (expected.size() > 3) {
+      terms.clear();
+      ASSERT_FALSE(dict.ExpandPrefix(prefix, 3, &terms));
+      ASSERT_EQ(3U, terms.size());
+      ASSERT_EQ(expected[2], terms[2].word);
+    }
+
+    // A prefix query ranks each document by the sum of the ranks of the
+    // words it expands to, and says when it had to stop expanding.
+    if (prefix.empty()) {
+      continue;
+    }
+    bool truncated;
+    sqp.ProcessQuery(vector<string>{prefix + "*"}, nullptr, &truncated);
+    ASSERT_EQ(expected.size() > SegmentQueryProcessor::kMaxPrefixTerms,
+              truncated);
+    vector<bool> batch_truncated;
+    sqp.ProcessQueries({{prefix + "*"}, {"private"}}, 2, &batch_truncated);
+    ASSERT_EQ((vector<bool>{truncated, false}), batch_truncated);
+    if (truncated) {
+      continue;
+    }
+    std::map<string, int> sums;
+    for (const string& word : expected) {
+      for (const auto& result : qp.ProcessQuery(vector<string>{word})) {
+        sums[result.document_name] += result.rank;
+      }
+    }
+    std::map<string, int> ranks;
+    for (const auto& result : sqp.ProcessQuery(vector<string>{prefix + "*"})) {
+      ranks[result.document_name] = result.rank;
+    }
+    ASSERT_EQ(sums, ranks);
+  }
+
+  // Prefix and plain terms combine: a document must match both.
+  std::map<string, int> prefix_ranks, expected;
+  for (const auto& result : sqp.ProcessQuery(vector<string>{"sh*"})) {
+    prefix_ranks[result.document_name] = result.rank;
+  }
+  for (const auto& result : qp.ProcessQuery(vector<string>{"private"})) {
+    if (prefix_ranks.count(result.document_name) == 1) {
+      expected[result.document_name] =
+        result.rank + prefix_ranks[result.document_name];
+    }
+  }
+  std::map<string, int> combined;
+  for (const auto& result :
+         sqp.ProcessQuery(vector<string>{"private", "sh*"})) {
+    combined[result.document_name] = result.rank;
+  }
+  ASSERT_LT(0U, expected.size());
+  ASSERT_EQ(expected, combined);
+
+  MemIndex_Free(mi);
+  DocTable_Free(dt);
+  unlink(kDictIndex);
+  unlink(TermDictionary::DictionaryName(kDictIndex).c_str());
+}
+
+}  // namespace hw4
@@ -1,5 +1,7 @@
 #include <unistd.h>
 
+#include <atomic>
+
 #include "gtest/gtest.h"
 extern "C" {
   #include "libhw1/CSE333.h"
@@ -51,4 +53,72 @@ TEST(Test_ThreadPool, TestThreadPoolBasic) {
   ASSERT_EQ((uint32_t) 300, workcount);
 }
 
+static std::atomic<int> started, finished, shed;
+static std::atomic<bool> released;
+
+// Waits until "released" before finishing.
+static void BlockingTaskFn(ThreadPool::Task* t) {
+  started++;
+  while (!released) {
+    usleep(1000);
+  }
+  finished++;
+  delete t;
+}
+
+// Takes 10ms, unless it's shed.
+static void SlowTaskFn(ThreadPool::Task* t) {
+  if (t->shed_) {
+    shed++;
+  } else {
+    usleep(10000);
+  }
+  finished++;
+  delete t;
+}
+
+TEST(Test_ThreadPool, BoundedQueue) {
+  started = finished = 0;
+  released = false;
+  ThreadPool tp(1, 2);
+  ASSERT_TRUE(tp.Dispatch(new ThreadPool::Task(BlockingTaskFn)));
+  while (started == 0) {
+    usleep(1000);
+  }
+
+  // With the thread busy, two Tasks fit in the queue and a third doesn't.
+  ThreadPool::Task* refused = new ThreadPool::Task(BlockingTaskFn);
+  ASSERT_TRUE(tp.Dispatch(new ThreadPool::Task(BlockingTaskFn)));
+  ASSERT_TRUE(tp.Dispatch(new ThreadPool::Task(BlockingTaskFn)));
+  ASSERT_FALSE(tp.Dispatch(refused));
+  delete refused;
+  ASSERT_EQ(2U, tp.queue_length());
+  ASSERT_EQ(1U, tp.num_refused());
+
+  released = true;
+  while (finished < 3) {
+    usleep(1000);
+  }
+  ASSERT_EQ(0U, tp.queue_length());
+  ASSERT_EQ(0U, tp.num_shed());
+}
+
+TEST(Test_ThreadPool, ShedsStandingQueue) {
+  finished = shed = 0;
+  const int kNumTasks = 40;
+
+  // One thread can't keep up with a burst of 10ms Tasks, so the queue
+  // stands well above a 5ms target and the pool starts shedding.
+  ThreadPool tp(1, 0, 5, 20);
+  for (int i = 0; i < kNumTasks; i++) {
+    ASSERT_TRUE(tp.Dispatch(new ThreadPool::Task(SlowTaskFn)));
+  }
+  while (finished < kNumTasks) {
+    usleep(1000);
+  }
+  ASSERT_GT(shed, 0);
+  ASSERT_LT(shed, kNumTasks - 1);
+  ASSERT_EQ(static_cast<uint64_t>(shed), tp.num_shed());
+}
+
 }  // namespace hw4
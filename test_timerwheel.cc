@@ -0,0 +1,111 @@
+#include <stdint.h>
+
+#include <vector>
+
+#include "./TimerWheel.h"
+
+#include "gtest/gtest.h"
+#include "./test_suite.h"
+
+using std::vector;
+
+namespace hw4 {
+
+TEST(Test_TimerWheel, FiresOnTime) {
+  TimerWheel wheel(1000);
+  vector<uint64_t> fired;
+  // Timers for each level of the wheel, and one beyond its reach.
+  vector<uint64_t> delays = {0, 1, 5, 63, 64, 65, 100, 4095, 4096, 5000,
+                             300000, (uint64_t(1) << 24) + 7};
+  for (uint64_t delay : delays) {
+    uint64_t expiry = 1000 + delay;
+    wheel.Schedule(expiry, [&wheel, &fired, expiry]() {
+        // Nothing fires early or late.
+        ASSERT_EQ(expiry == 1000 ? 1001 : expiry, wheel.now());
+        fired.push_back(expiry);
+      });
+  }
+  ASSERT_EQ(delays.size(), wheel.size());
+
+  // Step through in uneven strides.
+  uint64_t now = 1000;
+  for (uint64_t stride = 1; now < 1000 + (uint64_t(1) << 24) + 10;
+       stride = stride * 3 + 1) {
+    now += stride;
+    wheel.Advance(now);
+  }
+  ASSERT_EQ(0U, wheel.size());
+  ASSERT_EQ(delays.size(), fired.size());
+  for (size_t i = 0; i < delays.size(); i++) {
+    ASSERT_EQ(1000 + delays[i], fired[i]);
+  }
+}
+
+TEST(Test_TimerWheel, FiresOnLevelBoundaries) {
+  TimerWheel wheel(1000);
+  vector<uint64_t> fired;
+  // Expiries where each level's slots come around to zero, so the timers
+  // are cascaded down on the very tick they're due.
+  vector<uint64_t> expiries = {1024, 4096, uint64_t(1) << 18,
+                               uint64_t(1) << 24, uint64_t(1) << 25};
+  for (uint64_t expiry : expiries) {
+    wheel.Schedule(expiry, [&wheel, &fired, expiry]() {
+        ASSERT_EQ(expiry, wheel.now());
+        fired.push_back(expiry);
+      });
+  }
+  for (uint64_t expiry : expiries) {
+    ASSERT_EQ(1U, wheel.Advance(expiry));
+  }
+  ASSERT_EQ(expiries, fired);
+}
+
+TEST(Test_TimerWheel, Cancel) {
+  TimerWheel wheel;
+  int fired = 0;
+  TimerWheel::TimerId near = wheel.Schedule(10, [&fired]() { fired++; });
+  TimerWheel::TimerId far = wheel.Schedule(10000, [&fired]() { fired++; });
+  wheel.Schedule(20, [&fired]() { fired++; });
+  ASSERT_NE(0U, near);
+  ASSERT_TRUE(wheel.Cancel(near));
+  ASSERT_FALSE(wheel.Cancel(near));
+  ASSERT_EQ(1U, wheel.Advance(100));
+  ASSERT_EQ(1, fired);
+
+  // A callback may cancel a timer due at the same moment, and schedule
+  // new ones.
+  TimerWheel::TimerId second = 0;
+  wheel.Schedule(200, [&]() {
+      fired++;
+      ASSERT_TRUE(wheel.Cancel(second));
+      wheel.Schedule(150, [&fired]() { fired++; });
+    });
+  second = wheel.Schedule(200, [&fired]() { fired++; });
+  ASSERT_EQ(2U, wheel.Advance(300));
+  ASSERT_EQ(3, fired);
+
+  ASSERT_TRUE(wheel.Cancel(far));
+  ASSERT_EQ(0U, wheel.size());
+  ASSERT_EQ(0U, wheel.Advance(20000));
+  ASSERT_EQ(20000U, wheel.now());
+}
+
+TEST(Test_TimerWheel, ManyTimers) {
+  TimerWheel wheel;
+  const int kNumTimers = 200000;
+  int fired = 0;
+  vector<TimerWheel::TimerId> ids;
+  for (int i = 0; i < kNumTimers; i++) {
+    ids.push_back(wheel.Schedule(1 + (i * 7919) % 30000,
+                                 [&fired]() { fired++; }));
+  }
+  // Cancel every other one, as connections that finish in time would.
+  for (int i = 0; i < kNumTimers; i += 2) {
+    ASSERT_TRUE(wheel.Cancel(ids[i]));
+  }
+  ASSERT_EQ(static_cast<size_t>(kNumTimers / 2), wheel.size());
+  ASSERT_EQ(static_cast<size_t>(kNumTimers / 2), wheel.Advance(30000));
+  ASSERT_EQ(kNumTimers / 2, fired);
+}
+
+}  // namespace hw4